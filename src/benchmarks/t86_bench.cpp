@@ -8,8 +8,9 @@ using namespace tiny::t86;
 
 class T86Runner: public bench::Fixture {
 public:
-    void Run(const std::string& path) {
+    void Run(const std::string& path, Cpu::Mode mode = Cpu::Mode::Cycle) {
         OS os;
+        os.SetMode(mode);
         std::ifstream fs{TEST_CASE_DIRECTORY + path};
         Parser parser(fs);
         Program p = parser.Parse();
@@ -25,6 +26,14 @@ BENCH(T86Runner, T86Prime) {
     Run("/benches/prime.t86");
 }
 
+BENCH(T86Runner, T86QuicksortFunctional) {
+    Run("/benches/quicksort.t86", Cpu::Mode::Functional);
+}
+
+BENCH(T86Runner, T86PrimeFunctional) {
+    Run("/benches/prime.t86", Cpu::Mode::Functional);
+}
+
 int main(int argc, char* argv[]) {
     if (argc < 2) {
         fmt::print("usage: {} bench\n", argv[0]);
@@ -32,5 +41,7 @@ int main(int argc, char* argv[]) {
     }
     RUN_BENCHMARK(T86Quicksort);
     RUN_BENCHMARK(T86Prime);
+    RUN_BENCHMARK(T86QuicksortFunctional);
+    RUN_BENCHMARK(T86PrimeFunctional);
     fmt::print("Unknown benchmark\n");
 }
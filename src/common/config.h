@@ -68,6 +68,10 @@ namespace tiny {
             return i->second;
         }
 
+        bool has(std::string const & name) const {
+            return args_.find(name) != args_.end();
+        }
+
         std::string const & get(std::string const & name) const {
             auto i = args_.find(name);
             if (i == args_.end())
@@ -134,6 +134,31 @@ namespace utils {
         return result;
     }
 
+    /// Escapes 's' to be placed between the quotes of a JSON string.
+    inline std::string escape_json(std::string_view s) {
+        static const char* hex = "0123456789abcdef";
+        std::string result;
+        result.reserve(s.size());
+        for (const auto c: s) {
+            switch (c) {
+                case '"': result += "\\\""; break;
+                case '\\': result += "\\\\"; break;
+                case '\n': result += "\\n"; break;
+                case '\t': result += "\\t"; break;
+                case '\r': result += "\\r"; break;
+                default:
+                    if (static_cast<unsigned char>(c) < 0x20) {
+                        result += "\\u00";
+                        result += hex[(c >> 4) & 0xf];
+                        result += hex[c & 0xf];
+                    } else {
+                        result.push_back(c);
+                    }
+            }
+        }
+        return result;
+    }
+
     template<typename To, typename From>
     To reinterpret_safe(From from) {
         union {
@@ -66,6 +66,10 @@ commands:
 - expression = Evaluate the source language expression and print result.
 - source = Print the source code that is being debugged.
 - memory = Read and write to the RAM memory.
+- snapshot <file> = Save the state of the VM into a file.
+- reverse-istep = Go back by one instruction.
+- reverse-continue = Go back to the previous breakpoint or watchpoint hit.
+- reverse-finish = Go back to the call of current function.
 )";
     static constexpr const char* RUN_USAGE =
 R"(run [--arg=val [--arg=val ...]]
@@ -201,6 +205,26 @@ Display current function and active variables.
     static constexpr const char* CONTINUE_USAGE =
 R"(continue
 Continue execution until a debug event happens.
+)";
+    static constexpr const char* SNAPSHOT_USAGE =
+R"(snapshot <file>
+Save the registers, memory and instructions of the VM into a file.
+The breakpoints are not saved. Continue the saved run later
+with `t86-cli --restore <file>`.
+)";
+    static constexpr const char* REVERSE_ISTEP_USAGE =
+R"(reverse-istep
+Go back by one instruction. The VM keeps checkpoints of the run
+and replays the one before, the output is not printed again.
+)";
+    static constexpr const char* REVERSE_CONTINUE_USAGE =
+R"(reverse-continue
+Go back until a breakpoint or a watchpoint is hit, or to the
+beginning of the kept history.
+)";
+    static constexpr const char* REVERSE_FINISH_USAGE =
+R"(reverse-finish
+Go back to the call of current function.
 )";
 
 public:
@@ -939,6 +963,59 @@ Most often, the correct address will be one below it.)";
                                       idx, source.TypedValueToString(process, val));
     }
 
+    void HandleSnapshot(std::string_view command) {
+        if (!process.Active()) {
+            Error("No active process.");
+        }
+        if (!is_running) {
+            Error("Process finished executing, there is nothing to save.");
+        }
+        if (command == "") {
+            fmt::print("{}", SNAPSHOT_USAGE);
+            return;
+        }
+        process.Snapshot(std::string{command});
+        fmt::print("Saved the snapshot to '{}'\n", command);
+    }
+
+    void HandleReverse(std::string_view main_command, std::string_view command) {
+        if (!process.Active()) {
+            Error("No active process.");
+        }
+        DebugEvent e;
+        if (utils::is_prefix_of(main_command, "reverse-istep")) {
+            if (command != "") {
+                fmt::print("{}", REVERSE_ISTEP_USAGE);
+                return;
+            }
+            e = process.ReverseSingleStep();
+        } else if (utils::is_prefix_of(main_command, "reverse-continue")) {
+            if (command != "") {
+                fmt::print("{}", REVERSE_CONTINUE_USAGE);
+                return;
+            }
+            e = process.ReverseContinue();
+        } else {
+            if (command != "") {
+                fmt::print("{}", REVERSE_FINISH_USAGE);
+                return;
+            }
+            e = process.ReverseStepOut();
+        }
+        // Going back from the end lets the process run again
+        is_running = true;
+        if (!std::holds_alternative<Singlestep>(e)) {
+            ReportDebugEvent(e);
+        }
+        auto ip = process.GetIP();
+        auto line = source.AddrToLine(ip);
+        if (!line || utils::is_prefix_of(main_command, "reverse-istep")) {
+            PrettyPrintText(ip);
+        } else {
+            PrettyPrintCode(*line);
+        }
+    }
+
     void HandleHelp(std::string_view command) {
         if (command == "") {
             fmt::print("{}", USAGE);
@@ -974,6 +1051,14 @@ Most often, the correct address will be one below it.)";
             fmt::print("{}", SOURCE_USAGE);
         } else if (utils::is_prefix_of(command, "expression")) {
             fmt::print("{}", EXPRESSION_USAGE);
+        } else if (utils::is_prefix_of(command, "snapshot")) {
+            fmt::print("{}", SNAPSHOT_USAGE);
+        } else if (utils::is_prefix_of(command, "reverse-istep")) {
+            fmt::print("{}", REVERSE_ISTEP_USAGE);
+        } else if (utils::is_prefix_of(command, "reverse-continue")) {
+            fmt::print("{}", REVERSE_CONTINUE_USAGE);
+        } else if (utils::is_prefix_of(command, "reverse-finish")) {
+            fmt::print("{}", REVERSE_FINISH_USAGE);
         } else {
             fmt::print("{}", USAGE);
         }
@@ -1041,6 +1126,12 @@ Most often, the correct address will be one below it.)";
             HandleFrame(command);
         } else if (utils::is_prefix_of(main_command, "source")) {
             HandleSource(command);
+        } else if (utils::is_prefix_of(main_command, "snapshot")) {
+            HandleSnapshot(command);
+        } else if (utils::is_prefix_of(main_command, "reverse-istep")
+                || utils::is_prefix_of(main_command, "reverse-continue")
+                || utils::is_prefix_of(main_command, "reverse-finish")) {
+            HandleReverse(main_command, command);
         } else if (utils::is_prefix_of(main_command, "expression")
                 || utils::is_prefix_of(main_command, "print")) {
             HandleExpression(command);
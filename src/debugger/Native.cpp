@@ -197,6 +197,28 @@ DebugEvent Native::PerformStepOut() {
     }
 }
 
+DebugEvent Native::ReverseSingleStep() {
+    return MapReverseReasonToEvent(process->ReverseSinglestep());
+}
+
+DebugEvent Native::ReverseContinue() {
+    return MapReverseReasonToEvent(process->ReverseContinue());
+}
+
+DebugEvent Native::ReverseStepOut() {
+    return MapReverseReasonToEvent(process->ReverseStepOut());
+}
+
+DebugEvent Native::MapReverseReasonToEvent(StopReason reason) {
+    // Whatever was cached belongs to the forgotten future
+    cached_event.reset();
+    // The VM stops before the instruction with the breakpoint,
+    // not after the BKPT, so the IP is already right.
+    if (reason == StopReason::SoftwareBreakpointHit) {
+        return BreakpointHit{BPType::Software, GetIP()};
+    }
+    return MapReasonToEvent(reason);
+}
 
 size_t Native::TextSize() {
     return process->TextSize();
@@ -382,6 +404,7 @@ void Native::RemoveWatchpoint(uint64_t address) {
     
     auto dbg_regs = process->FetchDebugRegisters();
     Arch::DeactivateDebugRegister(wp->second.hw_reg, dbg_regs);
+    process->SetDebugRegisters(dbg_regs);
     watchpoints.erase(address); 
 }
 
@@ -393,6 +416,29 @@ const std::map<uint64_t, SoftwareBreakpoint>& Native::GetBreakpoints() {
     return software_breakpoints;
 }
 
+void Native::Snapshot(const std::string& path) {
+    std::vector<uint64_t> enabled;
+    for (const auto& [address, bp] : software_breakpoints) {
+        if (bp.enabled) {
+            enabled.push_back(address);
+        }
+    }
+    for (auto address : enabled) {
+        DisableSoftwareBreakpoint(address);
+    }
+    try {
+        process->Snapshot(path);
+    } catch (...) {
+        for (auto address : enabled) {
+            EnableSoftwareBreakpoint(address);
+        }
+        throw;
+    }
+    for (auto address : enabled) {
+        EnableSoftwareBreakpoint(address);
+    }
+}
+
 void Native::Terminate() {
     process->Terminate();
 }
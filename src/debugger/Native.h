@@ -142,6 +142,10 @@ public:
     /// does not represent a running process.
     const std::map<uint64_t, SoftwareBreakpoint>& GetBreakpoints();
 
+    /// Saves the state of the debugee into the file, without
+    /// the software breakpoints.
+    void Snapshot(const std::string& path);
+
     /// Terminates the debugee, no other calls should
     /// be made after this.
     void Terminate();
@@ -159,7 +163,23 @@ public:
 
     /// Does singlestep, does not check for breakpoints.
     DebugEvent DoRawSingleStep();
+
+    /// Goes back by one instruction, returns ExecutionBegin
+    /// if there is no recorded history before it.
+    DebugEvent ReverseSingleStep();
+
+    /// Goes back to the last breakpoint or watchpoint hit, the breakpoints
+    /// and watchpoints are the current ones. Returns ExecutionBegin
+    /// if there is none in the recorded history.
+    DebugEvent ReverseContinue();
+
+    /// Goes back to the call instruction of the current function,
+    /// or to a breakpoint or watchpoint hit on the way.
+    DebugEvent ReverseStepOut();
 protected:
+    /// Maps the reason of a stop after going back to an event.
+    DebugEvent MapReverseReasonToEvent(StopReason reason);
+
     /// Maps the DebugEvent to a reason.
     DebugEvent MapReasonToEvent(StopReason reason);
 
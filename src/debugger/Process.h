@@ -38,6 +38,17 @@ public:
     virtual void ResumeExecution() = 0;
     virtual size_t TextSize() = 0;
     virtual void Wait() = 0;
+    /// Saves the state of the stopped process into the file.
+    virtual void Snapshot(const std::string& path) = 0;
+    /// Goes back by one instruction in the recorded history of the process.
+    /// Returns ExecutionBegin if there is nothing before, Singlestep otherwise.
+    /// Throws DebuggerError if the process keeps no history.
+    virtual StopReason ReverseSinglestep() = 0;
+    /// Goes back to the last breakpoint or watchpoint hit, the reason
+    /// is the one of the hit, or to the start of the history.
+    virtual StopReason ReverseContinue() = 0;
+    /// Goes back to the call of the current function, or to a hit on the way.
+    virtual StopReason ReverseStepOut() = 0;
     /// Cause the process to end, the class should not be used
     /// after this function is called.
     virtual void Terminate() = 0;
@@ -69,7 +69,14 @@ StopReason T86Process::GetReason() {
     if (!reason_opt) {
         throw DebuggerError("REASON error");
     }
-    auto &r = *reason_opt;
+    auto reason = ParseReason(*reason_opt);
+    if (!reason) {
+        UNREACHABLE;
+    }
+    return *reason;
+}
+
+std::optional<StopReason> T86Process::ParseReason(std::string_view r) {
     if (r == "START") {
         return StopReason::ExecutionBegin;
     } else if (r == "SW_BKPT") {
@@ -82,9 +89,8 @@ StopReason T86Process::GetReason() {
         return StopReason::ExecutionEnd;
     } else if (r == "CPU_ERROR") {
         return StopReason::CpuError;
-    } else {
-        UNREACHABLE;
     }
+    return std::nullopt;
 }
 
 void T86Process::Singlestep() {
@@ -162,6 +168,42 @@ void T86Process::Wait() {
     }
 }
 
+void T86Process::Snapshot(const std::string& path) {
+    process->Send(fmt::format("SNAPSHOT {}", path));
+    auto response = process->Receive();
+    if (!response) {
+        throw DebuggerError("SNAPSHOT error");
+    }
+    if (*response != "OK") {
+        throw DebuggerError(fmt::format("Could not save the snapshot: {}", *response));
+    }
+}
+
+StopReason T86Process::ReverseSinglestep() {
+    return Reverse("REVERSESTEP");
+}
+
+StopReason T86Process::ReverseContinue() {
+    return Reverse("REVERSECONTINUE");
+}
+
+StopReason T86Process::ReverseStepOut() {
+    return Reverse("REVERSEFINISH");
+}
+
+StopReason T86Process::Reverse(std::string_view command) {
+    process->Send(std::string(command));
+    auto response = process->Receive();
+    if (!response) {
+        throw DebuggerError(fmt::format("{} error", command));
+    }
+    auto reason = ParseReason(*response);
+    if (!reason) {
+        throw DebuggerError(fmt::format("Could not go back: {}", *response));
+    }
+    return *reason;
+}
+
 void T86Process::Terminate() {
     process->Send("TERMINATE");
     CheckResponse("TERMINATE fail");
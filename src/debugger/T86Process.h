@@ -3,6 +3,7 @@
 #include <vector>
 #include <memory>
 #include <functional>
+#include <optional>
 
 #include "common/messenger.h"
 #include "common/logger.h"
@@ -84,6 +85,19 @@ public:
     /// after previous call to ResumeExecution.
     void Wait() override;
 
+    /// Saves the state of the VM into the file, it can be
+    /// continued later with `t86-cli --restore`.
+    void Snapshot(const std::string& path) override;
+
+    /// Goes back by one instruction in the history kept by the VM.
+    StopReason ReverseSinglestep() override;
+
+    /// Goes back to the last breakpoint or watchpoint hit.
+    StopReason ReverseContinue() override;
+
+    /// Goes back to the call of the current function.
+    StopReason ReverseStepOut() override;
+
     /// Terminates the process. Any subsequent call to any other
     /// method is undefined after this.
     void Terminate() override;
@@ -113,6 +127,12 @@ private:
 
     void CheckResponse(std::string_view error_message);
 
+    /// Maps the reason sent by the VM, nullopt if it is an error message.
+    static std::optional<StopReason> ParseReason(std::string_view reason);
+
+    /// Sends the command to go back and returns where the VM stopped.
+    StopReason Reverse(std::string_view command);
+
     std::unique_ptr<Messenger> process;
     const size_t data_size{1024};
     const size_t gen_purpose_regs_count{8};
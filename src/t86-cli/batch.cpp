@@ -0,0 +1,256 @@
+#include "batch.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <fmt/core.h>
+
+#include "common/config.h"
+#include "common/helpers.h"
+#include "t86-parser/parser.h"
+#include "t86/utils/parallel_for.h"
+
+namespace tiny::t86 {
+    namespace {
+        /// Number of ticks between two looks at the clock.
+        constexpr std::size_t timeCheckInterval = 1024;
+
+        tiny::Config caseConfig(const std::vector<std::string>& options) {
+            std::vector<std::string> args{"batch"};
+            args.insert(args.end(), options.begin(), options.end());
+            std::vector<char*> argv;
+            for (auto& arg : args) {
+                argv.push_back(arg.data());
+            }
+            tiny::Config config;
+            config.parse(static_cast<int>(argv.size()), argv.data());
+            return config;
+        }
+
+        std::size_t sizeOption(const tiny::Config& config, const char* name, std::size_t defaultValue) {
+            if (!config.has(name)) {
+                return defaultValue;
+            }
+            auto value = utils::svtonum<std::size_t>(config.get(name));
+            if (!value) {
+                throw std::invalid_argument("Option `" + std::string(name) + "` expects a number, got `" + config.get(name) + "`");
+            }
+            return *value;
+        }
+
+        Cpu::Mode modeOption(const tiny::Config& config, Cpu::Mode defaultMode) {
+            if (!config.has("-mode")) {
+                return defaultMode;
+            }
+            const std::string& mode = config.get("-mode");
+            if (mode == "cycle") {
+                return Cpu::Mode::Cycle;
+            }
+            if (mode == "functional") {
+                return Cpu::Mode::Functional;
+            }
+            throw std::invalid_argument("Unknown mode `" + mode + "`, expected `cycle` or `functional`");
+        }
+    }
+
+    const char* BatchResult::statusName(Status status) {
+        switch (status) {
+            case Status::Halted: return "halted";
+            case Status::TickLimit: return "tick-limit";
+            case Status::Timeout: return "timeout";
+            case Status::Error: return "error";
+        }
+        return "?";
+    }
+
+    std::vector<BatchCase> BatchRunner::parseManifest(std::istream& is, const std::filesystem::path& directory) {
+        auto resolve = [&](const std::string& path) {
+            return std::filesystem::path(path).is_absolute() ? path : (directory / path).string();
+        };
+        std::vector<BatchCase> cases;
+        std::string line;
+        for (std::size_t lineNumber = 1; std::getline(is, line); ++lineNumber) {
+            std::istringstream tokens(line);
+            std::string token;
+            if (!(tokens >> token) || token[0] == '#') {
+                continue;
+            }
+            BatchCase batchCase;
+            batchCase.program = resolve(token);
+            if (tokens >> token) {
+                if (token != "-" && token[0] == '-') {
+                    batchCase.options.push_back(token);
+                } else if (token != "-") {
+                    batchCase.input = resolve(token);
+                }
+            }
+            while (tokens >> token) {
+                if (token[0] != '-') {
+                    throw std::invalid_argument(fmt::format("Unexpected `{}` on line {} of the manifest, options start with `-`", token, lineNumber));
+                }
+                batchCase.options.push_back(token);
+            }
+            cases.push_back(std::move(batchCase));
+        }
+        return cases;
+    }
+
+    std::size_t BatchRunner::jobs() const {
+        if (options_.jobs != 0) {
+            return options_.jobs;
+        }
+        return std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    std::vector<BatchResult> BatchRunner::run(const std::vector<BatchCase>& cases) const {
+        // Every distinct program is parsed once, the cases share it
+        std::unordered_map<std::string, std::size_t> programIndex;
+        std::vector<std::string> programPaths;
+        for (const auto& batchCase : cases) {
+            if (programIndex.emplace(batchCase.program, programPaths.size()).second) {
+                programPaths.push_back(batchCase.program);
+            }
+        }
+        std::vector<std::shared_ptr<const Program>> programs(programPaths.size());
+        std::vector<std::string> parseErrors(programPaths.size());
+        parallelFor(programPaths.size(), jobs(), [&](std::size_t i, std::size_t) {
+            std::ifstream f(programPaths[i]);
+            if (!f) {
+                parseErrors[i] = "Unable to open file `" + programPaths[i] + "`";
+                return;
+            }
+            try {
+                Parser parser(f);
+                programs[i] = std::make_shared<const Program>(parser.Parse());
+            } catch (const std::exception& e) {
+                parseErrors[i] = e.what();
+            }
+        });
+
+        std::vector<BatchResult> results(cases.size());
+        parallelFor(cases.size(), jobs(), [&](std::size_t i, std::size_t) {
+            std::size_t program = programIndex.at(cases[i].program);
+            if (programs[program] == nullptr) {
+                results[i].error = parseErrors[program];
+                return;
+            }
+            results[i] = runCase(cases[i], programs[program]);
+        });
+        return results;
+    }
+
+    BatchResult BatchRunner::runCase(const BatchCase& batchCase, const std::shared_ptr<const Program>& program) const {
+        auto start = std::chrono::steady_clock::now();
+        BatchResult result;
+        StatsLogger stats;
+        stats.setLevel(options_.statsLevel);
+        std::ostringstream output;
+        std::ifstream inputFile;
+        std::istringstream noInput;
+        std::unique_ptr<Cpu> cpu;
+        Cpu::Mode mode = options_.mode;
+        std::size_t calls = 0;
+        // The functional engine does not log ticks, one call executes one instruction
+        auto ticks = [&]() {
+            return mode == Cpu::Mode::Functional ? calls : stats.tickCount();
+        };
+        try {
+            tiny::Config config = caseConfig(batchCase.options);
+            Cpu::Context context;
+            context.config = Cpu::Config(config);
+            context.stats = &stats;
+            context.output = &output;
+            context.input = &noInput;
+            if (!batchCase.input.empty()) {
+                inputFile.open(batchCase.input);
+                if (!inputFile) {
+                    throw std::runtime_error("Unable to open file `" + batchCase.input + "`");
+                }
+                context.input = &inputFile;
+            }
+            mode = modeOption(config, options_.mode);
+            std::size_t maxTicks = sizeOption(config, "-maxTicks", options_.maxTicks);
+            std::chrono::milliseconds timeout{sizeOption(config, "-timeout", options_.timeout.count())};
+
+            std::size_t aluCount = context.config.aluCnt();
+            // Without its own option the station has two entries per ALU, the same as in OS
+            std::size_t entries = sizeOption(config, Cpu::Config::reservationStationEntriesCountConfigString, 2 * aluCount);
+            cpu = std::make_unique<Cpu>(sizeOption(config, Cpu::Config::registerCountConfigString, options_.registerCount),
+                                        sizeOption(config, Cpu::Config::floatRegisterCountConfigString, options_.floatRegisterCount),
+                                        aluCount,
+                                        entries,
+                                        sizeOption(config, Cpu::Config::ramSizeConfigString, options_.memorySize),
+                                        context.config.ramGatesCount(),
+                                        context);
+            cpu->setMode(mode);
+            cpu->setSkipIdleTicks(options_.skipIdleTicks || config.has("-skipIdle"));
+            if (!config.has(Cpu::Config::branchPredictorConfigString)) {
+                cpu->setBranchPredictor(BranchPredictor::create(options_.branchPredictor));
+            }
+            cpu->start(program);
+
+            result.status = BatchResult::Status::Halted;
+            while (!cpu->halted()) {
+                if (maxTicks != 0 && ticks() >= maxTicks) {
+                    result.status = BatchResult::Status::TickLimit;
+                    break;
+                }
+                if (timeout.count() != 0 && calls % timeCheckInterval == 0
+                        && std::chrono::steady_clock::now() - start >= timeout) {
+                    result.status = BatchResult::Status::Timeout;
+                    break;
+                }
+                cpu->tick();
+                ++calls;
+                // Interrupts 1 to 3 are for the debugger, there is none here
+                if (int n = cpu->interrupted(); n > 3) {
+                    throw std::runtime_error(fmt::format("No interrupt handler for interrupt no. {}!", n));
+                }
+            }
+        } catch (const std::exception& e) {
+            result.status = BatchResult::Status::Error;
+            result.error = e.what();
+        }
+        result.ticks = ticks();
+        result.instructions = cpu ? cpu->retiredInstructions() : 0;
+        result.output = output.str();
+        result.mispredictions = stats.mispredictionCount();
+        result.flushes = stats.flushCount();
+        if (stats.level() != StatsLogger::Level::Off) {
+            result.stages = stats.retiredTotals();
+        }
+        result.time = std::chrono::steady_clock::now() - start;
+        return result;
+    }
+
+    void BatchRunner::writeSummary(std::ostream& os, const std::vector<BatchCase>& cases, const std::vector<BatchResult>& results,
+                                   const std::filesystem::path& outputDirectory) {
+        os << "{\"cases\":[";
+        for (std::size_t i = 0; i < cases.size(); ++i) {
+            const BatchCase& batchCase = cases[i];
+            const BatchResult& result = results[i];
+            os << (i == 0 ? "\n" : ",\n")
+               << "{\"program\":\"" << utils::escape_json(batchCase.program)
+               << "\",\"input\":\"" << utils::escape_json(batchCase.input)
+               << "\",\"status\":\"" << BatchResult::statusName(result.status)
+               << "\",\"ticks\":" << result.ticks
+               << ",\"instructions\":" << result.instructions
+               << ",\"seconds\":" << result.time.count();
+            if (!result.error.empty()) {
+                os << ",\"error\":\"" << utils::escape_json(result.error) << "\"";
+            }
+            if (outputDirectory.empty()) {
+                os << ",\"output\":\"" << utils::escape_json(result.output) << "\"";
+            } else {
+                auto path = outputDirectory / (std::to_string(i) + ".out");
+                std::ofstream(path) << result.output;
+                os << ",\"outputFile\":\"" << utils::escape_json(path.string()) << "\"";
+            }
+            os << "}";
+        }
+        os << "\n]}\n";
+    }
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <filesystem>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "t86/cpu.h"
+#include "t86/utils/stats_logger.h"
+
+namespace tiny::t86 {
+    /// One run of the batch, a line of the manifest.
+    struct BatchCase {
+        std::string program;
+        /// File read by GETCHAR, empty if the program gets no input
+        std::string input;
+        /// Options in the same form as on the command line, for example `-aluCnt=2`
+        std::vector<std::string> options;
+    };
+
+    struct BatchResult {
+        enum class Status {
+            Halted,
+            TickLimit,
+            Timeout,
+            Error,
+        };
+
+        static const char* statusName(Status status);
+
+        Status status{Status::Error};
+        std::size_t ticks{0};
+        std::size_t instructions{0};
+        std::chrono::duration<double> time{0};
+        std::size_t mispredictions{0};
+        std::size_t flushes{0};
+        /// Ticks the retired instructions spent in each stage, if the stats were kept
+        StatsLogger::LifeTimeTotals stages;
+        /// What the program printed with PUTCHAR and PUTNUM
+        std::string output;
+        std::string error;
+    };
+
+    /**
+     * Runs many programs with their inputs on a pool of threads, each case
+     * on its own cpu with its own context. Every distinct program is parsed
+     * only once and shared by all the cases that run it.
+     *
+     * The manifest has one case per line, the program, optionally the file
+     * with its input (`-` for none) and the options of the case. Those are
+     * the cpu options (`-aluCnt=2`, `-reservationStationEntriesCnt=4`, ...) and the
+     * options of the batch below, which override the defaults for the case:
+     * `-mode=cycle|functional`, `-skipIdle`, `-maxTicks=N` and `-timeout=MS`.
+     * Empty lines and lines starting with `#` are skipped.
+     */
+    class BatchRunner {
+    public:
+        struct Options {
+            std::size_t registerCount{8};
+            std::size_t floatRegisterCount{4};
+            std::size_t memorySize{1024};
+            Cpu::Mode mode{Cpu::Mode::Cycle};
+            bool skipIdleTicks{false};
+            /// Used by the cases that do not choose their own
+            std::string branchPredictor{"naive"};
+            /// Zero means no limit
+            std::size_t maxTicks{0};
+            /// Wall-clock limit of one case, zero means no limit
+            std::chrono::milliseconds timeout{0};
+            /// Zero means one thread per core
+            std::size_t jobs{0};
+            /// Counters fill in the stages of the results, at a cost in speed
+            StatsLogger::Level statsLevel{StatsLogger::Level::Off};
+        };
+
+        explicit BatchRunner(Options options) : options_(options) {}
+
+        /// Relative paths in the manifest are taken relative to the directory.
+        static std::vector<BatchCase> parseManifest(std::istream& is, const std::filesystem::path& directory);
+
+        /// Returns the results in the order of the cases.
+        std::vector<BatchResult> run(const std::vector<BatchCase>& cases) const;
+
+        /// Number of threads that run the cases.
+        std::size_t jobs() const;
+
+        const Options& options() const {
+            return options_;
+        }
+
+        /**
+         * Writes the results as a JSON object with the `cases` array. The output
+         * of every case is a string in it, or if the directory is given, the case
+         * writes it into `<index>.out` there and the summary names the file.
+         */
+        static void writeSummary(std::ostream& os, const std::vector<BatchCase>& cases, const std::vector<BatchResult>& results,
+                                 const std::filesystem::path& outputDirectory = {});
+
+    private:
+        BatchResult runCase(const BatchCase& batchCase, const std::shared_ptr<const Program>& program) const;
+
+        Options options_;
+    };
+}
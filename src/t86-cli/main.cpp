@@ -3,8 +3,14 @@
 #include <argparse/argparse.hpp>
 
 #include "TCP.h"
+#include "batch.h"
+#include "common/helpers.h"
+#include "sweep.h"
 #include "t86-parser/parser.h"
 #include "t86/os.h"
+#include "t86/parallel_simulator.h"
+#include "t86/utils/stats_logger.h"
+#include "t86/utils/trace_writer.h"
 
 using namespace tiny::t86;
 
@@ -15,19 +21,279 @@ Usage: t86-cli command
 commands:
     run input - Parses input, which must be valid T86 assembly file,
                 and runs it on the VM.
+    batch manifest - Runs every program of the manifest with its input
+                     on all the cores and prints a JSON summary.
+    sweep programs - Runs the comma separated programs on every combination
+                     of the cpu sizes and prints a CSV table, the results
+                     are cached on disk.
 )";
 
+static int batchMain(int argc, char* argv[]) {
+    argparse::ArgumentParser args("t86-cli batch");
+
+    args.add_argument("manifest")
+        .help("file with one case per line: program, input file or '-', and options "
+              "such as -aluCnt=2, -mode=functional, -skipIdle, -maxTicks=N or -timeout=MS");
+
+    args.add_argument("--jobs")
+        .help("number of threads, 0 for one per core")
+        .default_value((size_t)0)
+        .scan<'u', size_t>();
+
+    args.add_argument("--max-ticks")
+        .help("tick budget of every case, 0 for no limit")
+        .default_value((size_t)0)
+        .scan<'u', size_t>();
+
+    args.add_argument("--timeout")
+        .help("wall-clock limit of every case in milliseconds, 0 for no limit")
+        .default_value((size_t)0)
+        .scan<'u', size_t>();
+
+    args.add_argument("--register-cnt")
+        .help("number of general purpose registers")
+        .default_value((size_t)8)
+        .scan<'u', size_t>();
+
+    args.add_argument("--float-register-cnt")
+        .help("number of float registers")
+        .default_value((size_t)4)
+        .scan<'u', size_t>();
+
+    args.add_argument("--memory-size")
+        .help("RAM memory size")
+        .default_value((size_t)1024)
+        .scan<'u', size_t>();
+
+    args.add_argument("--mode")
+        .help("execution mode, either 'cycle' or 'functional'")
+        .default_value(std::string("cycle"));
+
+    args.add_argument("--skip-idle")
+        .help("jump over ticks in which the cycle model only waits for latencies")
+        .default_value(false)
+        .implicit_value(true);
+
+    args.add_argument("--branch-predictor")
+        .help("branch predictor of the cases that do not choose one")
+        .default_value(std::string("naive"));
+
+    args.add_argument("--output-dir")
+        .help("write the output of case N into N.out in the directory instead of the summary");
+
+    args.add_argument("--summary")
+        .help("write the JSON summary into the file instead of stdout");
+
+    try {
+        args.parse_args(argc, argv);
+    } catch (const std::runtime_error& err) {
+        std::cerr << err.what() << "\n";
+        std::cerr << args;
+        return 1;
+    }
+
+    BatchRunner::Options options;
+    options.jobs = args.get<size_t>("--jobs");
+    options.maxTicks = args.get<size_t>("--max-ticks");
+    options.timeout = std::chrono::milliseconds(args.get<size_t>("--timeout"));
+    options.registerCount = args.get<size_t>("--register-cnt");
+    options.floatRegisterCount = args.get<size_t>("--float-register-cnt");
+    options.memorySize = args.get<size_t>("--memory-size");
+    options.skipIdleTicks = args["--skip-idle"] == true;
+    options.branchPredictor = args.get<std::string>("--branch-predictor");
+    std::string mode = args.get<std::string>("--mode");
+    if (mode == "functional") {
+        options.mode = Cpu::Mode::Functional;
+    } else if (mode != "cycle") {
+        std::cerr << "Unknown mode `" << mode << "`, expected `cycle` or `functional`\n";
+        return 1;
+    }
+    try {
+        BranchPredictor::create(options.branchPredictor);
+    } catch (const std::invalid_argument& err) {
+        std::cerr << err.what() << "\n";
+        return 1;
+    }
+
+    std::string manifestFile = args.get<std::string>("manifest");
+    std::ifstream manifest(manifestFile);
+    if (!manifest) {
+        std::cerr << "Unable to open file `" << manifestFile << "`\n";
+        return 3;
+    }
+    std::vector<BatchCase> cases;
+    try {
+        cases = BatchRunner::parseManifest(manifest, std::filesystem::path(manifestFile).parent_path());
+    } catch (const std::invalid_argument& err) {
+        std::cerr << err.what() << "\n";
+        return 2;
+    }
+
+    std::filesystem::path outputDirectory;
+    if (auto directory = args.present("--output-dir")) {
+        outputDirectory = *directory;
+        std::filesystem::create_directories(outputDirectory);
+    }
+
+    BatchRunner runner(options);
+    auto results = runner.run(cases);
+
+    if (auto summaryFile = args.present("--summary")) {
+        std::ofstream summary(*summaryFile);
+        if (!summary) {
+            std::cerr << "Unable to open file `" << *summaryFile << "`\n";
+            return 3;
+        }
+        BatchRunner::writeSummary(summary, cases, results, outputDirectory);
+    } else {
+        BatchRunner::writeSummary(std::cout, cases, results, outputDirectory);
+    }
+
+    // Scripts can tell from the exit code that some case did not halt
+    for (const auto& result : results) {
+        if (result.status != BatchResult::Status::Halted) {
+            return 4;
+        }
+    }
+    return 0;
+}
+
+static int sweepMain(int argc, char* argv[]) {
+    argparse::ArgumentParser args("t86-cli sweep");
+
+    args.add_argument("programs")
+        .help("comma separated list of t86 assembly files");
+
+    args.add_argument("--registers")
+        .help("comma separated numbers of general purpose registers")
+        .default_value(std::string("8"));
+
+    args.add_argument("--float-registers")
+        .help("comma separated numbers of float registers")
+        .default_value(std::string("4"));
+
+    args.add_argument("--alus")
+        .help("comma separated numbers of ALUs")
+        .default_value(std::string("1"));
+
+    args.add_argument("--rs-entries")
+        .help("comma separated numbers of reservation station entries")
+        .default_value(std::string("2"));
+
+    args.add_argument("--memory-size")
+        .help("comma separated RAM sizes")
+        .default_value(std::string("1024"));
+
+    args.add_argument("--ram-gates")
+        .help("comma separated numbers of RAM gates")
+        .default_value(std::string("4"));
+
+    args.add_argument("--cache")
+        .help("directory with the results of the points simulated before")
+        .default_value(std::string(".t86-sweep-cache"));
+
+    args.add_argument("--jobs")
+        .help("number of threads, 0 for one per core")
+        .default_value((size_t)0)
+        .scan<'u', size_t>();
+
+    args.add_argument("--max-ticks")
+        .help("tick budget of every point, 0 for no limit")
+        .default_value((size_t)0)
+        .scan<'u', size_t>();
+
+    args.add_argument("--branch-predictor")
+        .help("branch predictor of the cycle model")
+        .default_value(std::string("naive"));
+
+    args.add_argument("--output")
+        .help("write the CSV table into the file instead of stdout");
+
+    try {
+        args.parse_args(argc, argv);
+    } catch (const std::runtime_error& err) {
+        std::cerr << err.what() << "\n";
+        std::cerr << args;
+        return 1;
+    }
+
+    SweepGrid grid;
+    BatchRunner::Options options;
+    try {
+        grid.registers = SweepGrid::parseValues(args.get<std::string>("--registers"));
+        grid.floatRegisters = SweepGrid::parseValues(args.get<std::string>("--float-registers"));
+        grid.alus = SweepGrid::parseValues(args.get<std::string>("--alus"));
+        grid.reservationStationEntries = SweepGrid::parseValues(args.get<std::string>("--rs-entries"));
+        grid.memory = SweepGrid::parseValues(args.get<std::string>("--memory-size"));
+        grid.ramGates = SweepGrid::parseValues(args.get<std::string>("--ram-gates"));
+        options.branchPredictor = args.get<std::string>("--branch-predictor");
+        BranchPredictor::create(options.branchPredictor);
+    } catch (const std::invalid_argument& err) {
+        std::cerr << err.what() << "\n";
+        return 1;
+    }
+    options.jobs = args.get<size_t>("--jobs");
+    options.maxTicks = args.get<size_t>("--max-ticks");
+
+    Sweep sweep(options, args.get<std::string>("--cache"));
+    auto rows = sweep.run(utils::split(args.get<std::string>("programs"), ','), grid);
+
+    if (auto outputFile = args.present("--output")) {
+        std::ofstream output(*outputFile);
+        if (!output) {
+            std::cerr << "Unable to open file `" << *outputFile << "`\n";
+            return 3;
+        }
+        Sweep::writeCsv(output, rows);
+    } else {
+        Sweep::writeCsv(std::cout, rows);
+    }
+
+    for (const auto& row : rows) {
+        if (row.result.status == BatchResult::Status::Error) {
+            std::cerr << row.program << ": " << row.result.error << "\n";
+            return 4;
+        }
+    }
+    return 0;
+}
+
 int main(int argc, char* argv[]) {
+    if (argc > 1 && std::string(argv[1]) == "batch") {
+        return batchMain(argc - 1, argv + 1);
+    }
+    if (argc > 1 && std::string(argv[1]) == "sweep") {
+        return sweepMain(argc - 1, argv + 1);
+    }
+
     argparse::ArgumentParser args("t86-cli");
 
     args.add_argument("file")
-        .help("input file containing t86 assembly");
+        .help("input file containing t86 assembly")
+        .default_value(std::string(""));
+
+    args.add_argument("--restore")
+        .help("continue the run saved in the snapshot file instead of running a program");
+
+    args.add_argument("--save-snapshot-at")
+        .help("save the snapshot of the run at 'tick:N' (or just N), or before the "
+              "instruction at 'pc:N' executes");
+
+    args.add_argument("--snapshot")
+        .help("file of the snapshot saved by --save-snapshot-at")
+        .default_value(std::string("t86.snapshot"));
 
     args.add_argument("--debug")
         .help("open debugging port at 9110")
         .default_value(false)
         .implicit_value(true);
 
+    args.add_argument("--history-interval")
+        .help("instructions between the checkpoints the debugger goes back to, "
+              "0 turns the reverse execution off")
+        .default_value((size_t)10000)
+        .scan<'u', size_t>();
+
     args.add_argument("--register-cnt")
         .help("number of general purpose registers")
         .default_value((size_t)8)
@@ -43,6 +309,77 @@ int main(int argc, char* argv[]) {
         .default_value((size_t)1024)
         .scan<'u', size_t>();
 
+    args.add_argument("--mode")
+        .help("execution mode, either 'cycle' for the out-of-order model, "
+              "'functional' for fast in order execution without timing, 'sampled' "
+              "which estimates the ticks from detailed windows between functional runs, "
+              "or 'parallel' which simulates intervals of the cycle model on all the cores")
+        .default_value(std::string("cycle"));
+
+    args.add_argument("--sample-period")
+        .help("instructions from the start of one detailed window to the next in the sampled mode")
+        .default_value((size_t)1000000)
+        .scan<'u', size_t>();
+
+    args.add_argument("--sample-window")
+        .help("instructions measured in each detailed window of the sampled mode")
+        .default_value((size_t)10000)
+        .scan<'u', size_t>();
+
+    args.add_argument("--sample-warmup")
+        .help("instructions that fill the pipeline before each window is measured")
+        .default_value((size_t)2000)
+        .scan<'u', size_t>();
+
+    args.add_argument("--interval")
+        .help("instructions simulated by one thread in the parallel mode")
+        .default_value((size_t)1000000)
+        .scan<'u', size_t>();
+
+    args.add_argument("--interval-warmup")
+        .help("instructions before each interval of the parallel mode that fill the pipeline")
+        .default_value((size_t)10000)
+        .scan<'u', size_t>();
+
+    args.add_argument("--jobs")
+        .help("number of threads of the parallel mode, 0 for one per core")
+        .default_value((size_t)0)
+        .scan<'u', size_t>();
+
+    args.add_argument("--skip-idle")
+        .help("jump over ticks in which the cycle model only waits for latencies, "
+              "the simulated tick count stays the same")
+        .default_value(false)
+        .implicit_value(true);
+
+    args.add_argument("--branch-predictor")
+        .help("branch predictor of the cycle model, one of 'naive', 'ras' "
+              "(return address stack), 'bimodal' or 'gshare'")
+        .default_value(std::string("naive"));
+
+    args.add_argument("--stats")
+        .help("stats of the cycle model printed to stderr after the run, 'off', "
+              "'counters' for aggregates per instruction and stall reason, "
+              "or 'full' which also keeps every event of every tick")
+        .default_value(std::string("off"));
+
+    args.add_argument("--trace")
+        .help("write the pipeline of the cycle model to the file, for the Konata "
+              "or Chrome trace viewer");
+
+    args.add_argument("--trace-format")
+        .help("format of the --trace file, 'konata' or 'chrome'")
+        .default_value(std::string("konata"));
+
+    args.add_argument("--record")
+        .help("record the retired instructions with the registers and the memory they "
+              "wrote into the file, for queries by t86-trace");
+
+    args.add_argument("--map")
+        .help("FILE@ADDRESS, puts the binary file of 64 bit words into the RAM at the address, "
+              "the file is mapped and only the pages that the program writes are copied")
+        .append();
+
     try {
         args.parse_args(argc, argv);
     } catch (const std::runtime_error& err) {
@@ -51,35 +388,217 @@ int main(int argc, char* argv[]) {
         std::exit(1);
     }
 
+    size_t regs = args.get<size_t>("--register-cnt");
+    size_t fltregs = args.get<size_t>("--float-register-cnt");
+    size_t memsize = args.get<size_t>("--memory-size");
+
     std::string filename = args.get<std::string>("file");
-    std::fstream f(filename);
-    if (!f) {
-        std::cerr << "Unable to open file `" << filename << "`\n";
-        return 3;
+    tiny::t86::Program program;
+    std::unique_ptr<Snapshot> snapshot;
+    if (auto snapshotFile = args.present("--restore")) {
+        if (!filename.empty()) {
+            std::cerr << "Give either the program or the snapshot to --restore, not both\n";
+            return 1;
+        }
+        try {
+            snapshot = std::make_unique<Snapshot>(*snapshotFile);
+        } catch (const std::runtime_error& err) {
+            std::cerr << err.what() << "\n";
+            return 3;
+        }
+        // The cpu must be the one the snapshot was taken on
+        regs = snapshot->registersCount();
+        fltregs = snapshot->floatRegistersCount();
+        memsize = snapshot->ramSize();
+    } else {
+        if (filename.empty()) {
+            std::cerr << "No input file given\n" << args;
+            return 1;
+        }
+        std::fstream f(filename);
+        if (!f) {
+            std::cerr << "Unable to open file `" << filename << "`\n";
+            return 3;
+        }
+
+        Parser parser(f);
+        try {
+            program = parser.Parse();
+            // program.dump();
+        } catch (ParserError &err) {
+            std::cerr << err.what() << std::endl;
+            return 2;
+        }
+    }
+
+    StatsLogger stats;
+    Cpu::Context context;
+    context.stats = &stats;
+    OS os(context, regs, fltregs, memsize);
+
+    std::string mode = args.get<std::string>("--mode");
+    if (mode == "functional") {
+        os.SetMode(Cpu::Mode::Functional);
+    } else if (mode != "cycle" && mode != "sampled" && mode != "parallel") {
+        std::cerr << "Unknown mode `" << mode << "`, expected `cycle`, `functional`, `sampled` or `parallel`\n";
+        return 1;
+    }
+
+    if (args["--skip-idle"] == true) {
+        os.SetSkipIdleTicks(true);
+    }
+
+    bool savesSnapshot = args.is_used("--save-snapshot-at");
+    if ((snapshot || savesSnapshot) && (mode == "sampled" || mode == "parallel")) {
+        std::cerr << "Snapshots are only supported in the cycle and functional modes\n";
+        return 1;
+    }
+    if (savesSnapshot) {
+        try {
+            os.SaveSnapshotAt(Snapshot::Trigger::parse(args.get<std::string>("--save-snapshot-at")),
+                              args.get<std::string>("--snapshot"));
+        } catch (const std::invalid_argument& err) {
+            std::cerr << err.what() << "\n";
+            return 1;
+        }
     }
 
-    Parser parser(f);
-    tiny::t86::Program program;
     try {
-        program = parser.Parse();
-        // program.dump();
-    } catch (ParserError &err) {
-        std::cerr << err.what() << std::endl;
-        return 2;
+        os.SetBranchPredictor(BranchPredictor::create(args.get<std::string>("--branch-predictor")));
+    } catch (const std::invalid_argument& err) {
+        std::cerr << err.what() << "\n";
+        return 1;
     }
 
-    size_t regs = args.get<size_t>("--register-cnt");
-    size_t fltregs = args.get<size_t>("--float-register-cnt");
-    size_t memsize = args.get<size_t>("--memory-size");
+    StatsLogger::Level statsLevel;
+    try {
+        statsLevel = StatsLogger::parseLevel(args.get<std::string>("--stats"));
+    } catch (const std::invalid_argument& err) {
+        std::cerr << err.what() << "\n";
+        return 1;
+    }
+    stats.setLevel(statsLevel);
 
-    OS os(regs, fltregs, memsize);
+    if (auto traceFile = args.present("--trace")) {
+        if (mode == "parallel") {
+            std::cerr << "The pipeline of the parallel mode can not be traced\n";
+            return 1;
+        }
+        auto trace = std::make_unique<std::ofstream>(*traceFile);
+        if (!*trace) {
+            std::cerr << "Unable to open file `" << *traceFile << "`\n";
+            return 3;
+        }
+        try {
+            stats.setTraceWriter(TraceWriter::create(args.get<std::string>("--trace-format"), std::move(trace)));
+        } catch (const std::invalid_argument& err) {
+            std::cerr << err.what() << "\n";
+            return 1;
+        }
+    }
+
+    if (auto recordFile = args.present("--record")) {
+        if (mode == "sampled" || mode == "parallel") {
+            std::cerr << "Only the runs in the cycle and functional modes can be recorded\n";
+            return 1;
+        }
+        // The debugger changes the state and goes back in time behind the back of the trace
+        if (args["debug"] == true) {
+            std::cerr << "A debugged run can not be recorded\n";
+            return 1;
+        }
+        os.RecordExecution(*recordFile);
+    }
+
+    if (args.is_used("--map")) {
+        if (snapshot || mode == "parallel") {
+            std::cerr << "Files can not be mapped into a restored run or in the parallel mode\n";
+            return 1;
+        }
+        for (const auto& map : args.get<std::vector<std::string>>("--map")) {
+            auto at = map.rfind('@');
+            auto address = at == std::string::npos ? std::nullopt
+                                                   : utils::svtonum<uint64_t>(std::string_view(map).substr(at + 1));
+            if (!address) {
+                std::cerr << "Expected FILE@ADDRESS, got `" << map << "`\n";
+                return 1;
+            }
+            try {
+                os.MapFile(*address, std::make_shared<MappedFile>(map.substr(0, at)));
+            } catch (const std::runtime_error& err) {
+                std::cerr << err.what() << "\n";
+                return 3;
+            }
+        }
+    }
 
     if (args["debug"] == true) {
         auto m = std::make_unique<TCP::TCPServer>(DEFAULT_DBG_PORT);
         m->Initialize();
         os.SetDebuggerComms(std::move(m));
+        History::Options history;
+        history.interval = args.get<size_t>("--history-interval");
+        os.SetHistoryOptions(history);
         log_info("Listening for debugger connections");
     }
 
-    os.Run(std::move(program));
+    if (mode == "sampled") {
+        Sampler::Options sampling;
+        sampling.period = args.get<size_t>("--sample-period");
+        sampling.window = args.get<size_t>("--sample-window");
+        sampling.warmup = args.get<size_t>("--sample-warmup");
+        try {
+            auto estimate = os.RunSampled(std::move(program), sampling);
+            std::cerr << "Estimated ticks: " << estimate.ticks << " +- " << estimate.confidence
+                      << " (95% confidence)\n"
+                      << "Instructions: " << estimate.instructions << "\n"
+                      << "Ticks per instruction: " << estimate.ticksPerInstruction << "\n"
+                      << "Samples: " << estimate.samples << ", " << estimate.detailedTicks
+                      << " ticks simulated in detail\n";
+        } catch (const std::exception& err) {
+            std::cerr << err.what() << "\n";
+            return 1;
+        }
+    } else if (mode == "parallel") {
+        ParallelSimulator::Options parallel;
+        parallel.interval = args.get<size_t>("--interval");
+        parallel.warmup = args.get<size_t>("--interval-warmup");
+        parallel.threads = args.get<size_t>("--jobs");
+        bool skipIdle = args["--skip-idle"] == true;
+        std::string predictor = args.get<std::string>("--branch-predictor");
+        auto makeCpu = [&](const Cpu::Context& cpuContext) {
+            auto cpu = std::make_unique<Cpu>(regs, fltregs, memsize, cpuContext);
+            cpu->setSkipIdleTicks(skipIdle);
+            cpu->setBranchPredictor(BranchPredictor::create(predictor));
+            return cpu;
+        };
+        try {
+            ParallelSimulator simulator(makeCpu, parallel);
+            auto result = simulator.run(std::make_shared<const Program>(std::move(program)), context);
+            std::cerr << "Ticks: " << result.ticks << "\n"
+                      << "Instructions: " << result.instructions << "\n"
+                      << "Intervals: " << result.intervals << ", " << result.warmupTicks
+                      << " ticks simulated in the warm-ups\n";
+        } catch (const std::exception& err) {
+            std::cerr << err.what() << "\n";
+            return 1;
+        }
+    } else {
+        try {
+            if (snapshot) {
+                os.Run(*snapshot);
+            } else {
+                os.Run(std::move(program));
+            }
+        } catch (const std::exception& err) {
+            std::cerr << err.what() << "\n";
+            return 1;
+        }
+    }
+    stats.setTraceWriter(nullptr);
+
+    if (statsLevel != StatsLogger::Level::Off) {
+        stats.processBasicStats(std::cerr);
+        stats.processDetailedStats(std::cerr);
+    }
 }
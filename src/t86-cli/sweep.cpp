@@ -0,0 +1,247 @@
+#include "sweep.h"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+#include <fmt/core.h>
+#include <unistd.h>
+
+#include "common/helpers.h"
+
+namespace tiny::t86 {
+    namespace {
+        using LifeTimeTotals = StatsLogger::LifeTimeTotals;
+
+        /// Stages of the results as they are named in the cache.
+        const std::pair<const char*, std::size_t LifeTimeTotals::*> stageFields[] = {
+            {"fetch", &LifeTimeTotals::fetch},
+            {"decode", &LifeTimeTotals::decode},
+            {"preparing", &LifeTimeTotals::preparing},
+            {"fetchingStalls", &LifeTimeTotals::fetchingStalls},
+            {"registerFetchStalls", &LifeTimeTotals::registerFetchStalls},
+            {"floatRegisterFetchStalls", &LifeTimeTotals::floatRegisterFetchStalls},
+            {"memoryReadStalls", &LifeTimeTotals::memoryReadStalls},
+            {"waitingForAlu", &LifeTimeTotals::waitingForAlu},
+            {"executing", &LifeTimeTotals::executing},
+            {"waitingForRetirement", &LifeTimeTotals::waitingForRetirement},
+            {"retirement", &LifeTimeTotals::retirement},
+        };
+
+        std::optional<BatchResult::Status> parseStatus(const std::string& name) {
+            for (auto status : {BatchResult::Status::Halted, BatchResult::Status::TickLimit,
+                                BatchResult::Status::Timeout, BatchResult::Status::Error}) {
+                if (name == BatchResult::statusName(status)) {
+                    return status;
+                }
+            }
+            return std::nullopt;
+        }
+    }
+
+    std::vector<std::string> SweepPoint::options() const {
+        return {
+            fmt::format("{}={}", Cpu::Config::registerCountConfigString, registers),
+            fmt::format("{}={}", Cpu::Config::floatRegisterCountConfigString, floatRegisters),
+            fmt::format("{}={}", Cpu::Config::aluCountConfigString, alus),
+            fmt::format("{}={}", Cpu::Config::reservationStationEntriesCountConfigString, reservationStationEntries),
+            fmt::format("{}={}", Cpu::Config::ramSizeConfigString, memory),
+            fmt::format("{}={}", Cpu::Config::ramGatesCountConfigString, ramGates),
+        };
+    }
+
+    std::vector<SweepPoint> SweepGrid::points() const {
+        std::vector<SweepPoint> points;
+        for (std::size_t r : registers) {
+            for (std::size_t f : floatRegisters) {
+                for (std::size_t a : alus) {
+                    for (std::size_t e : reservationStationEntries) {
+                        for (std::size_t m : memory) {
+                            for (std::size_t g : ramGates) {
+                                points.push_back(SweepPoint{r, f, a, e, m, g});
+                            }
+                        }
+                    }
+                }
+            }
+        }
+        return points;
+    }
+
+    std::vector<std::size_t> SweepGrid::parseValues(const std::string& list) {
+        std::vector<std::size_t> values;
+        for (const auto& item : utils::split_v(list, ',')) {
+            auto value = utils::svtonum<std::size_t>(item);
+            if (!value) {
+                throw std::invalid_argument("Expected a list of numbers like `1,2,4`, got `" + list + "`");
+            }
+            values.push_back(*value);
+        }
+        if (values.empty()) {
+            throw std::invalid_argument("Expected a list of numbers like `1,2,4`, got `" + list + "`");
+        }
+        return values;
+    }
+
+    SweepCache::SweepCache(std::filesystem::path directory) : directory_(std::move(directory)) {
+        std::filesystem::create_directories(directory_);
+    }
+
+    uint64_t SweepCache::hash(std::string_view data) {
+        uint64_t hash = 0xcbf29ce484222325;
+        for (char c : data) {
+            hash ^= static_cast<uint8_t>(c);
+            hash *= 0x100000001b3;
+        }
+        return hash;
+    }
+
+    std::filesystem::path SweepCache::path(const std::string& key) const {
+        return directory_ / fmt::format("{:016x}", hash(key));
+    }
+
+    std::optional<BatchResult> SweepCache::load(const std::string& key) const {
+        std::ifstream f(path(key));
+        std::string line;
+        // Another key with the same hash is a miss
+        if (!f || !std::getline(f, line) || line != key) {
+            return std::nullopt;
+        }
+        std::unordered_map<std::string, std::string> values;
+        std::string name;
+        std::string value;
+        while (f >> name >> value) {
+            values[name] = value;
+        }
+        auto number = [&](const char* field) {
+            auto i = values.find(field);
+            return i == values.end() ? std::nullopt : utils::svtonum<std::size_t>(i->second);
+        };
+        BatchResult result;
+        auto status = values.count("status") ? parseStatus(values["status"]) : std::nullopt;
+        auto ticks = number("ticks");
+        auto instructions = number("instructions");
+        auto mispredictions = number("mispredictions");
+        auto flushes = number("flushes");
+        if (!status || !ticks || !instructions || !mispredictions || !flushes) {
+            return std::nullopt;
+        }
+        result.status = *status;
+        result.ticks = *ticks;
+        result.instructions = *instructions;
+        result.mispredictions = *mispredictions;
+        result.flushes = *flushes;
+        for (const auto& [field, member] : stageFields) {
+            auto stage = number(field);
+            if (!stage) {
+                return std::nullopt;
+            }
+            result.stages.*member = *stage;
+        }
+        return result;
+    }
+
+    void SweepCache::store(const std::string& key, const BatchResult& result) const {
+        if (result.status != BatchResult::Status::Halted && result.status != BatchResult::Status::TickLimit) {
+            return;
+        }
+        // Written aside and renamed, so that a sweep running at the same time never reads half of it
+        auto target = path(key);
+        auto temporary = target;
+        temporary += fmt::format(".{}.tmp", ::getpid());
+        {
+            std::ofstream f(temporary);
+            f << key << '\n'
+              << "status " << BatchResult::statusName(result.status) << '\n'
+              << "ticks " << result.ticks << '\n'
+              << "instructions " << result.instructions << '\n'
+              << "mispredictions " << result.mispredictions << '\n'
+              << "flushes " << result.flushes << '\n';
+            for (const auto& [field, member] : stageFields) {
+                f << field << ' ' << result.stages.*member << '\n';
+            }
+            if (!f) {
+                return;
+            }
+        }
+        std::filesystem::rename(temporary, target);
+    }
+
+    Sweep::Sweep(BatchRunner::Options options, std::filesystem::path cacheDirectory)
+            : runner_([&]() {
+                  options.mode = Cpu::Mode::Cycle;
+                  options.skipIdleTicks = true;
+                  options.statsLevel = StatsLogger::Level::Counters;
+                  return options;
+              }()),
+              cache_(std::move(cacheDirectory)) {}
+
+    std::string Sweep::key(uint64_t programHash, const SweepPoint& point) const {
+        const auto& options = runner_.options();
+        std::vector<std::string> sizes = point.options();
+        return fmt::format("t86-sweep {} program={:016x} {} maxTicks={} branchPredictor={}",
+                           SweepCache::version, programHash, utils::join(sizes.begin(), sizes.end()),
+                           options.maxTicks, options.branchPredictor);
+    }
+
+    std::vector<Sweep::Row> Sweep::run(const std::vector<std::string>& programs, const SweepGrid& grid) const {
+        std::vector<SweepPoint> points = grid.points();
+        std::vector<Row> rows;
+        std::vector<std::string> keys;
+        std::vector<std::size_t> pending;
+        std::vector<BatchCase> cases;
+        for (const auto& program : programs) {
+            std::ifstream f(program);
+            std::optional<uint64_t> programHash;
+            if (f) {
+                std::stringstream text;
+                text << f.rdbuf();
+                programHash = SweepCache::hash(text.str());
+            }
+            for (const auto& point : points) {
+                rows.push_back(Row{program, point, {}, false});
+                keys.push_back(programHash ? key(*programHash, point) : std::string());
+                if (programHash) {
+                    if (auto cached = cache_.load(keys.back())) {
+                        rows.back().result = *cached;
+                        rows.back().cached = true;
+                        continue;
+                    }
+                }
+                // Unreadable programs fail in the runner like in a batch
+                pending.push_back(rows.size() - 1);
+                cases.push_back(BatchCase{program, "", point.options()});
+            }
+        }
+
+        std::vector<BatchResult> results = runner_.run(cases);
+        for (std::size_t i = 0; i < pending.size(); ++i) {
+            Row& row = rows[pending[i]];
+            row.result = std::move(results[i]);
+            row.result.output.clear();
+            if (!keys[pending[i]].empty()) {
+                cache_.store(keys[pending[i]], row.result);
+            }
+        }
+        return rows;
+    }
+
+    void Sweep::writeCsv(std::ostream& os, const std::vector<Row>& rows) {
+        os << "program,registers,float_registers,alus,rs_entries,memory,ram_gates,status,ticks,instructions,ipc,"
+              "mispredictions,flushes,fetch_stalls,register_stalls,float_register_stalls,memory_stalls,"
+              "alu_stalls,retirement_stalls,cached\n";
+        for (const auto& row : rows) {
+            const SweepPoint& p = row.point;
+            const BatchResult& r = row.result;
+            double ipc = r.ticks == 0 ? 0 : static_cast<double>(r.instructions) / r.ticks;
+            os << '"' << row.program << "\"," << p.registers << ',' << p.floatRegisters << ',' << p.alus << ','
+               << p.reservationStationEntries << ',' << p.memory << ',' << p.ramGates << ','
+               << BatchResult::statusName(r.status) << ',' << r.ticks << ',' << r.instructions << ',' << ipc << ','
+               << r.mispredictions << ',' << r.flushes << ',' << r.stages.fetchingStalls << ','
+               << r.stages.registerFetchStalls << ',' << r.stages.floatRegisterFetchStalls << ','
+               << r.stages.memoryReadStalls << ',' << r.stages.waitingForAlu << ','
+               << r.stages.waitingForRetirement << ',' << (row.cached ? 1 : 0) << '\n';
+        }
+    }
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <iosfwd>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "batch.h"
+
+namespace tiny::t86 {
+    /// Sizes of the cpu in one point of the sweep.
+    struct SweepPoint {
+        std::size_t registers;
+        std::size_t floatRegisters;
+        std::size_t alus;
+        std::size_t reservationStationEntries;
+        std::size_t memory;
+        std::size_t ramGates;
+
+        /// The point as cpu options, for example `-aluCnt=2`.
+        std::vector<std::string> options() const;
+    };
+
+    /// Values tried for each size, the sweep runs every combination of them.
+    struct SweepGrid {
+        std::vector<std::size_t> registers{8};
+        std::vector<std::size_t> floatRegisters{4};
+        std::vector<std::size_t> alus{1};
+        std::vector<std::size_t> reservationStationEntries{2};
+        std::vector<std::size_t> memory{1024};
+        std::vector<std::size_t> ramGates{4};
+
+        std::vector<SweepPoint> points() const;
+
+        /// Parses a list like `1,2,4`.
+        static std::vector<std::size_t> parseValues(const std::string& list);
+    };
+
+    /**
+     * Results of the simulated points stored on disk, one small text file
+     * per point. A file is named by the hash of its key, which holds the
+     * hash of the program text, the point and every other option that
+     * changes the result. Running a sweep again only simulates the points
+     * that are new, and a changed program gets new entries.
+     */
+    class SweepCache {
+    public:
+        /// Increase when the timing of the cycle model changes, the old results are then ignored.
+        static constexpr int version = 1;
+
+        explicit SweepCache(std::filesystem::path directory);
+
+        std::optional<BatchResult> load(const std::string& key) const;
+
+        /// Timeouts and errors are not stored, they may turn out differently next time.
+        void store(const std::string& key, const BatchResult& result) const;
+
+        /// 64-bit FNV-1a.
+        static uint64_t hash(std::string_view data);
+
+    private:
+        std::filesystem::path path(const std::string& key) const;
+
+        std::filesystem::path directory_;
+    };
+
+    /**
+     * Runs every program on every point of a grid with the batch runner and
+     * keeps the results in a SweepCache. The cycle model runs with the
+     * counters stats to get the stall breakdown, and skips the idle ticks,
+     * which does not change the results.
+     */
+    class Sweep {
+    public:
+        struct Row {
+            std::string program;
+            SweepPoint point;
+            BatchResult result;
+            bool cached{false};
+        };
+
+        Sweep(BatchRunner::Options options, std::filesystem::path cacheDirectory);
+
+        /// Rows for every program and point, in that order.
+        std::vector<Row> run(const std::vector<std::string>& programs, const SweepGrid& grid) const;
+
+        static void writeCsv(std::ostream& os, const std::vector<Row>& rows);
+
+    private:
+        /// Everything that decides the result of the point besides the program.
+        std::string key(uint64_t programHash, const SweepPoint& point) const;
+
+        BatchRunner runner_;
+
+        SweepCache cache_;
+    };
+}
@@ -0,0 +1,226 @@
+#include <algorithm>
+#include <bit>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include <argparse/argparse.hpp>
+#include <fmt/core.h>
+
+#include "common/helpers.h"
+#include "t86-parser/parser.h"
+#include "t86/execution_trace.h"
+
+using namespace tiny::t86;
+
+const char* usage_str = R"(
+Usage: t86-trace command file
+Queries the trace recorded by `t86-cli --record file`.
+commands:
+    info file - Prints the size of the trace.
+    last-write file address - Prints the last write to the address,
+                              optionally before the given instruction.
+    values file register pc - Prints every value the register held
+                              when the instruction at pc executed.
+    histogram file - Prints how many times every instruction executed.
+)";
+
+/// Parses the register as the debugger writes it: R0, F0, SP, BP or FLAGS.
+static std::size_t parseSlot(const ExecutionTrace& trace, std::string_view name) {
+    if (name == "SP") {
+        return trace.slot(Register::StackPointer());
+    } else if (name == "BP") {
+        return trace.slot(Register::StackBasePointer());
+    } else if (name == "FLAGS") {
+        return trace.slot(Register::Flags());
+    }
+    auto index = name.size() > 1 ? utils::svtonum<size_t>(name.substr(1)) : std::nullopt;
+    if (index && name[0] == 'R') {
+        return trace.slot(Register{*index});
+    } else if (index && name[0] == 'F') {
+        return trace.slot(FloatRegister{*index});
+    }
+    throw std::invalid_argument(fmt::format("Unknown register `{}`, expected R<n>, F<n>, SP, BP or FLAGS", name));
+}
+
+static int infoMain(int argc, char* argv[]) {
+    argparse::ArgumentParser args("t86-trace info");
+
+    args.add_argument("file")
+        .help("trace recorded by t86-cli --record");
+
+    try {
+        args.parse_args(argc, argv);
+    } catch (const std::runtime_error& err) {
+        std::cerr << err.what() << "\n";
+        std::cerr << args;
+        return 1;
+    }
+
+    ExecutionTrace trace(args.get<std::string>("file"));
+    std::cout << "Instructions: " << trace.instructions() << "\n"
+              << "Blocks: " << trace.blocks() << "\n"
+              << "Registers: " << trace.registersCount() << "\n"
+              << "Float registers: " << trace.floatRegistersCount() << "\n";
+    return 0;
+}
+
+static int lastWriteMain(int argc, char* argv[]) {
+    argparse::ArgumentParser args("t86-trace last-write");
+
+    args.add_argument("file")
+        .help("trace recorded by t86-cli --record");
+
+    args.add_argument("address")
+        .help("address in the RAM")
+        .scan<'u', size_t>();
+
+    args.add_argument("--before")
+        .help("only look at the instructions before the one with this index")
+        .scan<'u', size_t>();
+
+    try {
+        args.parse_args(argc, argv);
+    } catch (const std::runtime_error& err) {
+        std::cerr << err.what() << "\n";
+        std::cerr << args;
+        return 1;
+    }
+
+    ExecutionTrace trace(args.get<std::string>("file"));
+    auto address = args.get<size_t>("address");
+    auto before = args.present<size_t>("--before").value_or(trace.instructions());
+    auto write = trace.lastWrite(address, before);
+    if (!write) {
+        std::cout << "No write to " << address << "\n";
+        return 4;
+    }
+    std::cout << "Instruction " << write->instruction << " at " << write->pc
+              << " wrote " << write->value << "\n";
+    return 0;
+}
+
+static int valuesMain(int argc, char* argv[]) {
+    argparse::ArgumentParser args("t86-trace values");
+
+    args.add_argument("file")
+        .help("trace recorded by t86-cli --record");
+
+    args.add_argument("register")
+        .help("R<n>, F<n>, SP, BP or FLAGS");
+
+    args.add_argument("pc")
+        .help("address of the instruction")
+        .scan<'u', size_t>();
+
+    try {
+        args.parse_args(argc, argv);
+    } catch (const std::runtime_error& err) {
+        std::cerr << err.what() << "\n";
+        std::cerr << args;
+        return 1;
+    }
+
+    ExecutionTrace trace(args.get<std::string>("file"));
+    std::string name = args.get<std::string>("register");
+    std::size_t slot;
+    try {
+        slot = parseSlot(trace, name);
+    } catch (const std::invalid_argument& err) {
+        std::cerr << err.what() << "\n";
+        return 1;
+    }
+    for (const auto& value : trace.values(slot, args.get<size_t>("pc"))) {
+        std::cout << value.instruction << " ";
+        if (name[0] == 'F') {
+            std::cout << std::bit_cast<double>(value.value) << "\n";
+        } else {
+            std::cout << value.value << "\n";
+        }
+    }
+    return 0;
+}
+
+static int histogramMain(int argc, char* argv[]) {
+    argparse::ArgumentParser args("t86-trace histogram");
+
+    args.add_argument("file")
+        .help("trace recorded by t86-cli --record");
+
+    args.add_argument("--program")
+        .help("the t86 assembly file that was run, prints the instructions next to their counts");
+
+    args.add_argument("--top")
+        .help("print only this many of the most executed instructions, 0 for all")
+        .default_value((size_t)0)
+        .scan<'u', size_t>();
+
+    try {
+        args.parse_args(argc, argv);
+    } catch (const std::runtime_error& err) {
+        std::cerr << err.what() << "\n";
+        std::cerr << args;
+        return 1;
+    }
+
+    ExecutionTrace trace(args.get<std::string>("file"));
+    Program program;
+    if (auto programFile = args.present("--program")) {
+        std::ifstream f(*programFile);
+        if (!f) {
+            std::cerr << "Unable to open file `" << *programFile << "`\n";
+            return 3;
+        }
+        try {
+            Parser parser(f);
+            program = parser.Parse();
+        } catch (const ParserError& err) {
+            std::cerr << err.what() << "\n";
+            return 2;
+        }
+    }
+
+    auto histogram = trace.histogram();
+    std::vector<std::size_t> order(histogram.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(),
+                     [&](std::size_t a, std::size_t b) { return histogram[a] > histogram[b]; });
+    auto top = args.get<size_t>("--top");
+    if (top != 0 && top < order.size()) {
+        order.resize(top);
+    }
+    for (std::size_t pc : order) {
+        if (histogram[pc] == 0) {
+            break;
+        }
+        std::cout << pc << " " << histogram[pc];
+        if (pc < program.instructions().size()) {
+            std::cout << " " << program.at(pc).toString();
+        }
+        std::cout << "\n";
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << usage_str;
+        return 1;
+    }
+    std::string command = argv[1];
+    try {
+        if (command == "info") {
+            return infoMain(argc - 1, argv + 1);
+        } else if (command == "last-write") {
+            return lastWriteMain(argc - 1, argv + 1);
+        } else if (command == "values") {
+            return valuesMain(argc - 1, argv + 1);
+        } else if (command == "histogram") {
+            return histogramMain(argc - 1, argv + 1);
+        }
+    } catch (const std::runtime_error& err) {
+        std::cerr << err.what() << "\n";
+        return 3;
+    }
+    std::cerr << usage_str;
+    return 1;
+}
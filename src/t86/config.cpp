@@ -4,14 +4,6 @@
 
 namespace tiny::t86 {
 
-    std::size_t RAM::readLatency(std::size_t) const {
-        return 5;
-    }
-
-    std::size_t RAM::writeLatency(std::size_t) const {
-        return 5;
-    }
-
     std::size_t MOV::length() const {
         // POC how this can be used
         if (!destination_.isRegister()) {
@@ -1,22 +1,28 @@
+#include <algorithm>
 #include <functional>
+#include <limits>
+#include <stdexcept>
 #include <utility>
 #include <cassert>
 
 #include "cpu.h"
 #include "execution_error.h"
-#include "utils/stats_logger.h"
-#include "cpu/branch_predictors/naive_branch_predictor.h"
-#include "common/config.h"
 #include "common/logger.h"
 
 namespace tiny::t86 {
     void Cpu::tick() {
+        if (mode_ == Mode::Functional) {
+            functionalTick();
+            return;
+        }
         log_debug("main: flag register value: {:x}", getRegister(Register::Flags()));
         log_debug("Beginning of tick");
         // Clear interrupt flag
         interrupted_ = 0;
 
-        StatsLogger::instance().newTick();
+        std::size_t changes = ram_.changes() + reservationStation_.changes();
+
+        stats().newTick();
 
         ram_.tick();
 
@@ -45,43 +51,118 @@ namespace tiny::t86 {
 
         reservationStation_.fetchAndStartExecution();
 
-        if (instructionDecode_) {
-            if (reservationStation_.hasFreeEntry()) {
-                reservationStation_.add(instructionDecode_->instruction, instructionDecode_->pc, instructionDecode_->loggingId);
-                instructionDecode_ = std::nullopt;
-            }
+        // None of the instructions moves
+        bool frontEndStalled = !reservationStation_.hasFreeEntry()
+            && instructionDecode_.size() == widths_.decode
+            && instructionFetch_.size() == widths_.fetch;
+
+        // Decoded instructions enter the reservation station in program order
+        while (!instructionDecode_.empty() && reservationStation_.hasFreeEntry()) {
+            const InstructionEntry& decoded = instructionDecode_.front();
+            reservationStation_.add(*decoded.instruction, decoded.pc, decoded.loggingId);
+            instructionDecode_.pop_front();
         }
 
-        if (!instructionDecode_) {
-            // this will set instructionFetch to be nullopt
-            std::swap(instructionDecode_, instructionFetch_);
+        while (!instructionFetch_.empty() && instructionDecode_.size() < widths_.decode) {
+            instructionDecode_.push_back(instructionFetch_.front());
+            instructionFetch_.pop_front();
         }
 
-        if (!instructionFetch_) {
-            instructionFetch_ = fetchInstruction();
+        while (instructionFetch_.size() < widths_.fetch) {
+            instructionFetch_.push_back(fetchInstruction());
         }
 
-        if (instructionFetch_) {
-            StatsLogger::instance().logInstructionFetch(instructionFetch_->loggingId);
+        auto& logger = stats();
+        if (logger.enabled()) {
+            for (std::size_t i = 0; i < instructionFetch_.size(); ++i) {
+                logger.logInstructionFetch(instructionFetch_[i].loggingId);
+            }
+            for (std::size_t i = 0; i < instructionDecode_.size(); ++i) {
+                logger.logInstructionDecode(instructionDecode_[i].loggingId);
+            }
         }
-        if (instructionDecode_) {
-            StatsLogger::instance().logInstructionDecode(instructionDecode_->loggingId);
+
+        if (skipIdleTicks_ && frontEndStalled
+                && changes == ram_.changes() + reservationStation_.changes()) {
+            advanceOverIdleTicks();
         }
 
         log_debug("End of tick");
     }
 
+    void Cpu::setMode(Mode mode) {
+        if (mode == mode_) {
+            return;
+        }
+        if (mode_ == Mode::Cycle) {
+            squash();
+        } else {
+            speculativeProgramCounter_ = getRegister(Register::ProgramCounter());
+        }
+        mode_ = mode;
+    }
+
+    void Cpu::squash() {
+        // The fetch buffer is only empty before the first tick of the cycle model
+        // and right after a flush
+        if (mode_ != Mode::Cycle || instructionFetch_.empty()) {
+            return;
+        }
+        unrollSpeculation();
+        // The retired writes are already in the memory, nothing waits for them
+        ram_.settle();
+        writesManager_.removeFinished(ram_);
+    }
+
+    void Cpu::warmBranchPredictor(uint64_t pc, const JumpInstruction& instruction, uint64_t destination) {
+        branchPredictor_->nextGuess(pc, instruction);
+        if (destination != pc + 1) {
+            branchPredictor_->registerBranchTaken(pc, instruction, destination);
+        } else {
+            branchPredictor_->registerBranchNotTaken(pc, instruction);
+        }
+    }
+
+    void Cpu::advanceOverIdleTicks() {
+        // Until some latency runs out, every tick would only count down
+        // and log the same stalls again
+        std::size_t ticks = std::min(ram_.idleTicks(), reservationStation_.idleTicks());
+        if (ticks == 0 || ticks == std::numeric_limits<std::size_t>::max()) {
+            return;
+        }
+        ram_.skipTicks(ticks);
+        reservationStation_.skipTicks(ticks);
+        stats().repeatTick(ticks);
+    }
+
+    void Cpu::functionalTick() {
+        interrupted_ = 0;
+
+        functionalEngine_.step();
+
+        if (halted()) {
+            return;
+        }
+
+        // Every instruction is retired right away, so single step is done after each one
+        if (isTrapFlagSet() && interrupted_ == 0) {
+            log_info("Breaking on single step!");
+            interrupted_ = 1;
+        }
+    }
+
     Cpu::InstructionEntry Cpu::fetchInstruction() {
         std::size_t oldPc = speculativeProgramCounter_;
-        const auto* instruction = &program_.at(speculativeProgramCounter_);
-        if (auto jumpInstruction = dynamic_cast<const JumpInstruction*>(instruction); jumpInstruction) {
-            speculativeProgramCounter_ = branchPredictor_->nextGuess(speculativeProgramCounter_, *jumpInstruction);
+        const auto* instruction = &getDecodedText(speculativeProgramCounter_);
+        if (instruction->isJump) {
+            const auto& jumpInstruction = static_cast<const JumpInstruction&>(*instruction->instruction);
+            speculativeProgramCounter_ = branchPredictor_->nextGuess(speculativeProgramCounter_, jumpInstruction);
             predictions_.push_back(speculativeProgramCounter_);
         }
         else {
             ++speculativeProgramCounter_;
         }
-        return {instruction, oldPc + 1, StatsLogger::instance().registerNewInstruction(oldPc, instruction)};
+        return {instruction, oldPc + 1, stats().registerNewInstruction(oldPc, instruction->instruction)};
     }
 
     int64_t Cpu::getRegister(Register reg) const {
@@ -110,19 +191,45 @@ namespace tiny::t86 {
               Cpu::Config::instance().ramSize()) {}
 
     Cpu::Cpu(std::size_t registerCount, std::size_t floatRegisterCount, std::size_t ramSize)
-            : Cpu(registerCount, floatRegisterCount, Cpu::Config::instance().aluCnt(), 2 * Cpu::Config::instance().aluCnt(), ramSize, Config::instance().ramGatesCount()) {}
+            : Cpu(registerCount, floatRegisterCount, ramSize, Context{}) {}
+
+    Cpu::Cpu(std::size_t registerCount, std::size_t floatRegisterCount, std::size_t ramSize, const Context& context)
+            : Cpu(registerCount, floatRegisterCount, context.config.aluCnt(), 2 * context.config.aluCnt(), ramSize, context.config.ramGatesCount(), context) {}
 
     Cpu::Cpu(std::size_t registerCount, std::size_t floatRegisterCount, std::size_t aluCnt, std::size_t reservationStationEntriesCount,
         std::size_t ramSize, std::size_t ramGatesCnt)
-            : registerCnt_(registerCount),
+            : Cpu(registerCount, floatRegisterCount, aluCnt, reservationStationEntriesCount, ramSize, ramGatesCnt, Context{}) {}
+
+    Cpu::Cpu(const Context& context)
+            : Cpu(context.config.registerCnt(), context.config.floatRegisterCnt(), context.config.aluCnt(),
+                  context.config.reservationStationEntriesCnt(), context.config.ramSize(), context.config.ramGatesCount(),
+                  context) {}
+
+    Cpu::Cpu(std::size_t registerCount, std::size_t floatRegisterCount, std::size_t aluCnt, std::size_t reservationStationEntriesCount,
+        std::size_t ramSize, std::size_t ramGatesCnt, const Context& context)
+            : context_(context),
+              registerCnt_(registerCount),
               floatRegisterCnt_(floatRegisterCount),
+              aluCnt_(aluCnt),
+              reservationStationEntriesCnt_(reservationStationEntriesCount),
               physicalRegisterCnt_(specialRegistersCnt + registerCount + floatRegisterCount + reservationStationEntriesCount * possibleRenamedRegisterCnt),
               registers_(physicalRegisterCnt_),
               reservationStation_(*this, aluCnt, reservationStationEntriesCount),
-              branchPredictor_{std::make_unique<NaiveBranchPredictor>()},
-              rat_(*this, registerCount, floatRegisterCount),
-              ram_(ramSize, ramGatesCnt)
+              branchPredictor_{BranchPredictor::create(context_.config.branchPredictor())},
+              rat_(registerCount, floatRegisterCount),
+              retiredRat_(rat_),
+              ram_(ramSize, ramGatesCnt),
+              functionalEngine_(*this)
     {
+        const Config& config = context_.config;
+        setWidths(Widths{config.fetchWidth(), config.decodeWidth(), config.issueWidth(), config.retireWidth()});
+        setRamLatencyPolicy(std::make_shared<UniformRamLatency>(config.ramReadLatency(), config.ramWriteLatency()));
+        // The first physical registers are mapped by the tables, the rest is free.
+        // Lowest indices are at the top of the stack.
+        freeRegisters_.reserve(physicalRegisterCnt_);
+        for (std::size_t i = physicalRegisterCnt_; i > rat_.size(); --i) {
+            freeRegisters_.emplace_back(i - 1);
+        }
         // To be sure, theoretically not needed
         for (std::size_t i = 0; i < registerCount; ++i) {
             setRegister(Register{i}, 0);
@@ -135,6 +242,7 @@ namespace tiny::t86 {
         setRegister(Register::Flags(), 0);
         setRegister(Register::StackPointer(), ram_.size());
         setRegister(Register::StackBasePointer(), ram_.size());
+        decodeProgram();
     }
 
     void Cpu::setRegister(Register reg, int64_t value) {
@@ -160,21 +268,123 @@ namespace tiny::t86 {
     void Cpu::setRegister(PhysicalRegister reg, int64_t value) {
         registers_.at(reg.index()).value = value;
         registers_.at(reg.index()).ready = true;
+        reservationStation_.wakeUp(reg);
     }
 
     void Cpu::setRegister(PhysicalRegister reg, double value) {
         registers_.at(reg.index()).value = utils::reinterpret_safe<int64_t>(value); // Store the double as int64_t
         registers_.at(reg.index()).ready = true;
+        reservationStation_.wakeUp(reg);
     }
 
     void Cpu::start(Program&& program) {
+        start(std::make_shared<const Program>(std::move(program)));
+    }
+
+    void Cpu::start(std::shared_ptr<const Program> program) {
         program_ = std::move(program);
-        const auto& data = program_.data();
+        patches_.clear();
+        decodeProgram();
+        const auto& data = program_->data();
         for (std::size_t i = 0; i < data.size(); ++i) {
             setMemory(i, data[i]);
         }
     }
 
+    Cpu::Checkpoint Cpu::checkpoint() const {
+        assert(mode_ == Mode::Functional || instructionFetch_.empty());
+        Checkpoint checkpoint = registerCheckpoint();
+        checkpoint.memory = ram_.image();
+        return checkpoint;
+    }
+
+    Cpu::Checkpoint Cpu::registerCheckpoint() const {
+        Checkpoint checkpoint;
+        checkpoint.registers.reserve(registerCnt_);
+        for (std::size_t i = 0; i < registerCnt_; ++i) {
+            checkpoint.registers.push_back(getRegister(retiredRat_.translate(Register{i})));
+        }
+        checkpoint.floatRegisters.reserve(floatRegisterCnt_);
+        for (std::size_t i = 0; i < floatRegisterCnt_; ++i) {
+            checkpoint.floatRegisters.push_back(getFloatRegister(retiredRat_.translate(FloatRegister{i})));
+        }
+        checkpoint.programCounter = getRegister(retiredRat_.translate(Register::ProgramCounter()));
+        checkpoint.stackPointer = getRegister(retiredRat_.translate(Register::StackPointer()));
+        checkpoint.stackBasePointer = getRegister(retiredRat_.translate(Register::StackBasePointer()));
+        checkpoint.flags = getRegister(retiredRat_.translate(Register::Flags()));
+        checkpoint.debugRegisters.assign(debug_registers_.begin(), debug_registers_.end());
+        checkpoint.retiredInstructions = retiredInstructions_;
+        return checkpoint;
+    }
+
+    void Cpu::restore(const Checkpoint& checkpoint) {
+        if (checkpoint.registers.size() != registerCnt_
+                || checkpoint.floatRegisters.size() != floatRegisterCnt_
+                || checkpoint.debugRegisters.size() != debug_registers_.size()
+                || checkpoint.memory.size != ram_.size()) {
+            throw std::invalid_argument("The checkpoint was taken on a cpu of a different size");
+        }
+        restoreRegisters(checkpoint);
+        ram_.restore(checkpoint.memory);
+    }
+
+    void Cpu::restoreRegisters(const Checkpoint& checkpoint) {
+        assert(instructionFetch_.empty());
+        for (std::size_t i = 0; i < registerCnt_; ++i) {
+            setRegister(Register{i}, checkpoint.registers[i]);
+        }
+        for (std::size_t i = 0; i < floatRegisterCnt_; ++i) {
+            setFloatRegister(FloatRegister{i}, checkpoint.floatRegisters[i]);
+        }
+        setRegister(Register::ProgramCounter(), checkpoint.programCounter);
+        setRegister(Register::StackPointer(), checkpoint.stackPointer);
+        setRegister(Register::StackBasePointer(), checkpoint.stackBasePointer);
+        setRegister(Register::Flags(), checkpoint.flags);
+        speculativeProgramCounter_ = checkpoint.programCounter;
+        std::copy(checkpoint.debugRegisters.begin(), checkpoint.debugRegisters.end(), debug_registers_.begin());
+        retiredInstructions_ = checkpoint.retiredInstructions;
+    }
+
+    std::unique_ptr<Cpu> Cpu::fork(const Context& context) {
+        auto child = std::make_unique<Cpu>(registerCnt_, floatRegisterCnt_, aluCnt_, reservationStationEntriesCnt_,
+                                           ram_.size(), ram_.gatesCount(), context);
+        child->setWidths(widths_);
+        child->setRamLatencyPolicy(ram_.latencyPolicy());
+        child->setBranchPredictor(branchPredictor_->clone());
+        child->mode_ = mode_;
+        child->skipIdleTicks_ = skipIdleTicks_;
+        child->functionalWarming_ = functionalWarming_;
+        child->breakHandler_ = breakHandler_;
+
+        child->program_ = program_;
+        child->patches_ = patches_;
+        // Decoded again, the latencies come from the options of the child
+        child->text_.reserve(text_.size());
+        for (const auto& ins : text_) {
+            child->text_.push_back(DecodedInstruction::decode(*ins.instruction, *child));
+        }
+
+        child->restoreRegisters(registerCheckpoint());
+        child->ram_.share(ram_);
+        return child;
+    }
+
+    void Cpu::rewind(Cpu& other) {
+        assert(other.registerCnt_ == registerCnt_ && other.floatRegisterCnt_ == floatRegisterCnt_);
+        squash();
+        other.squash();
+        auto checkpoint = other.registerCheckpoint();
+        checkpoint.debugRegisters.assign(debug_registers_.begin(), debug_registers_.end());
+        restoreRegisters(checkpoint);
+        ram_.share(other.ram_);
+        halted_ = false;
+        interrupted_ = 0;
+    }
+
+    uint64_t Cpu::retiredProgramCounter() const {
+        return getRegister(retiredRat_.translate(Register::ProgramCounter()));
+    }
+
     bool Cpu::halted() const {
         return halted_;
     }
@@ -212,9 +422,36 @@ namespace tiny::t86 {
     void Cpu::writeMemory(MemoryWrite::Id id) {
         auto write = writesManager_.getWrite(id);
         writesManager_.startWriting(id, ram_);
+        if (executionTrace_) {
+            executionTrace_->memoryWritten(write.address(), static_cast<int64_t>(write.value()));
+        }
         checkWrite(write.address());
     }
 
+    void Cpu::storeMemory(uint64_t address, int64_t value) {
+        ram_.set(address, value);
+        if (executionTrace_) {
+            executionTrace_->memoryWritten(address, value);
+        }
+        checkWrite(address);
+    }
+
+    void Cpu::traceRetirement(uint64_t pc) {
+        for (const auto& product : getDecodedText(pc).products) {
+            if (product.isRegister()) {
+                Register reg = product.getRegister();
+                // The program counter is told by the address of the next instruction
+                if (reg != Register::ProgramCounter()) {
+                    executionTrace_->registerWritten(reg, getRegister(retiredRat_.translate(reg)));
+                }
+            } else if (product.isFloatRegister()) {
+                FloatRegister fReg = product.getFloatRegister();
+                executionTrace_->floatRegisterWritten(fReg, getFloatRegister(retiredRat_.translate(fReg)));
+            }
+        }
+        executionTrace_->retired(pc);
+    }
+
     int64_t Cpu::getMemory(uint64_t address) const {
         return ram_.get(address);
     }
@@ -223,39 +460,68 @@ namespace tiny::t86 {
         ram_.set(address, value);
     }
 
-    const Instruction& Cpu::getText(uint64_t address) {
-        return program_.at(address);
+    void Cpu::mapMemory(uint64_t address, std::shared_ptr<const MappedFile> file) {
+        auto words = file->words();
+        ram_.map(address, words, std::move(file));
+    }
+
+    const Instruction& Cpu::getText(uint64_t address) const {
+        if (address >= text_.size()) {
+            return program_->at(address);
+        }
+        return *text_[address].instruction;
+    }
+
+    const DecodedInstruction& Cpu::getDecodedText(uint64_t address) const {
+        if (address >= text_.size()) {
+            return nop_;
+        }
+        return text_[address];
     }
 
     void Cpu::setText(uint64_t address, std::unique_ptr<Instruction> ins) {
-        program_.instructions_.at(address) = std::move(ins);
+        text_.at(address) = DecodedInstruction::decode(*ins, *this);
+        patches_.push_back(std::move(ins));
+    }
+
+    void Cpu::decodeProgram() {
+        text_.clear();
+        text_.reserve(program_->instructions().size());
+        for (const auto& ins : program_->instructions()) {
+            text_.push_back(DecodedInstruction::decode(*ins, *this));
+        }
+        nop_ = DecodedInstruction::decode(program_->at(text_.size()), *this);
     }
 
 
     void Cpu::jump(const ReservationStation::Entry& entry, bool taken) {
         uint64_t destination = entry.getUpdatedProgramCounter();
+        const auto& instruction = static_cast<const JumpInstruction&>(*entry.instruction());
+        uint64_t sourcePc = entry.pc();
         if (taken) {
-            registerBranchTaken(entry.getRegister(Register::ProgramCounter()), destination);
+            registerBranchTaken(sourcePc, instruction, destination);
         } else {
-            registerBranchNotTaken(entry.getRegister(Register::ProgramCounter()));
+            registerBranchNotTaken(sourcePc, instruction);
         }
         checkBranchPrediction(entry, destination);
     }
 
-    void Cpu::registerBranchTaken(uint64_t sourcePc, uint64_t destination) {
-        branchPredictor_->registerBranchTaken(sourcePc, destination);
+    void Cpu::registerBranchTaken(uint64_t sourcePc, const JumpInstruction& instruction, uint64_t destination) {
+        branchPredictor_->registerBranchTaken(sourcePc, instruction, destination);
     }
 
-    void Cpu::registerBranchNotTaken(uint64_t sourcePc) {
-        branchPredictor_->registerBranchNotTaken(sourcePc);
+    void Cpu::registerBranchNotTaken(uint64_t sourcePc, const JumpInstruction& instruction) {
+        branchPredictor_->registerBranchNotTaken(sourcePc, instruction);
     }
 
     void Cpu::checkBranchPrediction(const ReservationStation::Entry& entry, uint64_t destination) {
         assert(!predictions_.empty());
         std::size_t predictedDestination = predictions_.front();
         predictions_.pop_front();
-        if (predictedDestination != destination) {
-            unrollSpeculation(entry.rat());
+        bool mispredicted = predictedDestination != destination;
+        stats().logBranch(entry.loggingId(), mispredicted);
+        if (mispredicted) {
+            unrollSpeculation();
         }
     }
 
@@ -266,6 +532,7 @@ namespace tiny::t86 {
     void Cpu::setReady(PhysicalRegister reg) {
         assert(!registerReady(reg));
         registers_.at(reg.index()).ready = true;
+        reservationStation_.wakeUp(reg);
     }
 
     void Cpu::connectBreakHandler(std::function<void(Cpu&)> handler) {
@@ -282,54 +549,79 @@ namespace tiny::t86 {
         return rat_;
     }
 
-    void Cpu::subscribeRegisterRead(PhysicalRegister reg) {
-        ++(registers_.at(reg.index()).subscribedReads);
-    }
-
-    void Cpu::unsubscribeRegisterRead(PhysicalRegister reg) {
-        assert(registers_.at(reg.index()).subscribedReads);
-        --(registers_.at(reg.index()).subscribedReads);
-    }
-
-    void Cpu::renameRegister(Register reg) {
+    RegisterAllocationTable::Rename Cpu::renameRegister(Register reg) {
         PhysicalRegister dest = nextFreeRegister();
-        rat_.rename(reg, dest);
         registers_.at(dest.index()).ready = false;
+        return rat_.rename(reg, dest);
     }
 
-    void Cpu::renameFloatRegister(FloatRegister fReg) {
+    RegisterAllocationTable::Rename Cpu::renameFloatRegister(FloatRegister fReg) {
         PhysicalRegister dest = nextFreeRegister();
-        rat_.rename(fReg, dest);
         registers_.at(dest.index()).ready = false;
+        return rat_.rename(fReg, dest);
     }
 
-    PhysicalRegister Cpu::nextFreeRegister() const {
-        for (std::size_t i = 0; i < physicalRegisterCnt_; ++i) {
-            if (rat_.isUnmapped(PhysicalRegister{i}) && registers_.at(i).subscribedReads == 0) {
-                return i;
-            }
+    void Cpu::retireRename(const RegisterAllocationTable::Rename& rename) {
+        retiredRat_.apply(rename);
+        freeRegister(rename.previous);
+    }
+
+    void Cpu::squashRename(const RegisterAllocationTable::Rename& rename) {
+        freeRegister(rename.to);
+    }
+
+    PhysicalRegister Cpu::nextFreeRegister() {
+        if (freeRegisters_.empty()) {
+            throw std::runtime_error("No free register was found, either bug in RAT or small scale for physical registers");
         }
-        throw std::runtime_error("No free register was found, either bug in RAT or small scale for physical registers");
+        PhysicalRegister reg = freeRegisters_.back();
+        freeRegisters_.pop_back();
+        return reg;
+    }
+
+    void Cpu::freeRegister(PhysicalRegister reg) {
+        assert(freeRegisters_.size() < physicalRegisterCnt_ - rat_.size());
+        freeRegisters_.push_back(reg);
     }
 
     void Cpu::flushPipeline() {
-        // Unroll speculation
+        stats().logFlush();
+        // Unroll speculation, the squashed instructions free their registers
         reservationStation_.clear();
+        rat_ = retiredRat_;
         predictions_.clear();
-        if (instructionFetch_) {
-            StatsLogger::instance().logClearSpeculation(instructionFetch_->loggingId);
-            instructionFetch_ = std::nullopt;
+        branchPredictor_->unrollSpeculation();
+        auto& logger = stats();
+        if (logger.enabled()) {
+            for (std::size_t i = 0; i < instructionFetch_.size(); ++i) {
+                logger.logClearSpeculation(instructionFetch_[i].loggingId);
+            }
+            for (std::size_t i = 0; i < instructionDecode_.size(); ++i) {
+                logger.logClearSpeculation(instructionDecode_[i].loggingId);
+            }
         }
-        if (instructionDecode_) {
-            StatsLogger::instance().logClearSpeculation(instructionDecode_->loggingId);
-            instructionDecode_ = std::nullopt;
+        instructionFetch_.clear();
+        instructionDecode_.clear();
+    }
+
+    void Cpu::setBranchPredictor(std::unique_ptr<BranchPredictor> predictor) {
+        assert(predictions_.empty());
+        branchPredictor_ = std::move(predictor);
+    }
+
+    void Cpu::setWidths(const Widths& widths) {
+        if (widths.fetch == 0 || widths.decode == 0) {
+            throw std::invalid_argument("Fetch and decode widths must be at least 1");
         }
+        assert(instructionFetch_.empty() && instructionDecode_.empty());
+        widths_ = widths;
+        instructionFetch_ = RingBuffer<InstructionEntry>(widths.fetch);
+        instructionDecode_ = RingBuffer<InstructionEntry>(widths.decode);
+        reservationStation_.setWidths(widths.issue, widths.retire);
     }
 
-    void Cpu::unrollSpeculation(const RegisterAllocationTable& rat) {
+    void Cpu::unrollSpeculation() {
         flushPipeline();
-        // Restore rat
-        rat_ = rat;
 
         // Set correct PC
         speculativeProgramCounter_ = getRegister(Register::ProgramCounter());
@@ -350,7 +642,7 @@ namespace tiny::t86 {
         return writesManager_.registerPendingWrite();
     }
 
-    MemoryWrite& Cpu::getWrite(MemoryWrite::Id id) const {
+    MemoryWrite& Cpu::getWrite(MemoryWrite::Id id) {
         return writesManager_.getWrite(id);
     }
 
@@ -362,32 +654,8 @@ namespace tiny::t86 {
         writesManager_.specifyAddress(id, value);
     }
 
-    std::size_t Cpu::Config::registerCnt() const {
-        return std::stoul(config.get(registerCountConfigString));
-    }
-
-    std::size_t Cpu::Config::floatRegisterCnt() const {
-        return std::stoul(config.get(floatRegisterCountConfigString));
-    }
-
-    std::size_t Cpu::Config::aluCnt() const {
-        return std::stoul(config.get(aluCountConfigString));
-    }
-
-    std::size_t Cpu::Config::reservationStationEntriesCnt() const {
-        return std::stoul(config.get(reservationStationEntriesCountConfigString));
-    }
-
-    std::size_t Cpu::Config::ramSize() const {
-        return std::stoul(config.get(ramSizeConfigString));
-    }
-
-    std::size_t Cpu::Config::ramGatesCount() const {
-        return std::stoul(config.get(ramGatesCountConfigString));
-    }
-
     std::size_t Cpu::Config::getExecutionLength(const Instruction* ins) const {
-        static std::map<Instruction::Signature, std::size_t> lengths = {
+        static const std::map<Instruction::Signature, std::size_t> lengths = {
             { { Instruction::Type::MOV, { Operand::Type::Reg, Operand::Type::Imm } }, 2 },
         };
 
@@ -399,21 +667,31 @@ namespace tiny::t86 {
         }
     }
 
-    Cpu::Config::Config() {
-        config.setDefaultIfMissing(Config::registerCountConfigString,
-                                   std::to_string(Config::defaultRegisterCount));
-        config.setDefaultIfMissing(Config::floatRegisterCountConfigString,
-                                   std::to_string(Config::defaultFloatRegisterCount));
-        config.setDefaultIfMissing(Config::aluCountConfigString,
-                                   std::to_string(Config::defaultAluCount));
-        config.setDefaultIfMissing(Config::reservationStationEntriesCountConfigString,
-                                   std::to_string(Config::defaultReservationStationEntriesCount));
-        config.setDefaultIfMissing(Config::ramSizeConfigString,
-                                   std::to_string(Config::defaultRamSize));
-        config.setDefaultIfMissing(Config::ramGatesCountConfigString,
-                                   std::to_string(Config::defaultRamGatesCount));
+    namespace {
+        std::string option(const tiny::Config& source, const char* name, const std::string& fallback) {
+            return source.has(name) ? source.get(name) : fallback;
+        }
+
+        std::size_t option(const tiny::Config& source, const char* name, std::size_t fallback) {
+            return source.has(name) ? std::stoul(source.get(name)) : fallback;
+        }
     }
 
+    Cpu::Config::Config(const tiny::Config& source)
+            : registerCnt_(option(source, registerCountConfigString, defaultRegisterCount)),
+              floatRegisterCnt_(option(source, floatRegisterCountConfigString, defaultFloatRegisterCount)),
+              aluCnt_(option(source, aluCountConfigString, defaultAluCount)),
+              reservationStationEntriesCnt_(option(source, reservationStationEntriesCountConfigString, defaultReservationStationEntriesCount)),
+              ramSize_(option(source, ramSizeConfigString, defaultRamSize)),
+              ramGatesCount_(option(source, ramGatesCountConfigString, defaultRamGatesCount)),
+              ramReadLatency_(option(source, ramReadLatencyConfigString, defaultRamLatency)),
+              ramWriteLatency_(option(source, ramWriteLatencyConfigString, defaultRamLatency)),
+              fetchWidth_(option(source, fetchWidthConfigString, defaultFetchWidth)),
+              decodeWidth_(option(source, decodeWidthConfigString, defaultDecodeWidth)),
+              issueWidth_(option(source, issueWidthConfigString, defaultIssueWidth)),
+              retireWidth_(option(source, retireWidthConfigString, defaultRetireWidth)),
+              branchPredictor_(option(source, branchPredictorConfigString, std::string(defaultBranchPredictor))) {}
+
     bool Cpu::isTrapFlagSet() {
         // int64_t flags = getRegister(Register::Flags());
         // log_debug("flag register value: {:x}", flags);
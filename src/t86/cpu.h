@@ -2,12 +2,19 @@
 
 #include "program.h"
 #include "instruction.h"
+#include "decoded_instruction.h"
+#include "execution_trace.h"
+#include "mapped_file.h"
 #include "ram.h"
 #include "cpu/register.h"
 #include "cpu/reservation_station.h"
 #include "cpu/register_allocation_table.h"
 #include "cpu/branchpredictor.h"
 #include "cpu/memory_writes_manager.h"
+#include "cpu/functional_engine.h"
+#include "utils/ring_buffer.h"
+#include "utils/stats_logger.h"
+#include "common/config.h"
 
 #include <vector>
 #include <list>
@@ -18,18 +25,27 @@
 #include <memory>
 #include <unordered_map>
 #include <set>
+#include <string>
+#include <iostream>
 
 namespace tiny::t86 {
     class Cpu {
     public:
-        /// A singleton class
+        /**
+         * Options of the cpu, read once from the command line config.
+         * Every Cpu keeps its own copy in its Context, the instance
+         * only provides the defaults for the cpus created without one.
+         */
         class Config {
         public:
-            static Config& instance() {
-                static Config c;
+            /// The options given to the process, read from tiny::config.
+            static const Config& instance() {
+                static const Config c{tiny::config};
                 return c;
             }
 
+            explicit Config(const tiny::Config& source);
+
             constexpr static const char* registerCountConfigString = "-registerCnt";
 
             constexpr static std::size_t defaultRegisterCount = 10;
@@ -54,29 +70,81 @@ namespace tiny::t86 {
 
             constexpr static std::size_t defaultRamGatesCount = 4;
 
+            constexpr static const char* ramReadLatencyConfigString = "-ramReadLatency";
+
+            constexpr static const char* ramWriteLatencyConfigString = "-ramWriteLatency";
+
+            constexpr static std::size_t defaultRamLatency = UniformRamLatency::defaultLatency;
+
+            constexpr static const char* fetchWidthConfigString = "-fetchWidth";
+
+            constexpr static std::size_t defaultFetchWidth = 1;
+
+            constexpr static const char* decodeWidthConfigString = "-decodeWidth";
+
+            constexpr static std::size_t defaultDecodeWidth = 1;
+
+            constexpr static const char* issueWidthConfigString = "-issueWidth";
+
+            /// Zero means no limit, only the ALUs limit the issue
+            constexpr static std::size_t defaultIssueWidth = 0;
+
+            constexpr static const char* retireWidthConfigString = "-retireWidth";
+
+            /// Zero means no limit
+            constexpr static std::size_t defaultRetireWidth = 0;
+
+            constexpr static const char* branchPredictorConfigString = "-branchPredictor";
+
+            /// Either "naive" or "ras"
+            constexpr static const char* defaultBranchPredictor = "naive";
+
             constexpr static const char* debuggerPortString = "-debuggerPort";
 
-            std::size_t registerCnt() const;
+            std::size_t registerCnt() const { return registerCnt_; }
+
+            std::size_t floatRegisterCnt() const { return floatRegisterCnt_; }
+
+            std::size_t aluCnt() const { return aluCnt_; }
+
+            std::size_t reservationStationEntriesCnt() const { return reservationStationEntriesCnt_; }
 
-            std::size_t floatRegisterCnt() const;
+            std::size_t ramSize() const { return ramSize_; }
 
-            std::size_t aluCnt() const;
+            std::size_t ramGatesCount() const { return ramGatesCount_; }
 
-            std::size_t reservationStationEntriesCnt() const;
+            std::size_t ramReadLatency() const { return ramReadLatency_; }
 
-            std::size_t ramSize() const;
+            std::size_t ramWriteLatency() const { return ramWriteLatency_; }
 
-            std::size_t ramGatesCount() const;
+            std::size_t fetchWidth() const { return fetchWidth_; }
+
+            std::size_t decodeWidth() const { return decodeWidth_; }
+
+            std::size_t issueWidth() const { return issueWidth_; }
+
+            std::size_t retireWidth() const { return retireWidth_; }
+
+            const std::string& branchPredictor() const { return branchPredictor_; }
 
             std::size_t getExecutionLength(const Instruction* ins) const;
 
         private:
-            Config();
+            std::size_t registerCnt_;
+            std::size_t floatRegisterCnt_;
+            std::size_t aluCnt_;
+            std::size_t reservationStationEntriesCnt_;
+            std::size_t ramSize_;
+            std::size_t ramGatesCount_;
+            std::size_t ramReadLatency_;
+            std::size_t ramWriteLatency_;
+            std::size_t fetchWidth_;
+            std::size_t decodeWidth_;
+            std::size_t issueWidth_;
+            std::size_t retireWidth_;
+            std::string branchPredictor_;
         };
 
-        // Max instruction operands - for example ADD R1 R2 has 3 (destination and 2 source)
-        static constexpr std::size_t maxInstructionOperands = 3;
-
         // These are Pc, Sp, Bp and Flags
         static constexpr std::size_t specialRegistersCnt = 4;
 
@@ -88,16 +156,90 @@ namespace tiny::t86 {
 
         static constexpr uint64_t TRAP_FLAG_MASK = 0x0400;
 
+        /// How the instructions are executed.
+        enum class Mode {
+            /// The out-of-order model, one call to tick is one cycle.
+            Cycle,
+            /// In order execution without any timing, one call to tick
+            /// executes one instruction.
+            Functional,
+        };
+
+        /// How many instructions go through each pipeline stage in one tick.
+        struct Widths {
+            std::size_t fetch{Config::defaultFetchWidth};
+            std::size_t decode{Config::defaultDecodeWidth};
+            /// Zero means no limit
+            std::size_t issue{Config::defaultIssueWidth};
+            /// Zero means no limit
+            std::size_t retire{Config::defaultRetireWidth};
+        };
+
+        /**
+         * Everything the cpu takes from outside besides the program: its
+         * options, the stats logger and the streams of the I/O instructions
+         * that were not given their own. Cpus with their own contexts share
+         * no mutable state and can run on different threads. The defaults
+         * are the process-wide ones.
+         */
+        struct Context {
+            Config config{Config::instance()};
+            StatsLogger* stats{&StatsLogger::instance()};
+            std::ostream* output{&std::cout};
+            std::istream* input{&std::cin};
+        };
+
+        /**
+         * Architectural state of the cpu as of the last retired instruction,
+         * without the program. A cpu started with the same program continues
+         * from it as if it ran all the instructions before.
+         */
+        struct Checkpoint {
+            std::vector<int64_t> registers;
+            std::vector<double> floatRegisters;
+            int64_t programCounter{0};
+            int64_t stackPointer{0};
+            int64_t stackBasePointer{0};
+            int64_t flags{0};
+            std::vector<uint64_t> debugRegisters;
+            /// Shares the pages with the RAM of the cpu
+            RAM::Image memory;
+            std::size_t retiredInstructions{0};
+        };
+
         Cpu();
 
+        /// Sizes are taken from the options in the context.
+        explicit Cpu(const Context& context);
+
         Cpu(size_t registerCount);
 
         Cpu(size_t registerCount, size_t floatRegisterCount);
 
         Cpu(std::size_t registerCount, std::size_t floatRegisterCount, size_t ramSize);
 
+        Cpu(std::size_t registerCount, std::size_t floatRegisterCount, size_t ramSize, const Context& context);
+
         Cpu(std::size_t registerCount, std::size_t floatRegisterCount, std::size_t aluCnt, std::size_t reservationStationEntriesCount, std::size_t ramSize, std::size_t ramGatesCnt);
 
+        Cpu(std::size_t registerCount, std::size_t floatRegisterCount, std::size_t aluCnt, std::size_t reservationStationEntriesCount, std::size_t ramSize, std::size_t ramGatesCnt, const Context& context);
+
+        const Config& config() const { return context_.config; }
+
+        StatsLogger& stats() const { return *context_.stats; }
+
+        /// Stream of the output instructions that were not given their own.
+        std::ostream& output() const { return *context_.output; }
+
+        /// Stream of the input instructions that were not given their own.
+        std::istream& input() const { return *context_.input; }
+
+        /// Replaces the streams of the I/O instructions that were not given their own.
+        void setStreams(std::istream& input, std::ostream& output) {
+            context_.input = &input;
+            context_.output = &output;
+        }
+
         // These do not include special registers
         std::size_t registersCount() const {
             return registerCnt_;
@@ -111,14 +253,67 @@ namespace tiny::t86 {
             return physicalRegisterCnt_;
         }
 
+        /// Physical registers that are not mapped to any logical one.
+        std::size_t freePhysicalRegistersCount() const {
+            return freeRegisters_.size();
+        }
+
         void connectBreakHandler(std::function<void(Cpu&)> handler);
 
         void doBreak();
 
         void start(Program&& program);
 
+        /// Starts a program that may be shared with other cpus. The program
+        /// itself is never modified, setText only changes the copy of this cpu.
+        void start(std::shared_ptr<const Program> program);
+
         void tick();
 
+        Mode mode() const { return mode_; }
+
+        /// Can also be switched while the program runs. Leaving the cycle model
+        /// throws away the instructions in flight, the functional engine then
+        /// executes them again, so the switch keeps the program correct.
+        void setMode(Mode mode);
+
+        /// Throws away the instructions in flight in the cycle model, they are
+        /// fetched again by the next tick. Afterwards the retired state is the
+        /// whole state of the cpu.
+        void squash();
+
+        /// If enabled, the functional mode trains the branch predictor with the
+        /// jumps it executes, so that the cycle model starts warm after a switch.
+        void setFunctionalWarming(bool warm) { functionalWarming_ = warm; }
+
+        bool functionalWarming() const { return functionalWarming_; }
+
+        /// Trains the branch predictor with a jump executed outside of the pipeline.
+        void warmBranchPredictor(uint64_t pc, const JumpInstruction& instruction, uint64_t destination);
+
+        /// If enabled, a tick after which nothing but the latencies can change
+        /// for a while jumps right to the tick where something happens. The stats
+        /// and the tick count are the same as if all the ticks were done.
+        void setSkipIdleTicks(bool skip) { skipIdleTicks_ = skip; }
+
+        /// The widths are read from the config by the constructor, this
+        /// overrides them. Must be called before the program starts.
+        void setWidths(const Widths& widths);
+
+        const Widths& widths() const { return widths_; }
+
+        /// The predictor is chosen by the config in the constructor, this
+        /// replaces it. Must be called before the program starts.
+        void setBranchPredictor(std::unique_ptr<BranchPredictor> predictor);
+
+        const BranchPredictor& branchPredictor() const { return *branchPredictor_; }
+
+        /// The RAM latencies are uniform, as read from the config,
+        /// unless they are replaced by this.
+        void setRamLatencyPolicy(std::shared_ptr<const RamLatencyPolicy> policy) {
+            ram_.setLatencyPolicy(std::move(policy));
+        }
+
         void jump(const ReservationStation::Entry& entry, bool taken);
 
         int64_t getRegister(PhysicalRegister reg) const;
@@ -133,10 +328,14 @@ namespace tiny::t86 {
 
         std::optional<uint64_t> readMemory(uint64_t address, MemoryWrite::Id maxId);
 
-        MemoryWrite& getWrite(MemoryWrite::Id id) const;
+        MemoryWrite& getWrite(MemoryWrite::Id id);
 
         void writeMemory(MemoryWrite::Id id);
 
+        /// Writes the value to the RAM right away, bypassing the pending writes,
+        /// and checks the watchpoints. Used by the functional engine.
+        void storeMemory(uint64_t address, int64_t value);
+
         bool halted() const;
 
         void halt();
@@ -149,15 +348,20 @@ namespace tiny::t86 {
 
         void setReady(PhysicalRegister reg);
 
-        void renameRegister(Register reg);
+        /// Maps the register to a free physical register. The returned rename
+        /// has to be passed to retireRename or squashRename later.
+        RegisterAllocationTable::Rename renameRegister(Register reg);
 
-        void renameFloatRegister(FloatRegister fReg);
+        RegisterAllocationTable::Rename renameFloatRegister(FloatRegister fReg);
 
-        const RegisterAllocationTable& getRat() const;
+        /// The renaming instruction retired, the rename becomes part of the
+        /// retired state and the previously mapped register is freed.
+        void retireRename(const RegisterAllocationTable::Rename& rename);
 
-        void subscribeRegisterRead(PhysicalRegister reg);
+        /// The renaming instruction was thrown away, frees its register.
+        void squashRename(const RegisterAllocationTable::Rename& rename);
 
-        void unsubscribeRegisterRead(PhysicalRegister reg);
+        const RegisterAllocationTable& getRat() const;
 
         MemoryWrite::Id registerPendingWrite(Memory::Immediate mem);
 
@@ -165,7 +369,9 @@ namespace tiny::t86 {
 
         void specifyWriteAddress(MemoryWrite::Id id, uint64_t value);
 
-        void unrollSpeculation(const RegisterAllocationTable& rat);
+        /// Throws away all speculatively executed instructions and continues
+        /// from the state of the last retired one.
+        void unrollSpeculation();
 
         void flushPipeline();
 
@@ -179,6 +385,62 @@ namespace tiny::t86 {
         /// Tells the CPU that single step has been completed.
         void singleStepped();
 
+        /// Takes the checkpoint of the retired state. The cpu must not have
+        /// instructions in flight, see squash.
+        Checkpoint checkpoint() const;
+
+        /// Continues from the checkpoint, must be called after start and before
+        /// the first tick. Throws std::invalid_argument if the checkpoint was taken
+        /// on a cpu with different numbers of registers or size of the RAM.
+        void restore(const Checkpoint& checkpoint);
+
+        /**
+         * Creates a cpu of the same sizes and options, with its own context,
+         * that continues from the retired state of this one. The program, the
+         * patched text and the pages of the RAM are shared, a page is copied
+         * by the cpu that writes it first, so forking does not copy the memory.
+         * The instructions in flight stay in this cpu, which continues with
+         * the same ticks as without the fork. The cpus can then run on
+         * different threads.
+         */
+        std::unique_ptr<Cpu> fork(const Context& context);
+
+        /**
+         * Continues from the retired state of the other cpu of the same sizes,
+         * usually a fork of this one, sharing the pages of its RAM. The text,
+         * the debug registers and the options of this cpu stay, a halted cpu
+         * runs again. The instructions in flight are squashed first.
+         */
+        void rewind(Cpu& other);
+
+        /// Pages of the RAM not shared with a mapped file or a forked cpu.
+        std::size_t ownedRamPages() const { return ram_.ownedPages(); }
+
+        /// Address of the instruction after the last retired one.
+        uint64_t retiredProgramCounter() const;
+
+        /// Number of instructions retired since the cpu was created.
+        std::size_t retiredInstructions() const { return retiredInstructions_; }
+
+        /// Tells the CPU that the instruction at the address retired.
+        void instructionRetired(uint64_t pc) {
+            ++retiredInstructions_;
+            if (executionTrace_) {
+                traceRetirement(pc);
+            }
+        }
+
+        /// Records the retired instructions into the trace, nullptr stops.
+        /// The cpu must not have instructions in flight when it starts.
+        void setExecutionTrace(ExecutionTraceWriter* trace) { executionTrace_ = trace; }
+
+        /// Tells the trace the value read or printed by the retiring instruction.
+        void inputOutputRetired(int64_t value) {
+            if (executionTrace_) {
+                executionTrace_->inputOutput(value);
+            }
+        }
+
         /// Following function are for debug only
         /// In execution, version with PhysicalRegister should be used
         /// NOTE: Debug only but they are used anyway with special registers...
@@ -202,9 +464,17 @@ namespace tiny::t86 {
 
         void setMemory(uint64_t address, int64_t value);
 
-        size_t textSize() const { return program_.instructions().size(); }
+        /// Puts the words of the file into the RAM from the address on, without copying
+        /// the whole pages of them. Throws std::out_of_range if they do not fit.
+        void mapMemory(uint64_t address, std::shared_ptr<const MappedFile> file);
+
+        size_t textSize() const { return text_.size(); }
 
-        const Instruction& getText(uint64_t address);
+        const Instruction& getText(uint64_t address) const;
+
+        /// Returns the decoded instruction at given address, NOP if the
+        /// address is outside of the program.
+        const DecodedInstruction& getDecodedText(uint64_t address) const;
 
         void setText(uint64_t address, std::unique_ptr<Instruction> ins);
 
@@ -228,6 +498,8 @@ namespace tiny::t86 {
             debug_registers_.at(i) = value;
         }
     private:
+        Context context_;
+
         /// If true then after every retired instruction an interrupt 1 is sent.
         /// TODO: This should really be a part of flags register. For now however,
         /// it is a separate entity because the flags are often set with '=', which
@@ -239,41 +511,76 @@ namespace tiny::t86 {
         // Branch processing
         void checkBranchPrediction(const ReservationStation::Entry& entry, uint64_t destination);
 
-        void registerBranchNotTaken(uint64_t sourcePc);
+        void registerBranchNotTaken(uint64_t sourcePc, const JumpInstruction& instruction);
+
+        void registerBranchTaken(uint64_t sourcePc, const JumpInstruction& instruction, uint64_t destination);
 
-        void registerBranchTaken(uint64_t sourcePc, uint64_t destination);
+        PhysicalRegister nextFreeRegister();
 
-        PhysicalRegister nextFreeRegister() const;
+        void freeRegister(PhysicalRegister reg);
+
+        void functionalTick();
+
+        /// Called after a tick in which only the latencies ticked down,
+        /// does all the following ticks that would do the same at once.
+        void advanceOverIdleTicks();
 
         /// Checks if any of the writes were done to location watched by debug
         /// registers and if so then sets an interrupt.
         void checkWrite(uint64_t address);
 
+        /// Passes the registers written by the instruction at the address to the trace.
+        void traceRetirement(uint64_t pc);
+
+        /// Decodes the whole program into text_ and the NOP past its end.
+        void decodeProgram();
+
+        /// The checkpoint without the memory. The retired registers are
+        /// complete also with instructions in flight.
+        Checkpoint registerCheckpoint() const;
+
+        /// Restores all but the memory, the sizes must match.
+        void restoreRegisters(const Checkpoint& checkpoint);
+
         // Harvard architecture
-        Program program_;
+        std::shared_ptr<const Program> program_{std::make_shared<const Program>()};
+
+        // Instructions put into the text by setText, the shared program stays intact
+        // Shared with the forked cpus
+        std::vector<std::shared_ptr<const Instruction>> patches_;
+
+        // Decoded program_, indexed the same way
+        std::vector<DecodedInstruction> text_;
+
+        // Returned for the addresses past the text, decoded with the options of this cpu
+        DecodedInstruction nop_;
 
         uint64_t speculativeProgramCounter_{0};
 
         struct InstructionEntry {
-            const Instruction* instruction;
+            const DecodedInstruction* instruction;
             std::size_t pc;
             std::size_t loggingId;
         };
 
         InstructionEntry fetchInstruction();
 
-        std::optional<InstructionEntry> instructionFetch_;
+        // Instructions in the fetch and decode stages, oldest first
+        RingBuffer<InstructionEntry> instructionFetch_;
+
+        RingBuffer<InstructionEntry> instructionDecode_;
 
-        std::optional<InstructionEntry> instructionDecode_;
+        Widths widths_;
 
         std::size_t registerCnt_;
         std::size_t floatRegisterCnt_;
+        std::size_t aluCnt_;
+        std::size_t reservationStationEntriesCnt_;
         std::size_t physicalRegisterCnt_;
 
         struct RegisterValue {
             int64_t value{0};
             bool ready{false};
-            std::size_t subscribedReads{0};
         };
 
         // Values of registers, indexed by PhysicalRegister
@@ -292,12 +599,27 @@ namespace tiny::t86 {
         // Register allocation table
         RegisterAllocationTable rat_;
 
+        // Register allocation table as of the last retired instruction,
+        // rat_ is restored from it when the speculation is thrown away
+        RegisterAllocationTable retiredRat_;
+
+        // Physical registers not mapped by any table, used as a stack
+        std::vector<PhysicalRegister> freeRegisters_;
+
         RAM ram_;
 
         MemoryWritesManager writesManager_;
 
+        Mode mode_{Mode::Cycle};
+
+        bool skipIdleTicks_{false};
+
+        bool functionalWarming_{false};
+
+        FunctionalEngine functionalEngine_;
+
         // list of predicted jump destinations
-        std::list<uint64_t> predictions_;
+        RingBuffer<uint64_t> predictions_;
 
         std::function<void(Cpu&)> breakHandler_;
 
@@ -305,6 +627,10 @@ namespace tiny::t86 {
 
         bool single_stepped_{false};
 
+        std::size_t retiredInstructions_{0};
+
+        ExecutionTraceWriter* executionTrace_{nullptr};
+
         // Zero means that the program is not interrupted, any other number
         // means that interrupt has occured.
         int interrupted_{0};
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "dynamic_branch_predictor.h"
+
+namespace tiny::t86 {
+    /// Predicts the direction from a counter of the jump's own pc.
+    class BimodalBranchPredictor : public DynamicBranchPredictor {
+    public:
+        static constexpr std::size_t defaultSize = 1024;
+
+        explicit BimodalBranchPredictor(std::size_t size = defaultSize) : counters_(size) {}
+
+        std::unique_ptr<BranchPredictor> clone() const override {
+            return std::make_unique<BimodalBranchPredictor>(*this);
+        }
+
+    protected:
+        bool predictTaken(uint64_t pc) override {
+            return counters_.taken(pc);
+        }
+
+        void updateDirection(uint64_t pc, bool taken) override {
+            counters_.update(pc, taken);
+        }
+
+    private:
+        SaturatingCounters counters_;
+    };
+}
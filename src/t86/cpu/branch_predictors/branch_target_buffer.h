@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace tiny::t86 {
+    /**
+     * Remembers the last destination of jumps whose destination is
+     * not known at fetch (JMP R, CALL R). Direct mapped by the pc,
+     * the tag tells apart the jumps that map to the same entry.
+     */
+    class BranchTargetBuffer {
+    public:
+        static constexpr std::size_t defaultSize = 256;
+
+        explicit BranchTargetBuffer(std::size_t size = defaultSize) : entries_(size == 0 ? 1 : size) {}
+
+        std::optional<uint64_t> lookup(uint64_t pc) const {
+            const Entry& entry = entries_[pc % entries_.size()];
+            if (entry.valid && entry.pc == pc) {
+                return entry.target;
+            }
+            return std::nullopt;
+        }
+
+        void update(uint64_t pc, uint64_t target) {
+            entries_[pc % entries_.size()] = Entry{pc, target, true};
+        }
+
+    private:
+        struct Entry {
+            uint64_t pc{0};
+            uint64_t target{0};
+            bool valid{false};
+        };
+
+        std::vector<Entry> entries_;
+    };
+}
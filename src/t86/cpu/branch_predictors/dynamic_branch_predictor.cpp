@@ -0,0 +1,64 @@
+#include "dynamic_branch_predictor.h"
+
+namespace tiny::t86 {
+    uint64_t DynamicBranchPredictor::nextGuess(uint64_t pc, const JumpInstruction& instruction) {
+        // Keeps the return address stack up to date
+        uint64_t guess = ReturnAddressStackPredictor::nextGuess(pc, instruction);
+        Instruction::Type type = instruction.type();
+        if (type == Instruction::Type::RET) {
+            return guess;
+        }
+        if (isConditional(type) && !predictTaken(pc)) {
+            return pc + 1;
+        }
+        if (!instruction.getDestination().isFetched()) {
+            if (auto target = targets_.lookup(pc)) {
+                return *target;
+            }
+        }
+        return guess;
+    }
+
+    void DynamicBranchPredictor::registerBranchTaken(uint64_t pc, const JumpInstruction& instruction, uint64_t destination) {
+        ReturnAddressStackPredictor::registerBranchTaken(pc, instruction, destination);
+        Instruction::Type type = instruction.type();
+        if (isConditional(type)) {
+            updateDirection(pc, true);
+        }
+        if (type != Instruction::Type::RET && !instruction.getDestination().isFetched()) {
+            targets_.update(pc, destination);
+        }
+    }
+
+    void DynamicBranchPredictor::registerBranchNotTaken(uint64_t pc, const JumpInstruction& instruction) {
+        ReturnAddressStackPredictor::registerBranchNotTaken(pc, instruction);
+        if (isConditional(instruction.type())) {
+            updateDirection(pc, false);
+        }
+    }
+
+    bool DynamicBranchPredictor::isConditional(Instruction::Type type) {
+        switch (type) {
+            case Instruction::Type::LOOP:
+            case Instruction::Type::JZ:
+            case Instruction::Type::JNZ:
+            case Instruction::Type::JE:
+            case Instruction::Type::JNE:
+            case Instruction::Type::JG:
+            case Instruction::Type::JGE:
+            case Instruction::Type::JL:
+            case Instruction::Type::JLE:
+            case Instruction::Type::JA:
+            case Instruction::Type::JAE:
+            case Instruction::Type::JB:
+            case Instruction::Type::JBE:
+            case Instruction::Type::JO:
+            case Instruction::Type::JNO:
+            case Instruction::Type::JS:
+            case Instruction::Type::JNS:
+                return true;
+            default:
+                return false;
+        }
+    }
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "return_address_stack_predictor.h"
+#include "branch_target_buffer.h"
+
+namespace tiny::t86 {
+    /**
+     * Base of the predictors that learn from the retired jumps.
+     * The direction of conditional jumps is predicted by the subclass,
+     * destinations not known at fetch come from the branch target buffer
+     * and returns from the return address stack.
+     */
+    class DynamicBranchPredictor : public ReturnAddressStackPredictor {
+    public:
+        uint64_t nextGuess(uint64_t pc, const JumpInstruction& instruction) override;
+
+        void registerBranchTaken(uint64_t pc, const JumpInstruction& instruction, uint64_t destination) override;
+
+        void registerBranchNotTaken(uint64_t pc, const JumpInstruction& instruction) override;
+
+        /// JZ to JNS and LOOP, the jumps that are not always taken.
+        static bool isConditional(Instruction::Type type);
+
+    protected:
+        /// Called when a conditional jump is fetched.
+        virtual bool predictTaken(uint64_t pc) = 0;
+
+        /// Called when a conditional jump retires, in program order.
+        virtual void updateDirection(uint64_t pc, bool taken) = 0;
+
+    private:
+        BranchTargetBuffer targets_;
+    };
+
+    /// Table of two bit saturating counters, the upper half of the values means taken.
+    /// They start weakly taken, the same as the naive predictor guesses.
+    class SaturatingCounters {
+    public:
+        explicit SaturatingCounters(std::size_t size) : counters_(size == 0 ? 1 : size, 2) {}
+
+        bool taken(std::size_t index) const {
+            return counters_[index % counters_.size()] >= 2;
+        }
+
+        void update(std::size_t index, bool taken) {
+            uint8_t& counter = counters_[index % counters_.size()];
+            if (taken && counter < 3) {
+                ++counter;
+            } else if (!taken && counter > 0) {
+                --counter;
+            }
+        }
+
+    private:
+        std::vector<uint8_t> counters_;
+    };
+}
@@ -0,0 +1,24 @@
+#include "gshare_branch_predictor.h"
+
+namespace tiny::t86 {
+    GshareBranchPredictor::GshareBranchPredictor(std::size_t historyBits)
+            : mask_((uint64_t{1} << historyBits) - 1), counters_(mask_ + 1) {}
+
+    bool GshareBranchPredictor::predictTaken(uint64_t pc) {
+        bool taken = counters_.taken(index(pc, speculativeHistory_));
+        speculativeHistory_ = extend(speculativeHistory_, taken);
+        return taken;
+    }
+
+    void GshareBranchPredictor::updateDirection(uint64_t pc, bool taken) {
+        // Unless something before was mispredicted, this is the same
+        // history the jump was predicted with
+        counters_.update(index(pc, retiredHistory_), taken);
+        retiredHistory_ = extend(retiredHistory_, taken);
+    }
+
+    void GshareBranchPredictor::unrollSpeculation() {
+        DynamicBranchPredictor::unrollSpeculation();
+        speculativeHistory_ = retiredHistory_;
+    }
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "dynamic_branch_predictor.h"
+
+namespace tiny::t86 {
+    /**
+     * Predicts the direction from a counter indexed by the pc xored with
+     * the outcomes of the last conditional jumps. The history is extended
+     * by the predictions at fetch and repaired from the retired history
+     * when the speculation is thrown away.
+     */
+    class GshareBranchPredictor : public DynamicBranchPredictor {
+    public:
+        static constexpr std::size_t defaultHistoryBits = 10;
+
+        explicit GshareBranchPredictor(std::size_t historyBits = defaultHistoryBits);
+
+        void unrollSpeculation() override;
+
+        std::unique_ptr<BranchPredictor> clone() const override {
+            return std::make_unique<GshareBranchPredictor>(*this);
+        }
+
+    protected:
+        bool predictTaken(uint64_t pc) override;
+
+        void updateDirection(uint64_t pc, bool taken) override;
+
+    private:
+        std::size_t index(uint64_t pc, uint64_t history) const {
+            return (pc ^ history) & mask_;
+        }
+
+        uint64_t extend(uint64_t history, bool taken) const {
+            return ((history << 1) | (taken ? 1 : 0)) & mask_;
+        }
+
+        const uint64_t mask_;
+
+        SaturatingCounters counters_;
+
+        uint64_t speculativeHistory_{0};
+
+        uint64_t retiredHistory_{0};
+    };
+}
@@ -1,6 +1,6 @@
 #include "naive_branch_predictor.h"
 
-uint64_t tiny::t86::NaiveBranchPredictor::nextGuess(uint64_t pc, const JumpInstruction& instruction) const {
+uint64_t tiny::t86::NaiveBranchPredictor::nextGuess(uint64_t pc, const JumpInstruction& instruction) {
     const Operand& destination = instruction.getDestination();
     if (destination.isFetched()) {
         return destination.getValue();
@@ -11,6 +11,6 @@ uint64_t tiny::t86::NaiveBranchPredictor::nextGuess(uint64_t pc, const JumpInstr
     }
 }
 
-void tiny::t86::NaiveBranchPredictor::registerBranchTaken(uint64_t, uint64_t) {}
+void tiny::t86::NaiveBranchPredictor::registerBranchTaken(uint64_t, const JumpInstruction&, uint64_t) {}
 
-void tiny::t86::NaiveBranchPredictor::registerBranchNotTaken(uint64_t) {}
+void tiny::t86::NaiveBranchPredictor::registerBranchNotTaken(uint64_t, const JumpInstruction&) {}
@@ -7,10 +7,14 @@
 namespace tiny::t86 {
     class NaiveBranchPredictor : public BranchPredictor {
     public:
-        uint64_t nextGuess(uint64_t pc, const JumpInstruction& instruction) const override;
+        uint64_t nextGuess(uint64_t pc, const JumpInstruction& instruction) override;
 
-        void registerBranchTaken(uint64_t pc, uint64_t destination) override;
+        void registerBranchTaken(uint64_t pc, const JumpInstruction& instruction, uint64_t destination) override;
 
-        void registerBranchNotTaken(uint64_t pc) override;
+        void registerBranchNotTaken(uint64_t pc, const JumpInstruction& instruction) override;
+
+        std::unique_ptr<BranchPredictor> clone() const override {
+            return std::make_unique<NaiveBranchPredictor>(*this);
+        }
     };
 }
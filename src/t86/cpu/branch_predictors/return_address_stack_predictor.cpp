@@ -0,0 +1,53 @@
+#include "return_address_stack_predictor.h"
+
+#include <algorithm>
+
+namespace tiny::t86 {
+    ReturnAddressStackPredictor::ReturnAddressStackPredictor(std::size_t capacity)
+            : speculative_(capacity), retired_(capacity) {}
+
+    uint64_t ReturnAddressStackPredictor::nextGuess(uint64_t pc, const JumpInstruction& instruction) {
+        switch (instruction.type()) {
+            case Instruction::Type::CALL:
+                speculative_.push(pc + 1);
+                break;
+            case Instruction::Type::RET:
+                if (auto address = speculative_.pop()) {
+                    return *address;
+                }
+                break;
+            default:
+                break;
+        }
+        return NaiveBranchPredictor::nextGuess(pc, instruction);
+    }
+
+    void ReturnAddressStackPredictor::registerBranchTaken(uint64_t pc, const JumpInstruction& instruction, uint64_t) {
+        if (instruction.type() == Instruction::Type::CALL) {
+            retired_.push(pc + 1);
+        } else if (instruction.type() == Instruction::Type::RET) {
+            retired_.pop();
+        }
+    }
+
+    void ReturnAddressStackPredictor::unrollSpeculation() {
+        // Both have the same capacity, so this does not allocate
+        speculative_ = retired_;
+    }
+
+    void ReturnAddressStackPredictor::Stack::push(uint64_t address) {
+        top_ = (top_ + 1) % addresses_.size();
+        addresses_[top_] = address;
+        size_ = std::min(size_ + 1, addresses_.size());
+    }
+
+    std::optional<uint64_t> ReturnAddressStackPredictor::Stack::pop() {
+        if (size_ == 0) {
+            return std::nullopt;
+        }
+        uint64_t address = addresses_[top_];
+        top_ = (top_ + addresses_.size() - 1) % addresses_.size();
+        --size_;
+        return address;
+    }
+}
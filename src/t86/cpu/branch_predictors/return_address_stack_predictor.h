@@ -0,0 +1,57 @@
+#pragma once
+
+#include "naive_branch_predictor.h"
+
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+namespace tiny::t86 {
+    /**
+     * Predicts the destination of RET from a stack of return addresses,
+     * CALL pushes the address after itself when it is fetched. Other jumps
+     * are predicted the same way as by the naive predictor.
+     * The stack is changed already on the speculative path, so a copy
+     * that only follows the retired calls and returns is kept to repair
+     * it when the speculation is thrown away.
+     */
+    class ReturnAddressStackPredictor : public NaiveBranchPredictor {
+    public:
+        static constexpr std::size_t defaultCapacity = 16;
+
+        explicit ReturnAddressStackPredictor(std::size_t capacity = defaultCapacity);
+
+        uint64_t nextGuess(uint64_t pc, const JumpInstruction& instruction) override;
+
+        void registerBranchTaken(uint64_t pc, const JumpInstruction& instruction, uint64_t destination) override;
+
+        void unrollSpeculation() override;
+
+        std::unique_ptr<BranchPredictor> clone() const override {
+            return std::make_unique<ReturnAddressStackPredictor>(*this);
+        }
+
+    private:
+        /// Stack of fixed capacity, when full the oldest address is overwritten.
+        class Stack {
+        public:
+            explicit Stack(std::size_t capacity) : addresses_(capacity == 0 ? 1 : capacity) {}
+
+            void push(uint64_t address);
+
+            std::optional<uint64_t> pop();
+
+        private:
+            std::vector<uint64_t> addresses_;
+
+            // Index of the top address
+            std::size_t top_{0};
+
+            std::size_t size_{0};
+        };
+
+        Stack speculative_;
+
+        Stack retired_;
+    };
+}
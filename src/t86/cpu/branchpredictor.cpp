@@ -0,0 +1,25 @@
+#include "branchpredictor.h"
+#include "branch_predictors/naive_branch_predictor.h"
+#include "branch_predictors/return_address_stack_predictor.h"
+#include "branch_predictors/bimodal_branch_predictor.h"
+#include "branch_predictors/gshare_branch_predictor.h"
+
+#include <stdexcept>
+
+namespace tiny::t86 {
+    std::unique_ptr<BranchPredictor> BranchPredictor::create(const std::string& name) {
+        if (name == "naive") {
+            return std::make_unique<NaiveBranchPredictor>();
+        }
+        if (name == "ras") {
+            return std::make_unique<ReturnAddressStackPredictor>();
+        }
+        if (name == "bimodal") {
+            return std::make_unique<BimodalBranchPredictor>();
+        }
+        if (name == "gshare") {
+            return std::make_unique<GshareBranchPredictor>();
+        }
+        throw std::invalid_argument("Unknown branch predictor `" + name + "`, expected `naive`, `ras`, `bimodal` or `gshare`");
+    }
+}
@@ -3,19 +3,34 @@
 #include "../instruction.h"
 
 #include <cstddef>
+#include <memory>
+#include <string>
 
 namespace tiny::t86 {
     class BranchPredictor {
     public:
         virtual ~BranchPredictor() = default;
 
+        /// Creates the predictor with given name ("naive", "ras", "bimodal" or
+        /// "gshare"), throws std::invalid_argument for an unknown name.
+        static std::unique_ptr<BranchPredictor> create(const std::string& name);
+
+        /// Copy of the predictor with everything it has learned so far.
+        virtual std::unique_ptr<BranchPredictor> clone() const = 0;
+
         // Instruction pointer would be unique
         // but pc is provided so that the predictor can predict some relative jumps
+        // Called when the jump is fetched, so it is on the speculative path
         // Returns new pc
-        virtual uint64_t nextGuess(uint64_t pc, const JumpInstruction& instruction) const = 0;
+        virtual uint64_t nextGuess(uint64_t pc, const JumpInstruction& instruction) = 0;
+
+        // Called when the jump at pc retires
+        virtual void registerBranchTaken(uint64_t pc, const JumpInstruction& instruction, uint64_t destination) = 0;
 
-        virtual void registerBranchTaken(uint64_t pc, uint64_t destination) = 0;
+        virtual void registerBranchNotTaken(uint64_t pc, const JumpInstruction& instruction) = 0;
 
-        virtual void registerBranchNotTaken(uint64_t pc) = 0;
+        /// The speculatively fetched instructions were thrown away, any state
+        /// changed by nextGuess since the last retired jump is repaired.
+        virtual void unrollSpeculation() {}
     };
 }
@@ -0,0 +1,283 @@
+#include "functional_engine.h"
+#include "../cpu.h"
+#include "../instruction.h"
+#include "../decoded_instruction.h"
+#include "../execution_error.h"
+#include "common/helpers.h"
+
+#include <cassert>
+#include <fmt/core.h>
+#include <stdexcept>
+
+namespace tiny::t86 {
+    FunctionalEngine::FunctionalEngine(Cpu& cpu) : cpu_(cpu) {}
+
+    void FunctionalEngine::step() {
+        uint64_t pc = cpu_.getRegister(Register::ProgramCounter());
+        const DecodedInstruction& instruction = cpu_.getDecodedText(pc);
+        // Instructions see the address of the next instruction in IP,
+        // the same as in the out-of-order model
+        cpu_.setRegister(Register::ProgramCounter(), pc + 1);
+        execute(instruction);
+        if (instruction.isJump && cpu_.functionalWarming()) {
+            cpu_.warmBranchPredictor(pc, static_cast<const JumpInstruction&>(*instruction.instruction),
+                                     cpu_.getRegister(Register::ProgramCounter()));
+        }
+        cpu_.instructionRetired(pc);
+    }
+
+    Operand FunctionalEngine::fetch(Operand operand) const {
+        while (!operand.isFetched()) {
+            Requirement requirement = operand.requirement();
+            if (requirement.isRegisterRead()) {
+                operand.supply(getRegister(requirement.getRegisterRead()));
+            } else if (requirement.isFloatRegisterRead()) {
+                operand.supply(cpu_.getFloatRegister(requirement.getFloatRegisterRead()));
+            } else if (requirement.isMemoryRead()) {
+                operand.supply(cpu_.getMemory(requirement.getMemoryRead()));
+            } else {
+                assert(false && "Unhandled requirement type");
+            }
+        }
+        return operand;
+    }
+
+    int64_t FunctionalEngine::value(const Operand& operand) const {
+        return fetch(operand).getValue();
+    }
+
+    double FunctionalEngine::floatValue(const Operand& operand) const {
+        return fetch(operand).getFloatValue();
+    }
+
+    uint64_t FunctionalEngine::address(Operand operand) const {
+        while (!operand.isMemoryImmediate()) {
+            Requirement requirement = operand.requirement();
+            assert(requirement.isRegisterRead() && "Memory operand must be addressed by registers");
+            operand.supply(getRegister(requirement.getRegisterRead()));
+        }
+        return operand.getMemoryImmediate().index();
+    }
+
+    int64_t FunctionalEngine::getRegister(Register reg) const {
+        return cpu_.getRegister(reg);
+    }
+
+    void FunctionalEngine::setRegister(Register reg, int64_t value) {
+        if (reg.index() >= cpu_.registersCount()
+                && Register::ProgramCounter() != reg
+                && Register::StackPointer() != reg
+                && Register::StackBasePointer() != reg
+                && Register::Flags() != reg) {
+            throw T86ExecutionError(fmt::format(
+                "Register out of range ({})", reg.index()));
+        }
+        cpu_.setRegister(reg, value);
+    }
+
+    void FunctionalEngine::setFloatRegister(FloatRegister fReg, double value) {
+        if (fReg.index() >= cpu_.floatRegistersCount()) {
+            throw T86ExecutionError(fmt::format(
+                "Float register out of range ({})", fReg.index()));
+        }
+        cpu_.setFloatRegister(fReg, value);
+    }
+
+    void FunctionalEngine::push(int64_t value) {
+        int64_t sp = getRegister(Register::StackPointer()) - 1;
+        cpu_.storeMemory(sp, value);
+        setRegister(Register::StackPointer(), sp);
+    }
+
+    int64_t FunctionalEngine::pop() {
+        int64_t sp = getRegister(Register::StackPointer());
+        int64_t value = cpu_.getMemory(sp);
+        setRegister(Register::StackPointer(), sp + 1);
+        return value;
+    }
+
+    void FunctionalEngine::execute(const DecodedInstruction& decoded) {
+        using Type = Instruction::Type;
+        const Instruction& instruction = *decoded.instruction;
+        const auto& operands = decoded.operands;
+        const auto& signatureOperands = decoded.signatureOperands;
+        switch (decoded.type) {
+            case Type::MOD:
+            case Type::ADD:
+            case Type::SUB:
+            case Type::MUL:
+            case Type::DIV:
+            case Type::IMUL:
+            case Type::IDIV:
+            case Type::AND:
+            case Type::OR:
+            case Type::XOR:
+            case Type::LSH:
+            case Type::RSH: {
+                const auto& ins = static_cast<const BinaryArithmeticInstruction&>(instruction);
+                Alu::Result res = ins.compute(value(operands[0]), value(operands[1]));
+                setRegister(ins.destination(), res.value);
+                setRegister(Register::Flags(), res.flags);
+                break;
+            }
+            case Type::FADD:
+            case Type::FSUB:
+            case Type::FMUL:
+            case Type::FDIV: {
+                const auto& ins = static_cast<const FloatBinaryArithmeticInstruction&>(instruction);
+                Alu::FloatResult res = ins.compute(floatValue(operands[0]), floatValue(operands[1]));
+                setFloatRegister(operands[0].getFloatRegister(), res.value);
+                setRegister(Register::Flags(), res.flags);
+                break;
+            }
+            case Type::INC:
+            case Type::DEC:
+            case Type::NEG:
+            case Type::NOT: {
+                const auto& ins = static_cast<const UnaryArithmeticInstruction&>(instruction);
+                Alu::Result res = ins.compute(value(operands[0]));
+                setRegister(operands[0].getRegister(), res.value);
+                setRegister(Register::Flags(), res.flags);
+                break;
+            }
+            case Type::NOP:
+                break;
+            case Type::HALT:
+                cpu_.halt();
+                break;
+            case Type::BKPT:
+                // TODO: Hardcoded
+                cpu_.interrupt(3);
+                break;
+            case Type::BREAK:
+                cpu_.doBreak();
+                break;
+            case Type::DBG:
+                static_cast<const DBG&>(instruction).debugFunction()(cpu_);
+                break;
+            case Type::MOV: {
+                const Operand& destination = signatureOperands[0];
+                if (destination.isRegister()) {
+                    setRegister(destination.getRegister(), value(signatureOperands[1]));
+                } else if (destination.isFloatRegister()) {
+                    setFloatRegister(destination.getFloatRegister(), floatValue(signatureOperands[1]));
+                } else {
+                    int64_t val = value(signatureOperands[1]);
+                    cpu_.storeMemory(address(destination), val);
+                }
+                break;
+            }
+            case Type::LEA: {
+                setRegister(signatureOperands[0].getRegister(), address(signatureOperands[1]));
+                break;
+            }
+            case Type::CLF:
+                setRegister(Register::Flags(), Alu::Flags{false, false, false, false});
+                break;
+            case Type::CMP: {
+                Alu::Result res = Alu::subtract(value(operands[0]), value(operands[1]));
+                setRegister(Register::Flags(), res.flags);
+                break;
+            }
+            case Type::FCMP: {
+                Alu::FloatResult res = Alu::fsubtract(floatValue(operands[0]), floatValue(operands[1]));
+                setRegister(Register::Flags(), res.flags);
+                break;
+            }
+            case Type::JMP: {
+                setRegister(Register::ProgramCounter(), value(operands[0]));
+                break;
+            }
+            case Type::JZ:
+            case Type::JNZ:
+            case Type::JE:
+            case Type::JNE:
+            case Type::JG:
+            case Type::JGE:
+            case Type::JL:
+            case Type::JLE:
+            case Type::JA:
+            case Type::JAE:
+            case Type::JB:
+            case Type::JBE:
+            case Type::JO:
+            case Type::JNO:
+            case Type::JS:
+            case Type::JNS: {
+                const auto& ins = static_cast<const ConditionalJumpInstruction&>(instruction);
+                int64_t destination = value(operands[0]);
+                if (ins.condition(getRegister(Register::Flags()))) {
+                    setRegister(Register::ProgramCounter(), destination);
+                }
+                break;
+            }
+            case Type::LOOP: {
+                int64_t destination = value(operands[1]);
+                Alu::Result res = Alu::subtract(value(operands[0]), 1);
+                setRegister(operands[0].getRegister(), res.value);
+                setRegister(Register::Flags(), res.flags);
+                if (res.value != 0) {
+                    setRegister(Register::ProgramCounter(), destination);
+                }
+                break;
+            }
+            case Type::CALL: {
+                int64_t destination = value(operands[0]);
+                push(getRegister(Register::ProgramCounter()));
+                setRegister(Register::ProgramCounter(), destination);
+                break;
+            }
+            case Type::RET:
+                setRegister(Register::ProgramCounter(), pop());
+                break;
+            case Type::PUSH:
+            case Type::FPUSH: {
+                push(value(operands[0]));
+                break;
+            }
+            case Type::POP: {
+                int64_t val = pop();
+                setRegister(signatureOperands[0].getRegister(), val);
+                break;
+            }
+            case Type::FPOP: {
+                int64_t val = pop();
+                setFloatRegister(signatureOperands[0].getFloatRegister(), utils::reinterpret_safe<double>(val));
+                break;
+            }
+            case Type::PUTCHAR: {
+                const auto& ins = static_cast<const PUTCHAR&>(instruction);
+                int64_t c = value(operands[0]);
+                ins.outputStream(cpu_) << static_cast<char>(c) << std::flush;
+                cpu_.inputOutputRetired(c);
+                break;
+            }
+            case Type::PUTNUM: {
+                const auto& ins = static_cast<const PUTNUM&>(instruction);
+                int64_t number = value(operands[0]);
+                ins.outputStream(cpu_) << static_cast<int>(number) << std::endl;
+                cpu_.inputOutputRetired(number);
+                break;
+            }
+            case Type::GETCHAR: {
+                const auto& ins = static_cast<const GETCHAR&>(instruction);
+                char c;
+                ins.inputStream(cpu_) >> c;
+                cpu_.inputOutputRetired(c);
+                setRegister(signatureOperands[0].getRegister(), c);
+                break;
+            }
+            case Type::EXT: {
+                setFloatRegister(signatureOperands[0].getFloatRegister(), static_cast<double>(value(signatureOperands[1])));
+                break;
+            }
+            case Type::NRW: {
+                setRegister(signatureOperands[0].getRegister(), static_cast<int64_t>(floatValue(signatureOperands[1])));
+                break;
+            }
+            default:
+                throw std::runtime_error("Unhandled instruction type in functional engine: "
+                                         + Instruction::typeToString(decoded.type));
+        }
+    }
+}
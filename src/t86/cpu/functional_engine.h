@@ -0,0 +1,52 @@
+#pragma once
+
+#include "register.h"
+#include "../instructions/operand.h"
+
+#include <cstdint>
+
+namespace tiny::t86 {
+    // Forward declaration
+    class Cpu;
+
+    struct DecodedInstruction;
+
+    /**
+     * Executes instructions in order, one at a time, directly against the
+     * architectural registers and RAM. There is no renaming, no reservation
+     * station and no memory latency, so this is much faster than the
+     * out-of-order model but it does not say anything about timing.
+     */
+    class FunctionalEngine {
+    public:
+        explicit FunctionalEngine(Cpu& cpu);
+
+        /// Executes the instruction at the program counter.
+        void step();
+
+    private:
+        void execute(const DecodedInstruction& decoded);
+
+        /// Supplies registers and memory to the operand until it is a value.
+        Operand fetch(Operand operand) const;
+
+        int64_t value(const Operand& operand) const;
+
+        double floatValue(const Operand& operand) const;
+
+        /// Computes the address of a memory operand without reading it.
+        uint64_t address(Operand operand) const;
+
+        int64_t getRegister(Register reg) const;
+
+        void setRegister(Register reg, int64_t value);
+
+        void setFloatRegister(FloatRegister fReg, double value);
+
+        void push(int64_t value);
+
+        int64_t pop();
+
+        Cpu& cpu_;
+    };
+}
@@ -1,66 +1,124 @@
 #include <cassert>
+#include <algorithm>
 
 #include "memory_writes_manager.h"
 
 namespace tiny::t86 {
 
     MemoryWrite::Id MemoryWritesManager::registerPendingWrite() {
-        MemoryWrite::Id writeId = ++currentId;
-        unspecifiedWrites_.insert(writeId);
+        MemoryWrite::Id writeId = push(std::nullopt);
+        // Ids are increasing, so this keeps the vector sorted
+        unspecifiedWrites_.push_back(writeId);
         return writeId;
     }
 
     MemoryWrite::Id MemoryWritesManager::registerPendingWrite(std::size_t address) {
+        return push(address);
+    }
+
+    MemoryWrite::Id MemoryWritesManager::push(std::optional<std::size_t> address) {
         MemoryWrite::Id writeId = ++currentId;
-        writesById.emplace(writeId, writesMap_[address].add(writeId, address));
+        if (queue_.empty()) {
+            firstId_ = writeId;
+        }
+        assert(writeId == firstId_ + queue_.size());
+        queue_.push_back(Entry{MemoryWrite(writeId, address.value_or(0)), address.has_value(), false});
+        if (address) {
+            ++addressCounts_[addressSlot(*address)];
+        }
         return writeId;
     }
 
     void MemoryWritesManager::specifyAddress(MemoryWrite::Id id, std::size_t address) {
-        std::size_t erased = unspecifiedWrites_.erase(id);
-        assert(erased == 1
+        auto it = std::find(unspecifiedWrites_.begin(), unspecifiedWrites_.end(), id);
+        assert(it != unspecifiedWrites_.end()
                 && "Trying to specify address for invalid, unknown or already specified write id");
-        writesById.emplace(id, writesMap_[address].add(id, address));
+        unspecifiedWrites_.erase(it);
+        Entry& e = entry(id);
+        e.write = MemoryWrite(id, address);
+        e.hasAddress = true;
+        ++addressCounts_[addressSlot(address)];
     }
 
-    void MemoryWritesManager::specifyValue(MemoryWrite::Id id, uint64_t value) const {
+    void MemoryWritesManager::specifyValue(MemoryWrite::Id id, uint64_t value) {
         auto& write = getWrite(id);
         write.setValue(value);
     }
 
     std::optional<MemoryWrite> MemoryWritesManager::previousWrite(std::size_t address, MemoryWrite::Id maxId) const {
         assert(!hasUnspecifiedWrites(maxId));
-        // Lets check, if there are some pending writes to this address
-        auto it = writesMap_.find(address);
-        if (it == writesMap_.end()) {
+        if (addressCounts_[addressSlot(address)] == 0 || queue_.empty() || maxId < firstId_) {
             return std::nullopt;
         }
-        return it->second.latest(maxId);
+        // Search from the youngest write the reader may see
+        std::size_t end = std::min<std::size_t>(maxId - firstId_ + 1, queue_.size());
+        for (std::size_t i = end; i > 0; --i) {
+            const Entry& e = queue_[i - 1];
+            if (!e.removed && e.hasAddress && e.write.address() == address) {
+                return e.write;
+            }
+        }
+        return std::nullopt;
     }
 
     void MemoryWritesManager::removeFinished(const RAM& ram) {
-        for (auto& [address, writes] : writesMap_) {
-            auto removedIds = writes.removeFinished(ram);
-            for (MemoryWrite::Id id : removedIds) {
-                writesById.erase(id);
+        for (std::size_t i = 0; i < queue_.size(); ++i) {
+            Entry& e = queue_[i];
+            if (!e.removed && e.write.isOutgoing() && !ram.pending(e.write.writeId())) {
+                remove(e);
             }
         }
+        dropRemoved();
     }
 
     void MemoryWritesManager::removePending() {
-        for (auto& [address, writes] : writesMap_) {
-            auto removedIds = writes.removePending();
-            for (MemoryWrite::Id id : removedIds) {
-                writesById.erase(id);
+        // The ids stay consecutive, so the removed entries are only
+        // dropped when they get to the front
+        for (std::size_t i = 0; i < queue_.size(); ++i) {
+            Entry& e = queue_[i];
+            if (!e.removed && e.write.isPending()) {
+                remove(e);
             }
         }
+        dropRemoved();
         unspecifiedWrites_.clear();
     }
 
-    MemoryWrite& MemoryWritesManager::getWrite(MemoryWrite::Id id) const {
-        auto it = writesById.find(id);
-        assert(it != writesById.end() && "Unknown id");
-        return it->second;
+    void MemoryWritesManager::remove(Entry& e) {
+        e.removed = true;
+        if (e.hasAddress) {
+            assert(addressCounts_[addressSlot(e.write.address())] > 0);
+            --addressCounts_[addressSlot(e.write.address())];
+        }
+    }
+
+    void MemoryWritesManager::dropRemoved() {
+        while (!queue_.empty() && queue_.front().removed) {
+            queue_.pop_front();
+            ++firstId_;
+        }
+    }
+
+    MemoryWritesManager::Entry& MemoryWritesManager::entry(MemoryWrite::Id id) {
+        assert(id >= firstId_ && id - firstId_ < queue_.size() && "Unknown id");
+        return queue_[id - firstId_];
+    }
+
+    const MemoryWritesManager::Entry& MemoryWritesManager::entry(MemoryWrite::Id id) const {
+        assert(id >= firstId_ && id - firstId_ < queue_.size() && "Unknown id");
+        return queue_[id - firstId_];
+    }
+
+    MemoryWrite& MemoryWritesManager::getWrite(MemoryWrite::Id id) {
+        Entry& e = entry(id);
+        assert(e.hasAddress && !e.removed);
+        return e.write;
+    }
+
+    const MemoryWrite& MemoryWritesManager::getWrite(MemoryWrite::Id id) const {
+        const Entry& e = entry(id);
+        assert(e.hasAddress && !e.removed);
+        return e.write;
     }
 
     void MemoryWritesManager::startWriting(MemoryWrite::Id id, RAM& ram) {
@@ -1,22 +1,28 @@
 #pragma once
 
-#include <list>
-#include <memory>
-#include <unordered_map>
-#include <unordered_set>
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <vector>
 
 #include "memory_writes_manager/memory_write.h"
-#include "memory_writes_manager/memory_writes.h"
+#include "../utils/ring_buffer.h"
 
 namespace tiny::t86 {
+    /**
+     * Store queue, keeps the memory writes from their registration
+     * until the RAM finishes them. The writes are ordered by their ids,
+     * which are consecutive, so a write is found by its id directly.
+     * All the work done per tick is proportional to the number of
+     * writes in flight, not to the number of addresses ever written.
+     */
     class MemoryWritesManager {
     public:
         MemoryWrite::Id currentMaxWriteId() const {
             return currentId;
         }
 
-        /// Removes all finished outgoing writes and returns
-        /// addresses of the finished writes.
+        /// Removes all finished outgoing writes.
         void removeFinished(const RAM& ram);
 
         /**
@@ -35,32 +41,70 @@ namespace tiny::t86 {
         void specifyAddress(MemoryWrite::Id, std::size_t address);
 
         /// Specify value of the write, this does not transitions the write to outgoing state
-        void specifyValue(MemoryWrite::Id, uint64_t value) const;
+        void specifyValue(MemoryWrite::Id, uint64_t value);
 
         /// Starts the writing
         void startWriting(MemoryWrite::Id id, RAM& ram);
 
         bool hasUnspecifiedWrites(MemoryWrite::Id maxId) const {
-            auto it = unspecifiedWrites_.lower_bound(maxId);
-            return it != unspecifiedWrites_.end();
+            return !unspecifiedWrites_.empty() && unspecifiedWrites_.front() <= maxId;
         }
 
         /**
-         * Checks if there are some pending writes
+         * Returns the latest write to the address with id up to maxId,
+         * its value can be forwarded to a read.
          * It DOES NOT take into account all writes with unspecified address
          * Check hasUnspecifiedWrites
          */
         std::optional<MemoryWrite> previousWrite(std::size_t address, MemoryWrite::Id maxId) const;
 
-        MemoryWrite& getWrite(MemoryWrite::Id id) const;
+        MemoryWrite& getWrite(MemoryWrite::Id id);
+
+        const MemoryWrite& getWrite(MemoryWrite::Id id) const;
+
+        /// Number of writes in flight, including the removed ones that
+        /// are younger than the oldest write still in flight.
+        std::size_t size() const {
+            return queue_.size();
+        }
 
     private:
+        struct Entry {
+            MemoryWrite write{0, 0};
+            bool hasAddress{false};
+            // Finished or thrown away, the entry is dropped once it gets to the front
+            bool removed{false};
+        };
+
+        Entry& entry(MemoryWrite::Id id);
+
+        const Entry& entry(MemoryWrite::Id id) const;
+
+        MemoryWrite::Id push(std::optional<std::size_t> address);
+
+        void remove(Entry& entry);
+
+        /// Drops the removed entries from the front of the queue.
+        void dropRemoved();
+
+        static std::size_t addressSlot(std::size_t address) {
+            return address % addressCountsSize;
+        }
+
         MemoryWrite::Id currentId{0};
 
-        std::unordered_map<std::size_t, MemoryWrites> writesMap_;
+        // Writes ordered by id, the front has id firstId_
+        RingBuffer<Entry> queue_;
+
+        MemoryWrite::Id firstId_{1};
+
+        static constexpr std::size_t addressCountsSize = 256;
 
-        std::unordered_map<MemoryWrite::Id, MemoryWrite&> writesById;
+        // Number of writes in flight per address slot. If the slot of an address
+        // has no writes, a read can skip searching the queue
+        std::array<uint32_t, addressCountsSize> addressCounts_{};
 
-        std::set<MemoryWrite::Id, std::greater<>> unspecifiedWrites_;
+        // Ids of writes without address, sorted in ascending order
+        std::vector<MemoryWrite::Id> unspecifiedWrites_;
     };
 }
@@ -1,110 +1,57 @@
 #include "register_allocation_table.h"
 
-#include <cassert>
-
-#include "../cpu.h"
 #include "../execution_error.h"
 #include "fmt/core.h"
 
 namespace tiny::t86 {
 
-    RegisterAllocationTable::RegisterAllocationTable(Cpu& cpu, std::size_t registerCnt, std::size_t floatRegisterCnt)
-            : cpu_{cpu} {
-        std::size_t i = 0;
-        for (; i < registerCnt; ++i) {
-            table_.insert_or_assign(Register{i}, PhysicalRegister{i});
-        }
-        for (std::size_t j = 0; j < floatRegisterCnt; ++j, ++i) {
-            table_.insert_or_assign(FloatRegister{j}, PhysicalRegister{i});
+    RegisterAllocationTable::RegisterAllocationTable(std::size_t registerCnt, std::size_t floatRegisterCnt)
+            : registerCnt_{registerCnt}, floatRegisterCnt_{floatRegisterCnt} {
+        // Program counter, stack pointer, stack base pointer and flags
+        std::size_t slots = registerCnt + floatRegisterCnt + 4;
+        table_.reserve(slots);
+        for (std::size_t i = 0; i < slots; ++i) {
+            table_.emplace_back(i);
         }
-        table_.insert_or_assign(Register::ProgramCounter(), PhysicalRegister{ ++i });
-        table_.insert_or_assign(Register::StackPointer(), PhysicalRegister{ ++i });
-        table_.insert_or_assign(Register::StackBasePointer(), PhysicalRegister{ ++i });
-        table_.insert_or_assign(Register::Flags(), PhysicalRegister{ ++i });
-        subscribeToReads();
     }
 
-    RegisterAllocationTable::RegisterAllocationTable(const RegisterAllocationTable& other)
-            : table_{other.table_}, cpu_{other.cpu_} {
-        subscribeToReads();
+    RegisterAllocationTable::Rename RegisterAllocationTable::rename(Register from, PhysicalRegister to) {
+        std::size_t s = slot(from);
+        Rename result{s, to, table_[s]};
+        table_[s] = to;
+        return result;
     }
 
-    RegisterAllocationTable::RegisterAllocationTable(RegisterAllocationTable&& other)
-            : table_{std::move(other.table_)}, cpu_{other.cpu_} {
+    RegisterAllocationTable::Rename RegisterAllocationTable::rename(FloatRegister from, PhysicalRegister to) {
+        std::size_t s = slot(from);
+        Rename result{s, to, table_[s]};
+        table_[s] = to;
+        return result;
     }
 
-
-    RegisterAllocationTable::~RegisterAllocationTable() {
-        unsubscribeFromReads();
-    }
-
-    void RegisterAllocationTable::subscribeToReads() {
-        for (const auto&[x, physical] : table_) {
-            cpu_.subscribeRegisterRead(physical);
+    std::size_t RegisterAllocationTable::slot(Register reg) const {
+        std::size_t special = registerCnt_ + floatRegisterCnt_;
+        if (reg == Register::ProgramCounter()) {
+            return special;
+        } else if (reg == Register::StackPointer()) {
+            return special + 1;
+        } else if (reg == Register::StackBasePointer()) {
+            return special + 2;
+        } else if (reg == Register::Flags()) {
+            return special + 3;
         }
-    }
-
-    void RegisterAllocationTable::unsubscribeFromReads() {
-        for (const auto&[x, physical] : table_) {
-            cpu_.unsubscribeRegisterRead(physical);
-        }
-    }
-
-    RegisterAllocationTable& RegisterAllocationTable::operator=(const RegisterAllocationTable& other) {
-        assert(&cpu_ == &other.cpu_);
-
-        if (&other == this) {
-            return *this;
-        }
-
-        unsubscribeFromReads();
-
-        table_ = other.table_;
-
-        subscribeToReads();
-
-        return *this;
-    }
-
-    void RegisterAllocationTable::rename(Register from, PhysicalRegister to) {
-        if (from.index() >= cpu_.registersCount()
-                && Register::ProgramCounter() != from.index()
-                && Register::StackPointer() != from.index()
-                && Register::StackBasePointer() != from.index()
-                && Register::Flags() != from.index()) {
+        if (reg.index() >= registerCnt_) {
             throw T86ExecutionError(fmt::format(
-                "Register out of range ({})", from.index()));
-        }
-        if (auto it = table_.find(from); it != table_.end()) {
-            cpu_.unsubscribeRegisterRead(it->second);
+                "Register out of range ({})", reg.index()));
         }
-        table_.insert_or_assign(from, to);
-        cpu_.subscribeRegisterRead(to);
+        return reg.index();
     }
 
-    void RegisterAllocationTable::rename(FloatRegister from, PhysicalRegister to) {
-        if (from.index() >= cpu_.floatRegistersCount()) {
+    std::size_t RegisterAllocationTable::slot(FloatRegister fReg) const {
+        if (fReg.index() >= floatRegisterCnt_) {
             throw T86ExecutionError(fmt::format(
-                "Float register out of range ({})", from.index()));
-        }
-        if (auto it = table_.find(from); it != table_.end()) {
-            cpu_.unsubscribeRegisterRead(it->second);
+                "Float register out of range ({})", fReg.index()));
         }
-        table_.insert_or_assign(from, to);
-        cpu_.subscribeRegisterRead(to);
-    }
-
-    PhysicalRegister RegisterAllocationTable::translate(Register reg) const {
-        return table_.at(reg);
-    }
-
-    PhysicalRegister RegisterAllocationTable::translate(FloatRegister fReg) const {
-        return table_.at(fReg);
-    }
-
-    bool RegisterAllocationTable::isUnmapped(PhysicalRegister reg) const {
-        return std::all_of(table_.begin(), table_.end(), [reg](const auto& mapping) {
-            return mapping.second.index() != reg.index();
-        });
+        return registerCnt_ + fReg.index();
     }
 }
@@ -1,43 +1,72 @@
 #pragma once
 
-#include <map>
+#include <vector>
 
 #include "register.h"
 
 namespace tiny::t86 {
-    class Cpu;
-
+    /**
+     * Maps logical registers to physical ones.
+     * The table is a flat array indexed by the logical register, general purpose
+     * registers go first, then the float registers and the four special
+     * registers at the end. Copying the table is therefore a single memcpy,
+     * which makes it cheap to keep as a checkpoint.
+     *
+     * The table does not own the physical registers, the cpu frees them
+     * once the renaming instruction retires, see Cpu::retireRename.
+     */
     class RegisterAllocationTable {
     public:
+        /// Single change of the table done by renaming.
+        struct Rename {
+            /// Index of the renamed logical register in the table
+            std::size_t slot;
+            PhysicalRegister to;
+            /// Physical register the logical register was mapped to before
+            PhysicalRegister previous;
+        };
+
         // The number of logical registers here is passed so we don't have to worry
-        // if cpu's register count is already initialized
-        RegisterAllocationTable(Cpu& cpu, std::size_t registerCnt, std::size_t floatRegisterCnt);
+        // if cpu's register count is already initialized.
+        // The i-th logical register is mapped to i-th physical register.
+        RegisterAllocationTable(std::size_t registerCnt, std::size_t floatRegisterCnt);
 
-        RegisterAllocationTable(const RegisterAllocationTable& other);
+        /// Number of the logical registers, including the special ones.
+        std::size_t size() const {
+            return table_.size();
+        }
 
-        RegisterAllocationTable(RegisterAllocationTable&& other);
+        Rename rename(Register from, PhysicalRegister to);
 
-        ~RegisterAllocationTable();
+        Rename rename(FloatRegister from, PhysicalRegister to);
 
-        RegisterAllocationTable& operator=(const RegisterAllocationTable& other);
+        /// Applies the renaming done on some other table.
+        void apply(const Rename& rename) {
+            table_[rename.slot] = rename.to;
+        }
 
-        void rename(Register from, PhysicalRegister to);
+        PhysicalRegister translate(Register reg) const {
+            return table_[slot(reg)];
+        }
 
-        void rename(FloatRegister from, PhysicalRegister to);
+        PhysicalRegister translate(FloatRegister fReg) const {
+            return table_[slot(fReg)];
+        }
 
-        PhysicalRegister translate(Register reg) const;
+        /// Physical register mapped to the slot.
+        PhysicalRegister translateSlot(std::size_t slot) const {
+            return table_[slot];
+        }
 
-        PhysicalRegister translate(FloatRegister fReg) const;
+        std::size_t slot(Register reg) const;
 
-        bool isUnmapped(PhysicalRegister reg) const;
+        std::size_t slot(FloatRegister fReg) const;
 
     protected:
-        void subscribeToReads();
-
-        void unsubscribeFromReads();
+        std::vector<PhysicalRegister> table_;
 
-        std::map<std::variant<Register, FloatRegister>, PhysicalRegister> table_;
+        std::size_t registerCnt_;
 
-        Cpu& cpu_;
+        std::size_t floatRegisterCnt_;
     };
 }
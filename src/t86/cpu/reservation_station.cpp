@@ -1,38 +1,52 @@
 #include "reservation_station.h"
 #include "../cpu.h"
+#include "../decoded_instruction.h"
 #include "../utils/stats_logger.h"
 #include "logger.h"
 
+#include <algorithm>
 #include <cassert>
 #include <stdexcept>
 #include <exception>
+#include <limits>
 
 namespace tiny::t86 {
     void ReservationStation::executeAndRetire() {
-        // First check finished ones by progressing execution
-        for (auto& entry : entries_) {
-            if (entry.state() == Entry::State::executing) {
-                if (entry.executionTick()) {
-                    // finished
-                    if (entry.instruction()->needsAlu()) {
-                        ++freeAlus_;
-                    }
+        // First check finished ones by progressing execution, in program order
+        std::size_t stillExecuting = 0;
+        for (Entry* entry : executing_) {
+            if (entry->executionTick()) {
+                entry->finishExecution();
+                ++changes_;
+                if (entry->needsAlu()) {
+                    ++freeAlus_;
                 }
+            } else {
+                executing_[stillExecuting++] = entry;
             }
         }
+        executing_.resize(stillExecuting);
 
-        // List of entries are in order of execution
+        // Entries are in order of execution
         // We start from the start and retire until first unfinished instruction is met
         // It is better to do this in this while loop, because retiring conditional jump instruction
-        // might lead to erasure of all other instructions in reservation station (invalidating all iterators)
+        // might lead to erasure of all other instructions in reservation station
         // Instructions that just ended execution can retire also in this tick
         // but one tick was also "taken" by preparing state
-        while (!entries_.empty()) {
-            if (entries_.front().state() == Entry::State::retiring) {
-                Entry entry = std::move(entries_.front());
-                entries_.pop_front();
+        std::size_t retired = 0;
+        while (size_ > 0 && (retireWidth_ == 0 || retired < retireWidth_)) {
+            if (entryAt(0).state() == Entry::State::retiring) {
+                // Free the slot first, retiring can clear the entries
+                Entry& entry = entryAt(0);
+                head_ = (head_ + 1) % entries_.size();
+                --size_;
+                ++retired;
                 entry.logRetirement();
+                // Before retiring, so that unrolling the speculation
+                // during retirement restores the state including this entry
+                entry.retireRenames();
                 entry.retire();
+                ++changes_;
             }
             else {
                 break;
@@ -41,80 +55,27 @@ namespace tiny::t86 {
     }
 
     void ReservationStation::fetchAndStartExecution() {
+        std::size_t issued = 0;
         // Loop through the rest and update them
-        for (auto& entry : entries_) {
+        for (std::size_t i = 0; i < size_; ++i) {
+            Entry& entry = entryAt(i);
             switch (entry.state()) {
-                case Entry::State::preparing: {
+                case Entry::State::preparing:
                     entry.logPreparing();
-                    bool fetchStall{false};
-                    for (Operand& operand : entry.operands()) {
-                        // Check if we need to fetch and fetch as much as we can right now
-                        while(!operand.isFetched()) {
-                            // Get the requirement
-                            Requirement requirement = operand.requirement();
-                            if (requirement.isRegisterRead()) {
-                                Register reg = requirement.getRegisterRead();
-                                if (entry.registerAvailable(reg)) {
-                                    operand.supply(entry.getRegister(reg));
-                                } else {
-                                    fetchStall = true;
-                                    entry.logStallRegisterFetch(reg);
-                                    // This following is very hacky, it's here only for better logging
-                                    // This assumes that there are max 2 register in operands
-                                    // We don't really care for memory, the mem will not start fetching until we know the address, that can be made of 2 registers    
-                                    // COPY the operand, not to mess up the real operand
-                                    Operand op = operand;
-                                    // supply dummy value
-                                    op.supply((int64_t)0);
-                                    // Check it still needs another register
-                                    if (!op.isFetched()) {
-                                        Requirement req = op.requirement();
-                                        if (req.isRegisterRead()) {
-                                            // Another register
-                                            Register r = req.getRegisterRead();
-                                            // check if available
-                                            if (!entry.registerAvailable(r)) {
-                                                // We log this one as well
-                                                entry.logStallRegisterFetch(r);
-                                            }
-                                        }
-                                    }
-                                    break;
-                                }
-                            } else if (requirement.isFloatRegisterRead()) {
-                                FloatRegister fReg = requirement.getFloatRegisterRead();
-                                if (entry.floatRegisterAvailable(fReg)) {
-                                    operand.supply(entry.getFloatRegister(fReg));
-                                } else {
-                                    fetchStall = true;
-                                    entry.logStallFloatRegisterFetch(fReg);
-                                    break;
-                                }
-                            } else if (requirement.isMemoryRead()) {
-                                uint64_t address = requirement.getMemoryRead();
-                                auto optMemory = entry.readMemory(address);
-                                if (optMemory.has_value()) {
-                                    operand.supply(optMemory.value());
-                                } else {
-                                    fetchStall = true;
-                                    entry.logStallRAMRead(address);
-                                    break;
-                                }
-                            } else {
-                                assert(false && "Unhandled requirement type");
-                            }
-                        }
-                    }
-                    if (fetchStall) {
-                        entry.logStallFetch();
+                    // Nothing the entry waits for has changed, it would stall the same way again
+                    if (entry.woken()) {
+                        fetchOperands(entry);
                     }
-                    // Check if all operands fetched
-                    entry.checkReady();
+                    entry.logStalls();
                     break;
-                }
                 case Entry::State::ready:
+                    // All the issue slots of this tick are taken, logged the same as waiting for an ALU
+                    if (issueWidth_ != 0 && issued == issueWidth_) {
+                        entry.logStallALU();
+                        break;
+                    }
                     // Check for ALU
-                    if (entry.instruction()->needsAlu()) {
+                    if (entry.needsAlu()) {
                         // No ALU is free
                         if (!freeAlus_) {
                             entry.logStallALU();
@@ -125,6 +86,11 @@ namespace tiny::t86 {
                     // Start execution
                     // Again, this will result into one tick spent in "ready" state
                     entry.startExecution();
+                    ++issued;
+                    ++changes_;
+                    // Entries start in program order, unless an older one waited for an ALU
+                    executing_.insert(std::upper_bound(executing_.begin(), executing_.end(), &entry,
+                        [](const Entry* a, const Entry* b) { return a->sequence() < b->sequence(); }), &entry);
                     // This transition can be interpreted as already executing
                     [[fallthrough]];
                 case Entry::State::executing:
@@ -141,29 +107,147 @@ namespace tiny::t86 {
         }
     }
 
+    void ReservationStation::fetchOperands(Entry& entry) {
+        entry.clearStalls();
+        for (Operand& operand : entry.operands()) {
+            // Check if we need to fetch and fetch as much as we can right now
+            while(!operand.isFetched()) {
+                // Get the requirement
+                Requirement requirement = operand.requirement();
+                if (requirement.isRegisterRead()) {
+                    Register reg = requirement.getRegisterRead();
+                    if (entry.registerAvailable(reg)) {
+                        operand.supply(entry.getRegister(reg));
+                        ++changes_;
+                    } else {
+                        entry.addStall(StatsLogger::Event::StallRegisterFetch, reg.index());
+                        waitFor(entry, entry.physicalRegister(reg));
+                        // This following is very hacky, it's here only for better logging
+                        // This assumes that there are max 2 register in operands
+                        // We don't really care for memory, the mem will not start fetching until we know the address, that can be made of 2 registers
+                        // COPY the operand, not to mess up the real operand
+                        Operand op = operand;
+                        // supply dummy value
+                        op.supply((int64_t)0);
+                        // Check it still needs another register
+                        if (!op.isFetched()) {
+                            Requirement req = op.requirement();
+                            if (req.isRegisterRead()) {
+                                // Another register
+                                Register r = req.getRegisterRead();
+                                // check if available
+                                if (!entry.registerAvailable(r)) {
+                                    // We log this one as well, and wake up when it changes
+                                    entry.addStall(StatsLogger::Event::StallRegisterFetch, r.index());
+                                    waitFor(entry, entry.physicalRegister(r));
+                                }
+                            }
+                        }
+                        break;
+                    }
+                } else if (requirement.isFloatRegisterRead()) {
+                    FloatRegister fReg = requirement.getFloatRegisterRead();
+                    if (entry.floatRegisterAvailable(fReg)) {
+                        operand.supply(entry.getFloatRegister(fReg));
+                        ++changes_;
+                    } else {
+                        entry.addStall(StatsLogger::Event::StallFloatRegisterFetch, fReg.index());
+                        waitFor(entry, entry.physicalRegister(fReg));
+                        break;
+                    }
+                } else if (requirement.isMemoryRead()) {
+                    uint64_t address = requirement.getMemoryRead();
+                    auto optMemory = entry.readMemory(address);
+                    if (optMemory.has_value()) {
+                        operand.supply(optMemory.value());
+                        ++changes_;
+                    } else {
+                        // Memory is not tracked, the entry is woken up every tick
+                        entry.addStall(StatsLogger::Event::StallRAMRead, address);
+                        break;
+                    }
+                } else {
+                    assert(false && "Unhandled requirement type");
+                }
+            }
+        }
+        // Check if all operands fetched
+        entry.checkReady();
+        if (entry.state() == Entry::State::ready) {
+            ++changes_;
+        }
+    }
+
+    std::size_t ReservationStation::idleTicks() const {
+        std::size_t result = std::numeric_limits<std::size_t>::max();
+        for (const Entry* entry : executing_) {
+            // The execution finishes in the tick the time drops to zero
+            std::size_t remaining = entry->remainingExecutionTime();
+            result = std::min(result, remaining == 0 ? 0 : remaining - 1);
+        }
+        return result;
+    }
+
+    void ReservationStation::skipTicks(std::size_t ticks) {
+        assert(ticks <= idleTicks());
+        for (Entry* entry : executing_) {
+            entry->skipExecutionTicks(ticks);
+        }
+    }
+
+    void ReservationStation::waitFor(Entry& entry, PhysicalRegister reg) {
+        registerWaiters_[reg.index()].push_back(Waiter{&entry, entry.sequence()});
+    }
+
+    void ReservationStation::wakeUp(PhysicalRegister reg) {
+        auto& waiters = registerWaiters_[reg.index()];
+        for (const Waiter& waiter : waiters) {
+            // Entries retired or cleared since then are left alone
+            if (waiter.entry->sequence() == waiter.sequence) {
+                waiter.entry->wakeUp();
+            }
+        }
+        waiters.clear();
+    }
+
     bool ReservationStation::hasFreeEntry() const {
-        return entries_.size() < maxEntries_;
+        return size_ < entries_.size();
     }
 
     ReservationStation::ReservationStation(Cpu& cpu, std::size_t aluCnt, std::size_t maxEntriesCnt)
-            : maxEntries_(maxEntriesCnt), cpu_(cpu), freeAlus_(aluCnt) {}
+            : registerWaiters_(cpu.physicalRegistersCount()),
+              cpu_(cpu), freeAlus_(aluCnt) {
+        entries_.reserve(maxEntriesCnt);
+        for (std::size_t i = 0; i < maxEntriesCnt; ++i) {
+            entries_.emplace_back(cpu);
+        }
+        executing_.reserve(maxEntriesCnt);
+    }
+
+    void ReservationStation::setWidths(std::size_t issueWidth, std::size_t retireWidth) {
+        issueWidth_ = issueWidth;
+        retireWidth_ = retireWidth;
+    }
 
-    void ReservationStation::add(const Instruction* instruction, std::size_t nextPc, std::size_t loggingId) {
-        assert(entries_.size() < maxEntries_ && "Can't add another entry, max capacity was reached");
-        cpu_.renameRegister(Register::ProgramCounter());
+    void ReservationStation::add(const DecodedInstruction& instruction, std::size_t nextPc, std::size_t loggingId) {
+        assert(hasFreeEntry() && "Can't add another entry, max capacity was reached");
+        Entry::Renames renames;
+        renames.push_back(cpu_.renameRegister(Register::ProgramCounter()));
         cpu_.setRegister(Register::ProgramCounter(), nextPc);
-        RegisterAllocationTable readRat = cpu_.getRat();
-        std::vector<MemoryWrite::Id> memWriteIds;
-        for (const auto& product : instruction->produces()) {
+        ++changes_;
+        Entry& entry = newEntry();
+        entry.reset(instruction, cpu_.getRat(), nextPc - 1, loggingId, nextSequence_++);
+        Entry::MemoryWriteIds memWriteIds;
+        for (const auto& product : instruction.products) {
             if (product.isRegister()) {
                 Register reg = product.getRegister();
                 // We always rename program counter
                 if (reg != Register::ProgramCounter()) {
-                    cpu_.renameRegister(reg);
+                    renames.push_back(cpu_.renameRegister(reg));
                 }
             } else if (product.isFloatRegister()) {
                 FloatRegister fReg = product.getFloatRegister();
-                cpu_.renameFloatRegister(fReg);
+                renames.push_back(cpu_.renameFloatRegister(fReg));
             } else if (product.isMemoryImmediate()) {
                 memWriteIds.push_back(cpu_.registerPendingWrite(product.getMemoryImmediate()));
             } else if (product.isMemoryRegister()) {
@@ -172,11 +256,7 @@ namespace tiny::t86 {
                 assert(false && "Missing product type");
             }
         }
-        RegisterAllocationTable writeRat = cpu_.getRat();
-        auto& entry = entries_.emplace_back(instruction, cpu_,
-                              std::move(readRat), std::move(writeRat),
-                              std::move(memWriteIds), cpu_.currentMaxWriteId(),
-                              loggingId);
+        entry.finishRenaming(renames, memWriteIds, cpu_.currentMaxWriteId());
 
         // Log as preparing status
         entry.logPreparing();
@@ -185,13 +265,23 @@ namespace tiny::t86 {
     }
 
     void ReservationStation::clear() {
-        for (const auto& entry : entries_) {
-            if (entry.state() == Entry::State::executing && entry.instruction()->needsAlu()) {
+        for (std::size_t i = 0; i < size_; ++i) {
+            Entry& entry = entryAt(i);
+            if (entry.state() == Entry::State::executing && entry.needsAlu()) {
                 ++freeAlus_;
             }
             entry.logClearSpeculation();
+            entry.squashRenames();
         }
-        entries_.clear();
+        // The waiters are left in place, they are recognized by the sequence number
+        executing_.clear();
+        ++changes_;
+        size_ = 0;
+    }
+
+    ReservationStation::Entry& ReservationStation::newEntry() {
+        ++size_;
+        return entryAt(size_ - 1);
     }
 
     bool ReservationStation::Entry::registerAvailable(Register reg) const {
@@ -212,17 +302,30 @@ namespace tiny::t86 {
         return cpu_.getFloatRegister(readRat_.translate(fReg));
     }
 
+    PhysicalRegister ReservationStation::Entry::renamed(std::size_t slot) const {
+        // The latest rename wins if the register was renamed twice
+        for (auto it = renames_.end(); it != renames_.begin();) {
+            --it;
+            if (it->slot == slot) {
+                return it->to;
+            }
+        }
+        // Not renamed by this instruction, it is mapped the same way it was read
+        return readRat_.translateSlot(slot);
+    }
+
     void ReservationStation::Entry::setRegister(Register reg, int64_t val) {
-        assert(reg == Register::ProgramCounter() || !cpu_.registerReady(writeRat_.translate(reg)));
-        cpu_.setRegister(writeRat_.translate(reg), val);
+        PhysicalRegister dest = renamed(readRat_.slot(reg));
+        assert(reg == Register::ProgramCounter() || !cpu_.registerReady(dest));
+        cpu_.setRegister(dest, val);
     }
 
     void ReservationStation::Entry::setFloatRegister(FloatRegister fReg, double val) {
-        cpu_.setRegister(writeRat_.translate(fReg), val);
+        cpu_.setRegister(renamed(readRat_.slot(fReg)), val);
     }
 
     uint64_t ReservationStation::Entry::getUpdatedProgramCounter() const {
-        return cpu_.getRegister(writeRat_.translate(Register::ProgramCounter()));
+        return cpu_.getRegister(renamed(readRat_.slot(Register::ProgramCounter())));
     }
 
     void ReservationStation::Entry::processJump(bool taken) {
@@ -246,20 +349,50 @@ namespace tiny::t86 {
         setRegister(Register::StackBasePointer(), address);
     }
 
-    ReservationStation::Entry::Entry(const Instruction* instruction, Cpu& cpu,
-                                     RegisterAllocationTable readRat, RegisterAllocationTable writeRat,
-                                     std::vector<MemoryWrite::Id> memWriteIds,
-                                     MemoryWrite::Id maxWriteId,
-                                     std::size_t loggingId)
-            : instruction_(instruction),
-              operands_(instruction->operands()),
-              readRat_(std::move(readRat)),
-              writeRat_(std::move(writeRat)),
-              memWriteIds_(std::move(memWriteIds)),
-              maxWriteId_(maxWriteId),
-              cpu_(cpu),
-              loggingId_(loggingId) {
-        remainingExecutionTime_ = Cpu::Config::instance().getExecutionLength(instruction);
+    ReservationStation::Entry::Entry(Cpu& cpu)
+            : readRat_(cpu.registersCount(), cpu.floatRegistersCount()),
+              cpu_(cpu) {}
+
+    void ReservationStation::Entry::reset(const DecodedInstruction& instruction,
+                                          const RegisterAllocationTable& readRat,
+                                          std::size_t pc,
+                                          std::size_t loggingId,
+                                          std::size_t sequence) {
+        instruction_ = instruction.instruction;
+        needsAlu_ = instruction.needsAlu;
+        operands_ = instruction.operands;
+        readRat_ = readRat;
+        state_ = State::preparing;
+        remainingExecutionTime_ = instruction.latency;
+        pc_ = pc;
+        loggingId_ = loggingId;
+        sequence_ = sequence;
+        woken_ = true;
+        stalls_.clear();
+        memoryAccessException_ = nullptr;
+    }
+
+    void ReservationStation::Entry::finishRenaming(const Renames& renames,
+                                                   const MemoryWriteIds& memWriteIds,
+                                                   MemoryWrite::Id maxWriteId) {
+        renames_ = renames;
+        memWriteIds_ = memWriteIds;
+        maxWriteId_ = maxWriteId;
+    }
+
+    void ReservationStation::Entry::retireRenames() {
+        for (const auto& rename : renames_) {
+            cpu_.retireRename(rename);
+        }
+        // Kept, the instructions writing their registers on retirement (GETCHAR)
+        // still look up where they were renamed to
+    }
+
+    void ReservationStation::Entry::squashRenames() {
+        for (const auto& rename : renames_) {
+            cpu_.squashRename(rename);
+        }
+        renames_.clear();
     }
 
     bool ReservationStation::Entry::allOperandsFetched() const {
@@ -274,12 +407,44 @@ namespace tiny::t86 {
             --remainingExecutionTime_;
         }
         // This is done "two-steps" because some instructions might have zero execution tickCount required
-        if (remainingExecutionTime_ == 0) {
-            instruction_->execute(*this);
-            state_ = State::retiring;
-            return true;
+        return remainingExecutionTime_ == 0;
+    }
+
+    void ReservationStation::Entry::finishExecution() {
+        assert(state_ == State::executing && remainingExecutionTime_ == 0);
+        instruction_->execute(*this);
+        state_ = State::retiring;
+    }
+
+    void ReservationStation::Entry::skipExecutionTicks(std::size_t ticks) {
+        assert(state_ == State::executing && remainingExecutionTime_ > ticks);
+        remainingExecutionTime_ -= ticks;
+    }
+
+    void ReservationStation::Entry::clearStalls() {
+        stalls_.clear();
+        woken_ = false;
+    }
+
+    void ReservationStation::Entry::addStall(StatsLogger::Event event, std::size_t arg) {
+        // Two operands can wait for the same register, it is one stall
+        bool duplicate = std::any_of(stalls_.begin(), stalls_.end(), [&](const Stall& stall) {
+            return stall.event == event && stall.arg == arg;
+        });
+        if (!duplicate) {
+            stalls_.push_back(Stall{event, arg});
         }
-        return false;
+        if (event == StatsLogger::Event::StallRAMRead) {
+            woken_ = true;
+        }
+    }
+
+    PhysicalRegister ReservationStation::Entry::physicalRegister(Register reg) const {
+        return readRat_.translate(reg);
+    }
+
+    PhysicalRegister ReservationStation::Entry::physicalRegister(FloatRegister fReg) const {
+        return readRat_.translate(fReg);
     }
 
     ReservationStation::Entry::State ReservationStation::Entry::state() const {
@@ -308,6 +473,7 @@ namespace tiny::t86 {
         if (memoryAccessException_) {
             std::rethrow_exception(memoryAccessException_);
         }
+        cpu_.instructionRetired(pc_);
 
         // Handle single step with trapflags here
         if (cpu_.isTrapFlagSet()) {
@@ -316,7 +482,10 @@ namespace tiny::t86 {
         } else if (cpu_.interrupted()) {
             unrollSpeculation();
         }
+#if LOG_LEVEL > 2
+        // Only build the string when it is printed
         log_info("Retired instruction '{}'", instruction_->toString());
+#endif
     }
 
     Cpu& ReservationStation::Entry::cpu() const {
@@ -327,14 +496,8 @@ namespace tiny::t86 {
         cpu_.writeMemory(id);
     }
 
-    const RegisterAllocationTable& ReservationStation::Entry::rat() const {
-        // Returning the write rat, because we moved some registers
-        // Used mostly when fixing branch prediction miss, so we care mainly for the PC
-        return writeRat_;
-    }
-
     void ReservationStation::Entry::unrollSpeculation() {
-        cpu_.unrollSpeculation(writeRat_);
+        cpu_.unrollSpeculation();
     }
 
     std::optional<int64_t> ReservationStation::Entry::readMemory(uint64_t address) {
@@ -363,42 +526,49 @@ namespace tiny::t86 {
     }
 
     void ReservationStation::Entry::logClearSpeculation() const {
-        StatsLogger::instance().logClearSpeculation(loggingId_);
+        cpu_.stats().logClearSpeculation(loggingId_);
     }
 
     void ReservationStation::Entry::logExecuting() const {
-        StatsLogger::instance().logExecuting(loggingId_);
+        cpu_.stats().logExecuting(loggingId_);
     }
 
     void ReservationStation::Entry::logPreparing() const {
-        StatsLogger::instance().logOperandFetching(loggingId_);
+        cpu_.stats().logOperandFetching(loggingId_);
     }
 
-    void ReservationStation::Entry::logStallFetch() const {
-        StatsLogger::instance().logStallFetch(loggingId_);
-    }
-
-    void ReservationStation::Entry::logStallRegisterFetch(Register reg) const {
-        StatsLogger::instance().logStallRegisterFetch(loggingId_, reg);
-    }
-
-    void ReservationStation::Entry::logStallFloatRegisterFetch(FloatRegister fReg) const {
-        StatsLogger::instance().logStallFloatRegisterFetch(loggingId_, fReg);
-    }
-
-    void ReservationStation::Entry::logStallRAMRead(uint64_t address) const {
-        StatsLogger::instance().logStallRAMRead(loggingId_, address);
+    void ReservationStation::Entry::logStalls() const {
+        auto& logger = cpu_.stats();
+        if (stalls_.empty() || !logger.enabled()) {
+            return;
+        }
+        for (const Stall& stall : stalls_) {
+            switch (stall.event) {
+                case StatsLogger::Event::StallRegisterFetch:
+                    logger.logStallRegisterFetch(loggingId_, Register{stall.arg});
+                    break;
+                case StatsLogger::Event::StallFloatRegisterFetch:
+                    logger.logStallFloatRegisterFetch(loggingId_, FloatRegister{stall.arg});
+                    break;
+                case StatsLogger::Event::StallRAMRead:
+                    logger.logStallRAMRead(loggingId_, stall.arg);
+                    break;
+                default:
+                    assert(false && "Not an operand fetch stall");
+            }
+        }
+        logger.logStallFetch(loggingId_);
     }
 
     void ReservationStation::Entry::logStallRetirement() const {
-        StatsLogger::instance().logStallRetirement(loggingId_);
+        cpu_.stats().logStallRetirement(loggingId_);
     }
 
     void ReservationStation::Entry::logRetirement() const {
-        StatsLogger::instance().logRetirement(loggingId_);
+        cpu_.stats().logRetirement(loggingId_);
     }
 
     void ReservationStation::Entry::logStallALU() const {
-        StatsLogger::instance().logNoAluAvailable(loggingId_);
+        cpu_.stats().logNoAluAvailable(loggingId_);
     }
 }
@@ -5,8 +5,9 @@
 #include "../cpu/register_allocation_table.h"
 #include "../cpu/memory_writes_manager/memory_write.h"
 #include "../utils/stats_logger.h"
+#include "../utils/static_vector.h"
+#include "../instructions/product.h"
 
-#include <list>
 #include <vector>
 #include <optional>
 #include <condition_variable>
@@ -17,12 +18,16 @@ namespace tiny::t86 {
 
     class Instruction;
 
-    class Operand;
+    struct DecodedInstruction;
 
     class ReservationStation {
     public:
         ReservationStation(Cpu& cpu, std::size_t aluCnt, std::size_t maxEntriesCnt);
 
+        /// Sets how many instructions can start executing and how many can
+        /// retire in one tick, zero means no limit.
+        void setWidths(std::size_t issueWidth, std::size_t retireWidth);
+
 
         // We process executing and possibly finished instructions first
         // If they are finished, we can free the alu and forward result.
@@ -35,31 +40,110 @@ namespace tiny::t86 {
 
         bool hasFreeEntry() const;
 
-        void add(const Instruction*, std::size_t nextPc, std::size_t loggingId);
+        void add(const DecodedInstruction& instruction, std::size_t nextPc, std::size_t loggingId);
 
         void clear();
 
+        /// Called when the physical register gets its value, wakes up
+        /// the entries that were waiting for it.
+        void wakeUp(PhysicalRegister reg);
+
+        /// Number of changes of the state so far, not counting the execution
+        /// times that tick down. Used to recognize ticks in which nothing happens.
+        std::size_t changes() const {
+            return changes_;
+        }
+
+        /// Number of following ticks in which no instruction finishes
+        /// its execution, max value if nothing is executing.
+        std::size_t idleTicks() const;
+
+        /// Does the given number of idle ticks at once.
+        void skipTicks(std::size_t ticks);
+
         class Entry;
 
     private:
-        std::list<Entry> entries_;
+        /// Takes the first free slot after the occupied ones.
+        Entry& newEntry();
+
+        /// Entry at i-th position in the program order.
+        Entry& entryAt(std::size_t i) {
+            return entries_[(head_ + i) % entries_.size()];
+        }
+
+        /// Tries to fetch the operands of a woken up entry. The entry
+        /// is subscribed to every register it stalls on.
+        void fetchOperands(Entry& entry);
+
+        void waitFor(Entry& entry, PhysicalRegister reg);
+
+        /// Reorder buffer, a ring of all the entries. The occupied ones are
+        /// in program order starting at head_. The entries never move,
+        /// so they can be pointed to and reused without allocating.
+        std::vector<Entry> entries_;
+
+        std::size_t head_{0};
+
+        std::size_t size_{0};
+
+        /// Entry waiting for a register, the sequence number tells if
+        /// the entry was not reused for another instruction since.
+        struct Waiter {
+            Entry* entry;
+            std::size_t sequence;
+        };
 
-        const std::size_t maxEntries_;
+        /// Entries waiting for a register, indexed by the physical register.
+        std::vector<std::vector<Waiter>> registerWaiters_;
+
+        /// Executing entries in program order.
+        std::vector<Entry*> executing_;
+
+        std::size_t nextSequence_{0};
+
+        std::size_t changes_{0};
 
         Cpu& cpu_;
 
         std::size_t freeAlus_;
+
+        std::size_t issueWidth_{0};
+
+        std::size_t retireWidth_{0};
     };
 
     class ReservationStation::Entry {
     public:
-        Entry(const Instruction* instruction,
-              Cpu& cpu,
-              RegisterAllocationTable readRat,
-              RegisterAllocationTable writeRat,
-              std::vector<MemoryWrite::Id> memWriteIds,
-              MemoryWrite::Id maxWriteId,
-              std::size_t loggingId);
+        /// Ids of pending memory writes, one per memory product.
+        using MemoryWriteIds = StaticVector<MemoryWrite::Id, maxInstructionProducts>;
+
+        /// Registers renamed by the instruction, its products and the program counter.
+        using Renames = StaticVector<RegisterAllocationTable::Rename, maxInstructionProducts + 1>;
+
+        explicit Entry(Cpu& cpu);
+
+        /// Prepares the entry for a newly decoded instruction,
+        /// readRat is the table before renaming its products.
+        void reset(const DecodedInstruction& instruction,
+                   const RegisterAllocationTable& readRat,
+                   std::size_t pc,
+                   std::size_t loggingId,
+                   std::size_t sequence);
+
+        /// Called once the products of the instruction are renamed
+        /// and its memory writes registered.
+        void finishRenaming(const Renames& renames,
+                            const MemoryWriteIds& memWriteIds,
+                            MemoryWrite::Id maxWriteId);
+
+        /// Makes the renames part of the retired state, freeing
+        /// the registers that were overwritten.
+        void retireRenames();
+
+        /// Frees the registers the instruction renamed to, used
+        /// when the instruction is thrown away.
+        void squashRenames();
 
         enum class State {
             preparing, ready, executing, retiring
@@ -67,15 +151,15 @@ namespace tiny::t86 {
 
         State state() const;
 
-        std::vector<Operand>& operands() {
+        OperandList& operands() {
             return operands_;
         }
 
-        const std::vector<Operand>& operands() const {
+        const OperandList& operands() const {
             return operands_;
         }
 
-        const std::vector<MemoryWrite::Id>& memoryWriteIds() const {
+        const MemoryWriteIds& memoryWriteIds() const {
             return memWriteIds_;
         }
 
@@ -85,11 +169,72 @@ namespace tiny::t86 {
 
         void startExecution();
 
+        /// Returns true if the instruction finished execution in this tick,
+        /// its results are produced by finishExecution.
         bool executionTick();
 
+        void finishExecution();
+
+        std::size_t remainingExecutionTime() const {
+            return remainingExecutionTime_;
+        }
+
+        /// Counts down the execution time without finishing the execution.
+        void skipExecutionTicks(std::size_t ticks);
+
+        /// Position of the instruction in the program order.
+        std::size_t sequence() const {
+            return sequence_;
+        }
+
+        /// Only woken up entries try to fetch their operands.
+        bool woken() const {
+            return woken_;
+        }
+
+        void wakeUp() {
+            woken_ = true;
+        }
+
+        /// Reason for which fetching the operands did not finish.
+        struct Stall {
+            StatsLogger::Event event;
+            // Register index or address
+            std::size_t arg;
+        };
+
+        /// Stalls found by the last fetch of operands, these last until
+        /// the entry is woken up again.
+        using Stalls = StaticVector<Stall, 2 * maxInstructionOperands>;
+
+        void clearStalls();
+
+        /// Records the stall. Unless it is a memory stall, the entry sleeps
+        /// until one of the registers it waits for is ready.
+        void addStall(StatsLogger::Event event, std::size_t arg);
+
+        const Stalls& stalls() const {
+            return stalls_;
+        }
+
+        PhysicalRegister physicalRegister(Register reg) const;
+
+        PhysicalRegister physicalRegister(FloatRegister fReg) const;
+
         const Instruction* instruction() const;
 
-        const RegisterAllocationTable& rat() const;
+        std::size_t loggingId() const {
+            return loggingId_;
+        }
+
+        /// Address of the instruction.
+        std::size_t pc() const {
+            return pc_;
+        }
+
+        bool needsAlu() const {
+            return needsAlu_;
+        }
 
         void unrollSpeculation();
 
@@ -133,13 +278,8 @@ namespace tiny::t86 {
 
         void logPreparing() const;
 
-        void logStallFetch() const;
-
-        void logStallRegisterFetch(Register reg) const;
-
-        void logStallFloatRegisterFetch(FloatRegister fReg) const;
-
-        void logStallRAMRead(uint64_t address) const;
+        /// Logs the stalls of the last fetch of operands.
+        void logStalls() const;
 
         void logStallALU() const;
 
@@ -152,25 +292,38 @@ namespace tiny::t86 {
     private:
         bool allOperandsFetched() const;
 
-        const Instruction* instruction_;
+        /// Physical register the instruction writes to.
+        PhysicalRegister renamed(std::size_t slot) const;
+
+        const Instruction* instruction_{nullptr};
 
-        std::vector<Operand> operands_;
+        bool needsAlu_{false};
+
+        OperandList operands_;
 
         RegisterAllocationTable readRat_;
 
-        RegisterAllocationTable writeRat_;
+        Renames renames_;
 
-        std::vector<MemoryWrite::Id> memWriteIds_;
+        MemoryWriteIds memWriteIds_;
 
-        MemoryWrite::Id maxWriteId_;
+        MemoryWrite::Id maxWriteId_{0};
 
         Cpu& cpu_;
 
         State state_ = State::preparing;
 
-        size_t remainingExecutionTime_;
+        size_t remainingExecutionTime_{0};
+
+        std::size_t pc_{0};
+
+        std::size_t loggingId_{0};
+
+        std::size_t sequence_{0};
+
+        bool woken_{true};
 
-        std::size_t loggingId_;
+        Stalls stalls_;
 
         std::exception_ptr memoryAccessException_;
     };
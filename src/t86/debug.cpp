@@ -1,4 +1,5 @@
 #include "t86/debug.h"
+#include "t86/snapshot.h"
 
 namespace tiny::t86 {
     std::string Debug::ReasonToString(BreakReason reason) {
@@ -13,6 +14,27 @@ namespace tiny::t86 {
         UNREACHABLE;
     }
 
+    void Debug::Reverse(std::string_view command) {
+        if (!history) {
+            messenger->Send("Reverse execution is not enabled");
+            return;
+        }
+        try {
+            History::Stop stop = command == "REVERSESTEP" ? history->stepBack()
+                : command == "REVERSECONTINUE" ? history->continueBack()
+                : history->finishBack();
+            switch (stop) {
+                case History::Stop::Start: messenger->Send(ReasonToString(BreakReason::Begin)); break;
+                case History::Stop::Step:
+                case History::Stop::Call: messenger->Send(ReasonToString(BreakReason::SingleStep)); break;
+                case History::Stop::Breakpoint: messenger->Send(ReasonToString(BreakReason::SoftwareBreakpoint)); break;
+                case History::Stop::Watchpoint: messenger->Send(ReasonToString(BreakReason::HardwareBreakpoint)); break;
+            }
+        } catch (const std::exception& e) {
+            messenger->Send(e.what());
+        }
+    }
+
     size_t Debug::svtoidx(std::string_view s) {
         auto v = utils::svtoi64(s);
         if (!v || *v < 0) {
@@ -148,6 +170,9 @@ namespace tiny::t86 {
                 log_info("Setting instruction '{}' at address {}", ins_s, index);
                 auto ins = ParseInstruction(ins_s);
                 cpu.setText(index, std::move(ins));
+                if (history) {
+                    history->modified();
+                }
                 messenger->Send("OK");
             } else if (command.starts_with("PEEKDATA")) {
                 auto index = svtoidx(commands.at(1));
@@ -164,6 +189,9 @@ namespace tiny::t86 {
                     throw std::runtime_error("Expected number as second arg");
                 }
                 cpu.setMemory(index, *value);
+                if (history) {
+                    history->modified();
+                }
                 messenger->Send("OK");
             } else if (command == "PEEKREGS") {
                 auto regs = RegistersToString();
@@ -183,11 +211,17 @@ namespace tiny::t86 {
                 auto reg = TranslateToFloatRegister(commands.at(1));
                 auto val = *utils::svtonum<double>(commands.at(2));
                 cpu.setFloatRegisterDebug(reg, val);
+                if (history) {
+                    history->modified();
+                }
                 messenger->Send("OK");
             } else if (command.starts_with("POKEREGS")) {
                 auto reg = TranslateToRegister(commands.at(1));
                 auto val = *utils::svtonum<int64_t>(commands.at(2));
                 cpu.setRegisterDebug(reg, val);
+                if (history) {
+                    history->modified();
+                }
                 messenger->Send("OK");
             } else if (command == "SINGLESTEP") {
                 cpu.setTrapFlag();
@@ -195,12 +229,23 @@ namespace tiny::t86 {
                 break; // continue
             } else if (command == "REGCOUNT") {
                 messenger->Send(fmt::format(
-                    "REGCOUNT:{}", Cpu::Config::instance().registerCnt()));
+                    "REGCOUNT:{}", cpu.config().registerCnt()));
             } else if (command == "TEXTSIZE") {
                 messenger->Send(fmt::format("TEXTSIZE:{}", cpu.textSize()));
             } else if (command == "DATASIZE") {
                 messenger->Send(fmt::format("DATASIZE:{}",
-                                            Cpu::Config::instance().ramSize()));
+                                            cpu.config().ramSize()));
+            } else if (command == "SNAPSHOT") {
+                auto path = utils::join(std::next(commands.begin()), commands.end(), " ");
+                try {
+                    cpu.squash();
+                    Snapshot::save(cpu, path);
+                    messenger->Send("OK");
+                } catch (const std::exception& e) {
+                    messenger->Send(e.what());
+                }
+            } else if (command == "REVERSESTEP" || command == "REVERSECONTINUE" || command == "REVERSEFINISH") {
+                Reverse(command);
             } else if (command == "TERMINATE") {
                 messenger->Send("OK");
                 return false;
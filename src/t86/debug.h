@@ -8,6 +8,7 @@
 #include "common/helpers.h"
 #include "t86/cpu/register.h"
 #include "t86/cpu.h"
+#include "t86/history.h"
 #include "common/messenger.h"
 #include "t86-parser/parser.h"
 
@@ -29,6 +30,11 @@ public:
 
     std::string ReasonToString(BreakReason reason);
 
+    /// Lets the debugger go back in the history of the run.
+    void SetHistory(History* history) {
+        this->history = history;
+    }
+
     size_t svtoidx(std::string_view s);
 
     Register TranslateToRegister(std::string_view s);
@@ -50,7 +56,11 @@ public:
     /// Should be called on any break situation.
     bool Work(BreakReason reason);
 private:
+    /// Goes back in the history as the command asks and tells where it stopped.
+    void Reverse(std::string_view command);
+
     Cpu& cpu;
     std::unique_ptr<Messenger> messenger;
+    History* history{nullptr};
 };
 }
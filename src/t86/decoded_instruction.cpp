@@ -0,0 +1,49 @@
+#include "decoded_instruction.h"
+#include "cpu.h"
+
+namespace tiny::t86 {
+    DecodedInstruction DecodedInstruction::decode(const Instruction& instruction) {
+        return decode(instruction, Cpu::Config::instance().getExecutionLength(&instruction));
+    }
+
+    DecodedInstruction DecodedInstruction::decode(const Instruction& instruction, const Cpu& cpu) {
+        return decode(instruction, cpu.config().getExecutionLength(&instruction));
+    }
+
+    DecodedInstruction DecodedInstruction::decode(const Instruction& instruction, std::size_t latency) {
+        DecodedInstruction decoded;
+        decoded.instruction = &instruction;
+        decoded.type = instruction.type();
+        decoded.isJump = dynamic_cast<const JumpInstruction*>(&instruction) != nullptr;
+        decoded.needsAlu = instruction.needsAlu();
+        decoded.latency = latency;
+
+        auto operands = instruction.operands();
+        decoded.operands = {operands.begin(), operands.end()};
+        auto signatureOperands = instruction.signatureOperands();
+        decoded.signatureOperands = {signatureOperands.begin(), signatureOperands.end()};
+        auto products = instruction.produces();
+        decoded.products = {products.begin(), products.end()};
+
+        decoded.produces = 0;
+        for (const auto& product : decoded.products) {
+            if (product.isRegister()) {
+                Register reg = product.getRegister();
+                if (reg == Register::ProgramCounter()) {
+                    decoded.produces |= ProducesProgramCounter;
+                } else if (reg == Register::StackPointer()) {
+                    decoded.produces |= ProducesStackPointer;
+                } else if (reg == Register::Flags()) {
+                    decoded.produces |= ProducesFlags;
+                } else {
+                    decoded.produces |= ProducesRegister;
+                }
+            } else if (product.isFloatRegister()) {
+                decoded.produces |= ProducesFloatRegister;
+            } else {
+                decoded.produces |= ProducesMemory;
+            }
+        }
+        return decoded;
+    }
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "instruction.h"
+#include "instructions/operand.h"
+#include "instructions/product.h"
+
+#include <cstdint>
+#include <cstddef>
+
+namespace tiny::t86 {
+    class Cpu;
+
+    /**
+     * Instruction lowered at load time into a flat record.
+     * Everything the pipeline needs at fetch and decode (operands, products,
+     * whether it is a jump, how long it executes) is computed once here,
+     * so the hot loop does not call virtual functions that return freshly
+     * allocated vectors. The original instruction is kept for its
+     * execute/retire semantics and for printing.
+     */
+    struct DecodedInstruction {
+        /// Bits of the produces mask
+        enum ProducesMask : uint8_t {
+            ProducesRegister = 1 << 0,
+            ProducesFloatRegister = 1 << 1,
+            ProducesMemory = 1 << 2,
+            ProducesProgramCounter = 1 << 3,
+            ProducesStackPointer = 1 << 4,
+            ProducesFlags = 1 << 5,
+        };
+
+        /// The latency is taken from the options of the process.
+        static DecodedInstruction decode(const Instruction& instruction);
+
+        /// The latency is taken from the options of the cpu.
+        static DecodedInstruction decode(const Instruction& instruction, const Cpu& cpu);
+
+        static DecodedInstruction decode(const Instruction& instruction, std::size_t latency);
+
+        bool writesMemory() const {
+            return produces & ProducesMemory;
+        }
+
+        const Instruction* instruction;
+
+        Instruction::Type type;
+
+        /// Dynamic cast to JumpInstruction succeeds.
+        bool isJump;
+
+        bool needsAlu;
+
+        /// Number of ticks the instruction spends in execution.
+        uint8_t latency;
+
+        uint8_t produces;
+
+        /// Operands that are fetched by the reservation station.
+        /// Some instructions (LOOP) append one more during execution.
+        OperandList operands;
+
+        /// Operands as they were written in the program, used by the functional engine.
+        OperandList signatureOperands;
+
+        ProductList products;
+    };
+}
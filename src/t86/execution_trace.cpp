@@ -0,0 +1,415 @@
+#include "execution_trace.h"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#include <fmt/core.h>
+
+#include "cpu.h"
+
+namespace tiny::t86 {
+    using execution_trace::BlockEntry;
+    using execution_trace::Header;
+    using execution_trace::Trailer;
+
+    namespace {
+        constexpr char magic[8] = {'T', '8', '6', 'T', 'R', 'A', 'C', 'E'};
+
+        constexpr uint64_t version = 1;
+
+        /// Flags, SP and BP come before the general purpose registers
+        constexpr std::size_t specialSlots = 3;
+
+        // Bits of the header byte of a record
+        constexpr uint8_t registerCountMask = 0x07;
+        constexpr unsigned writeCountShift = 3;
+        constexpr uint8_t writeCountMask = 0x03;
+        constexpr uint8_t ioBit = 1 << 5;
+        constexpr uint8_t jumpBit = 1 << 6;
+
+        void writeVarint(std::vector<uint8_t>& bytes, uint64_t value) {
+            while (value >= 0x80) {
+                bytes.push_back(static_cast<uint8_t>(value) | 0x80);
+                value >>= 7;
+            }
+            bytes.push_back(static_cast<uint8_t>(value));
+        }
+
+        /// Reads the varint at data and moves past it, throws std::runtime_error
+        /// if it does not end before the end of the block.
+        uint64_t readVarint(const uint8_t*& data, const uint8_t* end) {
+            uint64_t value = 0;
+            for (unsigned shift = 0;; shift += 7) {
+                if (data >= end || shift >= 64) {
+                    throw std::runtime_error("The trace is damaged");
+                }
+                uint8_t byte = *data++;
+                value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+                if ((byte & 0x80) == 0) {
+                    return value;
+                }
+            }
+        }
+
+        /// Maps small negative deltas to small unsigned numbers.
+        uint64_t zigzag(int64_t value) {
+            return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+        }
+
+        int64_t unzigzag(uint64_t value) {
+            return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+        }
+
+        /// Bit of the value in a filter of a block.
+        void addToFilter(std::array<uint64_t, 4>& filter, uint64_t value) {
+            uint64_t hash = (value * 0x9E3779B97F4A7C15ull) >> 56;
+            filter[hash >> 6] |= uint64_t{1} << (hash & 63);
+        }
+
+        bool inFilter(const std::array<uint64_t, 4>& filter, uint64_t value) {
+            uint64_t hash = (value * 0x9E3779B97F4A7C15ull) >> 56;
+            return filter[hash >> 6] & (uint64_t{1} << (hash & 63));
+        }
+
+        std::size_t registerSlot(Register reg, std::size_t registerCount) {
+            if (reg == Register::Flags()) {
+                return 0;
+            } else if (reg == Register::StackPointer()) {
+                return 1;
+            } else if (reg == Register::StackBasePointer()) {
+                return 2;
+            }
+            assert(reg.index() < registerCount);
+            return specialSlots + reg.index();
+        }
+    }
+
+    ExecutionTraceWriter::ExecutionTraceWriter(const std::string& path, const Cpu& cpu)
+        : file_(path, std::ios::binary | std::ios::trunc), path_(path),
+          registerCount_(cpu.registersCount()), nextPc_(cpu.retiredProgramCounter()) {
+        if (!file_) {
+            throw std::runtime_error(fmt::format("Could not write the trace `{}`", path));
+        }
+        registers_.push_back(cpu.getRegister(Register::Flags()));
+        registers_.push_back(cpu.getRegister(Register::StackPointer()));
+        registers_.push_back(cpu.getRegister(Register::StackBasePointer()));
+        for (std::size_t i = 0; i < cpu.registersCount(); ++i) {
+            registers_.push_back(cpu.getRegister(Register{i}));
+        }
+        for (std::size_t i = 0; i < cpu.floatRegistersCount(); ++i) {
+            registers_.push_back(std::bit_cast<int64_t>(cpu.getFloatRegister(FloatRegister{i})));
+        }
+
+        Header header{};
+        std::memcpy(header.magic, magic, sizeof(magic));
+        header.version = version;
+        header.registerCount = cpu.registersCount();
+        header.floatRegisterCount = cpu.floatRegistersCount();
+        header.blockSize = blockSize;
+        file_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        entry_.offset = sizeof(header);
+        block_.reserve(blockSize * 8);
+    }
+
+    void ExecutionTraceWriter::registerWritten(Register reg, int64_t value) {
+        write(registerSlot(reg, registerCount_), value);
+    }
+
+    void ExecutionTraceWriter::floatRegisterWritten(FloatRegister fReg, double value) {
+        write(specialSlots + registerCount_ + fReg.index(), std::bit_cast<int64_t>(value));
+    }
+
+    void ExecutionTraceWriter::write(std::size_t slot, int64_t value) {
+        assert(pendingRegisterCount_ < pendingRegisters_.size());
+        pendingRegisters_[pendingRegisterCount_++] = {slot, value};
+    }
+
+    void ExecutionTraceWriter::memoryWritten(uint64_t address, int64_t value) {
+        assert(pendingWriteCount_ < pendingWrites_.size());
+        pendingWrites_[pendingWriteCount_++] = {address, value};
+    }
+
+    void ExecutionTraceWriter::inputOutput(int64_t value) {
+        pendingIo_ = value;
+    }
+
+    void ExecutionTraceWriter::retired(uint64_t pc) {
+        if (entry_.count == 0) {
+            entry_.firstInstruction = instructions_;
+            entry_.pc = nextPc_;
+            entry_.minAddress = std::numeric_limits<uint64_t>::max();
+            entry_.maxAddress = 0;
+            blockRegisters_.insert(blockRegisters_.end(), registers_.begin(), registers_.end());
+            lastAddress_ = 0;
+        }
+
+        uint8_t flags = static_cast<uint8_t>(pendingRegisterCount_)
+            | static_cast<uint8_t>(pendingWriteCount_ << writeCountShift);
+        if (pendingIo_) {
+            flags |= ioBit;
+        }
+        if (pc != nextPc_) {
+            flags |= jumpBit;
+        }
+        block_.push_back(flags);
+        if (pc != nextPc_) {
+            writeVarint(block_, zigzag(static_cast<int64_t>(pc - nextPc_)));
+        }
+        for (std::size_t i = 0; i < pendingRegisterCount_; ++i) {
+            auto [slot, value] = pendingRegisters_[i];
+            writeVarint(block_, slot);
+            writeVarint(block_, zigzag(value - registers_[slot]));
+            registers_[slot] = value;
+        }
+        for (std::size_t i = 0; i < pendingWriteCount_; ++i) {
+            auto [address, value] = pendingWrites_[i];
+            writeVarint(block_, zigzag(static_cast<int64_t>(address - lastAddress_)));
+            writeVarint(block_, zigzag(value));
+            lastAddress_ = address;
+            entry_.minAddress = std::min(entry_.minAddress, address);
+            entry_.maxAddress = std::max(entry_.maxAddress, address);
+            addToFilter(entry_.addressFilter, address);
+        }
+        if (pendingIo_) {
+            writeVarint(block_, zigzag(*pendingIo_));
+        }
+        addToFilter(entry_.pcFilter, pc);
+        if (pc >= histogram_.size()) {
+            histogram_.resize(pc + 1);
+        }
+        ++histogram_[pc];
+
+        pendingRegisterCount_ = 0;
+        pendingWriteCount_ = 0;
+        pendingIo_.reset();
+        nextPc_ = pc + 1;
+        ++instructions_;
+        if (++entry_.count == blockSize) {
+            endBlock();
+        }
+    }
+
+    void ExecutionTraceWriter::endBlock() {
+        entry_.size = block_.size();
+        file_.write(reinterpret_cast<const char*>(block_.data()), block_.size());
+        index_.push_back(entry_);
+        uint64_t offset = entry_.offset + entry_.size;
+        entry_ = BlockEntry{};
+        entry_.offset = offset;
+        block_.clear();
+    }
+
+    void ExecutionTraceWriter::finish() {
+        if (finished_) {
+            return;
+        }
+        finished_ = true;
+        if (entry_.count > 0) {
+            endBlock();
+        }
+        Trailer trailer{};
+        trailer.indexOffset = entry_.offset;
+        trailer.blockCount = index_.size();
+        trailer.registersOffset = trailer.indexOffset + index_.size() * sizeof(BlockEntry);
+        trailer.histogramOffset = trailer.registersOffset + blockRegisters_.size() * sizeof(int64_t);
+        trailer.histogramSize = histogram_.size();
+        trailer.instructions = instructions_;
+        std::memcpy(trailer.magic, magic, sizeof(magic));
+        file_.write(reinterpret_cast<const char*>(index_.data()), index_.size() * sizeof(BlockEntry));
+        file_.write(reinterpret_cast<const char*>(blockRegisters_.data()), blockRegisters_.size() * sizeof(int64_t));
+        file_.write(reinterpret_cast<const char*>(histogram_.data()), histogram_.size() * sizeof(uint64_t));
+        file_.write(reinterpret_cast<const char*>(&trailer), sizeof(trailer));
+        file_.close();
+        if (!file_) {
+            throw std::runtime_error(fmt::format("Could not write the trace `{}`", path_));
+        }
+    }
+
+    ExecutionTrace::ExecutionTrace(const std::string& path) : file_(path, 1) {
+        // The magic and the version come first, so that the layout of other versions is never read
+        if (file_.size() < sizeof(magic) + sizeof(uint64_t) || std::memcmp(file_.data(), magic, sizeof(magic)) != 0) {
+            throw std::runtime_error(fmt::format("`{}` is not a T86 trace", path));
+        }
+        uint64_t fileVersion;
+        std::memcpy(&fileVersion, file_.data() + sizeof(magic), sizeof(fileVersion));
+        if (fileVersion != version) {
+            throw std::runtime_error(fmt::format("The trace `{}` has version {}, expected {}", path, fileVersion, version));
+        }
+        std::size_t size = file_.size();
+        if (size < sizeof(Header) + sizeof(Trailer)) {
+            throw std::runtime_error(fmt::format("`{}` is not a finished T86 trace", path));
+        }
+
+        const Header& h = header();
+        const Trailer& t = trailer();
+        uint64_t slots = specialSlots + h.registerCount + h.floatRegisterCount;
+        uint64_t end = size - sizeof(Trailer);
+        // The sizes are checked by division, so that a broken file cannot overflow
+        bool valid = std::memcmp(t.magic, magic, sizeof(magic)) == 0
+            && t.indexOffset >= sizeof(Header)
+            && t.indexOffset <= end
+            && t.blockCount <= (end - t.indexOffset) / sizeof(BlockEntry)
+            && t.registersOffset == t.indexOffset + t.blockCount * sizeof(BlockEntry)
+            && t.registersOffset <= end
+            && t.blockCount <= (end - t.registersOffset) / sizeof(int64_t) / slots
+            && t.histogramOffset == t.registersOffset + t.blockCount * slots * sizeof(int64_t)
+            && t.histogramSize == (end - t.histogramOffset) / sizeof(uint64_t)
+            && t.histogramOffset + t.histogramSize * sizeof(uint64_t) == end;
+        if (valid) {
+            for (std::size_t i = 0; i < t.blockCount && valid; ++i) {
+                const BlockEntry& b = block(i);
+                valid = b.offset >= sizeof(Header) && b.offset <= t.indexOffset && b.size <= t.indexOffset - b.offset;
+            }
+        }
+        if (!valid) {
+            throw std::runtime_error(fmt::format("`{}` is not a finished T86 trace", path));
+        }
+    }
+
+    const Header& ExecutionTrace::header() const {
+        return *reinterpret_cast<const Header*>(file_.data());
+    }
+
+    const Trailer& ExecutionTrace::trailer() const {
+        return *reinterpret_cast<const Trailer*>(file_.data() + file_.size() - sizeof(Trailer));
+    }
+
+    const BlockEntry& ExecutionTrace::block(std::size_t index) const {
+        return reinterpret_cast<const BlockEntry*>(file_.data() + trailer().indexOffset)[index];
+    }
+
+    const int64_t* ExecutionTrace::blockRegisters(std::size_t index) const {
+        std::size_t slots = specialSlots + header().registerCount + header().floatRegisterCount;
+        return reinterpret_cast<const int64_t*>(file_.data() + trailer().registersOffset) + index * slots;
+    }
+
+    std::size_t ExecutionTrace::registersCount() const {
+        return header().registerCount;
+    }
+
+    std::size_t ExecutionTrace::floatRegistersCount() const {
+        return header().floatRegisterCount;
+    }
+
+    std::size_t ExecutionTrace::instructions() const {
+        return trailer().instructions;
+    }
+
+    std::size_t ExecutionTrace::blocks() const {
+        return trailer().blockCount;
+    }
+
+    std::size_t ExecutionTrace::slot(Register reg) const {
+        bool special = reg == Register::Flags() || reg == Register::StackPointer() || reg == Register::StackBasePointer();
+        if (!special && reg.index() >= registersCount()) {
+            throw std::invalid_argument(fmt::format("The register {} is not recorded", reg.toString()));
+        }
+        return registerSlot(reg, registersCount());
+    }
+
+    std::size_t ExecutionTrace::slot(FloatRegister fReg) const {
+        if (fReg.index() >= floatRegistersCount()) {
+            throw std::invalid_argument(fmt::format("The register {} is not recorded", fReg.toString()));
+        }
+        return specialSlots + registersCount() + fReg.index();
+    }
+
+    template<typename F>
+    void ExecutionTrace::forEachInBlock(std::size_t index, F&& callback) const {
+        const BlockEntry& b = block(index);
+        std::size_t slots = specialSlots + header().registerCount + header().floatRegisterCount;
+        const int64_t* start = blockRegisters(index);
+        std::vector<int64_t> registers(start, start + slots);
+        const auto* data = reinterpret_cast<const uint8_t*>(file_.data() + b.offset);
+        const auto* end = data + b.size;
+        uint64_t nextPc = b.pc;
+        uint64_t lastAddress = 0;
+        Record record{};
+        for (std::size_t i = 0; i < b.count; ++i) {
+            if (data >= end) {
+                throw std::runtime_error("The trace is damaged");
+            }
+            uint8_t flags = *data++;
+            record.instruction = b.firstInstruction + i;
+            record.pc = nextPc;
+            if (flags & jumpBit) {
+                record.pc += static_cast<uint64_t>(unzigzag(readVarint(data, end)));
+            }
+            record.registerCount = flags & registerCountMask;
+            if (record.registerCount > record.registers.size()) {
+                throw std::runtime_error("The trace is damaged");
+            }
+            for (std::size_t r = 0; r < record.registerCount; ++r) {
+                std::size_t slot = readVarint(data, end);
+                if (slot >= slots) {
+                    throw std::runtime_error("The trace is damaged");
+                }
+                record.registers[r] = {slot, registers[slot] + unzigzag(readVarint(data, end))};
+            }
+            record.writeCount = (flags >> writeCountShift) & writeCountMask;
+            for (std::size_t w = 0; w < record.writeCount; ++w) {
+                lastAddress += static_cast<uint64_t>(unzigzag(readVarint(data, end)));
+                record.writes[w] = {lastAddress, unzigzag(readVarint(data, end))};
+            }
+            record.io.reset();
+            if (flags & ioBit) {
+                record.io = unzigzag(readVarint(data, end));
+            }
+            callback(record, registers);
+            for (std::size_t r = 0; r < record.registerCount; ++r) {
+                registers[record.registers[r].first] = record.registers[r].second;
+            }
+            nextPc = record.pc + 1;
+        }
+    }
+
+    std::optional<ExecutionTrace::Write> ExecutionTrace::lastWrite(uint64_t address, std::size_t before) const {
+        for (std::size_t index = blocks(); index-- > 0;) {
+            const BlockEntry& b = block(index);
+            if (b.firstInstruction >= before) {
+                continue;
+            }
+            if (address < b.minAddress || address > b.maxAddress || !inFilter(b.addressFilter, address)) {
+                continue;
+            }
+            std::optional<Write> last;
+            forEachInBlock(index, [&](const Record& record, const std::vector<int64_t>&) {
+                if (record.instruction >= before) {
+                    return;
+                }
+                for (std::size_t w = 0; w < record.writeCount; ++w) {
+                    if (record.writes[w].first == address) {
+                        last = Write{record.instruction, record.pc, record.writes[w].second};
+                    }
+                }
+            });
+            if (last) {
+                return last;
+            }
+        }
+        return std::nullopt;
+    }
+
+    std::vector<ExecutionTrace::Value> ExecutionTrace::values(std::size_t slot, uint64_t pc) const {
+        std::vector<Value> values;
+        for (std::size_t index = 0; index < blocks(); ++index) {
+            if (!inFilter(block(index).pcFilter, pc)) {
+                continue;
+            }
+            forEachInBlock(index, [&](const Record& record, const std::vector<int64_t>& registers) {
+                if (record.pc == pc) {
+                    values.push_back({record.instruction, registers[slot]});
+                }
+            });
+        }
+        return values;
+    }
+
+    std::span<const uint64_t> ExecutionTrace::histogram() const {
+        return {reinterpret_cast<const uint64_t*>(file_.data() + trailer().histogramOffset), trailer().histogramSize};
+    }
+}
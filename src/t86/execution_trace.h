@@ -0,0 +1,223 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "cpu/register.h"
+#include "mapped_file.h"
+
+namespace tiny::t86 {
+    class Cpu;
+
+    /// Layout of the trace file, all the fields are 64 bit so that it is the same everywhere.
+    namespace execution_trace {
+        struct Header {
+            char magic[8];
+            uint64_t version;
+            uint64_t registerCount;
+            uint64_t floatRegisterCount;
+            uint64_t blockSize;
+        };
+
+        /// Index entry of a block, the registers at its start are stored separately
+        struct BlockEntry {
+            uint64_t offset;
+            uint64_t size;
+            uint64_t firstInstruction;
+            uint64_t count;
+            /// Address of the first instruction
+            uint64_t pc;
+            /// Range of the addresses written, empty if min > max
+            uint64_t minAddress;
+            uint64_t maxAddress;
+            /// One bit for each hash of an address written or a pc retired
+            std::array<uint64_t, 4> addressFilter;
+            std::array<uint64_t, 4> pcFilter;
+        };
+
+        /// The last bytes of the file
+        struct Trailer {
+            uint64_t indexOffset;
+            uint64_t blockCount;
+            uint64_t registersOffset;
+            uint64_t histogramOffset;
+            uint64_t histogramSize;
+            uint64_t instructions;
+            char magic[8];
+        };
+    }
+
+    /**
+     * Records what the program did, independent of the pipeline model: the
+     * retired instructions with the registers and the memory they wrote and
+     * the values they read or printed. Both modes of the cpu record the same
+     * trace for the same run. Time is the index of the retired instruction,
+     * the ticks of the cycle model are not architectural.
+     *
+     * Every instruction is one record of varint encoded deltas: a header byte,
+     * the program counter only if it did not just move to the next instruction,
+     * the registers as the difference from their previous value, the memory
+     * writes as the difference from the previous address. Most records take
+     * three to six bytes.
+     *
+     * Every blockSize instructions a new block starts, with its own index entry
+     * holding all the registers at its start, the range of the addresses written
+     * and a filter of the addresses and program counters in it. A block is decoded
+     * on its own and a query only decodes the blocks whose filters match.
+     * The index and the counts of the instructions by address follow the blocks,
+     * the file is written as the program runs.
+     */
+    class ExecutionTraceWriter {
+    public:
+        static constexpr std::size_t blockSize = 1 << 12;
+
+        /// Opens the file and takes the registers from the retired state of the cpu.
+        /// Throws std::runtime_error if the file cannot be written.
+        ExecutionTraceWriter(const std::string& path, const Cpu& cpu);
+
+        ExecutionTraceWriter(const ExecutionTraceWriter&) = delete;
+        ExecutionTraceWriter& operator=(const ExecutionTraceWriter&) = delete;
+
+        /// The products of the retiring instruction, before retired() is called.
+        void registerWritten(Register reg, int64_t value);
+
+        void floatRegisterWritten(FloatRegister fReg, double value);
+
+        /// Memory and I/O of the retiring instruction, as they happen.
+        void memoryWritten(uint64_t address, int64_t value);
+
+        /// The character read by GETCHAR or the value printed by PUTCHAR and PUTNUM.
+        void inputOutput(int64_t value);
+
+        /// Ends the record of the instruction at the address.
+        void retired(uint64_t pc);
+
+        /// Writes the last block, the index and the histogram. Throws std::runtime_error
+        /// if the file could not be written.
+        void finish();
+
+    private:
+        struct MemoryWrite {
+            uint64_t address;
+            int64_t value;
+        };
+
+        void write(std::size_t slot, int64_t value);
+
+        void endBlock();
+
+        std::ofstream file_;
+
+        std::string path_;
+
+        std::size_t registerCount_;
+
+        /// Registers as of the last retired instruction, by their slot in the trace
+        std::vector<int64_t> registers_;
+
+        std::vector<uint8_t> block_;
+
+        execution_trace::BlockEntry entry_{};
+
+        std::vector<execution_trace::BlockEntry> index_;
+
+        /// Registers at the start of every block
+        std::vector<int64_t> blockRegisters_;
+
+        std::vector<uint64_t> histogram_;
+
+        // The instruction being retired
+        std::array<std::pair<std::size_t, int64_t>, 4> pendingRegisters_;
+        std::size_t pendingRegisterCount_{0};
+        std::array<MemoryWrite, 3> pendingWrites_;
+        std::size_t pendingWriteCount_{0};
+        std::optional<int64_t> pendingIo_;
+
+        uint64_t instructions_{0};
+
+        uint64_t nextPc_;
+
+        uint64_t lastAddress_{0};
+
+        bool finished_{false};
+    };
+
+    /**
+     * Trace recorded by the ExecutionTraceWriter, mapped into the memory so
+     * that traces larger than the memory can be queried.
+     */
+    class ExecutionTrace {
+    public:
+        /// The last write to an address.
+        struct Write {
+            std::size_t instruction;
+            uint64_t pc;
+            int64_t value;
+        };
+
+        /// A value of a register right before an instruction executed.
+        struct Value {
+            std::size_t instruction;
+            int64_t value;
+        };
+
+        /// Maps the file into the memory. Throws std::runtime_error if the file
+        /// cannot be read or is not a finished trace of this version.
+        explicit ExecutionTrace(const std::string& path);
+
+        std::size_t registersCount() const;
+
+        std::size_t floatRegistersCount() const;
+
+        std::size_t instructions() const;
+
+        std::size_t blocks() const;
+
+        /// Slot of the register in the values, throws std::invalid_argument if it is not recorded.
+        std::size_t slot(Register reg) const;
+
+        std::size_t slot(FloatRegister fReg) const;
+
+        /// The last write to the address by the instructions before the given one.
+        std::optional<Write> lastWrite(uint64_t address, std::size_t before) const;
+
+        /// Values the register in the slot held every time before the instruction at pc executed.
+        std::vector<Value> values(std::size_t slot, uint64_t pc) const;
+
+        /// Number of the instructions retired at every address.
+        std::span<const uint64_t> histogram() const;
+
+    private:
+        struct Record {
+            std::size_t instruction;
+            uint64_t pc;
+            std::size_t registerCount;
+            std::array<std::pair<std::size_t, int64_t>, 4> registers;
+            std::size_t writeCount;
+            std::array<std::pair<uint64_t, int64_t>, 3> writes;
+            std::optional<int64_t> io;
+        };
+
+        const execution_trace::Header& header() const;
+
+        const execution_trace::Trailer& trailer() const;
+
+        const execution_trace::BlockEntry& block(std::size_t index) const;
+
+        /// Registers at the start of the block.
+        const int64_t* blockRegisters(std::size_t index) const;
+
+        /// Calls callback(record, registers) for every instruction of the block,
+        /// the registers are the ones before the instruction.
+        template<typename F>
+        void forEachInBlock(std::size_t index, F&& callback) const;
+
+        MappedFile file_;
+    };
+}
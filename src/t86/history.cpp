@@ -0,0 +1,280 @@
+#include "history.h"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+namespace tiny::t86 {
+    namespace {
+        const std::size_t controlRegister = Cpu::DEBUG_REGISTERS_CNT - 1;
+
+        // The second byte of the control register tells which watched address was written
+        const uint64_t responsibleMask = 0xFF00;
+    }
+
+    History::RecordedInput::int_type History::RecordedInput::underflow() {
+        if (cursor == log.size()) {
+            int_type c = source_.rdbuf()->sbumpc();
+            if (traits_type::eq_int_type(c, traits_type::eof())) {
+                return c;
+            }
+            log.push_back(traits_type::to_char_type(c));
+        }
+        return traits_type::to_int_type(log[cursor]);
+    }
+
+    History::RecordedInput::int_type History::RecordedInput::uflow() {
+        int_type c = underflow();
+        if (!traits_type::eq_int_type(c, traits_type::eof())) {
+            ++cursor;
+        }
+        return c;
+    }
+
+    History::MutedOutput::int_type History::MutedOutput::overflow(int_type c) {
+        if (traits_type::eq_int_type(c, traits_type::eof())) {
+            return traits_type::not_eof(c);
+        }
+        if (written++ == printed) {
+            target_.put(traits_type::to_char_type(c));
+            ++printed;
+        }
+        return c;
+    }
+
+    std::streamsize History::MutedOutput::xsputn(const char* s, std::streamsize n) {
+        auto count = static_cast<std::size_t>(n);
+        // The characters before the printed ones were printed already
+        std::size_t skipped = std::min(count, printed - std::min(printed, written));
+        if (skipped < count) {
+            target_.write(s + skipped, static_cast<std::streamsize>(count - skipped));
+            printed = written + count;
+        }
+        written += count;
+        return n;
+    }
+
+    int History::MutedOutput::sync() {
+        target_.flush();
+        return 0;
+    }
+
+    History::CountedOutput::int_type History::CountedOutput::overflow(int_type c) {
+        if (!traits_type::eq_int_type(c, traits_type::eof())) {
+            ++written;
+        }
+        return traits_type::not_eof(c);
+    }
+
+    std::streamsize History::CountedOutput::xsputn(const char*, std::streamsize n) {
+        written += static_cast<std::size_t>(n);
+        return n;
+    }
+
+    bool History::Replay::step() {
+        cpu->tick();
+        if (cpu->interrupted() == 3) {
+            ++breakpoints;
+            return false;
+        }
+        return true;
+    }
+
+    History::History(Cpu& cpu, Options options)
+        : cpu_(cpu), options_(options), interval_(options.interval),
+          recorded_(cpu.input()), muted_(cpu.output()), input_(&recorded_), output_(&muted_) {
+        if (options.interval == 0 || options.limit == 0) {
+            throw std::invalid_argument("The interval of the checkpoints and their limit must not be zero");
+        }
+        stats_.setLevel(StatsLogger::Level::Off);
+        // Reading flushes the output, as it does with the standard streams
+        input_.tie(&output_);
+        cpu_.setStreams(input_, output_);
+    }
+
+    void History::tick() {
+        std::size_t now = position();
+        if (checkpoints_.empty() || modified_) {
+            checkpoint(false);
+        } else if (now >= checkpoints_.back().position + interval_) {
+            checkpoint(true);
+        }
+    }
+
+    void History::checkpoint(bool periodic) {
+        Checkpoint checkpoint{
+            cpu_.fork(Cpu::Context{cpu_.config(), &stats_, &discarded_, &noInput_}),
+            position(),
+            breakpoints_,
+            recorded_.cursor,
+            muted_.written,
+            periodic,
+        };
+        modified_ = false;
+        // The changes of the debugger at one position replace each other
+        if (!checkpoints_.empty() && checkpoints_.back().position == checkpoint.position) {
+            checkpoints_.back() = std::move(checkpoint);
+            return;
+        }
+        checkpoints_.push_back(std::move(checkpoint));
+        if (periodic) {
+            thin();
+        }
+    }
+
+    void History::thin() {
+        auto periodic = std::count_if(checkpoints_.begin(), checkpoints_.end(),
+                                      [](const Checkpoint& c) { return c.periodic; });
+        if (static_cast<std::size_t>(periodic) <= options_.limit) {
+            return;
+        }
+        // The others are needed to replay the changes of the debugger
+        bool drop = true;
+        std::erase_if(checkpoints_, [&drop](const Checkpoint& c) {
+            if (!c.periodic) {
+                return false;
+            }
+            drop = !drop;
+            return !drop;
+        });
+        interval_ *= 2;
+    }
+
+    std::unique_ptr<History::Replay> History::replay(std::size_t index) {
+        auto& checkpoint = checkpoints_[index];
+        auto replay = std::make_unique<Replay>();
+        replay->input.str(recorded_.log.substr(checkpoint.input));
+        replay->counted.written = checkpoint.output;
+        replay->cpu = checkpoint.cpu->fork(Cpu::Context{cpu_.config(), &stats_, &replay->output, &replay->input});
+        replay->cpu->setMode(Cpu::Mode::Functional);
+        // Hits are looked for with the current watchpoints
+        for (std::size_t i = 0; i < Cpu::DEBUG_REGISTERS_CNT; ++i) {
+            replay->cpu->setDebugRegister(i, cpu_.getDebugRegister(i));
+        }
+        replay->cpu->setDebugRegister(controlRegister, cpu_.getDebugRegister(controlRegister) & ~responsibleMask);
+        replay->breakpoints = checkpoint.breakpoints;
+        return replay;
+    }
+
+    std::vector<History::Event> History::scan(std::size_t index, std::size_t end) {
+        std::vector<Event> events;
+        auto replay = this->replay(index);
+        Cpu& cpu = *replay->cpu;
+        // Only the first state at a position is looked at, the BKPTs do not move it
+        bool moved = true;
+        while (replay->position() < end && !cpu.halted()) {
+            if (moved) {
+                uint64_t pc = cpu.retiredProgramCounter();
+                // The breakpoints are the current ones, the calls are the ones executed
+                if (pc < cpu_.textSize() && cpu_.getText(pc).type() == Instruction::Type::BKPT) {
+                    events.push_back({Event::Kind::Breakpoint, replay->position()});
+                }
+                if (pc < cpu.textSize()) {
+                    auto type = cpu.getText(pc).type();
+                    if (type == Instruction::Type::CALL) {
+                        events.push_back({Event::Kind::Call, replay->position()});
+                    } else if (type == Instruction::Type::RET) {
+                        events.push_back({Event::Kind::Return, replay->position()});
+                    }
+                }
+            }
+            moved = replay->step();
+            if (cpu.interrupted() == 2) {
+                events.push_back({Event::Kind::Watchpoint, replay->position()});
+                cpu.setDebugRegister(controlRegister, cpu.getDebugRegister(controlRegister) & ~responsibleMask);
+            }
+        }
+        return events;
+    }
+
+    void History::land(std::size_t index, std::size_t position) {
+        auto replay = this->replay(index);
+        while (replay->position() < position && !replay->cpu->halted()) {
+            replay->step();
+        }
+        assert(replay->position() == position);
+        cpu_.rewind(*replay->cpu);
+        // The debugger finds the watchpoint written by the last instruction as after a hit
+        auto control = cpu_.getDebugRegister(controlRegister) & ~responsibleMask;
+        if (replay->cpu->interrupted() == 2) {
+            control |= replay->cpu->getDebugRegister(controlRegister) & responsibleMask;
+        }
+        cpu_.setDebugRegister(controlRegister, control);
+        breakpoints_ = replay->breakpoints;
+        auto consumed = replay->input.rdbuf()->pubseekoff(0, std::ios::cur, std::ios::in);
+        recorded_.cursor = checkpoints_[index].input + static_cast<std::size_t>(consumed);
+        checkpoints_.erase(checkpoints_.begin() + static_cast<std::ptrdiff_t>(index) + 1, checkpoints_.end());
+        muted_.written = replay->counted.written;
+        // The text of the cpu may differ from the one of the checkpoint
+        modified_ = true;
+    }
+
+    History::Stop History::stepBack() {
+        std::size_t now = position();
+        if (checkpoints_.empty() || now <= checkpoints_.front().position) {
+            return Stop::Start;
+        }
+        std::size_t index = checkpoints_.size() - 1;
+        while (checkpoints_[index].position > now - 1) {
+            --index;
+        }
+        land(index, now - 1);
+        return Stop::Step;
+    }
+
+    History::Stop History::continueBack() {
+        return travelBack(false);
+    }
+
+    History::Stop History::finishBack() {
+        return travelBack(true);
+    }
+
+    History::Stop History::travelBack(bool toCall) {
+        std::size_t now = position();
+        if (checkpoints_.empty() || now <= checkpoints_.front().position) {
+            return Stop::Start;
+        }
+        // Returns seen going back, each of them skips one call
+        std::size_t returns = 0;
+        for (std::size_t index = checkpoints_.size(); index-- > 0;) {
+            if (checkpoints_[index].position >= now) {
+                continue;
+            }
+            std::size_t end = now;
+            if (index + 1 < checkpoints_.size()) {
+                end = std::min(end, checkpoints_[index + 1].position);
+            }
+            auto events = scan(index, end);
+            for (auto event = events.rbegin(); event != events.rend(); ++event) {
+                // A hit right where the cpu is does not count
+                if (event->position >= now) {
+                    continue;
+                }
+                switch (event->kind) {
+                    case Event::Kind::Breakpoint:
+                        land(index, event->position);
+                        return Stop::Breakpoint;
+                    case Event::Kind::Watchpoint:
+                        land(index, event->position);
+                        return Stop::Watchpoint;
+                    case Event::Kind::Return:
+                        ++returns;
+                        break;
+                    case Event::Kind::Call:
+                        if (!toCall) {
+                            break;
+                        }
+                        if (returns == 0) {
+                            land(index, event->position);
+                            return Stop::Call;
+                        }
+                        --returns;
+                        break;
+                }
+            }
+        }
+        land(0, checkpoints_.front().position);
+        return Stop::Start;
+    }
+}
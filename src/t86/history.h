@@ -0,0 +1,216 @@
+#pragma once
+
+#include <cstddef>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+#include "cpu.h"
+#include "utils/stats_logger.h"
+
+namespace tiny::t86 {
+    /**
+     * Past of a debugged run, lets the debugger take the cpu back to an
+     * earlier instruction. The checkpoints are forks of the cpu, which share
+     * the pages of the RAM, so each of them only keeps the pages written
+     * since the one before. They are taken every `interval` instructions and
+     * before the cpu continues after the debugger changed it. Forking leaves
+     * the instructions in flight alone, so the history does not change the
+     * ticks of the cycle model. The input is
+     * recorded, so a run from a checkpoint retires the same instructions.
+     *
+     * Going back replays the closest checkpoint on the functional engine and
+     * continues the cpu from there with its own text and debug registers, so
+     * the breakpoints and watchpoints stay as they are. The characters the
+     * cpu already printed are not printed again.
+     *
+     * Positions count the retired instructions without the BKPTs, so that
+     * hitting a breakpoint and stepping over it keeps the position.
+     */
+    class History {
+    public:
+        struct Options {
+            /// Retired instructions between the periodic checkpoints
+            std::size_t interval{10'000};
+            /// Periodic checkpoints kept, once there are more every other one
+            /// is dropped and the interval doubles
+            std::size_t limit{64};
+        };
+
+        /// Where going back stopped.
+        enum class Stop {
+            /// The start of the history, nothing is recorded before
+            Start,
+            /// One instruction before
+            Step,
+            /// Before an instruction with a breakpoint
+            Breakpoint,
+            /// After a write to a watched address, the debug control register tells which one
+            Watchpoint,
+            /// Before the call of the current function
+            Call,
+        };
+
+        /// Takes over the I/O streams of the cpu. Throws std::invalid_argument
+        /// if the interval or the limit is zero.
+        History(Cpu& cpu, Options options);
+
+        History(const History&) = delete;
+        History& operator=(const History&) = delete;
+
+        /// Must be called before each tick of the cpu, takes the checkpoints.
+        void tick();
+
+        /// Tells that the cpu retired a BKPT.
+        void breakpoint() { ++breakpoints_; }
+
+        /// Tells that the debugger changed the cpu, the checkpoint is taken before it continues.
+        void modified() { modified_ = true; }
+
+        /// Retired instructions without the BKPTs.
+        std::size_t position() const { return cpu_.retiredInstructions() - breakpoints_; }
+
+        std::size_t checkpoints() const { return checkpoints_.size(); }
+
+        /// Instructions between the periodic checkpoints, grows as they are dropped.
+        std::size_t interval() const { return interval_; }
+
+        /// Goes back by one instruction.
+        Stop stepBack();
+
+        /// Goes back to the last breakpoint or watchpoint hit.
+        Stop continueBack();
+
+        /// Goes back to the call of the current function,
+        /// or to a breakpoint or watchpoint hit after it.
+        Stop finishBack();
+
+    private:
+        /// Records the characters read from the source, reads them again after going back.
+        class RecordedInput : public std::streambuf {
+        public:
+            explicit RecordedInput(std::istream& source) : source_(source) {}
+
+            std::string log;
+            /// Characters of the log read so far
+            std::size_t cursor{0};
+
+        protected:
+            int_type underflow() override;
+            int_type uflow() override;
+
+        private:
+            std::istream& source_;
+        };
+
+        /// Forwards the characters to the target unless they were printed before.
+        class MutedOutput : public std::streambuf {
+        public:
+            explicit MutedOutput(std::ostream& target) : target_(target) {}
+
+            /// Characters the cpu wrote so far
+            std::size_t written{0};
+            /// Characters forwarded to the target
+            std::size_t printed{0};
+
+        protected:
+            int_type overflow(int_type c) override;
+            std::streamsize xsputn(const char* s, std::streamsize n) override;
+            int sync() override;
+
+        private:
+            std::ostream& target_;
+        };
+
+        /// Only counts the characters written.
+        class CountedOutput : public std::streambuf {
+        public:
+            std::size_t written{0};
+
+        protected:
+            int_type overflow(int_type c) override;
+            std::streamsize xsputn(const char* s, std::streamsize n) override;
+        };
+
+        struct Checkpoint {
+            std::unique_ptr<Cpu> cpu;
+            std::size_t position;
+            /// BKPTs retired before
+            std::size_t breakpoints;
+            /// Characters of the input read before
+            std::size_t input;
+            /// Characters written before
+            std::size_t output;
+            /// Taken because of the interval, can be dropped
+            bool periodic;
+        };
+
+        /// The checkpoint continued on the functional engine.
+        struct Replay {
+            std::istringstream input;
+            CountedOutput counted;
+            std::ostream output{&counted};
+            std::unique_ptr<Cpu> cpu;
+            std::size_t breakpoints{0};
+
+            std::size_t position() const { return cpu->retiredInstructions() - breakpoints; }
+
+            /// Retires one instruction, returns false if it was a BKPT.
+            bool step();
+        };
+
+        struct Event {
+            enum class Kind { Breakpoint, Watchpoint, Call, Return };
+            Kind kind;
+            std::size_t position;
+        };
+
+        void checkpoint(bool periodic);
+
+        /// Drops every other periodic checkpoint if there are too many of them.
+        void thin();
+
+        std::unique_ptr<Replay> replay(std::size_t index);
+
+        /// Events of the replay of the checkpoint until the given position.
+        std::vector<Event> scan(std::size_t index, std::size_t end);
+
+        /// Continues the cpu from the first state at the position reached
+        /// from the checkpoint, the history after it is forgotten.
+        void land(std::size_t index, std::size_t position);
+
+        /// Goes back to the last hit, or to the call of the current function if asked to.
+        Stop travelBack(bool toCall);
+
+        Cpu& cpu_;
+
+        Options options_;
+
+        std::size_t interval_;
+
+        RecordedInput recorded_;
+
+        MutedOutput muted_;
+
+        std::istream input_;
+
+        std::ostream output_;
+
+        // Streams of the checkpoints and the replays
+        std::istream noInput_{nullptr};
+
+        std::ostream discarded_{nullptr};
+
+        StatsLogger stats_;
+
+        std::vector<Checkpoint> checkpoints_;
+
+        std::size_t breakpoints_{0};
+
+        bool modified_{false};
+    };
+}
@@ -706,21 +706,36 @@ INS_NAME::INS_NAME(Operand address) : ConditionalJumpInstruction([](Alu::Flags f
         entry.setRegister(reg_, address);
     }
 
+    std::ostream& PUTCHAR::outputStream(const Cpu& cpu) const {
+        return os_ != nullptr ? *os_ : cpu.output();
+    }
+
     void PUTCHAR::retire(ReservationStation::Entry& entry) const {
         const auto& operands = entry.operands();
         assert(operands.size() == 1);
-        os_ << static_cast<char>(operands[0].getValue()) << std::flush;
+        outputStream(entry.cpu()) << static_cast<char>(operands[0].getValue()) << std::flush;
+        entry.cpu().inputOutputRetired(operands[0].getValue());
+    }
+
+    std::ostream& PUTNUM::outputStream(const Cpu& cpu) const {
+        return os_ != nullptr ? *os_ : cpu.output();
     }
 
     void PUTNUM::retire(ReservationStation::Entry& entry) const {
         const auto& operands = entry.operands();
         assert(operands.size() == 1);
-        os_ << static_cast<int>(operands[0].getValue()) << std::endl;
+        outputStream(entry.cpu()) << static_cast<int>(operands[0].getValue()) << std::endl;
+        entry.cpu().inputOutputRetired(operands[0].getValue());
+    }
+
+    std::istream& GETCHAR::inputStream(const Cpu& cpu) const {
+        return is_ != nullptr ? *is_ : cpu.input();
     }
 
     void GETCHAR::retire(ReservationStation::Entry& entry) const {
         char c;
-        is_ >> c;
+        inputStream(entry.cpu()) >> c;
+        entry.cpu().inputOutputRetired(c);
         entry.setRegister(reg_, c);
     }
 
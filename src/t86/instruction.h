@@ -139,34 +139,36 @@ namespace tiny::t86 {
 
     class BinaryArithmeticInstruction : public Instruction {
     public:
-        BinaryArithmeticInstruction(std::function<Alu::Result(int64_t, int64_t)> op, Register reg, Register val)
+        using Operation = Alu::Result (*)(int64_t, int64_t);
+
+        BinaryArithmeticInstruction(Operation op, Register reg, Register val)
                 : op_(std::move(op)), dest_(reg), reg_(reg), val_(val) {}
 
-        BinaryArithmeticInstruction(std::function<Alu::Result(int64_t, int64_t)> op, Register reg, RegisterOffset regDisp)
+        BinaryArithmeticInstruction(Operation op, Register reg, RegisterOffset regDisp)
                 : op_(std::move(op)), dest_(reg), reg_(reg), val_(regDisp) {}
 
-        BinaryArithmeticInstruction(std::function<Alu::Result(int64_t, int64_t)> op, Register reg, int64_t val)
+        BinaryArithmeticInstruction(Operation op, Register reg, int64_t val)
                 : op_(std::move(op)), dest_(reg), reg_(reg), val_(val) {}
 
-        BinaryArithmeticInstruction(std::function<Alu::Result(int64_t, int64_t)> op, Register reg, Memory::Immediate val)
+        BinaryArithmeticInstruction(Operation op, Register reg, Memory::Immediate val)
                 : op_(std::move(op)), dest_(reg), reg_(reg), val_(val) {}
 
-        BinaryArithmeticInstruction(std::function<Alu::Result(int64_t, int64_t)> op, Register reg, Memory::Register val)
+        BinaryArithmeticInstruction(Operation op, Register reg, Memory::Register val)
                 : op_(std::move(op)), dest_(reg), reg_(reg), val_(val) {}
 
-        BinaryArithmeticInstruction(std::function<Alu::Result(int64_t, int64_t)> op, Register reg, Memory::RegisterOffset val)
+        BinaryArithmeticInstruction(Operation op, Register reg, Memory::RegisterOffset val)
                 : op_(std::move(op)), dest_(reg), reg_(reg), val_(val) {}
 
-        BinaryArithmeticInstruction(std::function<Alu::Result(int64_t, int64_t)> op, Register reg, Operand val)
+        BinaryArithmeticInstruction(Operation op, Register reg, Operand val)
                 : op_(std::move(op)), dest_(reg), reg_(reg), val_(val) {}
 
-        BinaryArithmeticInstruction(std::function<Alu::Result(int64_t, int64_t)> op, Register dest, Register reg, int64_t val)
+        BinaryArithmeticInstruction(Operation op, Register dest, Register reg, int64_t val)
                 : op_(std::move(op)), riscLike_(true), dest_(dest), reg_(reg), val_(val) {}
 
-        BinaryArithmeticInstruction(std::function<Alu::Result(int64_t, int64_t)> op, Register dest, Register reg, Register val)
+        BinaryArithmeticInstruction(Operation op, Register dest, Register reg, Register val)
                 : op_(std::move(op)), riscLike_(true), dest_(dest), reg_(reg), val_(val) {}
 
-        BinaryArithmeticInstruction(std::function<Alu::Result(int64_t, int64_t)> op, Register dest, Register reg, Operand val)
+        BinaryArithmeticInstruction(Operation op, Register dest, Register reg, Operand val)
                 : op_(std::move(op)), riscLike_(true), dest_(dest), reg_(reg), val_(val) {}
 
         bool needsAlu() const override {
@@ -195,8 +197,16 @@ namespace tiny::t86 {
             return {dest_, Register::Flags()};
         }
 
+        Register destination() const {
+            return dest_;
+        }
+
+        Alu::Result compute(int64_t x, int64_t y) const {
+            return op_(x, y);
+        }
+
     protected:
-        std::function<Alu::Result(int64_t, int64_t)> op_;
+        Operation op_;
 
         bool riscLike_ = false;
 
@@ -254,10 +264,12 @@ namespace tiny::t86 {
 
     class FloatBinaryArithmeticInstruction : public Instruction {
     public:
-        FloatBinaryArithmeticInstruction(std::function<Alu::FloatResult(double, double)> op, FloatRegister fReg, FloatRegister val)
+        using Operation = Alu::FloatResult (*)(double, double);
+
+        FloatBinaryArithmeticInstruction(Operation op, FloatRegister fReg, FloatRegister val)
             : op_(std::move(op)), fReg_(fReg), val_(val) {}
 
-        FloatBinaryArithmeticInstruction(std::function<Alu::FloatResult(double, double)> op, FloatRegister fReg, double val)
+        FloatBinaryArithmeticInstruction(Operation op, FloatRegister fReg, double val)
             : op_(std::move(op)), fReg_(fReg), val_(val) {}
 
         bool needsAlu() const override {
@@ -276,12 +288,16 @@ namespace tiny::t86 {
             return { fReg_, Register::Flags() };
         }
 
+        Alu::FloatResult compute(double x, double y) const {
+            return op_(x, y);
+        }
+
     protected:
         friend class ::Parser;
-        FloatBinaryArithmeticInstruction(std::function<Alu::FloatResult(double, double)> op, FloatRegister fReg, Operand val)
+        FloatBinaryArithmeticInstruction(Operation op, FloatRegister fReg, Operand val)
             : op_(std::move(op)), fReg_(fReg), val_(val) {}
 
-        std::function<Alu::FloatResult(double, double)> op_;
+        Operation op_;
 
         FloatRegister fReg_;
 
@@ -305,7 +321,9 @@ namespace tiny::t86 {
 
     class UnaryArithmeticInstruction : public Instruction {
     public:
-        UnaryArithmeticInstruction(std::function<Alu::Result(int64_t)> op, Register reg)
+        using Operation = Alu::Result (*)(int64_t);
+
+        UnaryArithmeticInstruction(Operation op, Register reg)
                 : op_(std::move(op)), reg_(reg) {}
 
         bool needsAlu() const override {
@@ -326,8 +344,12 @@ namespace tiny::t86 {
             return {reg_, Register::Flags()};
         }
 
+        Alu::Result compute(int64_t x) const {
+            return op_(x);
+        }
+
     private:
-        std::function<Alu::Result(int64_t)> op_;
+        Operation op_;
 
         Register reg_;
     };
@@ -747,6 +769,10 @@ class INS_NAME : public UnaryArithmeticInstruction {      \
 
         void retire(ReservationStation::Entry& entry) const override;
 
+        const std::function<void(Cpu&)>& debugFunction() const {
+            return debugFunction_;
+        }
+
     protected:
         std::function<void(Cpu&)> debugFunction_;
     };
@@ -799,19 +825,21 @@ class INS_NAME : public UnaryArithmeticInstruction {      \
 
     class ConditionalJumpInstruction : public PatchableJumpInstruction {
     public:
-        ConditionalJumpInstruction(std::function<bool(Alu::Flags)> condition, uint64_t address)
+        using Condition = bool (*)(Alu::Flags);
+
+        ConditionalJumpInstruction(Condition condition, uint64_t address)
                 : PatchableJumpInstruction{address}, condition_{std::move(condition)} {}
 
-        ConditionalJumpInstruction(std::function<bool(Alu::Flags)> condition, Register address)
+        ConditionalJumpInstruction(Condition condition, Register address)
                 : PatchableJumpInstruction{address}, condition_{std::move(condition)} {}
 
-        ConditionalJumpInstruction(std::function<bool(Alu::Flags)> condition, Memory::Immediate address)
+        ConditionalJumpInstruction(Condition condition, Memory::Immediate address)
                 : PatchableJumpInstruction{address}, condition_{std::move(condition)} {}
 
-        ConditionalJumpInstruction(std::function<bool(Alu::Flags)> condition, Memory::Register address)
+        ConditionalJumpInstruction(Condition condition, Memory::Register address)
                 : PatchableJumpInstruction{address}, condition_{std::move(condition)} {}
 
-        ConditionalJumpInstruction(std::function<bool(Alu::Flags)> condition, Memory::RegisterOffset address)
+        ConditionalJumpInstruction(Condition condition, Memory::RegisterOffset address)
                 : PatchableJumpInstruction{address}, condition_{std::move(condition)} {}
 
         std::vector<Operand> operands() const override {
@@ -826,12 +854,16 @@ class INS_NAME : public UnaryArithmeticInstruction {      \
 
         void retire(ReservationStation::Entry& entry) const override;
 
+        bool condition(Alu::Flags flags) const {
+            return condition_(flags);
+        }
+
     protected:
         friend class ::Parser;
-        ConditionalJumpInstruction(std::function<bool(Alu::Flags)> condition, Operand address)
+        ConditionalJumpInstruction(Condition condition, Operand address)
                 : PatchableJumpInstruction{address}, condition_{std::move(condition)} {}
 
-        std::function<bool(Alu::Flags)> condition_;
+        Condition condition_;
     };
 
     class JMP : public PatchableJumpInstruction {
@@ -1051,7 +1083,10 @@ class INS_NAME : public ConditionalJumpInstruction {          \
 
     class PUTCHAR : public Instruction {
     public:
-        PUTCHAR(Register reg, std::ostream& os = std::cout) : reg_(reg), os_(os) {}
+        /// Writes to the output stream of the cpu.
+        PUTCHAR(Register reg) : reg_(reg) {}
+
+        PUTCHAR(Register reg, std::ostream& os) : reg_(reg), os_(&os) {}
 
         Type type() const override { return Type::PUTCHAR; }
 
@@ -1073,15 +1108,21 @@ class INS_NAME : public ConditionalJumpInstruction {          \
 
         void retire(ReservationStation::Entry& entry) const override;
 
+        /// The stream given to the instruction, or the output of the cpu.
+        std::ostream& outputStream(const Cpu& cpu) const;
+
     protected:
         Register reg_;
 
-        std::ostream& os_;
+        std::ostream* os_{nullptr};
     };
     
     class PUTNUM : public Instruction {
     public:
-        PUTNUM(Register reg, std::ostream& os = std::cout) : reg_(reg), os_(os) {}
+        /// Writes to the output stream of the cpu.
+        PUTNUM(Register reg) : reg_(reg) {}
+
+        PUTNUM(Register reg, std::ostream& os) : reg_(reg), os_(&os) {}
 
         Type type() const override { return Type::PUTNUM; }
 
@@ -1103,15 +1144,21 @@ class INS_NAME : public ConditionalJumpInstruction {          \
 
         void retire(ReservationStation::Entry& entry) const override;
 
+        /// The stream given to the instruction, or the output of the cpu.
+        std::ostream& outputStream(const Cpu& cpu) const;
+
     protected:
         Register reg_;
 
-        std::ostream& os_;
+        std::ostream* os_{nullptr};
     };
 
     class GETCHAR : public Instruction {
     public:
-        GETCHAR(Register reg, std::istream& is = std::cin) : reg_(reg), is_(is) {}
+        /// Reads from the input stream of the cpu.
+        GETCHAR(Register reg) : reg_(reg) {}
+
+        GETCHAR(Register reg, std::istream& is) : reg_(reg), is_(&is) {}
 
         Type type() const override { return Type::GETCHAR; }
 
@@ -1137,10 +1184,13 @@ class INS_NAME : public ConditionalJumpInstruction {          \
 
         void retire(ReservationStation::Entry& entry) const override;
 
+        /// The stream given to the instruction, or the input of the cpu.
+        std::istream& inputStream(const Cpu& cpu) const;
+
     protected:
         Register reg_;
 
-        std::istream& is_;
+        std::istream* is_{nullptr};
     };
 
     class EXT : public Instruction {
@@ -3,6 +3,7 @@
 #include "requirements.h"
 #include "../cpu/register.h"
 #include "../cpu/memory.h"
+#include "../utils/static_vector.h"
 
 #include <variant>
 #include <cstdint>
@@ -198,4 +199,10 @@ namespace tiny::t86 {
                      Memory::Immediate, Memory::Register, Memory::RegisterOffset, Memory::RegisterRegister, Memory::RegisterScaled,
                      Memory::RegisterOffsetRegister, Memory::RegisterRegisterScaled, Memory::RegisterOffsetRegisterScaled> value_;
     };
+
+    // Max instruction operands - for example ADD R1 R2 has 3 (destination and 2 source)
+    static constexpr std::size_t maxInstructionOperands = 3;
+
+    /// Operands of a single instruction, stored inline.
+    using OperandList = StaticVector<Operand, maxInstructionOperands>;
 }
@@ -46,4 +46,10 @@ namespace tiny::t86 {
 
         std::variant<Register, FloatRegister, Memory::Immediate, MemoryRegister> product_;
     };
+
+    // LOOP and CALL produce the most, 3 products each
+    static constexpr std::size_t maxInstructionProducts = 3;
+
+    /// Products of a single instruction, stored inline.
+    using ProductList = StaticVector<Product, maxInstructionProducts>;
 }
@@ -0,0 +1,50 @@
+#include "mapped_file.h"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <fmt/core.h>
+
+namespace tiny::t86 {
+    MappedFile::MappedFile(const std::string& path, std::size_t unit) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error(fmt::format("Could not open `{}`: {}", path, std::strerror(errno)));
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0) {
+            close(fd);
+            throw std::runtime_error(fmt::format("Could not read `{}`: {}", path, std::strerror(errno)));
+        }
+        size_ = info.st_size;
+        if (size_ % unit != 0) {
+            close(fd);
+            throw std::runtime_error(fmt::format("The size of `{}` is not a multiple of {} bytes", path, unit));
+        }
+        // An empty file cannot be mapped, there is nothing to read from it anyway
+        if (size_ == 0) {
+            close(fd);
+            return;
+        }
+        // Read-only, the RAM copies a page of it before writing. Later changes
+        // of the file still show through, the file must not change while mapped
+        void* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (data == MAP_FAILED) {
+            throw std::runtime_error(fmt::format("Could not map `{}`: {}", path, std::strerror(errno)));
+        }
+        data_ = static_cast<const char*>(data);
+    }
+
+    MappedFile::~MappedFile() {
+        if (data_) {
+            munmap(const_cast<char*>(data_), size_);
+        }
+    }
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+
+namespace tiny::t86 {
+    /**
+     * File mapped read-only into the memory, so that its 64 bit words (in the
+     * byte order of the host) can be put into the RAM without reading them,
+     * see Cpu::mapMemory. Nothing is read until the program touches it.
+     */
+    class MappedFile {
+    public:
+        /// Throws std::runtime_error if the file cannot be mapped or its size
+        /// is not a multiple of the unit, which is the word by default.
+        explicit MappedFile(const std::string& path, std::size_t unit = sizeof(int64_t));
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        ~MappedFile();
+
+        const char* data() const {
+            return data_;
+        }
+
+        std::size_t size() const {
+            return size_;
+        }
+
+        /// The whole words of the file.
+        std::span<const int64_t> words() const {
+            return words(0, size_ / sizeof(int64_t));
+        }
+
+        /// The words from the offset in bytes, which must be a multiple of the word.
+        std::span<const int64_t> words(std::size_t offset, std::size_t count) const {
+            return {reinterpret_cast<const int64_t*>(data_ + offset), count};
+        }
+
+    private:
+        const char* data_{nullptr};
+
+        std::size_t size_{0};
+    };
+}
@@ -10,6 +10,9 @@ namespace tiny::t86 {
 void OS::DispatchInterrupt(int n) {
     switch (n) {
     case 3:
+        if (history) {
+            history->breakpoint();
+        }
         DebuggerMessage(Debug::BreakReason::SoftwareBreakpoint);
         break;
     case 2:
@@ -26,10 +29,39 @@ void OS::DispatchInterrupt(int n) {
 }
 
 bool OS::Run(Program program) {
-    cpu.start(std::move(program));
+    Start(std::move(program));
+    return Execute();
+}
+
+bool OS::Run(const Snapshot& snapshot) {
+    snapshot.restore(cpu);
+    return Execute();
+}
+
+bool OS::Execute() {
+    if (execution_trace_path.empty()) {
+        return ExecuteLoop();
+    }
+    ExecutionTraceWriter trace(execution_trace_path, cpu);
+    cpu.setExecutionTrace(&trace);
+    bool completed = ExecuteLoop();
+    cpu.setExecutionTrace(nullptr);
+    trace.finish();
+    return completed;
+}
+
+bool OS::ExecuteLoop() {
+    if (debug_interface && history_options.interval > 0 && !history) {
+        history.emplace(cpu, history_options);
+        debug_interface->SetHistory(&*history);
+    }
     DebuggerMessage(Debug::BreakReason::Begin);
     log_info("Starting execution\n");
-    while (true) {
+    for (std::size_t ticks = 0; ; ++ticks) {
+        CheckSnapshot(ticks);
+        if (history) {
+            history->tick();
+        }
         try {
             cpu.tick();
         } catch (const std::exception& e) {
@@ -40,7 +72,11 @@ bool OS::Run(Program program) {
         if (cpu.halted()) {
             log_info("Halt");
             DebuggerMessage(Debug::BreakReason::Halt);
-            return true;
+            // Unless the debugger went back in the history
+            if (cpu.halted() || stop) {
+                return true;
+            }
+            continue;
         }
 
         if (int n = cpu.interrupted(); n > 0) {
@@ -55,6 +91,40 @@ bool OS::Run(Program program) {
     }
 }
 
+Sampler::Estimate OS::RunSampled(Program program, Sampler::Options options) {
+    Sampler sampler(cpu, options);
+    Start(std::move(program));
+    log_info("Starting sampled execution\n");
+    return sampler.run();
+}
+
+void OS::Start(Program program) {
+    cpu.start(std::move(program));
+    for (const auto& [address, file] : mapped_files) {
+        cpu.mapMemory(address, file);
+    }
+}
+
+void OS::CheckSnapshot(std::size_t ticks) {
+    if (!snapshot_trigger) {
+        return;
+    }
+    // The skipped idle ticks of the cycle model are only counted by the stats
+    if (cpu.mode() == Cpu::Mode::Cycle) {
+        ticks = cpu.stats().tickCount();
+    }
+    bool reached = snapshot_trigger->kind == Snapshot::Trigger::Kind::Tick
+        ? ticks >= snapshot_trigger->value
+        : cpu.retiredProgramCounter() == snapshot_trigger->value;
+    if (!reached) {
+        return;
+    }
+    log_info("Saving the snapshot to {}", snapshot_path);
+    cpu.squash();
+    Snapshot::save(cpu, snapshot_path);
+    snapshot_trigger.reset();
+}
+
 void OS::DebuggerMessage(Debug::BreakReason reason) {
     if (debug_interface) {
         stop = !debug_interface->Work(reason);
@@ -2,6 +2,10 @@
 
 #include "t86/cpu.h"
 #include "t86/debug.h"
+#include "t86/execution_trace.h"
+#include "t86/history.h"
+#include "t86/sampler.h"
+#include "t86/snapshot.h"
 #include "t86/program.h"
 #include "common/logger.h"
 
@@ -10,15 +14,81 @@ class OS {
 public:
     OS(size_t register_count = 8, size_t float_register_count = 4, size_t memory_size = 1024): cpu(register_count, float_register_count, memory_size) {}
 
+    /// The cpu takes its options, stats logger and I/O streams from the context,
+    /// so that several OSes can run on different threads.
+    OS(const Cpu::Context& context, size_t register_count = 8, size_t float_register_count = 4, size_t memory_size = 1024)
+        : cpu(register_count, float_register_count, memory_size, context) {}
+
+    /// Sets all the sizes of the cpu, the other options come from the context.
+    OS(const Cpu::Context& context, size_t register_count, size_t float_register_count, size_t alu_count,
+       size_t reservation_station_entries, size_t memory_size, size_t ram_gates)
+        : cpu(register_count, float_register_count, alu_count, reservation_station_entries, memory_size, ram_gates, context) {}
+
     /// Runs the program on the T86 virtual machine.
     /// Returns true if the run was completed successfully,
     /// false if some error occured.
     bool Run(Program program);
 
+    /// Continues the run saved in the snapshot, the sizes of the cpu must match it.
+    /// Returns the same as above.
+    bool Run(const Snapshot& snapshot);
+
+    /// Saves the snapshot of the run into the file once the trigger is reached.
+    /// The cycle model squashes its instructions in flight first.
+    void SaveSnapshotAt(Snapshot::Trigger trigger, std::string path) {
+        snapshot_trigger = trigger;
+        snapshot_path = std::move(path);
+    }
+
+    /// Puts the file into the RAM at the address once the program is started,
+    /// after its data. Runs continued from a snapshot already have their RAM.
+    void MapFile(uint64_t address, std::shared_ptr<const MappedFile> file) {
+        mapped_files.emplace_back(address, std::move(file));
+    }
+
+    /// Records the architectural trace of the run into the file, see ExecutionTraceWriter.
+    void RecordExecution(std::string path) {
+        execution_trace_path = std::move(path);
+    }
+
+    /// Runs the program with detailed windows between functional
+    /// fast-forwards and estimates its ticks. There is no debugging.
+    Sampler::Estimate RunSampled(Program program, Sampler::Options options);
+
     void SetDebuggerComms(std::unique_ptr<Messenger> m) {
         debug_interface.emplace(cpu, std::move(m));
     }
+
+    /// Sets the checkpoints of the history the debugger goes back in,
+    /// the interval 0 turns the history off. It is kept only with a debugger.
+    void SetHistoryOptions(History::Options options) {
+        history_options = options;
+    }
+
+    /// Selects whether the program runs on the out-of-order model
+    /// or on the much faster functional engine.
+    void SetMode(Cpu::Mode mode) {
+        cpu.setMode(mode);
+    }
+
+    /// Lets the cycle model jump over ticks in which nothing happens.
+    void SetSkipIdleTicks(bool skip) {
+        cpu.setSkipIdleTicks(skip);
+    }
+
+    /// Replaces the branch predictor of the cycle model.
+    void SetBranchPredictor(std::unique_ptr<BranchPredictor> predictor) {
+        cpu.setBranchPredictor(std::move(predictor));
+    }
 private:
+    /// Runs the started cpu until it halts or the debugger ends the run,
+    /// records it if asked to.
+    bool Execute();
+    bool ExecuteLoop();
+    /// Starts the program and maps the files.
+    void Start(Program program);
+    /// Saves the snapshot if its trigger was reached, ticks are the ones done by the loop.
+    void CheckSnapshot(std::size_t ticks);
     void DebuggerMessage(Debug::BreakReason reason);
     void DispatchInterrupt(int n);
     /// If debug interface is present then sends message to it,
@@ -26,7 +96,13 @@ private:
     /// If returns false then the execution should be aborted.
     Cpu cpu;
     std::optional<Debug> debug_interface;
+    History::Options history_options;
+    std::optional<History> history;
     /// Indicates whether the execution should stop.
     bool stop{false};
+    std::optional<Snapshot::Trigger> snapshot_trigger;
+    std::string snapshot_path;
+    std::string execution_trace_path;
+    std::vector<std::pair<uint64_t, std::shared_ptr<const MappedFile>>> mapped_files;
 };
 }
@@ -0,0 +1,152 @@
+#include "parallel_simulator.h"
+
+#include <algorithm>
+#include <exception>
+#include <sstream>
+#include <stdexcept>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "utils/parallel_for.h"
+
+namespace tiny::t86 {
+    namespace {
+        /// Passes the input through and remembers what was read, so that
+        /// the intervals can read the same input again.
+        class RecordingBuffer : public std::streambuf {
+        public:
+            explicit RecordingBuffer(std::streambuf* source) : source_(source) {}
+
+            const std::string& recorded() const {
+                return recorded_;
+            }
+
+        protected:
+            int_type underflow() override {
+                return source_->sgetc();
+            }
+
+            int_type uflow() override {
+                int_type c = source_->sbumpc();
+                if (!traits_type::eq_int_type(c, traits_type::eof())) {
+                    recorded_.push_back(traits_type::to_char_type(c));
+                }
+                return c;
+            }
+
+        private:
+            std::streambuf* source_;
+
+            std::string recorded_;
+        };
+
+        /// Ticks until the cpu halts or retires the given number of instructions in total.
+        void runUntil(Cpu& cpu, std::size_t retired) {
+            // Interrupts are only for the debugger, there is none
+            while (!cpu.halted() && cpu.retiredInstructions() < retired) {
+                cpu.tick();
+            }
+        }
+
+        struct IntervalStart {
+            Cpu::Checkpoint checkpoint;
+            // Trained by the jumps before the checkpoint
+            std::unique_ptr<BranchPredictor> predictor;
+            // Characters of the input read before the checkpoint
+            std::size_t inputOffset;
+        };
+    }
+
+    ParallelSimulator::ParallelSimulator(CpuFactory makeCpu, Options options)
+            : makeCpu_(std::move(makeCpu)), options_(options) {
+        if (options.interval == 0) {
+            throw std::invalid_argument("The interval of the parallel simulation must not be empty");
+        }
+    }
+
+    ParallelSimulator::Result ParallelSimulator::run(std::shared_ptr<const Program> program, const Cpu::Context& context) {
+        if (context.stats->level() == StatsLogger::Level::Full) {
+            throw std::invalid_argument("The stats of the parallel simulation are `counters` or `off`");
+        }
+
+        // The functional run produces the output and the checkpoints
+        RecordingBuffer inputBuffer(context.input->rdbuf());
+        std::istream input(&inputBuffer);
+        StatsLogger functionalStats;
+        functionalStats.setLevel(StatsLogger::Level::Off);
+        Cpu::Context functionalContext = context;
+        functionalContext.stats = &functionalStats;
+        functionalContext.input = &input;
+        std::unique_ptr<Cpu> cpu = makeCpu_(functionalContext);
+        cpu->setMode(Cpu::Mode::Functional);
+        cpu->setFunctionalWarming(true);
+        cpu->start(program);
+
+        std::vector<IntervalStart> starts;
+        for (std::size_t i = 0; ; ++i) {
+            std::size_t begin = i * options_.interval;
+            runUntil(*cpu, begin - std::min(begin, options_.warmup));
+            if (cpu->halted()) {
+                break;
+            }
+            starts.push_back(IntervalStart{cpu->checkpoint(), cpu->branchPredictor().clone(), inputBuffer.recorded().size()});
+        }
+        Result result;
+        result.instructions = cpu->retiredInstructions();
+        // The last checkpoints may be warm-ups of intervals after the halt
+        result.intervals = std::max<std::size_t>(1, (result.instructions + options_.interval - 1) / options_.interval);
+        starts.resize(std::min(starts.size(), result.intervals));
+        cpu.reset();
+
+        std::vector<StatsLogger> stats(starts.size());
+        std::vector<std::size_t> warmupTicks(starts.size(), 0);
+        std::vector<std::exception_ptr> errors(starts.size());
+        std::size_t threads = options_.threads != 0 ? options_.threads : std::thread::hardware_concurrency();
+        parallelFor(starts.size(), threads, [&](std::size_t i, std::size_t) {
+            stats[i].setLevel(context.stats->level());
+            try {
+                warmupTicks[i] = simulateInterval(program, context, starts[i].checkpoint, *starts[i].predictor,
+                                                  inputBuffer.recorded(), starts[i].inputOffset,
+                                                  i * options_.interval, stats[i]);
+            } catch (...) {
+                errors[i] = std::current_exception();
+            }
+        });
+
+        for (std::size_t i = 0; i < starts.size(); ++i) {
+            if (errors[i]) {
+                std::rethrow_exception(errors[i]);
+            }
+            result.ticks += stats[i].tickCount();
+            result.warmupTicks += warmupTicks[i];
+            context.stats->merge(stats[i]);
+        }
+        return result;
+    }
+
+    std::size_t ParallelSimulator::simulateInterval(std::shared_ptr<const Program> program, const Cpu::Context& context,
+                                                    const Cpu::Checkpoint& checkpoint, const BranchPredictor& predictor,
+                                                    const std::string& input, std::size_t inputOffset, std::size_t begin,
+                                                    StatsLogger& stats) {
+        // The output was already written by the functional run
+        std::ostream output(nullptr);
+        std::istringstream intervalInput(input.substr(inputOffset));
+        Cpu::Context intervalContext = context;
+        intervalContext.stats = &stats;
+        intervalContext.output = &output;
+        intervalContext.input = &intervalInput;
+        std::unique_ptr<Cpu> cpu = makeCpu_(intervalContext);
+        cpu->setMode(Cpu::Mode::Cycle);
+        cpu->setBranchPredictor(predictor.clone());
+        cpu->start(std::move(program));
+        cpu->restore(checkpoint);
+
+        runUntil(*cpu, begin);
+        std::size_t warmupTicks = stats.tickCount();
+        stats.resetTotals();
+        runUntil(*cpu, begin + options_.interval);
+        return warmupTicks;
+    }
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "cpu.h"
+
+namespace tiny::t86 {
+    /**
+     * Runs the cycle model of one program on all the cores. The program first
+     * runs on the functional engine, which produces its output and takes a
+     * checkpoint every `interval` instructions, together with a copy of the
+     * branch predictor it keeps training. Each interval is then simulated in
+     * the cycle model on its own thread, starting `warmup` instructions before
+     * the interval so that the pipeline and the RAM are busy once it begins.
+     * The ticks and the stats of the intervals are added up.
+     *
+     * The result is exact if the state of the cpu at every boundary is the
+     * same as in the whole run. Without a warm-up the pipeline starts empty,
+     * which costs a few ticks per interval. A warm-up longer than the pipeline
+     * holds instructions removes that, what remains is the difference between
+     * the predictor trained by the functional engine and by the pipeline,
+     * which predicts jumps before the older ones retire. See docs/t86.md.
+     */
+    class ParallelSimulator {
+    public:
+        struct Options {
+            std::size_t interval{1'000'000};
+            std::size_t warmup{10'000};
+            /// Zero uses all the cores
+            std::size_t threads{0};
+        };
+
+        struct Result {
+            /// Instructions the whole program retired
+            std::size_t instructions{0};
+            std::size_t intervals{0};
+            std::size_t ticks{0};
+            /// Ticks done in the warm-ups, not counted in the ticks
+            std::size_t warmupTicks{0};
+        };
+
+        /// Creates a cpu with the given context, every cpu of the run must be the same.
+        using CpuFactory = std::function<std::unique_ptr<Cpu>(const Cpu::Context&)>;
+
+        /// Throws std::invalid_argument if the interval is zero.
+        ParallelSimulator(CpuFactory makeCpu, Options options);
+
+        /**
+         * Runs the program until it halts. The output goes to the stream of
+         * the context and the input comes from its stream, the intervals read
+         * again what the functional run has read. The stats of the intervals are merged into the logger of
+         * the context, whose level must be counters or off.
+         */
+        Result run(std::shared_ptr<const Program> program, const Cpu::Context& context);
+
+    private:
+        /// Simulates the interval from the checkpoint of its warm-up, the stats of the
+        /// interval go to the logger. Returns the ticks of the warm-up.
+        std::size_t simulateInterval(std::shared_ptr<const Program> program, const Cpu::Context& context,
+                                     const Cpu::Checkpoint& checkpoint, const BranchPredictor& predictor,
+                                     const std::string& input, std::size_t inputOffset, std::size_t begin,
+                                     StatsLogger& stats);
+
+        CpuFactory makeCpu_;
+
+        Options options_;
+    };
+}
@@ -1,44 +1,71 @@
 #include <cassert>
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
 
 #include "ram.h"
 
 namespace tiny::t86 {
 
-    RAM::RAM(std::size_t memSize, std::size_t gatesCnt) : mem_(memSize, 0), gatesCnt_(gatesCnt) {}
+    RAM::RAM(std::size_t memSize, std::size_t gatesCnt)
+            : size_(memSize), pages_((memSize + pageSize - 1) / pageSize), owned_(pages_.size(), true), gatesCnt_(gatesCnt),
+              latency_(std::make_shared<UniformRamLatency>()),
+              reads_(gatesCnt), wheel_(wheelSize) {}
+
+    void RAM::setLatencyPolicy(std::shared_ptr<const RamLatencyPolicy> policy) {
+        assert(policy);
+        latency_ = std::move(policy);
+    }
+
+    std::size_t RAM::readLatency(std::size_t address) const {
+        return latency_->readLatency(address);
+    }
+
+    std::size_t RAM::writeLatency(std::size_t address) const {
+        return latency_->writeLatency(address);
+    }
 
     void RAM::tick() {
+        ++now_;
         // writes and reads "linger" around for one tick after being finished
-        for (auto writeIt = writes_.begin(); writeIt != writes_.end();) {
-            auto& write = writeIt->second;
-            if (write.remainingCnt == 0) {
-                // Remove from the helper lookup map
-                writesById_.erase(write.id);
-                // Remove from this map
-                writeIt = writes_.erase(writeIt);
+        auto& bucket = wheel_[now_ % wheelSize];
+        std::size_t kept = 0;
+        for (const Removal& removal : bucket) {
+            if (removal.tick != now_) {
+                bucket[kept++] = removal;
+            } else if (removal.write) {
+                auto it = std::find_if(writes_.begin(), writes_.end(), [&removal](const WriteEntry& write) {
+                    return write.id == removal.slotOrId;
+                });
+                // The write could have been replaced by a later one to the same address
+                if (it != writes_.end()) {
+                    *it = writes_.back();
+                    writes_.pop_back();
+                    ++changes_;
+                }
             } else {
-                --write.remainingCnt;
-                ++writeIt;
+                reads_[removal.slotOrId].active = false;
+                --activeReads_;
+                ++changes_;
             }
         }
+        bucket.resize(kept);
+    }
 
-        for (auto readIt = reads_.begin(); readIt != reads_.end();) {
-            auto& read = readIt->second;
-            if (read.remainingCnt == 0) {
-                readIt = reads_.erase(readIt);
-            } else {
-                --read.remainingCnt;
-                ++readIt;
-            }
-        }
+    void RAM::schedule(uint64_t finish, bool write, std::size_t slotOrId) {
+        uint64_t tick = finish + 1;
+        wheel_[tick % wheelSize].push_back(Removal{tick, write, slotOrId});
     }
 
     std::optional<int64_t> RAM::read(std::size_t address) {
         // Check reads
-        if (auto it = reads_.find(address); it != reads_.end()) {
-            const auto& read = it->second;
-            if (read.remainingCnt == 0) {
+        auto it = std::find_if(reads_.begin(), reads_.end(), [address](const ReadSlot& read) {
+            return read.active && read.address == address;
+        });
+        if (it != reads_.end()) {
+            if (now_ >= it->finish) {
                 // Ready
-                return read.value;
+                return it->value;
             } else {
                 // Waiting to be fetched
                 return std::nullopt;
@@ -47,41 +74,174 @@ namespace tiny::t86 {
 
         if (!isBusy()) {
             // Start reading
-            assert(reads_.find(address) == reads_.end());
-            assert(writes_.find(address) == writes_.end() && "You should not read from address that is being written to");
-            reads_[address] = ReadEntry{readLatency(address), mem_.at(address)};
+            assert(std::none_of(writes_.begin(), writes_.end(), [address](const WriteEntry& write) {
+                return write.address == address;
+            }) && "You should not read from address that is being written to");
+            auto slot = std::find_if(reads_.begin(), reads_.end(), [](const ReadSlot& read) {
+                return !read.active;
+            });
+            *slot = ReadSlot{address, now_ + readLatency(address), get(address), true};
+            ++activeReads_;
+            schedule(slot->finish, false, slot - reads_.begin());
+            ++changes_;
         }
 
         return std::nullopt;
     }
 
     bool RAM::isBusy() const {
-        return reads_.size() == gatesCnt_;
+        return activeReads_ == gatesCnt_;
     }
 
     RAM::WriteId RAM::write(std::size_t address, int64_t value) {
-        mem_.at(address) = value;
+        writablePage(address)[address % pageSize] = value;
         WriteId id = writeIdCounter++;
-        if (auto it = writes_.find(address); it != writes_.end()) {
-            writesById_.erase(it->second.id);
+        ++changes_;
+        WriteEntry entry{id, address, now_ + writeLatency(address)};
+        auto it = std::find_if(writes_.begin(), writes_.end(), [address](const WriteEntry& write) {
+            return write.address == address;
+        });
+        if (it != writes_.end()) {
+            // The previous write to the same address is no longer tracked
+            *it = entry;
+        } else {
+            writes_.push_back(entry);
         }
-        writesById_.insert(std::make_pair(id, std::cref(writes_[address] = WriteEntry{id, writeLatency(address), value})));
+        schedule(entry.finish, true, id);
         return id;
     }
 
+    std::size_t RAM::idleTicks() const {
+        std::size_t result = std::numeric_limits<std::size_t>::max();
+        // A finished write is removed in the next tick
+        for (const auto& write : writes_) {
+            result = std::min<std::size_t>(result, write.finish - now_);
+        }
+        // A read can be used in the tick it finishes
+        for (const auto& read : reads_) {
+            if (read.active) {
+                std::size_t remaining = read.finish > now_ ? read.finish - now_ : 0;
+                result = std::min(result, remaining == 0 ? 0 : remaining - 1);
+            }
+        }
+        return result;
+    }
+
+    void RAM::skipTicks(std::size_t ticks) {
+        assert(ticks <= idleTicks());
+        // Nothing is removed in the skipped ticks, so their buckets are empty
+        now_ += ticks;
+    }
+
+    void RAM::settle() {
+        for (auto& read : reads_) {
+            read.active = false;
+        }
+        activeReads_ = 0;
+        writes_.clear();
+        for (auto& bucket : wheel_) {
+            bucket.clear();
+        }
+        ++changes_;
+    }
+
     int64_t RAM::get(std::size_t address) const {
-        return mem_.at(address);
+        if (address >= size_) {
+            throw std::out_of_range("Address outside of the RAM");
+        }
+        const auto& page = pages_[address / pageSize];
+        return page ? (*page)[address % pageSize] : 0;
     }
 
     void RAM::set(std::size_t address, int64_t value) {
-        mem_.at(address) = value;
+        writablePage(address)[address % pageSize] = value;
+    }
+
+    void RAM::load(std::span<const int64_t> values) {
+        if (values.size() > size_) {
+            throw std::out_of_range("The values do not fit into the RAM");
+        }
+        for (std::size_t begin = 0; begin < values.size(); begin += pageSize) {
+            auto chunk = values.subspan(begin, std::min(pageSize, values.size() - begin));
+            if (!pages_[begin / pageSize] && std::all_of(chunk.begin(), chunk.end(), [](int64_t value) {
+                return value == 0;
+            })) {
+                continue;
+            }
+            std::copy(chunk.begin(), chunk.end(), writablePage(begin).begin());
+        }
+    }
+
+    void RAM::map(std::size_t address, std::span<const int64_t> values, std::shared_ptr<const void> owner) {
+        if (values.size() > size_ || address > size_ - values.size()) {
+            throw std::out_of_range("The values do not fit into the RAM");
+        }
+        for (std::size_t done = 0; done < values.size();) {
+            std::size_t offset = (address + done) % pageSize;
+            auto chunk = values.subspan(done, std::min(pageSize - offset, values.size() - done));
+            std::size_t index = (address + done) / pageSize;
+            if (chunk.size() == pageSize) {
+                // Not owned, so the page is copied before it is written
+                pages_[index] = std::shared_ptr<Page>(owner, const_cast<Page*>(reinterpret_cast<const Page*>(chunk.data())));
+                owned_[index] = false;
+            } else {
+                std::copy(chunk.begin(), chunk.end(), writablePage(address + done).begin() + offset);
+            }
+            done += chunk.size();
+        }
+    }
+
+    RAM::Page& RAM::writablePage(std::size_t address) {
+        if (address >= size_) {
+            throw std::out_of_range("Address outside of the RAM");
+        }
+        std::size_t index = address / pageSize;
+        if (!pages_[index]) {
+            pages_[index] = std::make_shared<Page>();
+            owned_[index] = true;
+        } else if (!owned_[index]) {
+            pages_[index] = std::make_shared<Page>(*pages_[index]);
+            owned_[index] = true;
+        }
+        return *pages_[index];
+    }
+
+    void RAM::share(RAM& other) {
+        assert(other.size_ == size_);
+        pages_ = other.pages_;
+        owned_.assign(pages_.size(), false);
+        other.owned_.assign(pages_.size(), false);
+    }
+
+    RAM::Image RAM::image() const {
+        owned_.assign(pages_.size(), false);
+        return Image{size_, {pages_.begin(), pages_.end()}};
+    }
+
+    void RAM::restore(const Image& image) {
+        assert(image.size == size_ && image.pages.size() == pages_.size());
+        for (std::size_t i = 0; i < pages_.size(); ++i) {
+            // Not owned, so the page is copied before it is written
+            pages_[i] = std::const_pointer_cast<Page>(image.pages[i]);
+        }
+        owned_.assign(pages_.size(), false);
+    }
+
+    std::size_t RAM::ownedPages() const {
+        std::size_t result = 0;
+        for (std::size_t i = 0; i < pages_.size(); ++i) {
+            result += pages_[i] && owned_[i];
+        }
+        return result;
     }
 
     std::size_t RAM::size() const {
-        return mem_.size();
+        return size_;
     }
 
     bool RAM::pending(RAM::WriteId id) const {
-        return writesById_.find(id) != writesById_.end();
+        return std::any_of(writes_.begin(), writes_.end(), [id](const WriteEntry& write) {
+            return write.id == id;
+        });
     }
 }
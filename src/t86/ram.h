@@ -2,19 +2,52 @@
 
 #include <array>
 #include <optional>
-#include <list>
 #include <vector>
 #include <cstdint>
-#include <unordered_map>
-#include <functional>
+#include <memory>
+#include <span>
+
+#include "ram_latency.h"
 
 namespace tiny::t86 {
+    /**
+     * Memory of the cpu together with the timing of its reads and writes.
+     * The values are stored in pages, which can be shared with the files
+     * mapped into the RAM and the RAMs of forked cpus. A shared page is never
+     * written, the RAM that writes it first takes its own copy. A page is only
+     * allocated when it is first written, the pages that were not are read as
+     * zeros. Only the table of the pages is allocated up front, so a large RAM
+     * costs about as much as the memory the program touches.
+     */
     class RAM {
     public:
         using WriteId = size_t;
 
+        /// Words in one page of the memory
+        static constexpr std::size_t pageSize = 512;
+
+        using Page = std::array<int64_t, pageSize>;
+
+        /// Values of a RAM held by sharing its pages, see image.
+        struct Image {
+            std::size_t size{0};
+            /// Null for the pages that were never written
+            std::vector<std::shared_ptr<const Page>> pages;
+        };
+
         RAM(std::size_t memSize, std::size_t gatesCnt);
 
+        /// Replaces the latencies, the accesses in progress keep theirs.
+        void setLatencyPolicy(std::shared_ptr<const RamLatencyPolicy> policy);
+
+        const std::shared_ptr<const RamLatencyPolicy>& latencyPolicy() const {
+            return latency_;
+        }
+
+        std::size_t gatesCount() const {
+            return gatesCnt_;
+        }
+
         void tick();
 
         std::size_t readLatency(std::size_t address) const;
@@ -31,35 +64,116 @@ namespace tiny::t86 {
 
         bool pending(WriteId id) const;
 
+        /// Number of changes of the state so far, not counting the latencies
+        /// that tick down. Used to recognize ticks in which nothing happens.
+        std::size_t changes() const {
+            return changes_;
+        }
+
+        /// Number of following ticks in which only the latencies tick down,
+        /// max value if there is nothing in progress.
+        std::size_t idleTicks() const;
+
+        /// Does the given number of idle ticks at once.
+        void skipTicks(std::size_t ticks);
+
+        /// Forgets the reads and writes in progress. The memory already holds
+        /// the written values, used when the cpu leaves the cycle model.
+        void settle();
+
     public: /// These functions should be used only for debug purposes
         int64_t get(std::size_t address) const;
 
         void set(std::size_t address, int64_t value);
 
+        /// Replaces the values from address 0 on, throws std::out_of_range if they do not fit.
+        /// The zeros are not copied into the pages that were not allocated yet.
+        void load(std::span<const int64_t> values);
+
+        /// Puts the values at the address, throws std::out_of_range if they do not fit.
+        /// The whole pages of them are shared instead of copied and are never written,
+        /// the owner keeps the values alive as long as any RAM uses them.
+        void map(std::size_t address, std::span<const int64_t> values, std::shared_ptr<const void> owner);
+
+        /// Takes the values of the other RAM of the same size by sharing its pages,
+        /// neither of them writes the pages afterwards. The other RAM is only
+        /// modified by this, its values stay the same.
+        void share(RAM& other);
+
+        /// Takes the values by sharing the pages, so nothing is copied. The RAM
+        /// copies a page before it writes it again, the values of the image stay.
+        Image image() const;
+
+        /// Replaces the values by the ones of the image of a RAM of the same size,
+        /// sharing its pages.
+        void restore(const Image& image);
+
+        /// Allocated pages this RAM may write without copying them first.
+        std::size_t ownedPages() const;
+
     private:
+        /// Schedules the removal of a finished access.
+        void schedule(uint64_t finish, bool write, std::size_t slotOrId);
+
         WriteId writeIdCounter {0};
 
-        // TODO changeable mem size
-        std::vector<int64_t> mem_;
+        /// Page of the address that can be written, allocates a missing one and copies a shared one.
+        /// Throws std::out_of_range for an address outside of the memory.
+        Page& writablePage(std::size_t address);
+
+        std::size_t size_;
+
+        // Null for the pages that were never written
+        std::vector<std::shared_ptr<Page>> pages_;
+
+        // Pages that are not shared with a file or another RAM, taking an image shares them
+        mutable std::vector<bool> owned_;
+
         // TODO changeable gates count
         std::size_t gatesCnt_;
 
-        struct ReadEntry {
-            std::size_t remainingCnt;
-            int64_t value;
+        std::shared_ptr<const RamLatencyPolicy> latency_;
+
+        // Ticks done so far, the accesses remember the tick they finish in
+        uint64_t now_{0};
+
+        // Reads in progress, one slot per gate
+        struct ReadSlot {
+            std::size_t address{0};
+            uint64_t finish{0};
+            int64_t value{0};
+            bool active{false};
         };
 
+        std::vector<ReadSlot> reads_;
+
+        std::size_t activeReads_{0};
+
         struct WriteEntry {
             WriteId id;
-            std::size_t remainingCnt;
-            int64_t value;
+            std::size_t address;
+            uint64_t finish;
+        };
+
+        // At most one write per address, only a few of them at once
+        std::vector<WriteEntry> writes_;
+
+        /**
+         * Timing wheel of removals of finished accesses, the bucket of
+         * a tick is now_ modulo the wheel size. Removals further away than
+         * the size of the wheel wait in their bucket until their tick comes.
+         */
+        struct Removal {
+            uint64_t tick;
+            bool write;
+            // Read slot index or write id
+            std::size_t slotOrId;
         };
 
-        std::unordered_map<size_t, ReadEntry> reads_;
+        static constexpr std::size_t wheelSize = 64;
 
-        std::unordered_map<size_t, WriteEntry> writes_;
+        std::vector<std::vector<Removal>> wheel_;
 
-        // Helper lookup map by id
-        std::unordered_map<WriteId, std::reference_wrapper<const WriteEntry>> writesById_;
+        std::size_t changes_{0};
     };
 }
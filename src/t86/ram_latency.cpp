@@ -0,0 +1,32 @@
+#include "ram_latency.h"
+
+#include <stdexcept>
+#include <utility>
+
+namespace tiny::t86 {
+    BankedRamLatency::BankedRamLatency(std::vector<Bank> banks) : banks_(std::move(banks)) {
+        if (banks_.empty()) {
+            throw std::invalid_argument("Banked RAM needs at least one bank");
+        }
+    }
+
+    std::size_t RegionRamLatency::readLatency(std::size_t address) const {
+        const Region* region = find(address);
+        return region ? region->read : fallback_.readLatency(address);
+    }
+
+    std::size_t RegionRamLatency::writeLatency(std::size_t address) const {
+        const Region* region = find(address);
+        return region ? region->write : fallback_.writeLatency(address);
+    }
+
+    const RegionRamLatency::Region* RegionRamLatency::find(std::size_t address) const {
+        // There are only a few regions, the first one that matches wins
+        for (const auto& region : regions_) {
+            if (address >= region.begin && address < region.end) {
+                return &region;
+            }
+        }
+        return nullptr;
+    }
+}
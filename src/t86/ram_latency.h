@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace tiny::t86 {
+    /// Decides how many ticks an access to an address takes.
+    class RamLatencyPolicy {
+    public:
+        virtual ~RamLatencyPolicy() = default;
+
+        virtual std::size_t readLatency(std::size_t address) const = 0;
+
+        virtual std::size_t writeLatency(std::size_t address) const = 0;
+    };
+
+    /// Every address takes the same time.
+    class UniformRamLatency : public RamLatencyPolicy {
+    public:
+        static constexpr std::size_t defaultLatency = 5;
+
+        UniformRamLatency(std::size_t readLatency = defaultLatency, std::size_t writeLatency = defaultLatency)
+            : read_(readLatency), write_(writeLatency) {}
+
+        std::size_t readLatency(std::size_t) const override {
+            return read_;
+        }
+
+        std::size_t writeLatency(std::size_t) const override {
+            return write_;
+        }
+
+    private:
+        std::size_t read_;
+
+        std::size_t write_;
+    };
+
+    /// Consecutive addresses are interleaved over banks, each bank with its own latencies.
+    class BankedRamLatency : public RamLatencyPolicy {
+    public:
+        struct Bank {
+            std::size_t read;
+            std::size_t write;
+        };
+
+        /// There has to be at least one bank.
+        explicit BankedRamLatency(std::vector<Bank> banks);
+
+        std::size_t readLatency(std::size_t address) const override {
+            return banks_[address % banks_.size()].read;
+        }
+
+        std::size_t writeLatency(std::size_t address) const override {
+            return banks_[address % banks_.size()].write;
+        }
+
+    private:
+        std::vector<Bank> banks_;
+    };
+
+    /// Ranges of addresses with their own latencies, like memory attached
+    /// to different nodes. Addresses outside of all regions use the fallback.
+    class RegionRamLatency : public RamLatencyPolicy {
+    public:
+        struct Region {
+            // Half open range of addresses
+            std::size_t begin;
+            std::size_t end;
+            std::size_t read;
+            std::size_t write;
+        };
+
+        RegionRamLatency(std::vector<Region> regions, UniformRamLatency fallback = {})
+            : regions_(std::move(regions)), fallback_(fallback) {}
+
+        std::size_t readLatency(std::size_t address) const override;
+
+        std::size_t writeLatency(std::size_t address) const override;
+
+    private:
+        const Region* find(std::size_t address) const;
+
+        std::vector<Region> regions_;
+
+        UniformRamLatency fallback_;
+    };
+}
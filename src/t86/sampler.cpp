@@ -0,0 +1,75 @@
+#include "sampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace tiny::t86 {
+    Sampler::Sampler(Cpu& cpu, Options options) : cpu_(cpu), options_(options) {
+        if (options.window == 0 || options.warmup + options.window > options.period) {
+            throw std::invalid_argument("The sample window and its warm-up must fit into the sampling period");
+        }
+    }
+
+    void Sampler::runUntil(std::size_t retired) {
+        // Interrupts are only for the debugger, there is none
+        while (!cpu_.halted() && cpu_.retiredInstructions() < retired) {
+            cpu_.tick();
+        }
+    }
+
+    Sampler::Estimate Sampler::run() {
+        StatsLogger& stats = cpu_.stats();
+        Estimate estimate;
+        double sum = 0;
+        double sumOfSquares = 0;
+        std::size_t fastForwarded = 0;
+        cpu_.setFunctionalWarming(true);
+        // Every period starts with the detailed window, so even a short program gets a sample
+        while (!cpu_.halted()) {
+            cpu_.setMode(Cpu::Mode::Cycle);
+            std::size_t start = stats.tickCount();
+            runUntil(cpu_.retiredInstructions() + options_.warmup);
+            std::size_t measuredTicks = stats.tickCount();
+            std::size_t measuredInstructions = cpu_.retiredInstructions();
+            runUntil(measuredInstructions + options_.window);
+            std::size_t instructions = cpu_.retiredInstructions() - measuredInstructions;
+            if (instructions != 0) {
+                double sample = static_cast<double>(stats.tickCount() - measuredTicks) / instructions;
+                sum += sample;
+                sumOfSquares += sample * sample;
+                ++estimate.samples;
+            }
+            estimate.detailedTicks += stats.tickCount() - start;
+            std::size_t skipped = options_.period - options_.warmup - options_.window;
+            if (cpu_.halted() || skipped == 0) {
+                // Without anything to skip, the pipeline is not squashed between the windows
+                continue;
+            }
+
+            cpu_.setMode(Cpu::Mode::Functional);
+            std::size_t before = cpu_.retiredInstructions();
+            runUntil(before + skipped);
+            fastForwarded += cpu_.retiredInstructions() - before;
+        }
+        cpu_.setFunctionalWarming(false);
+
+        estimate.instructions = cpu_.retiredInstructions();
+        if (fastForwarded == 0) {
+            // Everything ran in the cycle model, the ticks are known exactly
+            estimate.ticks = static_cast<double>(estimate.detailedTicks);
+            estimate.ticksPerInstruction = estimate.instructions == 0 ? 0 : estimate.ticks / estimate.instructions;
+            return estimate;
+        }
+        double n = static_cast<double>(estimate.samples);
+        double mean = sum / n;
+        estimate.ticksPerInstruction = mean;
+        estimate.ticks = mean * estimate.instructions;
+        if (estimate.samples > 1) {
+            double variance = std::max(0.0, (sumOfSquares - n * mean * mean) / (n - 1));
+            // 1.96 standard errors of the mean on each side
+            estimate.confidence = 1.96 * std::sqrt(variance / n) * estimate.instructions;
+        }
+        return estimate;
+    }
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+
+#include "cpu.h"
+
+namespace tiny::t86 {
+    /**
+     * Estimates the ticks of a long run from short detailed windows, in the
+     * way of SMARTS. Most of the program runs on the functional engine, which
+     * keeps the branch predictor trained. Every `period` instructions the cpu
+     * switches to the cycle model. The first `warmup` instructions fill the
+     * pipeline and are not measured. The ticks of the next `window`
+     * instructions give one sample of the ticks per instruction.
+     *
+     * The total is the mean of the samples times the number of instructions,
+     * with a 95% confidence interval from the spread of the samples.
+     */
+    class Sampler {
+    public:
+        struct Options {
+            std::size_t period{1'000'000};
+            std::size_t window{10'000};
+            std::size_t warmup{2'000};
+        };
+
+        struct Estimate {
+            /// Instructions the whole program retired
+            std::size_t instructions{0};
+            std::size_t samples{0};
+            /// Ticks done in the cycle model, warm-ups included
+            std::size_t detailedTicks{0};
+            double ticksPerInstruction{0};
+            double ticks{0};
+            /// Half of the width of the 95% confidence interval of ticks
+            double confidence{0};
+        };
+
+        /// Throws std::invalid_argument if the window and warm-up do not fit into the period.
+        Sampler(Cpu& cpu, Options options);
+
+        /// Runs the program started on the cpu until it halts.
+        Estimate run();
+
+    private:
+        /// Ticks until the cpu halts or retires the given number of instructions in total.
+        void runUntil(std::size_t retired);
+
+        Cpu& cpu_;
+
+        Options options_;
+    };
+}
@@ -0,0 +1,231 @@
+#include "snapshot.h"
+
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include "t86-parser/parser.h"
+
+namespace tiny::t86 {
+    namespace {
+        constexpr char magic[8] = {'T', '8', '6', 'S', 'N', 'A', 'P', '\0'};
+
+        /// The RAM of the file starts at a multiple of this, so that its pages can be shared
+        constexpr uint64_t pageSize = RAM::pageSize * sizeof(int64_t);
+
+        /// Special registers stored after the normal ones: PC, SP, BP and flags
+        constexpr std::size_t specialRegisters = 4;
+
+        std::optional<uint64_t> parseNumber(std::string_view text) {
+            uint64_t value;
+            auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+            if (error != std::errc{} || end != text.data() + text.size()) {
+                return std::nullopt;
+            }
+            return value;
+        }
+    }
+
+    /// All the fields are 64 bit, so that the layout is the same everywhere
+    struct Snapshot::Header {
+        char magic[8];
+        uint64_t version;
+        uint64_t registerCount;
+        uint64_t floatRegisterCount;
+        uint64_t debugRegisterCount;
+        uint64_t ramSize;
+        /// Pages stored, their indices follow the registers
+        uint64_t pageCount;
+        uint64_t retiredInstructions;
+        uint64_t ramOffset;
+        uint64_t textOffset;
+        uint64_t textSize;
+
+        /// Words of the registers stored right after the header
+        uint64_t registerWords() const {
+            return registerCount + specialRegisters + floatRegisterCount + debugRegisterCount;
+        }
+    };
+
+    Snapshot::Trigger Snapshot::Trigger::parse(const std::string& text) {
+        std::string_view value = text;
+        Trigger trigger;
+        if (value.starts_with("pc:")) {
+            trigger.kind = Kind::ProgramCounter;
+            value.remove_prefix(3);
+        } else if (value.starts_with("tick:")) {
+            value.remove_prefix(5);
+        }
+        auto number = parseNumber(value);
+        if (!number) {
+            throw std::invalid_argument(fmt::format("Unknown snapshot point `{}`, expected `tick:N` or `pc:N`", text));
+        }
+        trigger.value = *number;
+        return trigger;
+    }
+
+    void Snapshot::save(const Cpu& cpu, const std::string& path) {
+        Cpu::Checkpoint checkpoint = cpu.checkpoint();
+        std::string text = ".text\n";
+        for (std::size_t i = 0; i < cpu.textSize(); ++i) {
+            text += cpu.getText(i).toString() + "\n";
+        }
+
+        Header header{};
+        std::memcpy(header.magic, magic, sizeof(magic));
+        header.version = version;
+        header.registerCount = checkpoint.registers.size();
+        header.floatRegisterCount = checkpoint.floatRegisters.size();
+        header.debugRegisterCount = checkpoint.debugRegisters.size();
+        const auto& pages = checkpoint.memory.pages;
+        // The pages that were never written and the ones written back to zeros are not stored
+        std::vector<uint64_t> index;
+        for (std::size_t i = 0; i < pages.size(); ++i) {
+            if (pages[i] && std::any_of(pages[i]->begin(), pages[i]->end(), [](int64_t value) { return value != 0; })) {
+                index.push_back(i);
+            }
+        }
+        header.ramSize = checkpoint.memory.size;
+        header.pageCount = index.size();
+        header.retiredInstructions = checkpoint.retiredInstructions;
+        uint64_t indexEnd = sizeof(Header) + (header.registerWords() + header.pageCount) * sizeof(int64_t);
+        header.ramOffset = (indexEnd + pageSize - 1) / pageSize * pageSize;
+        header.textOffset = header.ramOffset + header.pageCount * pageSize;
+        header.textSize = text.size();
+
+        std::vector<int64_t> registers(checkpoint.registers);
+        registers.push_back(checkpoint.programCounter);
+        registers.push_back(checkpoint.stackPointer);
+        registers.push_back(checkpoint.stackBasePointer);
+        registers.push_back(checkpoint.flags);
+        for (double value : checkpoint.floatRegisters) {
+            registers.push_back(std::bit_cast<int64_t>(value));
+        }
+        for (uint64_t value : checkpoint.debugRegisters) {
+            registers.push_back(static_cast<int64_t>(value));
+        }
+
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(registers.data()), registers.size() * sizeof(int64_t));
+        file.write(reinterpret_cast<const char*>(index.data()), index.size() * sizeof(uint64_t));
+        std::vector<char> padding(header.ramOffset - indexEnd, 0);
+        file.write(padding.data(), padding.size());
+        for (uint64_t page : index) {
+            file.write(reinterpret_cast<const char*>(pages[page]->data()), pageSize);
+        }
+        file.write(text.data(), text.size());
+        file.close();
+        if (!file) {
+            throw std::runtime_error(fmt::format("Could not write the snapshot `{}`", path));
+        }
+    }
+
+    Snapshot::Snapshot(const std::string& path) : file_(std::make_shared<MappedFile>(path, 1)) {
+        // The magic and the version come first, so that the layout of other versions is never read
+        if (file_->size() < sizeof(magic) + sizeof(uint64_t) || std::memcmp(file_->data(), magic, sizeof(magic)) != 0) {
+            throw std::runtime_error(fmt::format("`{}` is not a T86 snapshot", path));
+        }
+        uint64_t fileVersion;
+        std::memcpy(&fileVersion, file_->data() + sizeof(magic), sizeof(fileVersion));
+        if (fileVersion != version) {
+            throw std::runtime_error(fmt::format("The snapshot `{}` has version {}, expected {}", path, fileVersion, version));
+        }
+        std::size_t size = file_->size();
+        if (size < sizeof(Header)) {
+            throw std::runtime_error(fmt::format("The snapshot `{}` is damaged", path));
+        }
+        const Header& h = header();
+        // The sizes are checked by division, so that a broken header cannot overflow
+        bool valid = h.ramOffset % pageSize == 0
+            && h.ramOffset >= sizeof(Header)
+            && h.ramOffset <= size
+            && h.registerWords() <= (h.ramOffset - sizeof(Header)) / sizeof(int64_t)
+            && h.pageCount <= (h.ramOffset - sizeof(Header)) / sizeof(int64_t) - h.registerWords()
+            && h.pageCount <= (size - h.ramOffset) / pageSize
+            && h.textOffset == h.ramOffset + h.pageCount * pageSize
+            && h.textSize == size - h.textOffset;
+        if (valid) {
+            // The indices grow and are pages of the RAM
+            uint64_t previous = 0;
+            for (int64_t value : pageIndex()) {
+                auto page = static_cast<uint64_t>(value);
+                valid = valid && (page >= previous) && page < (h.ramSize + RAM::pageSize - 1) / RAM::pageSize;
+                previous = page + 1;
+            }
+        }
+        if (!valid) {
+            throw std::runtime_error(fmt::format("The snapshot `{}` is damaged", path));
+        }
+    }
+
+    const Snapshot::Header& Snapshot::header() const {
+        return *reinterpret_cast<const Header*>(file_->data());
+    }
+
+    std::span<const int64_t> Snapshot::pageIndex() const {
+        const Header& h = header();
+        return file_->words(sizeof(Header) + h.registerWords() * sizeof(int64_t), h.pageCount);
+    }
+
+    std::size_t Snapshot::registersCount() const {
+        return header().registerCount;
+    }
+
+    std::size_t Snapshot::floatRegistersCount() const {
+        return header().floatRegisterCount;
+    }
+
+    std::size_t Snapshot::ramSize() const {
+        return header().ramSize;
+    }
+
+    std::size_t Snapshot::retiredInstructions() const {
+        return header().retiredInstructions;
+    }
+
+    Program Snapshot::program() const {
+        std::istringstream text(std::string(file_->data() + header().textOffset, header().textSize));
+        Parser parser(text);
+        return parser.Parse();
+    }
+
+    void Snapshot::restore(Cpu& cpu) const {
+        const Header& h = header();
+        auto registers = file_->words(sizeof(Header), h.registerWords());
+        auto next = registers.begin();
+        Cpu::Checkpoint checkpoint;
+        checkpoint.registers.assign(next, next + h.registerCount);
+        next += h.registerCount;
+        checkpoint.programCounter = *next++;
+        checkpoint.stackPointer = *next++;
+        checkpoint.stackBasePointer = *next++;
+        checkpoint.flags = *next++;
+        for (std::size_t i = 0; i < h.floatRegisterCount; ++i) {
+            checkpoint.floatRegisters.push_back(std::bit_cast<double>(*next++));
+        }
+        for (std::size_t i = 0; i < h.debugRegisterCount; ++i) {
+            checkpoint.debugRegisters.push_back(static_cast<uint64_t>(*next++));
+        }
+        checkpoint.retiredInstructions = h.retiredInstructions;
+        // The pages of the RAM are the pages of the file until they are written
+        checkpoint.memory.size = h.ramSize;
+        checkpoint.memory.pages.resize((h.ramSize + RAM::pageSize - 1) / RAM::pageSize);
+        auto index = pageIndex();
+        for (std::size_t i = 0; i < index.size(); ++i) {
+            auto page = reinterpret_cast<const RAM::Page*>(file_->data() + h.ramOffset + i * pageSize);
+            checkpoint.memory.pages[static_cast<uint64_t>(index[i])] = std::shared_ptr<const RAM::Page>(file_, page);
+        }
+
+        cpu.start(program());
+        cpu.restore(checkpoint);
+    }
+}
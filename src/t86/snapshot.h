@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+
+#include "cpu.h"
+#include "mapped_file.h"
+#include "program.h"
+
+namespace tiny::t86 {
+    /**
+     * Architectural state of a stopped VM stored in a binary file: the
+     * registers, the RAM and the text with the instructions patched by the
+     * debugger. The state of the pipeline is not stored, the cycle model
+     * starts with it empty, as after a flush.
+     *
+     * The file begins with a fixed header followed by the registers and the
+     * index of the stored pages of the RAM. Only the pages that are not all
+     * zeros are stored, the others are zeros again when restored, so the file
+     * grows with the memory the program touched and not with the size of the
+     * RAM. The stored pages start at a page boundary, so the file is mapped
+     * into the memory when it is loaded and the pages of the RAM are the pages
+     * of the mapping, copied only when the program writes them.
+     * The text follows the pages in the T86 text format.
+     */
+    class Snapshot {
+    public:
+        static constexpr uint64_t version = 2;
+
+        /// When a running program is saved, see OS::SaveSnapshotAt.
+        struct Trigger {
+            enum class Kind {
+                /// After the given number of ticks of the run
+                Tick,
+                /// Before the instruction at the given address executes
+                ProgramCounter,
+            };
+
+            Kind kind{Kind::Tick};
+            uint64_t value{0};
+
+            /// Parses `tick:N`, `pc:N` or `N`, which is a tick.
+            /// Throws std::invalid_argument on anything else.
+            static Trigger parse(const std::string& text);
+        };
+
+        /// Stores the retired state of the cpu into the file, the cpu must not have
+        /// instructions in flight, see Cpu::squash. Throws std::runtime_error if the
+        /// file cannot be written.
+        static void save(const Cpu& cpu, const std::string& path);
+
+        /// Maps the file into the memory. Throws std::runtime_error if the file
+        /// cannot be read or is not a snapshot of this version.
+        explicit Snapshot(const std::string& path);
+
+        std::size_t registersCount() const;
+
+        std::size_t floatRegistersCount() const;
+
+        std::size_t ramSize() const;
+
+        std::size_t retiredInstructions() const;
+
+        /// The text as it was when saved, without the data, which is already in the RAM.
+        Program program() const;
+
+        /// Starts the program of the snapshot on the cpu and continues from the
+        /// saved state. Throws std::invalid_argument if the sizes of the cpu differ.
+        void restore(Cpu& cpu) const;
+
+    private:
+        struct Header;
+
+        const Header& header() const;
+
+        /// Pages of the RAM stored in the file, in the order of the pages.
+        std::span<const int64_t> pageIndex() const;
+
+        /// Shared with the RAMs restored from it
+        std::shared_ptr<const MappedFile> file_;
+    };
+}
@@ -0,0 +1,56 @@
+#include "event_columns.h"
+
+#include <cassert>
+
+namespace tiny::t86 {
+    void EventColumns::append(std::size_t kind, std::size_t tick, std::size_t id, std::size_t arg) {
+        Column& column = columns_[kind];
+        if (column.blocks.empty() || column.blocks.back().count == blockSize) {
+            column.blocks.push_back(Block{column.bytes.size(), 0});
+            column.lastTick = 0;
+            column.lastId = 0;
+        }
+        assert(tick >= column.lastTick);
+        writeVarint(column.bytes, tick - column.lastTick);
+        writeVarint(column.bytes, zigzag(static_cast<int64_t>(id - column.lastId)));
+        writeVarint(column.bytes, arg);
+        column.lastTick = tick;
+        column.lastId = id;
+        ++column.blocks.back().count;
+    }
+
+    void EventColumns::clear() {
+        for (Column& column : columns_) {
+            column.bytes.clear();
+            column.blocks.clear();
+            column.lastTick = 0;
+            column.lastId = 0;
+        }
+    }
+
+    std::size_t EventColumns::size() const {
+        std::size_t size = 0;
+        for (const Column& column : columns_) {
+            for (const Block& block : column.blocks) {
+                size += block.count;
+            }
+        }
+        return size;
+    }
+
+    std::size_t EventColumns::memoryUsage() const {
+        std::size_t bytes = 0;
+        for (const Column& column : columns_) {
+            bytes += column.bytes.capacity() + column.blocks.capacity() * sizeof(Block);
+        }
+        return bytes;
+    }
+
+    void EventColumns::writeVarint(std::vector<uint8_t>& bytes, uint64_t value) {
+        while (value >= 0x80) {
+            bytes.push_back(static_cast<uint8_t>(value) | 0x80);
+            value >>= 7;
+        }
+        bytes.push_back(static_cast<uint8_t>(value));
+    }
+}
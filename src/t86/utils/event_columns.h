@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace tiny::t86 {
+    /**
+     * Event stream of a whole run stored column by column, one column
+     * per kind of event. Each event is the tick it happened in, the id
+     * of the instruction and an argument (register or address), stored
+     * as varint encoded deltas from the previous event in the column.
+     * Ticks only grow and the ids in a column stay close to each other,
+     * so most events take three bytes.
+     *
+     * Every blockSize events a column starts a new block whose deltas
+     * are counted from zero again. The blocks can be decoded independently,
+     * which lets the analysis split the run between threads.
+     */
+    class EventColumns {
+    public:
+        static constexpr std::size_t blockSize = 1 << 16;
+
+        explicit EventColumns(std::size_t kinds) : columns_(kinds) {}
+
+        void append(std::size_t kind, std::size_t tick, std::size_t id, std::size_t arg = 0);
+
+        void clear();
+
+        /// Number of events in all the columns.
+        std::size_t size() const;
+
+        /// Bytes taken by the encoded events.
+        std::size_t memoryUsage() const;
+
+        std::size_t kinds() const {
+            return columns_.size();
+        }
+
+        std::size_t blockCount(std::size_t kind) const {
+            return columns_[kind].blocks.size();
+        }
+
+        /// Calls callback(tick, id, arg) for every event in the block, in the order they were logged.
+        template<typename F>
+        void forEachInBlock(std::size_t kind, std::size_t block, F&& callback) const;
+
+        /// Calls callback(tick, id, arg) for every event of the kind, in the order they were logged.
+        template<typename F>
+        void forEach(std::size_t kind, F&& callback) const {
+            for (std::size_t block = 0; block < blockCount(kind); ++block) {
+                forEachInBlock(kind, block, callback);
+            }
+        }
+
+    private:
+        struct Block {
+            // Offset of the first event in bytes
+            std::size_t offset;
+            std::size_t count;
+        };
+
+        struct Column {
+            std::vector<uint8_t> bytes;
+            std::vector<Block> blocks;
+            // Values of the last appended event, the next one is a delta from them
+            std::size_t lastTick{0};
+            std::size_t lastId{0};
+        };
+
+        static void writeVarint(std::vector<uint8_t>& bytes, uint64_t value);
+
+        static uint64_t readVarint(const uint8_t*& data) {
+            uint64_t value = 0;
+            for (unsigned shift = 0;; shift += 7) {
+                uint8_t byte = *data++;
+                value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+                if ((byte & 0x80) == 0) {
+                    return value;
+                }
+            }
+        }
+
+        /// Maps small negative deltas to small unsigned numbers.
+        static uint64_t zigzag(int64_t value) {
+            return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+        }
+
+        static int64_t unzigzag(uint64_t value) {
+            return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+        }
+
+        std::vector<Column> columns_;
+    };
+
+    template<typename F>
+    void EventColumns::forEachInBlock(std::size_t kind, std::size_t block, F&& callback) const {
+        const Column& column = columns_[kind];
+        const Block& b = column.blocks[block];
+        const uint8_t* data = column.bytes.data() + b.offset;
+        std::size_t tick = 0;
+        std::size_t id = 0;
+        for (std::size_t i = 0; i < b.count; ++i) {
+            tick += readVarint(data);
+            id += unzigzag(readVarint(data));
+            std::size_t arg = readVarint(data);
+            callback(tick, id, arg);
+        }
+    }
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace tiny::t86 {
+    /// Calls body(i, worker) for every i below count on at most the given
+    /// number of threads, each thread takes the next index once it is done
+    /// with the last one. The worker is the index of the calling thread,
+    /// below min(threads, count), the calling thread itself is worker 0.
+    template<typename F>
+    void parallelFor(std::size_t count, std::size_t threads, F&& body) {
+        std::atomic<std::size_t> next{0};
+        auto work = [&](std::size_t worker) {
+            for (std::size_t i = next++; i < count; i = next++) {
+                body(i, worker);
+            }
+        };
+        std::vector<std::thread> workers;
+        for (std::size_t t = 1; t < std::min(threads, count); ++t) {
+            workers.emplace_back(work, t);
+        }
+        work(0);
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+}
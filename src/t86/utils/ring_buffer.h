@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace tiny::t86 {
+    /**
+     * FIFO queue stored in a contiguous buffer that wraps around.
+     * Unlike std::list or std::deque it does not allocate once it
+     * has grown to the largest size it is used with. If it gets full,
+     * the capacity is doubled.
+     */
+    template<typename T>
+    class RingBuffer {
+    public:
+        explicit RingBuffer(std::size_t capacity = 8) : buffer_(capacity == 0 ? 1 : capacity) {}
+
+        void push_back(T value) {
+            if (size_ == buffer_.size()) {
+                grow();
+            }
+            buffer_[(head_ + size_) % buffer_.size()] = std::move(value);
+            ++size_;
+        }
+
+        void pop_front() {
+            assert(size_ > 0);
+            head_ = (head_ + 1) % buffer_.size();
+            --size_;
+        }
+
+        void pop_back() {
+            assert(size_ > 0);
+            --size_;
+        }
+
+        T& front() {
+            assert(size_ > 0);
+            return buffer_[head_];
+        }
+
+        const T& front() const {
+            assert(size_ > 0);
+            return buffer_[head_];
+        }
+
+        T& back() {
+            assert(size_ > 0);
+            return (*this)[size_ - 1];
+        }
+
+        const T& back() const {
+            assert(size_ > 0);
+            return (*this)[size_ - 1];
+        }
+
+        /// Element at i-th position from the front.
+        T& operator[](std::size_t i) {
+            assert(i < size_);
+            return buffer_[(head_ + i) % buffer_.size()];
+        }
+
+        const T& operator[](std::size_t i) const {
+            assert(i < size_);
+            return buffer_[(head_ + i) % buffer_.size()];
+        }
+
+        void clear() {
+            head_ = 0;
+            size_ = 0;
+        }
+
+        std::size_t size() const { return size_; }
+
+        bool empty() const { return size_ == 0; }
+
+        std::size_t capacity() const { return buffer_.size(); }
+
+    private:
+        void grow() {
+            std::vector<T> bigger(buffer_.size() * 2);
+            for (std::size_t i = 0; i < size_; ++i) {
+                bigger[i] = std::move((*this)[i]);
+            }
+            buffer_ = std::move(bigger);
+            head_ = 0;
+        }
+
+        std::vector<T> buffer_;
+
+        std::size_t head_{0};
+
+        std::size_t size_{0};
+    };
+}
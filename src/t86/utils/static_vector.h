@@ -0,0 +1,89 @@
+#pragma once
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <initializer_list>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace tiny::t86 {
+    /**
+     * Vector with fixed capacity that keeps its elements inline, so
+     * it never touches the heap. Used for the handful of operands and
+     * products an instruction can have.
+     * Only trivially copyable types are allowed, which keeps copying
+     * the whole thing a plain memcpy.
+     */
+    template<typename T, std::size_t N>
+    class StaticVector {
+        static_assert(std::is_trivially_copyable_v<T>, "StaticVector is only for trivially copyable types");
+    public:
+        StaticVector() = default;
+
+        StaticVector(std::initializer_list<T> values) {
+            for (const auto& value : values) {
+                push_back(value);
+            }
+        }
+
+        template<typename It>
+        StaticVector(It begin, It end) {
+            for (; begin != end; ++begin) {
+                push_back(*begin);
+            }
+        }
+
+        void push_back(const T& value) {
+            assert(size_ < N && "StaticVector capacity exceeded");
+            new (&storage_[size_ * sizeof(T)]) T(value);
+            ++size_;
+        }
+
+        template<typename... Args>
+        T& emplace_back(Args&&... args) {
+            assert(size_ < N && "StaticVector capacity exceeded");
+            T* ptr = new (&storage_[size_ * sizeof(T)]) T(std::forward<Args>(args)...);
+            ++size_;
+            return *ptr;
+        }
+
+        void clear() {
+            size_ = 0;
+        }
+
+        std::size_t size() const { return size_; }
+
+        bool empty() const { return size_ == 0; }
+
+        static constexpr std::size_t capacity() { return N; }
+
+        T* data() { return std::launder(reinterpret_cast<T*>(storage_.data())); }
+
+        const T* data() const { return std::launder(reinterpret_cast<const T*>(storage_.data())); }
+
+        T& operator[](std::size_t i) {
+            assert(i < size_);
+            return data()[i];
+        }
+
+        const T& operator[](std::size_t i) const {
+            assert(i < size_);
+            return data()[i];
+        }
+
+        T* begin() { return data(); }
+
+        T* end() { return data() + size_; }
+
+        const T* begin() const { return data(); }
+
+        const T* end() const { return data() + size_; }
+
+    private:
+        alignas(T) std::array<std::byte, N * sizeof(T)> storage_;
+
+        std::size_t size_{0};
+    };
+}
@@ -1,23 +1,27 @@
 #include "stats_logger.h"
 
+#include "trace_writer.h"
 #include "../instruction.h"
+#include "parallel_for.h"
 
 #include <algorithm>
 #include <iostream>
 #include <cassert>
+#include <stdexcept>
+#include <thread>
 #include <unordered_map>
 
 namespace tiny::t86 {
     void StatsLogger::logInstructionFetch(std::size_t id) {
-        currentTick().instructionFetchPc = id;
+        logEvent(Event::Fetch, id);
     }
 
     void StatsLogger::logInstructionDecode(std::size_t id) {
-        currentTick().instructionDecodePc = id;
+        logEvent(Event::Decode, id);
     }
 
     void StatsLogger::logStallRetirement(std::size_t id) {
-        currentTick().stallRetirementRSEntries.push_back(id);
+        logEvent(Event::StallRetirement, id);
     }
 
     StatsLogger& StatsLogger::instance() {
@@ -25,58 +29,116 @@ namespace tiny::t86 {
         return instance;
     }
 
+    StatsLogger::StatsLogger() = default;
+
+    StatsLogger::~StatsLogger() {
+        setTraceWriter(nullptr);
+    }
+
+    void StatsLogger::setTraceWriter(std::unique_ptr<TraceWriter> writer) {
+        if (trace_) {
+            trace_->finish(tickCount_);
+        }
+        trace_ = std::move(writer);
+    }
+
     void StatsLogger::logNoAluAvailable(std::size_t id) {
-        currentTick().stallNoAluRSEntries.push_back(id);
+        logEvent(Event::StallNoAlu, id);
+    }
+
+    StatsLogger::Level StatsLogger::parseLevel(const std::string& name) {
+        if (name == "off") {
+            return Level::Off;
+        }
+        if (name == "counters") {
+            return Level::Counters;
+        }
+        if (name == "full") {
+            return Level::Full;
+        }
+        throw std::invalid_argument("Unknown stats level `" + name + "`, expected `off`, `counters` or `full`");
+    }
+
+    void StatsLogger::setLevel(Level level) {
+        level_ = level;
+        reset();
     }
 
     void StatsLogger::newTick() {
-        ticks_.emplace_back();
+        ++tickCount_;
+        if (trace_) {
+            trace_->newTick(tickCount_ - 1);
+        }
+        lastTickEvents_.clear();
+        if (level_ == Level::Counters) {
+            // Retired instructions stay until now, their jumps are logged after the retirement
+            while (!inFlight_.empty() && inFlight_.front().done) {
+                inFlight_.pop_front();
+                ++firstInFlight_;
+            }
+        }
+    }
+
+    void StatsLogger::repeatTick(std::size_t times) {
+        std::size_t firstTick = tickCount_;
+        tickCount_ += times;
+        if (level_ == Level::Full) {
+            for (std::size_t i = 0; i < times; ++i) {
+                for (const EventRecord& record : lastTickEvents_) {
+                    events_.append(static_cast<std::size_t>(record.event), firstTick + i, record.id, record.arg);
+                }
+            }
+        } else if (level_ == Level::Counters) {
+            for (const EventRecord& record : lastTickEvents_) {
+                inFlight(record.id).totals.add(record.event, times);
+            }
+        }
     }
 
-    std::size_t StatsLogger::tickCount() const {
-        return ticks_.size();
+    StatsLogger::LifeTimeTotals StatsLogger::retiredTotals() {
+        LifeTimeTotals totals;
+        for (const auto& [pc, retired] : collectRetired()) {
+            totals += retired.totals;
+        }
+        return totals;
     }
 
     void StatsLogger::processBasicStats(std::ostream& os) {
-        std::size_t totalTicks = ticks_.size();
-        std::size_t totalInstructions = instructions_.size();
-        std::unordered_map<std::size_t, InstructionLifeTime> lifetimes;
-        std::map<Instruction::Signature, std::pair<InstructionLifeTime, std::size_t>> lifetimesBySignature;
-        InstructionLifeTime accumulativeInstructionLifeTime;
-        for (const auto& [id, ins] : instructions_) {
-            InstructionLifeTime lt = getInstructionLifeTime(id);
-            accumulativeInstructionLifeTime += lt;
-            lifetimes.emplace(id, lt);
-            auto& signatureEntry = lifetimesBySignature[instructions_.at(id).second->getSignature()];
-            signatureEntry.first += lt;
-            signatureEntry.second += 1;
-        }
+        std::size_t totalTicks = tickCount_;
+        std::size_t totalInstructions = instructionsCount_;
+        LifeTimeTotals accumulativeInstructionLifeTime = retiredTotals();
         os << "------------------------------------------\n";
         os << "Total ticks: " << totalTicks << std::endl;
-        os << "Total instructions executed: " << instructions_.size() << std::endl;
-        double throughput = static_cast<double>(instructions_.size()) / totalTicks;
+        os << "Total instructions executed: " << totalInstructions << std::endl;
+        double throughput = static_cast<double>(totalInstructions) / totalTicks;
         os << "Throughput: " << throughput << " instructions per tick\n";
         os << "Average instruction latency: " << 1 / throughput << " ticks\n";
+        os << "Branch mispredictions: " << mispredictions_ << std::endl;
+        std::size_t flushTicks = 0;
+        for (const auto& [pc, branch] : branches_) {
+            flushTicks += branch.flushTicks;
+        }
+        os << "Ticks lost to mispredictions: " << flushTicks << std::endl;
+        os << "Pipeline flushes: " << flushes_ << std::endl;
         os << "Global averages:\n";
         processAverageLifetime(os, accumulativeInstructionLifeTime, totalInstructions);
         std::cerr << std::flush;
     }
 
     void StatsLogger::processDetailedStats(std::ostream& os) {
-        [[maybe_unused]] std::size_t totalTicks = ticks_.size();
-        [[maybe_unused]] std::size_t totalInstructions = instructions_.size();
-        std::unordered_map<std::size_t, InstructionLifeTime> lifetimes;
-        std::map<Instruction::Signature, std::pair<InstructionLifeTime, std::size_t>> lifetimesBySignature;
-        InstructionLifeTime accumulativeInstructionLifeTime;
-        for (const auto& [id, ins] : instructions_) {
-            InstructionLifeTime lt = getInstructionLifeTime(id);
-            accumulativeInstructionLifeTime += lt;
-            lifetimes.emplace(id, lt);
-            auto& signatureEntry = lifetimesBySignature[instructions_.at(id).second->getSignature()];
-            signatureEntry.first += lt;
-            signatureEntry.second += 1;
+        std::map<Instruction::Signature, std::pair<LifeTimeTotals, std::size_t>> lifetimesBySignature;
+        for (const auto& [pc, retired] : collectRetired()) {
+            auto& signatureEntry = lifetimesBySignature[retired.instruction->getSignature()];
+            signatureEntry.first += retired.totals;
+            signatureEntry.second += retired.count;
         }
         os << "------------------------------------------\n";
+        for (const auto& [pc, branch] : branches_) {
+            double accuracy = 100.0 * (branch.count - branch.mispredictions) / branch.count;
+            os << "Jump at " << pc << ": " << branch.count << " retired, " << branch.mispredictions
+               << " mispredicted (" << accuracy << "% accuracy), " << branch.flushTicks
+               << " ticks lost to mispredictions\n";
+        }
         for (const auto& [signature, entry] : lifetimesBySignature) {
             const auto& [lt, count] = entry;
             os << "Averages for " << signature.toString() << ":\n";
@@ -84,73 +146,188 @@ namespace tiny::t86 {
         }
     }
 
+    std::unordered_map<std::size_t, StatsLogger::RetiredCounters> StatsLogger::collectRetired() {
+        if (level_ != Level::Full) {
+            return retiredByPc_;
+        }
+        std::size_t pcCount = 0;
+        for (const InstructionRecord& record : instructions_) {
+            pcCount = std::max(pcCount, record.pc + 1);
+        }
+        std::vector<LifeTimeTotals> totals = sumEventsByPc(pcCount);
+        std::unordered_map<std::size_t, RetiredCounters> retired;
+        for (const InstructionRecord& record : instructions_) {
+            if (record.cleared) {
+                continue;
+            }
+            RetiredCounters& counters = retired[record.pc];
+            counters.instruction = record.instruction;
+            counters.totals = totals[record.pc];
+            ++counters.count;
+        }
+        return retired;
+    }
+
+    std::vector<StatsLogger::LifeTimeTotals> StatsLogger::sumEventsByPc(std::size_t pcCount) const {
+        std::vector<std::pair<std::size_t, std::size_t>> blocks;
+        for (std::size_t kind = 0; kind < events_.kinds(); ++kind) {
+            for (std::size_t block = 0; block < events_.blockCount(kind); ++block) {
+                blocks.emplace_back(kind, block);
+            }
+        }
+        std::size_t threads = processingThreads_ != 0 ? processingThreads_ : std::thread::hardware_concurrency();
+        threads = std::clamp<std::size_t>(threads, 1, std::max<std::size_t>(blocks.size(), 1));
+
+        std::vector<std::vector<LifeTimeTotals>> partial(threads, std::vector<LifeTimeTotals>(pcCount));
+        parallelFor(blocks.size(), threads, [&](std::size_t i, std::size_t worker) {
+            auto [kind, block] = blocks[i];
+            Event event = static_cast<Event>(kind);
+            events_.forEachInBlock(kind, block, [&](std::size_t, std::size_t id, std::size_t) {
+                const InstructionRecord& record = instructions_[id];
+                if (!record.cleared) {
+                    partial[worker][record.pc].add(event);
+                }
+            });
+        });
+        for (std::size_t t = 1; t < threads; ++t) {
+            for (std::size_t pc = 0; pc < pcCount; ++pc) {
+                partial[0][pc] += partial[t][pc];
+            }
+        }
+        return std::move(partial[0]);
+    }
+
     void StatsLogger::reset() {
-        ticks_.clear();
+        tickCount_ = 0;
+        nextId_ = 0;
+        inFlight_.clear();
+        firstInFlight_ = 0;
+        lastTickEvents_.clear();
+        retiredByPc_.clear();
+        events_.clear();
         instructions_.clear();
-        id_ = 0;
+        instructionsCount_ = 0;
+        mispredictions_ = 0;
+        branches_.clear();
+        flushes_ = 0;
     }
 
-    StatsLogger::TickStats& StatsLogger::currentTick() {
-        return ticks_.back();
+    void StatsLogger::resetTotals() {
+        assert(level_ != Level::Full);
+        tickCount_ = 0;
+        lastTickEvents_.clear();
+        retiredByPc_.clear();
+        mispredictions_ = 0;
+        branches_.clear();
+        flushes_ = 0;
+        instructionsCount_ = 0;
+        // The instructions in the pipeline keep the ticks they spent in it, the
+        // part of the run that counted them before retired none of them
+        for (std::size_t i = 0; i < inFlight_.size(); ++i) {
+            InFlight& record = inFlight_[i];
+            record.firstTick = 0;
+            if (!record.done) {
+                ++instructionsCount_;
+            }
+        }
+    }
+
+    void StatsLogger::merge(const StatsLogger& other) {
+        assert(level_ != Level::Full && other.level_ != Level::Full);
+        tickCount_ += other.tickCount_;
+        instructionsCount_ += other.instructionsCount_;
+        mispredictions_ += other.mispredictions_;
+        flushes_ += other.flushes_;
+        for (const auto& [pc, branch] : other.branches_) {
+            BranchStats& merged = branches_[pc];
+            merged.count += branch.count;
+            merged.mispredictions += branch.mispredictions;
+            merged.flushTicks += branch.flushTicks;
+        }
+        for (const auto& [pc, retired] : other.retiredByPc_) {
+            RetiredCounters& merged = retiredByPc_[pc];
+            merged.instruction = retired.instruction;
+            merged.totals += retired.totals;
+            merged.count += retired.count;
+        }
+    }
+
+    void StatsLogger::logBranch(std::size_t id, bool mispredicted) {
+        if (level_ == Level::Off) {
+            return;
+        }
+        std::size_t pc;
+        std::size_t firstTick;
+        if (level_ == Level::Full) {
+            const InstructionRecord& record = instructions_.at(id);
+            pc = record.pc;
+            firstTick = record.firstTick;
+        } else {
+            const InFlight& record = inFlight(id);
+            pc = record.pc;
+            firstTick = record.firstTick;
+        }
+        BranchStats& branch = branches_[pc];
+        ++branch.count;
+        if (mispredicted) {
+            ++mispredictions_;
+            ++branch.mispredictions;
+            branch.flushTicks += tickCount_ - firstTick;
+        }
+    }
+
+    void StatsLogger::logFlush() {
+        if (level_ != Level::Off) {
+            ++flushes_;
+        }
+        if (trace_) {
+            trace_->flushed(currentTick());
+        }
     }
 
     void StatsLogger::logOperandFetching(std::size_t id) {
-        currentTick().operandFetchingRSEntries.push_back(id);
+        logEvent(Event::OperandFetching, id);
     }
 
     void StatsLogger::logStallFetch(std::size_t id) {
-        currentTick().operandFetchingStallRSEntries.push_back(id);
+        logEvent(Event::StallFetch, id);
     }
 
     void StatsLogger::logStallRegisterFetch(std::size_t id, Register reg) {
-        currentTick().stallRegisterFetchRSEntries[id].insert(reg);
+        logEvent(Event::StallRegisterFetch, id, reg.index());
     }
 
     void StatsLogger::logStallFloatRegisterFetch(std::size_t id, FloatRegister fReg) {
-        currentTick().stallFloatRegisterFetchRSEntries[id].insert(fReg);
+        logEvent(Event::StallFloatRegisterFetch, id, fReg.index());
     }
 
     void StatsLogger::logStallRAMRead(std::size_t id, std::size_t address) {
-        currentTick().stallRAMReadRSEntries[id].insert(address);
+        logEvent(Event::StallRAMRead, id, address);
     }
 
     void StatsLogger::logExecuting(std::size_t id) {
-        currentTick().executingRSEntries.push_back(id);
+        logEvent(Event::Executing, id);
     }
 
     void StatsLogger::logRetirement(std::size_t id) {
-        currentTick().retiredRSEntries.push_back(id);
+        logEvent(Event::Retirement, id);
     }
 
-    void StatsLogger::processAverageLifetime(std::ostream& os, const StatsLogger::InstructionLifeTime& lt, std::size_t totalCount) {
+    void StatsLogger::processAverageLifetime(std::ostream& os, const StatsLogger::LifeTimeTotals& lt, std::size_t totalCount) {
         os << "  Times executed: " << totalCount << '\n'
            << "  Average instruction lifetime: " << static_cast<double>(lt.totalTime()) / totalCount << " ticks\n"
            << "    Average fetch stalls: " << static_cast<double>(lt.fetch - 1) / totalCount << " ticks\n"
            << "    Average decode stalls: " << static_cast<double>(lt.decode - 1) / totalCount << " ticks\n"
            << "    Average operand fetching stalls: " << static_cast<double>(lt.fetchingStalls) / totalCount << " ticks\n";
 
-        std::size_t totalWaitingForRegisters = 0;
-        for (const auto& [reg, count] : lt.waitingForRegisterFetch) {
-            totalWaitingForRegisters += count;
+        if (lt.registerFetchStalls != 0) {
+            os << "      Average register fetch stalls: " << static_cast<double>(lt.registerFetchStalls) / totalCount << " ticks\n";
         }
-        if (totalWaitingForRegisters != 0) {
-            os << "      Average register fetch stalls: " << static_cast<double>(totalWaitingForRegisters) / totalCount << " ticks\n";
-        }
-
-        std::size_t totalWaitingForFloatRegisters = 0;
-        for (const auto& [reg, count] : lt.waitingForFloatRegisterFetch) {
-            totalWaitingForFloatRegisters += count;
-        }
-        if (totalWaitingForFloatRegisters != 0) {
-            os << "      Average float register fetch stalls: " << static_cast<double>(totalWaitingForFloatRegisters) / totalCount << " ticks\n";
-        }
-
-        std::size_t totalWaitingForMemory = 0;
-        for (const auto& [address, count] : lt.waitingForMemoryRead) {
-            totalWaitingForMemory += count;
+        if (lt.floatRegisterFetchStalls != 0) {
+            os << "      Average float register fetch stalls: " << static_cast<double>(lt.floatRegisterFetchStalls) / totalCount << " ticks\n";
         }
-        if (totalWaitingForMemory != 0) {
-            os << "      Average memory read stalls: " << static_cast<double>(totalWaitingForMemory) / totalCount << " ticks\n";
+        if (lt.memoryReadStalls != 0) {
+            os << "      Average memory read stalls: " << static_cast<double>(lt.memoryReadStalls) / totalCount << " ticks\n";
         }
 
         os << "    Average waiting for ALU: " << static_cast<double>(lt.waitingForAlu) / totalCount << " ticks\n"
@@ -160,70 +337,100 @@ namespace tiny::t86 {
     }
 
     std::size_t StatsLogger::registerNewInstruction(std::size_t pc, const Instruction* instruction) {
-        instructions_.emplace(id_, std::make_pair(pc, instruction));
-        return id_++;
+        std::size_t id = nextId_++;
+        // The fetch is logged in the current tick
+        std::size_t firstTick = currentTick();
+        if (trace_) {
+            trace_->instructionFetched(firstTick, id, pc, instruction);
+        }
+        if (level_ == Level::Full) {
+            assert(id == instructions_.size());
+            instructions_.push_back(InstructionRecord{pc, instruction, firstTick, false});
+            ++instructionsCount_;
+        } else if (level_ == Level::Counters) {
+            assert(id == firstInFlight_ + inFlight_.size());
+            inFlight_.push_back(InFlight{pc, instruction, firstTick, LifeTimeTotals{}, false});
+            ++instructionsCount_;
+        }
+        return id;
     }
 
     void StatsLogger::logClearSpeculation(std::size_t id) {
-        instructions_.erase(id);
-    }
-
-    StatsLogger::InstructionLifeTime StatsLogger::getInstructionLifeTime(std::size_t id) {
-        InstructionLifeTime lifeTime;
-        auto it = ticks_.cbegin();
-        // Skip to where the instruction appears for the first time
-        while(it != ticks_.end() && it->instructionFetchPc != id) {
-            ++it;
-        }
-        assert(it != ticks_.end());
-        while(it != ticks_.end() && it->instructionFetchPc == id) {
-            ++lifeTime.fetch;
-            ++it;
-        }
-        while(it != ticks_.end() && it->instructionDecodePc == id) {
-            ++lifeTime.decode;
-            ++it;
-        }
-        while(it != ticks_.end() &&
-              // Please, C++20 be here soon, so I can just replace this with contains
-              std::find(it->operandFetchingRSEntries.begin(), it->operandFetchingRSEntries.end(), id) != it->operandFetchingRSEntries.end()) {
-            ++lifeTime.preparing;
-            if (std::find(it->operandFetchingStallRSEntries.begin(), it->operandFetchingStallRSEntries.end(), id) != it->operandFetchingStallRSEntries.end()) {
-                ++lifeTime.fetchingStalls;
-            }
-            if (auto rsIt = it->stallRegisterFetchRSEntries.find(id); rsIt != it->stallRegisterFetchRSEntries.end()) {
-                for (Register reg : rsIt->second) {
-                    ++lifeTime.waitingForRegisterFetch[reg];
-                }
-            }
-            if (auto frsIt = it->stallFloatRegisterFetchRSEntries.find(id); frsIt != it->stallFloatRegisterFetchRSEntries.end()) {
-                for (FloatRegister fReg : frsIt->second) {
-                    ++lifeTime.waitingForFloatRegisterFetch[fReg];
-                }
+        if (trace_) {
+            trace_->squashed(currentTick(), id);
+        }
+        if (level_ == Level::Full) {
+            if (id < instructions_.size() && !instructions_[id].cleared) {
+                instructions_[id].cleared = true;
+                --instructionsCount_;
             }
-            if (auto memIt = it->stallRAMReadRSEntries.find(id); memIt != it->stallRAMReadRSEntries.end()) {
-                for (std::size_t address : memIt->second) {
-                    ++lifeTime.waitingForMemoryRead[address];
-                }
+        } else if (level_ == Level::Counters) {
+            if (id >= firstInFlight_ && id < firstInFlight_ + inFlight_.size() && !inFlight(id).done) {
+                inFlight(id).done = true;
+                --instructionsCount_;
             }
-            ++it;
         }
-        while(it != ticks_.end() &&
-              std::find(it->stallNoAluRSEntries.begin(), it->stallNoAluRSEntries.end(), id) != it->stallNoAluRSEntries.end()) {
-            ++lifeTime.waitingForAlu;
-            ++it;
+    }
+
+    void StatsLogger::logEvent(Event event, std::size_t id, std::size_t arg) {
+        if (trace_) {
+            trace_->event(currentTick(), event, id);
         }
-        while(it != ticks_.end() && std::find(it->executingRSEntries.begin(), it->executingRSEntries.end(), id) != it->executingRSEntries.end()) {
-            ++lifeTime.executing;
-            ++it;
+        if (level_ == Level::Full) {
+            events_.append(static_cast<std::size_t>(event), currentTick(), id, arg);
+            lastTickEvents_.push_back(EventRecord{event, id, arg});
+        } else if (level_ == Level::Counters) {
+            countEvent(event, id);
+            lastTickEvents_.push_back(EventRecord{event, id, arg});
         }
-        while(it != ticks_.end() && std::find(it->stallRetirementRSEntries.begin(), it->stallRetirementRSEntries.end(), id) != it->stallRetirementRSEntries.end()) {
-            ++lifeTime.waitingForRetirement;
-            ++it;
+    }
+
+    StatsLogger::InFlight& StatsLogger::inFlight(std::size_t id) {
+        assert(id >= firstInFlight_ && id - firstInFlight_ < inFlight_.size());
+        return inFlight_[id - firstInFlight_];
+    }
+
+    void StatsLogger::countEvent(Event event, std::size_t id) {
+        InFlight& record = inFlight(id);
+        record.totals.add(event);
+        if (event == Event::Retirement) {
+            // Kept until the next tick for logBranch
+            record.done = true;
+            RetiredCounters& retired = retiredByPc_[record.pc];
+            retired.instruction = record.instruction;
+            retired.totals += record.totals;
+            ++retired.count;
         }
-        assert(it != ticks_.end());
-        assert(std::find(it->retiredRSEntries.begin(), it->retiredRSEntries.end(), id) != it->retiredRSEntries.end());
-        ++lifeTime.retirement;
-        return lifeTime;
+    }
+
+    void StatsLogger::LifeTimeTotals::add(Event event, std::size_t ticks) {
+        switch (event) {
+            case Event::Fetch: fetch += ticks; break;
+            case Event::Decode: decode += ticks; break;
+            case Event::OperandFetching: preparing += ticks; break;
+            case Event::StallFetch: fetchingStalls += ticks; break;
+            case Event::StallRegisterFetch: registerFetchStalls += ticks; break;
+            case Event::StallFloatRegisterFetch: floatRegisterFetchStalls += ticks; break;
+            case Event::StallRAMRead: memoryReadStalls += ticks; break;
+            case Event::StallNoAlu: waitingForAlu += ticks; break;
+            case Event::Executing: executing += ticks; break;
+            case Event::StallRetirement: waitingForRetirement += ticks; break;
+            case Event::Retirement: retirement += ticks; break;
+        }
+    }
+
+    StatsLogger::LifeTimeTotals& StatsLogger::LifeTimeTotals::operator += (const LifeTimeTotals& other) {
+        fetch += other.fetch;
+        decode += other.decode;
+        preparing += other.preparing;
+        fetchingStalls += other.fetchingStalls;
+        registerFetchStalls += other.registerFetchStalls;
+        floatRegisterFetchStalls += other.floatRegisterFetchStalls;
+        memoryReadStalls += other.memoryReadStalls;
+        waitingForAlu += other.waitingForAlu;
+        executing += other.executing;
+        waitingForRetirement += other.waitingForRetirement;
+        retirement += other.retirement;
+        return *this;
     }
 }
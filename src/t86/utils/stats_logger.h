@@ -5,22 +5,77 @@
 #include <map>
 #include <optional>
 #include <unordered_map>
+#include <cstdint>
+#include <memory>
+#include <string>
 
 #include "../cpu/register.h"
+#include "event_columns.h"
+#include "ring_buffer.h"
 
 namespace tiny::t86 {
     // Forward declare instruction
     class Instruction;
+    class TraceWriter;
 
     class StatsLogger {
     public:
+        /// The logger of the cpus created without their own context.
         static StatsLogger& instance();
 
+        StatsLogger();
+
+        ~StatsLogger();
+
+        /**
+         * How much the logger remembers about the run.
+         * Off only counts the ticks, Counters keeps aggregates per instruction
+         * and per stall reason whose size does not depend on the length
+         * of the run, Full keeps every event of every tick.
+         */
+        enum class Level : uint8_t {
+            Off,
+            Counters,
+            Full,
+        };
+
+        /// Parses `off`, `counters` or `full`.
+        static Level parseLevel(const std::string& name);
+
+        /// Changes the level and resets the stats.
+        void setLevel(Level level);
+
+        Level level() const {
+            return level_;
+        }
+
+        /// Whether the events need to be logged at all.
+        bool enabled() const {
+            return level_ != Level::Off || trace_ != nullptr;
+        }
+
+        /// Streams the lifetimes of the instructions to the writer, at any level.
+        /// The previous writer, if any, is finished. Pass nullptr to finish the trace.
+        void setTraceWriter(std::unique_ptr<TraceWriter> writer);
+
         // Resets all the stats, should be called before every new run
         void reset();
 
+        /// Forgets the stats so far as if the run started now with the
+        /// instructions already in the pipeline, at the counters or off level.
+        /// Their lifetimes stay whole once they retire. Used to leave out
+        /// the warm-up of a run that starts from a checkpoint.
+        void resetTotals();
+
+        /// Adds the stats of another run of the same program, at the counters or off level.
+        void merge(const StatsLogger& other);
+
         void newTick();
 
+        /// Logs the last tick again the given number of times, used
+        /// when the cpu skips ticks in which nothing changes.
+        void repeatTick(std::size_t times);
+
         std::size_t registerNewInstruction(std::size_t pc, const Instruction* instruction);
 
         void logInstructionFetch(std::size_t id);
@@ -50,85 +105,191 @@ namespace tiny::t86 {
 
         void logClearSpeculation(std::size_t id);
 
-        std::size_t tickCount() const;
+        /// The jump retired, mispredicted if it went elsewhere than its
+        /// fetch predicted.
+        void logBranch(std::size_t id, bool mispredicted);
 
-        void processBasicStats(std::ostream& os);
+        /// All the speculatively fetched instructions were thrown away,
+        /// after a misprediction, an interrupt or a single step.
+        void logFlush();
 
-        void processDetailedStats(std::ostream& os);
+        std::size_t mispredictionCount() const {
+            return mispredictions_;
+        }
+
+        std::size_t flushCount() const {
+            return flushes_;
+        }
+
+        struct BranchStats {
+            std::size_t count{0};
+            std::size_t mispredictions{0};
+            // Ticks from fetching the mispredicted jumps until they were
+            // retired, spent on the wrong path
+            std::size_t flushTicks{0};
+        };
 
-        struct TickStats {
-            std::optional<std::size_t> instructionFetchPc;
-            std::optional<std::size_t> instructionDecodePc;
-            std::vector<std::size_t> activeRSEntries;
+        /// Retired jumps by their pc.
+        const std::map<std::size_t, BranchStats>& branchStats() const {
+            return branches_;
+        }
 
-            std::vector<std::size_t> operandFetchingRSEntries;
-            std::vector<std::size_t> operandFetchingStallRSEntries;
-            std::map<std::size_t, std::set<std::size_t>> stallRAMReadRSEntries;
-            std::map<std::size_t, std::set<Register>> stallRegisterFetchRSEntries;
-            std::map<std::size_t, std::set<FloatRegister>> stallFloatRegisterFetchRSEntries;
+        std::size_t tickCount() const {
+            return tickCount_;
+        }
 
-            std::vector<std::size_t> stallNoAluRSEntries;
+        /// Number of fetched instructions, wrongly speculated ones are not counted.
+        std::size_t instructionCount() const {
+            return instructionsCount_;
+        }
 
-            std::vector<std::size_t> executingRSEntries;
+        void processBasicStats(std::ostream& os);
+
+        void processDetailedStats(std::ostream& os);
 
-            std::vector<std::size_t> stallRetirementRSEntries;
-            std::vector<std::size_t> retiredRSEntries;
+        /// What happened to an instruction in the pipeline during a tick.
+        enum class Event : uint8_t {
+            Fetch,
+            Decode,
+            OperandFetching,
+            StallFetch,
+            StallRegisterFetch,
+            StallFloatRegisterFetch,
+            StallRAMRead,
+            StallNoAlu,
+            Executing,
+            StallRetirement,
+            Retirement,
         };
 
-    protected:
-        TickStats& currentTick();
+        static constexpr std::size_t eventKinds = static_cast<std::size_t>(Event::Retirement) + 1;
+
+        struct EventRecord {
+            Event event;
+            std::size_t id;
+            // Register index or address for the stalls, unused otherwise
+            std::size_t arg;
+        };
 
-        struct InstructionLifeTime {
+        /// Ticks spent in each stage of the pipeline, summed over any number of instructions.
+        struct LifeTimeTotals {
             std::size_t fetch{0};
             std::size_t decode{0};
             std::size_t preparing{0};
             std::size_t fetchingStalls{0};
-            std::map<Register, std::size_t> waitingForRegisterFetch;
-            std::map<FloatRegister, std::size_t> waitingForFloatRegisterFetch;
-            std::map<std::size_t, std::size_t> waitingForMemoryRead;
+            std::size_t registerFetchStalls{0};
+            std::size_t floatRegisterFetchStalls{0};
+            std::size_t memoryReadStalls{0};
             std::size_t waitingForAlu{0};
             std::size_t executing{0};
             std::size_t waitingForRetirement{0};
-            std::size_t retirement{0}; // Every retirement will take only one cycle, so this is excess for now, but maybe in future?
+            std::size_t retirement{0};
 
             std::size_t totalTime() const {
                 return fetch + decode + preparing + waitingForAlu + executing + waitingForRetirement + retirement;
             }
 
-            InstructionLifeTime& operator += (const InstructionLifeTime& other) {
-                fetch += other.fetch;
-                decode += other.decode;
-                preparing += other.preparing;
-                fetchingStalls += other.fetchingStalls;
-                for (const auto& [reg, count] : other.waitingForRegisterFetch) {
-                    waitingForRegisterFetch[reg] += count;
-                }
-                for (const auto& [reg, count] : other.waitingForFloatRegisterFetch) {
-                    waitingForFloatRegisterFetch[reg] += count;
-                }
-                for (const auto& [address, count] : other.waitingForMemoryRead) {
-                    waitingForMemoryRead[address] += count;
-                }
-                waitingForAlu += other.waitingForAlu;
-                executing += other.executing;
-                waitingForRetirement += other.waitingForRetirement;
-                retirement += other.retirement;
-                return *this;
-            }
+            /// Counts one tick in the stage the event belongs to.
+            void add(Event event, std::size_t ticks = 1);
+
+            LifeTimeTotals& operator += (const LifeTimeTotals& other);
         };
 
-        InstructionLifeTime getInstructionLifeTime(std::size_t id);
+        /// Ticks the retired instructions spent in each stage, at the counters and full levels.
+        LifeTimeTotals retiredTotals();
+
+        /// Number of threads the stats are processed with, 0 uses all the cores.
+        void setProcessingThreads(std::size_t threads) {
+            processingThreads_ = threads;
+        }
 
-        static void processAverageLifetime(std::ostream& os, const InstructionLifeTime& lt, std::size_t totalCount);
+        /// Bytes taken by the events of the full level.
+        std::size_t eventsMemoryUsage() const {
+            return events_.memoryUsage();
+        }
 
-        StatsLogger() = default;
+    protected:
+        static void processAverageLifetime(std::ostream& os, const LifeTimeTotals& lt, std::size_t totalCount);
+
+        void logEvent(Event event, std::size_t id, std::size_t arg = 0);
+
+        void countEvent(Event event, std::size_t id);
+
+        /// Index of the tick the events are logged in.
+        std::size_t currentTick() const {
+            return tickCount_ == 0 ? 0 : tickCount_ - 1;
+        }
+
+        Level level_{Level::Full};
+
+        std::size_t tickCount_{0};
+
+        std::size_t nextId_{0};
+
+        std::size_t processingThreads_{0};
+
+        std::unique_ptr<TraceWriter> trace_;
+
+        /// Every event of the full level.
+        EventColumns events_{eventKinds};
+
+        /// Events logged in the current tick, so that they can be repeated.
+        std::vector<EventRecord> lastTickEvents_;
+
+        struct InstructionRecord {
+            std::size_t pc;
+            const Instruction* instruction;
+            // Tick in which the instruction was fetched
+            std::size_t firstTick;
+            // Wrongly speculated instructions are not counted
+            bool cleared;
+        };
+
+        // Indexed by the instruction id
+        std::vector<InstructionRecord> instructions_;
+
+        // Number of instructions that were not cleared
+        std::size_t instructionsCount_{0};
+
+        std::size_t mispredictions_{0};
+
+        std::map<std::size_t, BranchStats> branches_;
+
+        std::size_t flushes_{0};
+
+        /// Instruction in the pipeline whose events are counted until it retires.
+        struct InFlight {
+            std::size_t pc;
+            const Instruction* instruction;
+            std::size_t firstTick;
+            LifeTimeTotals totals;
+            bool done;
+        };
+
+        /// The counters level keeps only the instructions in flight,
+        /// indexed by id - firstInFlight_.
+        RingBuffer<InFlight> inFlight_;
+
+        std::size_t firstInFlight_{0};
+
+        InFlight& inFlight(std::size_t id);
+
+        struct RetiredCounters {
+            const Instruction* instruction;
+            LifeTimeTotals totals;
+            std::size_t count{0};
+        };
 
-        std::vector<TickStats> ticks_;
+        /// Lifetimes of the retired instructions at each pc.
+        std::unordered_map<std::size_t, RetiredCounters> retiredByPc_;
 
-        // Each instruction gets its id
-        std::size_t id_{0};
+        /// Lifetimes of the retired instructions at each pc, taken from
+        /// the counters or computed from the events, whichever level is active.
+        std::unordered_map<std::size_t, RetiredCounters> collectRetired();
 
-        // Some ids might be missing, as wrongly speculated ones will be removed
-        std::unordered_map<std::size_t, std::pair<std::size_t, const Instruction*>> instructions_;
+        /// Sums the events of the full level by the pc of their instruction.
+        /// The blocks of the columns are split between threads, each sums
+        /// into its own vector and the vectors are added up at the end.
+        std::vector<LifeTimeTotals> sumEventsByPc(std::size_t pcCount) const;
     };
 }
@@ -0,0 +1,261 @@
+#include "trace_writer.h"
+
+#include "../instruction.h"
+#include "common/helpers.h"
+
+#include <cassert>
+#include <stdexcept>
+
+namespace tiny::t86 {
+    namespace {
+        using Event = StatsLogger::Event;
+
+        bool isOperandStall(Event event) {
+            return event == Event::StallRegisterFetch
+                || event == Event::StallFloatRegisterFetch
+                || event == Event::StallRAMRead;
+        }
+
+        std::string label(std::size_t pc, const Instruction* instruction) {
+            return std::to_string(pc) + ": " + instruction->toString();
+        }
+    }
+
+    std::unique_ptr<TraceWriter> TraceWriter::create(const std::string& format, std::unique_ptr<std::ostream> os) {
+        if (format == "konata") {
+            return std::make_unique<KonataTraceWriter>(std::move(os));
+        }
+        if (format == "chrome") {
+            return std::make_unique<ChromeTraceWriter>(std::move(os));
+        }
+        throw std::invalid_argument("Unknown trace format `" + format + "`, expected `konata` or `chrome`");
+    }
+
+    const char* TraceWriter::stageName(int event) {
+        switch (static_cast<Event>(event)) {
+            case Event::Fetch: return "F";
+            case Event::Decode: return "Dc";
+            case Event::OperandFetching: return "Op";
+            case Event::StallFetch: return "Stall";
+            case Event::StallRegisterFetch: return "Reg";
+            case Event::StallFloatRegisterFetch: return "FReg";
+            case Event::StallRAMRead: return "Mem";
+            case Event::StallNoAlu: return "Alu";
+            case Event::Executing: return "Ex";
+            case Event::StallRetirement: return "Wr";
+            case Event::Retirement: return "Rt";
+        }
+        return "?";
+    }
+
+    void TraceWriter::newTick(std::size_t tick) {
+        // The instructions retired in the last tick leave at its end
+        for (std::size_t id : retiring_) {
+            if (Track* t = track(id); t != nullptr && !t->done) {
+                retire(currentTick_ + 1, *t, false);
+            }
+        }
+        retiring_.clear();
+        // Stalls that were not logged again in the last tick are over
+        for (std::size_t i = 0; i < openStalls_.size();) {
+            Track* t = track(openStalls_[i]);
+            if (t != nullptr && t->stall != -1 && t->stalledThisTick) {
+                t->stalledThisTick = false;
+                ++i;
+                continue;
+            }
+            if (t != nullptr) {
+                closeStall(currentTick_, *t);
+            }
+            openStalls_[i] = openStalls_.back();
+            openStalls_.pop_back();
+        }
+        while (!tracks_.empty() && tracks_.front().done) {
+            tracks_.pop_front();
+            ++firstTrack_;
+        }
+        if (inFlight_ != writtenInFlight_) {
+            writeInFlight(currentTick_ + 1, inFlight_);
+            writtenInFlight_ = inFlight_;
+        }
+        currentTick_ = tick;
+    }
+
+    void TraceWriter::instructionFetched(std::size_t tick, std::size_t id, std::size_t pc, const Instruction* instruction) {
+        if (tracks_.empty()) {
+            firstTrack_ = id;
+        }
+        assert(id == firstTrack_ + tracks_.size());
+        std::size_t slot;
+        if (freeSlots_.empty()) {
+            slot = slotCount_++;
+        } else {
+            slot = freeSlots_.top();
+            freeSlots_.pop();
+        }
+        tracks_.push_back(Track{id, pc, instruction, tick, slot});
+        ++inFlight_;
+        writeInstruction(tick, tracks_.back());
+    }
+
+    void TraceWriter::event(std::size_t tick, StatsLogger::Event event, std::size_t id) {
+        Track* t = track(id);
+        if (t == nullptr || t->done || event == Event::StallFetch) {
+            return;
+        }
+        int kind = static_cast<int>(event);
+        if (isOperandStall(event)) {
+            if (t->stall != kind) {
+                if (t->stall != -1) {
+                    closeStall(tick, *t);
+                } else {
+                    openStalls_.push_back(id);
+                }
+                t->stall = kind;
+                t->stallStart = tick;
+                writeStageStart(tick, *t, 1, stageName(kind));
+            }
+            t->stalledThisTick = true;
+            return;
+        }
+        if (t->stage == kind) {
+            return;
+        }
+        closeStall(tick, *t);
+        closeStage(tick, *t);
+        t->stage = kind;
+        t->stageStart = tick;
+        writeStageStart(tick, *t, 0, stageName(kind));
+        if (event == Event::Retirement) {
+            retiring_.push_back(id);
+        }
+    }
+
+    void TraceWriter::squashed(std::size_t tick, std::size_t id) {
+        if (Track* t = track(id); t != nullptr && !t->done) {
+            retire(tick, *t, true);
+        }
+    }
+
+    void TraceWriter::flushed(std::size_t tick) {
+        writeFlush(tick);
+    }
+
+    void TraceWriter::finish(std::size_t tick) {
+        newTick(tick);
+        for (std::size_t i = 0; i < tracks_.size(); ++i) {
+            Track& t = tracks_[i];
+            if (!t.done) {
+                closeStall(tick, t);
+                closeStage(tick, t);
+            }
+        }
+        writeEnd(tick);
+        os_->flush();
+    }
+
+    TraceWriter::Track* TraceWriter::track(std::size_t id) {
+        if (id < firstTrack_ || id - firstTrack_ >= tracks_.size()) {
+            return nullptr;
+        }
+        return &tracks_[id - firstTrack_];
+    }
+
+    void TraceWriter::closeStall(std::size_t tick, Track& track) {
+        if (track.stall == -1) {
+            return;
+        }
+        writeStageEnd(track.stallStart, tick, track, 1, stageName(track.stall));
+        track.stall = -1;
+        track.stalledThisTick = false;
+    }
+
+    void TraceWriter::closeStage(std::size_t tick, Track& track) {
+        if (track.stage == -1) {
+            return;
+        }
+        writeStageEnd(track.stageStart, tick, track, 0, stageName(track.stage));
+        track.stage = -1;
+    }
+
+    void TraceWriter::retire(std::size_t tick, Track& track, bool squashed) {
+        closeStall(tick, track);
+        closeStage(tick, track);
+        writeRetire(tick, track, squashed);
+        track.done = true;
+        freeSlots_.push(track.slot);
+        --inFlight_;
+    }
+
+    KonataTraceWriter::KonataTraceWriter(std::unique_ptr<std::ostream> os) : TraceWriter(std::move(os)) {
+        *os_ << "Kanata\t0004\n"
+             << "C=\t0\n";
+    }
+
+    void KonataTraceWriter::advance(std::size_t tick) {
+        if (tick > tick_) {
+            *os_ << "C\t" << tick - tick_ << '\n';
+            tick_ = tick;
+        }
+    }
+
+    void KonataTraceWriter::writeInstruction(std::size_t tick, const Track& track) {
+        advance(tick);
+        *os_ << "I\t" << track.id << '\t' << track.id << "\t0\n"
+             << "L\t" << track.id << "\t0\t" << label(track.pc, track.instruction) << '\n';
+    }
+
+    void KonataTraceWriter::writeStageStart(std::size_t tick, const Track& track, int lane, const char* name) {
+        advance(tick);
+        *os_ << "S\t" << track.id << '\t' << lane << '\t' << name << '\n';
+    }
+
+    void KonataTraceWriter::writeStageEnd(std::size_t, std::size_t end, const Track& track, int lane, const char* name) {
+        advance(end);
+        *os_ << "E\t" << track.id << '\t' << lane << '\t' << name << '\n';
+    }
+
+    void KonataTraceWriter::writeRetire(std::size_t tick, const Track& track, bool squashed) {
+        advance(tick);
+        *os_ << "R\t" << track.id << '\t' << (squashed ? 0 : retired_++) << '\t' << (squashed ? 1 : 0) << '\n';
+    }
+
+    ChromeTraceWriter::ChromeTraceWriter(std::unique_ptr<std::ostream> os) : TraceWriter(std::move(os)) {
+        *os_ << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+    }
+
+    std::ostream& ChromeTraceWriter::next() {
+        if (!first_) {
+            *os_ << ",\n";
+        }
+        first_ = false;
+        return *os_;
+    }
+
+    void ChromeTraceWriter::writeStageEnd(std::size_t start, std::size_t end, const Track& track, int lane, const char* name) {
+        next() << "{\"name\":\"" << name << "\",\"cat\":\"" << (lane == 0 ? "stage" : "stall")
+               << "\",\"ph\":\"X\",\"ts\":" << start << ",\"dur\":" << end - start
+               << ",\"pid\":0,\"tid\":" << track.slot << ",\"args\":{\"id\":" << track.id << "}}";
+    }
+
+    void ChromeTraceWriter::writeRetire(std::size_t tick, const Track& track, bool squashed) {
+        next() << "{\"name\":\"" << utils::escape_json(label(track.pc, track.instruction))
+               << "\",\"cat\":\"" << (squashed ? "squashed" : "retired")
+               << "\",\"ph\":\"X\",\"ts\":" << track.firstTick << ",\"dur\":" << tick - track.firstTick
+               << ",\"pid\":0,\"tid\":" << track.slot << ",\"args\":{\"id\":" << track.id
+               << ",\"pc\":" << track.pc << "}}";
+    }
+
+    void ChromeTraceWriter::writeFlush(std::size_t tick) {
+        next() << "{\"name\":\"flush\",\"ph\":\"i\",\"s\":\"p\",\"ts\":" << tick << ",\"pid\":0,\"tid\":0}";
+    }
+
+    void ChromeTraceWriter::writeInFlight(std::size_t tick, std::size_t count) {
+        next() << "{\"name\":\"in flight\",\"ph\":\"C\",\"ts\":" << tick
+               << ",\"pid\":0,\"args\":{\"instructions\":" << count << "}}";
+    }
+
+    void ChromeTraceWriter::writeEnd(std::size_t) {
+        *os_ << "\n]}\n";
+    }
+}
@@ -0,0 +1,184 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <ostream>
+#include <queue>
+#include <string>
+#include <vector>
+
+#include "ring_buffer.h"
+#include "stats_logger.h"
+
+namespace tiny::t86 {
+    class Instruction;
+
+    /**
+     * Streams the lifetimes of the instructions into a file for a pipeline viewer.
+     * The StatsLogger forwards its events here as they are logged. Only
+     * the instructions in flight are remembered, a stage is written out
+     * as soon as the instruction moves to another one, so the trace of
+     * a long run does not need the full stats level.
+     *
+     * The stages are drawn on lane 0, the operand stalls (register,
+     * float register, memory read) on lane 1 below them.
+     */
+    class TraceWriter {
+    public:
+        /// Creates a writer for `konata` or `chrome` format.
+        static std::unique_ptr<TraceWriter> create(const std::string& format, std::unique_ptr<std::ostream> os);
+
+        virtual ~TraceWriter() = default;
+
+        void newTick(std::size_t tick);
+
+        void instructionFetched(std::size_t tick, std::size_t id, std::size_t pc, const Instruction* instruction);
+
+        void event(std::size_t tick, StatsLogger::Event event, std::size_t id);
+
+        /// The instruction was thrown away after a misprediction.
+        void squashed(std::size_t tick, std::size_t id);
+
+        /// The whole pipeline was flushed.
+        void flushed(std::size_t tick);
+
+        /// Closes what is still open and completes the file.
+        void finish(std::size_t tick);
+
+    protected:
+        explicit TraceWriter(std::unique_ptr<std::ostream> os) : os_(std::move(os)) {}
+
+        /// Instruction as the writer sees it.
+        struct Track {
+            std::size_t id;
+            std::size_t pc;
+            const Instruction* instruction;
+            std::size_t firstTick;
+            // Row of the viewer, the lowest one free when it was fetched
+            std::size_t slot;
+            // Events of the open stage and stall, or none
+            int stage{-1};
+            std::size_t stageStart{0};
+            int stall{-1};
+            std::size_t stallStart{0};
+            bool stalledThisTick{false};
+            bool done{false};
+        };
+
+        static const char* stageName(int event);
+
+        virtual void writeInstruction(std::size_t tick, const Track& track) = 0;
+
+        virtual void writeStageStart(std::size_t tick, const Track& track, int lane, const char* name) = 0;
+
+        virtual void writeStageEnd(std::size_t start, std::size_t end, const Track& track, int lane, const char* name) = 0;
+
+        virtual void writeRetire(std::size_t tick, const Track& track, bool squashed) = 0;
+
+        virtual void writeFlush(std::size_t tick) = 0;
+
+        /// Number of instructions in the pipeline changed.
+        virtual void writeInFlight(std::size_t tick, std::size_t count) = 0;
+
+        virtual void writeEnd(std::size_t tick) = 0;
+
+        std::unique_ptr<std::ostream> os_;
+
+    private:
+        Track* track(std::size_t id);
+
+        void closeStall(std::size_t tick, Track& track);
+
+        void closeStage(std::size_t tick, Track& track);
+
+        void retire(std::size_t tick, Track& track, bool squashed);
+
+        // Indexed by id - firstTrack_
+        RingBuffer<Track> tracks_;
+
+        std::size_t firstTrack_{0};
+
+        std::size_t currentTick_{0};
+
+        std::size_t inFlight_{0};
+
+        std::size_t writtenInFlight_{0};
+
+        // Ids with a stall open on lane 1
+        std::vector<std::size_t> openStalls_;
+
+        // Ids that retired in the current tick, they leave the pipeline when it ends
+        std::vector<std::size_t> retiring_;
+
+        std::priority_queue<std::size_t, std::vector<std::size_t>, std::greater<>> freeSlots_;
+
+        std::size_t slotCount_{0};
+    };
+
+    /**
+     * Pipeline log for the Konata viewer (format version 0004).
+     * Every instruction is labeled with its pc and text, retired
+     * and squashed instructions are told apart.
+     */
+    class KonataTraceWriter : public TraceWriter {
+    public:
+        explicit KonataTraceWriter(std::unique_ptr<std::ostream> os);
+
+    protected:
+        void writeInstruction(std::size_t tick, const Track& track) override;
+
+        void writeStageStart(std::size_t tick, const Track& track, int lane, const char* name) override;
+
+        void writeStageEnd(std::size_t start, std::size_t end, const Track& track, int lane, const char* name) override;
+
+        void writeRetire(std::size_t tick, const Track& track, bool squashed) override;
+
+        void writeFlush(std::size_t) override {}
+
+        void writeInFlight(std::size_t, std::size_t) override {}
+
+        void writeEnd(std::size_t) override {}
+
+    private:
+        /// Moves the clock of the log to the tick.
+        void advance(std::size_t tick);
+
+        std::size_t tick_{0};
+
+        std::size_t retired_{0};
+    };
+
+    /**
+     * Chrome trace-event JSON, for chrome://tracing or Perfetto. One tick
+     * is one microsecond. Instructions are drawn in rows that are reused
+     * once they leave the pipeline, so the number of rows in use shows
+     * the pressure on the pipeline. Every instruction is a slice labeled
+     * with its pc and text, with its stages nested in it. The number of
+     * instructions in flight is a counter and the flushes are instant events.
+     */
+    class ChromeTraceWriter : public TraceWriter {
+    public:
+        explicit ChromeTraceWriter(std::unique_ptr<std::ostream> os);
+
+    protected:
+        void writeInstruction(std::size_t, const Track&) override {}
+
+        void writeStageStart(std::size_t, const Track&, int, const char*) override {}
+
+        void writeStageEnd(std::size_t start, std::size_t end, const Track& track, int lane, const char* name) override;
+
+        void writeRetire(std::size_t tick, const Track& track, bool squashed) override;
+
+        void writeFlush(std::size_t tick) override;
+
+        void writeInFlight(std::size_t tick, std::size_t count) override;
+
+        void writeEnd(std::size_t tick) override;
+
+    private:
+        /// Starts a new element of the event array.
+        std::ostream& next();
+
+        bool first_{true};
+    };
+}
@@ -608,6 +608,24 @@ TEST_F(NativeTest, Watchpoints) {
     ASSERT_EQ(std::get<WatchpointTrigger>(e).address, 5);
 }
 
+TEST_F(NativeTest, RemovedWatchpointDoesNotTrigger) {
+    auto program = R"(
+.text
+
+0 MOV [1], 1
+1 MOV [2], 2
+2 HALT
+)";
+    Run(program, 3, 0);
+    native->WaitForDebugEvent();
+
+    native->SetWatchpointWrite(1);
+    native->RemoveWatchpoint(1);
+    native->ContinueExecution();
+
+    ASSERT_TRUE(std::holds_alternative<ExecutionEnd>(native->WaitForDebugEvent()));
+}
+
 TEST_F(NativeTest, RemoveWatchpoints) {
     auto program = R"(
 .text
@@ -938,3 +956,119 @@ TEST_F(NativeTest, StepOutRecursive) {
     native->PerformStepOut();
     ASSERT_EQ(native->GetIP(), 2);
 }
+
+TEST_F(NativeTest, ReverseSingleStep) {
+    auto program = R"(
+.text
+
+0 MOV R0, 1
+1 MOV R1, 2
+2 ADD R0, R1
+3 MOV R2, R0
+4 HALT
+)";
+    Run(program, 3, 0);
+    native->WaitForDebugEvent();
+    ASSERT_TRUE(std::holds_alternative<ExecutionBegin>(native->ReverseSingleStep()));
+    native->PerformSingleStep();
+    native->PerformSingleStep();
+    native->PerformSingleStep();
+    ASSERT_EQ(native->GetRegister("R0"), 3);
+
+    auto e = native->ReverseSingleStep();
+    ASSERT_TRUE(std::holds_alternative<Singlestep>(e));
+    EXPECT_EQ(native->GetIP(), 2);
+    EXPECT_EQ(native->GetRegister("R0"), 1);
+    EXPECT_EQ(native->GetRegister("R1"), 2);
+    native->ReverseSingleStep();
+    EXPECT_EQ(native->GetIP(), 1);
+    EXPECT_EQ(native->GetRegister("R1"), 0);
+
+    native->ContinueExecution();
+    ASSERT_TRUE(std::holds_alternative<ExecutionEnd>(native->WaitForDebugEvent()));
+    EXPECT_EQ(native->GetRegister("R2"), 3);
+    // Going back from the end lets the program run again
+    native->ReverseSingleStep();
+    EXPECT_EQ(native->GetIP(), 4);
+    native->ReverseSingleStep();
+    EXPECT_EQ(native->GetIP(), 3);
+    EXPECT_EQ(native->GetRegister("R2"), 0);
+    native->ContinueExecution();
+    ASSERT_TRUE(std::holds_alternative<ExecutionEnd>(native->WaitForDebugEvent()));
+    EXPECT_EQ(native->GetRegister("R2"), 3);
+}
+
+TEST_F(NativeTest, ReverseContinue) {
+    auto program = R"(
+.text
+
+0 MOV R0, 0
+1 MOV [R0], R0
+2 INC R0
+3 CMP R0, 5
+4 JL 1
+5 HALT
+)";
+    Run(program, 3, 0);
+    native->WaitForDebugEvent();
+    native->SetBreakpoint(3);
+    for (int i = 0; i < 3; ++i) {
+        native->ContinueExecution();
+        ASSERT_TRUE(std::holds_alternative<BreakpointHit>(native->WaitForDebugEvent()));
+    }
+    ASSERT_EQ(native->GetRegister("R0"), 3);
+
+    auto e = native->ReverseContinue();
+    ASSERT_TRUE(std::holds_alternative<BreakpointHit>(e));
+    EXPECT_EQ(native->GetIP(), 3);
+    EXPECT_EQ(native->GetRegister("R0"), 2);
+    EXPECT_EQ(native->ReadMemory(1, 1)[0], 1);
+    EXPECT_EQ(native->ReadMemory(2, 1)[0], 0);
+
+    // The watchpoint did not exist during the run, it is found nonetheless
+    native->SetWatchpointWrite(0);
+    e = native->ReverseContinue();
+    ASSERT_TRUE(std::holds_alternative<BreakpointHit>(e));
+    EXPECT_EQ(native->GetRegister("R0"), 1);
+    e = native->ReverseContinue();
+    ASSERT_TRUE(std::holds_alternative<WatchpointTrigger>(e));
+    EXPECT_EQ(std::get<WatchpointTrigger>(e).address, 0);
+    EXPECT_EQ(native->GetIP(), 2);
+    ASSERT_TRUE(std::holds_alternative<ExecutionBegin>(native->ReverseContinue()));
+    EXPECT_EQ(native->GetIP(), 0);
+
+    native->UnsetBreakpoint(3);
+    native->RemoveWatchpoint(0);
+    native->ContinueExecution();
+    ASSERT_TRUE(std::holds_alternative<ExecutionEnd>(native->WaitForDebugEvent()));
+    EXPECT_EQ(native->ReadMemory(4, 1)[0], 4);
+}
+
+TEST_F(NativeTest, ReverseStepOut) {
+    auto program = R"(
+.text
+
+0 MOV R0, 1
+1 CALL 3
+2 HALT
+
+3 NOP
+4 CALL 7
+5 NOP
+6 RET
+
+7 NOP
+8 RET
+)";
+    Run(program, 3, 0);
+    native->WaitForDebugEvent();
+    native->SetBreakpoint(6);
+    native->ContinueExecution();
+    native->WaitForDebugEvent();
+    ASSERT_EQ(native->GetIP(), 6);
+
+    auto e = native->ReverseStepOut();
+    ASSERT_TRUE(std::holds_alternative<Singlestep>(e));
+    EXPECT_EQ(native->GetIP(), 1);
+    ASSERT_TRUE(std::holds_alternative<ExecutionBegin>(native->ReverseStepOut()));
+}
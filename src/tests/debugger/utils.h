@@ -82,6 +82,18 @@ public:
     void Wait() override {
         NOT_IMPLEMENTED;
     }
+    void Snapshot(const std::string& path) override {
+        NOT_IMPLEMENTED;
+    }
+    StopReason ReverseSinglestep() override {
+        NOT_IMPLEMENTED;
+    }
+    StopReason ReverseContinue() override {
+        NOT_IMPLEMENTED;
+    }
+    StopReason ReverseStepOut() override {
+        NOT_IMPLEMENTED;
+    }
     /// Cause the process to end, the class should not be used
     /// after this function is called.
     void Terminate() override {
@@ -0,0 +1,185 @@
+#include <gtest/gtest.h>
+
+#include "t86-cli/batch.h"
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+using namespace tiny::t86;
+
+namespace {
+// Prints the numbers from 3 down to 1
+const char* countdown = R"(
+.text
+0 MOV R0, 3
+1 PUTNUM R0
+2 SUB R0, 1
+3 CMP R0, 0
+4 JNE 1
+5 HALT
+)";
+
+const char* forever = R"(
+.text
+0 JMP 0
+)";
+
+const char* echo = R"(
+.text
+0 GETCHAR R0
+1 PUTCHAR R0
+2 GETCHAR R0
+3 PUTCHAR R0
+4 HALT
+)";
+
+// Independent loads and additions, faster with more gates and ALUs
+const char* parallel = R"(
+.text
+0 MOV R0, [0]
+1 MOV R1, [1]
+2 MOV R2, [2]
+3 MOV R3, [3]
+4 ADD R0, R1
+5 ADD R2, R3
+6 ADD R0, R2
+7 PUTNUM R0
+8 HALT
+.data
+1
+2
+3
+4
+)";
+
+class BatchTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        directory_ = std::filesystem::temp_directory_path() / ("t86-batch-test-" + std::to_string(::getpid()));
+        std::filesystem::create_directories(directory_);
+    }
+
+    void TearDown() override {
+        std::filesystem::remove_all(directory_);
+    }
+
+    std::string write(const std::string& name, const std::string& content) {
+        auto path = directory_ / name;
+        std::ofstream(path) << content;
+        return path.string();
+    }
+
+    std::filesystem::path directory_;
+};
+}
+
+TEST_F(BatchTest, ParsesManifest) {
+    std::istringstream manifest(R"(
+# comment
+a.t86
+b.t86 in.txt -aluCnt=2 -mode=functional
+/abs/c.t86 - -maxTicks=10
+d.t86 -skipIdle
+)");
+    auto cases = BatchRunner::parseManifest(manifest, "dir");
+    ASSERT_EQ(cases.size(), 4);
+    EXPECT_EQ(cases[0].program, (std::filesystem::path("dir") / "a.t86").string());
+    EXPECT_TRUE(cases[0].input.empty());
+    EXPECT_EQ(cases[1].input, (std::filesystem::path("dir") / "in.txt").string());
+    EXPECT_EQ(cases[1].options, (std::vector<std::string>{"-aluCnt=2", "-mode=functional"}));
+    EXPECT_EQ(cases[2].program, "/abs/c.t86");
+    EXPECT_TRUE(cases[2].input.empty());
+    EXPECT_EQ(cases[3].options, std::vector<std::string>{"-skipIdle"});
+
+    std::istringstream bad("a.t86 in.txt extra");
+    EXPECT_THROW(BatchRunner::parseManifest(bad, ""), std::invalid_argument);
+}
+
+TEST_F(BatchTest, CasesGetTheirOwnOutputAndLimits) {
+    std::string program = write("countdown.t86", countdown);
+    std::string loop = write("forever.t86", forever);
+    std::string input = write("in.txt", "hi");
+    std::string echoProgram = write("echo.t86", echo);
+
+    std::vector<BatchCase> cases{
+        {program, "", {}},
+        {program, "", {"-mode=functional", "-registerCnt=2"}},
+        {program, "", {"-maxTicks=5"}},
+        {loop, "", {"-timeout=20"}},
+        {echoProgram, input, {"-mode=functional"}},
+        {write("broken.t86", ".text\n0 FOO R0\n"), "", {}},
+        {program, "", {"-mode=sideways"}},
+    };
+    BatchRunner::Options options;
+    options.jobs = 3;
+    auto results = BatchRunner(options).run(cases);
+    ASSERT_EQ(results.size(), cases.size());
+
+    EXPECT_EQ(results[0].status, BatchResult::Status::Halted);
+    EXPECT_EQ(results[0].output, "3\n2\n1\n");
+    EXPECT_EQ(results[0].instructions, 14);
+    EXPECT_GT(results[0].ticks, results[0].instructions);
+
+    EXPECT_EQ(results[1].status, BatchResult::Status::Halted);
+    EXPECT_EQ(results[1].output, "3\n2\n1\n");
+    EXPECT_EQ(results[1].ticks, 14);
+
+    EXPECT_EQ(results[2].status, BatchResult::Status::TickLimit);
+    EXPECT_EQ(results[2].ticks, 5);
+
+    EXPECT_EQ(results[3].status, BatchResult::Status::Timeout);
+    EXPECT_GT(results[3].ticks, 0);
+
+    EXPECT_EQ(results[4].status, BatchResult::Status::Halted);
+    EXPECT_EQ(results[4].output, "hi");
+
+    EXPECT_EQ(results[5].status, BatchResult::Status::Error);
+    EXPECT_FALSE(results[5].error.empty());
+
+    EXPECT_EQ(results[6].status, BatchResult::Status::Error);
+    EXPECT_NE(results[6].error.find("sideways"), std::string::npos);
+}
+
+TEST_F(BatchTest, SummaryIsJson) {
+    std::vector<BatchCase> cases{{"a \"b\".t86", "", {}}};
+    std::vector<BatchResult> results(1);
+    results[0].status = BatchResult::Status::Halted;
+    results[0].ticks = 7;
+    results[0].output = "1\n";
+    std::ostringstream summary;
+    BatchRunner::writeSummary(summary, cases, results);
+    EXPECT_NE(summary.str().find(R"("program":"a \"b\".t86")"), std::string::npos);
+    EXPECT_NE(summary.str().find(R"("status":"halted","ticks":7)"), std::string::npos);
+    EXPECT_NE(summary.str().find(R"("output":"1\n")"), std::string::npos);
+}
+
+TEST_F(BatchTest, CycleModeReadsInput) {
+    std::string input = write("in.txt", "hi");
+    std::vector<BatchCase> cases{{write("echo.t86", echo), input, {"-mode=cycle"}}};
+    auto results = BatchRunner(BatchRunner::Options{}).run(cases);
+    ASSERT_EQ(results.size(), 1);
+    EXPECT_EQ(results[0].status, BatchResult::Status::Halted);
+    EXPECT_EQ(results[0].output, "hi");
+}
+
+TEST_F(BatchTest, CaseOptionsSizeTheCpu) {
+    std::string program = write("parallel.t86", parallel);
+    std::vector<BatchCase> cases{
+        {program, "", {}},
+        {program, "", {"-ramGates=1"}},
+        {program, "", {"-fetchWidth=4", "-decodeWidth=4"}},
+        {program, "", {"-fetchWidth=4", "-decodeWidth=4", "-aluCnt=4", "-reservationStationEntriesCnt=16"}},
+    };
+    auto results = BatchRunner(BatchRunner::Options{}).run(cases);
+    ASSERT_EQ(results.size(), cases.size());
+    for (const auto& result : results) {
+        EXPECT_EQ(result.status, BatchResult::Status::Halted);
+        EXPECT_EQ(result.output, "10\n");
+    }
+    EXPECT_GT(results[1].ticks, results[0].ticks);
+    EXPECT_LT(results[3].ticks, results[2].ticks);
+}
@@ -0,0 +1,113 @@
+#include <gtest/gtest.h>
+
+#include "t86-cli/sweep.h"
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+using namespace tiny::t86;
+
+namespace {
+// Sums the numbers from 1 to 20 in memory
+const char* sum = R"(
+.text
+0 MOV R0, 20
+1 MOV [0], 0
+2 MOV R1, [0]
+3 ADD R1, R0
+4 MOV [0], R1
+5 SUB R0, 1
+6 CMP R0, 0
+7 JNE 2
+8 MOV R1, [0]
+9 PUTNUM R1
+10 HALT
+)";
+
+class SweepTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        directory_ = std::filesystem::temp_directory_path() / ("t86-sweep-test-" + std::to_string(::getpid()));
+        std::filesystem::create_directories(directory_);
+    }
+
+    void TearDown() override {
+        std::filesystem::remove_all(directory_);
+    }
+
+    std::string write(const std::string& name, const std::string& content) {
+        auto path = directory_ / name;
+        std::ofstream(path) << content;
+        return path.string();
+    }
+
+    std::filesystem::path directory_;
+};
+}
+
+TEST(SweepGridTest, RunsEveryCombination) {
+    SweepGrid grid;
+    grid.alus = SweepGrid::parseValues("1,2");
+    grid.reservationStationEntries = SweepGrid::parseValues("2,4,8");
+    auto points = grid.points();
+    ASSERT_EQ(points.size(), 6);
+    EXPECT_EQ(points[0].alus, 1);
+    EXPECT_EQ(points[0].reservationStationEntries, 2);
+    EXPECT_EQ(points[5].alus, 2);
+    EXPECT_EQ(points[5].reservationStationEntries, 8);
+    EXPECT_EQ(points[5].options()[3], "-reservationStationEntriesCnt=8");
+
+    EXPECT_THROW(SweepGrid::parseValues("1,x"), std::invalid_argument);
+    EXPECT_THROW(SweepGrid::parseValues(""), std::invalid_argument);
+}
+
+TEST_F(SweepTest, SecondRunComesFromTheCache) {
+    std::string program = write("sum.t86", sum);
+    SweepGrid grid;
+    grid.alus = {1, 2};
+    grid.reservationStationEntries = {2, 4};
+    BatchRunner::Options options;
+    options.jobs = 2;
+    Sweep sweep(options, directory_ / "cache");
+
+    auto first = sweep.run({program}, grid);
+    ASSERT_EQ(first.size(), 4);
+    for (const auto& row : first) {
+        EXPECT_EQ(row.result.status, BatchResult::Status::Halted);
+        EXPECT_FALSE(row.cached);
+        EXPECT_EQ(row.result.instructions, 5 + 6 * 20);
+        EXPECT_GT(row.result.stages.memoryReadStalls, 0);
+    }
+    // More entries in the station do not slow the program down
+    EXPECT_LE(first[1].result.ticks, first[0].result.ticks);
+
+    auto second = sweep.run({program}, grid);
+    for (std::size_t i = 0; i < first.size(); ++i) {
+        EXPECT_TRUE(second[i].cached);
+        EXPECT_EQ(second[i].result.ticks, first[i].result.ticks);
+        EXPECT_EQ(second[i].result.instructions, first[i].result.instructions);
+        EXPECT_EQ(second[i].result.stages.registerFetchStalls, first[i].result.stages.registerFetchStalls);
+    }
+
+    // A changed program is simulated again
+    write("sum.t86", std::string(sum) + "\n");
+    auto changed = sweep.run({program}, grid);
+    EXPECT_FALSE(changed[0].cached);
+    EXPECT_EQ(changed[0].result.ticks, first[0].result.ticks);
+}
+
+TEST_F(SweepTest, TicksMatchTheRunWithoutSkipping) {
+    std::string program = write("sum.t86", sum);
+    SweepGrid grid;
+    grid.alus = {2};
+    grid.reservationStationEntries = {4};
+    auto rows = Sweep(BatchRunner::Options{}, directory_ / "cache").run({program}, grid);
+
+    BatchRunner::Options options;
+    auto results = BatchRunner(options).run({BatchCase{program, "", rows[0].point.options()}});
+    EXPECT_EQ(rows[0].result.ticks, results[0].ticks);
+    EXPECT_EQ(results[0].output, "210\n");
+}
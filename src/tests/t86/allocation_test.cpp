@@ -0,0 +1,80 @@
+#include <gtest/gtest.h>
+
+#include "t86/cpu.h"
+#include "t86/utils/stats_logger.h"
+#include "t86-parser/parser.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <streambuf>
+
+using namespace tiny::t86;
+
+namespace {
+std::atomic<std::size_t> allocationCount{0};
+
+/// Swallows everything the program prints, without allocating.
+class NullBuffer : public std::streambuf {
+protected:
+    int overflow(int c) override { return c; }
+};
+}
+
+// Counts every allocation done by the allocationtests binary
+void* operator new(std::size_t size) {
+    ++allocationCount;
+    if (void* ptr = std::malloc(size == 0 ? 1 : size)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+TEST(AllocationTest, QuicksortSteadyState) {
+#if LOG_LEVEL > 2
+    GTEST_SKIP() << "The info and debug logs format a string for every retired instruction";
+#endif
+    auto path = std::filesystem::path(__FILE__).parent_path() / "../../benchmarks/benches/quicksort.t86";
+    std::ifstream fs{path};
+    ASSERT_TRUE(fs);
+    Parser parser(fs);
+    Program program = parser.Parse();
+
+    NullBuffer null;
+    auto* old = std::cout.rdbuf(&null);
+
+    StatsLogger::instance().reset();
+    Cpu cpu(8, 4, 1024);
+    cpu.start(std::move(program));
+
+    // Let all the pools, buffers and the stats grow to their working size
+    const std::size_t warmupTicks = 20'000;
+    const std::size_t measuredTicks = 200'000;
+    std::size_t tick = 0;
+    for (; tick < warmupTicks && !cpu.halted(); ++tick) {
+        cpu.tick();
+    }
+
+    std::size_t before = allocationCount;
+    for (; tick < warmupTicks + measuredTicks && !cpu.halted(); ++tick) {
+        cpu.tick();
+    }
+    std::size_t allocations = allocationCount - before;
+
+    std::cout.rdbuf(old);
+    ASSERT_FALSE(cpu.halted()) << "The measured window should be in the middle of the run";
+    // Only the occasional growth of the stats vectors is allowed
+    EXPECT_LT(allocations, measuredTicks / 1000)
+        << allocations << " allocations in " << measuredTicks << " ticks";
+}
@@ -0,0 +1,187 @@
+#include <gtest/gtest.h>
+
+#include "t86/cpu.h"
+#include "t86/cpu/branch_predictors/return_address_stack_predictor.h"
+#include "t86/cpu/branch_predictors/bimodal_branch_predictor.h"
+#include "t86/cpu/branch_predictors/gshare_branch_predictor.h"
+#include "t86/utils/stats_logger.h"
+#include "t86-parser/parser.h"
+
+#include <sstream>
+#include <stdexcept>
+
+using namespace tiny::t86;
+
+namespace {
+// Calls a function in a loop, the naive predictor guesses
+// the instruction after RET every time
+const char* callLoop = R"(
+.text
+0 MOV R0, 0
+1 MOV R1, 5
+2 CALL 7
+3 SUB R1, 1
+4 CMP R1, 0
+5 JNE 2
+6 HALT
+7 ADD R0, 3
+8 RET
+)";
+
+// The exit jump is taken only once, the naive predictor guesses it taken every time
+const char* forwardExit = R"(
+.text
+0 MOV R0, 0
+1 MOV R1, 20
+2 CMP R1, 0
+3 JE 7
+4 ADD R0, 1
+5 SUB R1, 1
+6 JMP 2
+7 HALT
+)";
+
+// The destination of JMP R2 is known only after it is executed
+const char* indirectLoop = R"(
+.text
+0 MOV R0, 0
+1 MOV R1, 10
+2 MOV R2, 5
+3 JMP R2
+4 ADD R0, 100
+5 ADD R0, 1
+6 SUB R1, 1
+7 CMP R1, 0
+8 JNE 3
+9 HALT
+)";
+
+struct RunResult {
+    std::size_t ticks;
+    std::size_t mispredictions;
+    std::size_t flushes;
+    int64_t result;
+};
+
+RunResult RunWith(const char* source, const std::string& predictor) {
+    std::istringstream iss{source};
+    Parser parser(iss);
+    Program program = parser.Parse();
+
+    StatsLogger::instance().reset();
+    Cpu cpu(4, 1, 64);
+    cpu.setBranchPredictor(BranchPredictor::create(predictor));
+    cpu.start(std::move(program));
+    while (!cpu.halted()) {
+        cpu.tick();
+    }
+    const auto& stats = StatsLogger::instance();
+    return {stats.tickCount(), stats.mispredictionCount(), stats.flushCount(), cpu.getRegister(Register{0})};
+}
+
+}
+
+TEST(BranchPredictorTest, ReturnAddressStackPredictsReturns) {
+    ReturnAddressStackPredictor predictor;
+    CALL call{7};
+    RET ret;
+
+    EXPECT_EQ(predictor.nextGuess(2, call), 7);
+    EXPECT_EQ(predictor.nextGuess(8, ret), 3);
+    // Nothing on the stack, falls back to the next instruction
+    EXPECT_EQ(predictor.nextGuess(8, ret), 9);
+}
+
+TEST(BranchPredictorTest, ReturnAddressStackIsRepaired) {
+    ReturnAddressStackPredictor predictor;
+    CALL call{7};
+    RET ret;
+
+    // The call is retired, a speculative one is thrown away
+    predictor.nextGuess(2, call);
+    predictor.registerBranchTaken(2, call, 7);
+    predictor.nextGuess(7, call);
+    predictor.unrollSpeculation();
+
+    EXPECT_EQ(predictor.nextGuess(8, ret), 3);
+}
+
+TEST(BranchPredictorTest, FewerMispredictionsWithReturnAddressStack) {
+    RunResult naive = RunWith(callLoop, "naive");
+    RunResult ras = RunWith(callLoop, "ras");
+
+    EXPECT_EQ(naive.result, 15);
+    EXPECT_EQ(ras.result, naive.result);
+    // Every return and the loop exit
+    EXPECT_EQ(naive.mispredictions, 6);
+    EXPECT_EQ(ras.mispredictions, 1);
+    EXPECT_GE(ras.flushes, ras.mispredictions);
+    EXPECT_LT(ras.ticks, naive.ticks);
+}
+
+TEST(BranchPredictorTest, UnknownPredictorIsRejected) {
+    EXPECT_THROW(BranchPredictor::create("oracle"), std::invalid_argument);
+}
+
+TEST(BranchPredictorTest, BimodalLearnsNotTakenJumps) {
+    RunResult naive = RunWith(forwardExit, "naive");
+    RunResult bimodal = RunWith(forwardExit, "bimodal");
+
+    EXPECT_EQ(naive.result, 20);
+    EXPECT_EQ(bimodal.result, naive.result);
+    EXPECT_EQ(naive.mispredictions, 20);
+    EXPECT_LE(bimodal.mispredictions, 3);
+    EXPECT_LT(bimodal.ticks, naive.ticks);
+}
+
+TEST(BranchPredictorTest, BranchTargetBufferPredictsIndirectJumps) {
+    RunResult naive = RunWith(indirectLoop, "naive");
+    RunResult bimodal = RunWith(indirectLoop, "bimodal");
+
+    EXPECT_EQ(naive.result, 10);
+    EXPECT_EQ(bimodal.result, naive.result);
+    // Every indirect jump and the loop exit
+    EXPECT_EQ(naive.mispredictions, 11);
+    // Only the first indirect jump and the loop exit
+    EXPECT_EQ(bimodal.mispredictions, 2);
+}
+
+TEST(BranchPredictorTest, GshareLearnsAlternatingPattern) {
+    BimodalBranchPredictor bimodal;
+    GshareBranchPredictor gshare;
+    JNE jne{uint64_t{2}};
+
+    auto mispredictions = [&](BranchPredictor& predictor) {
+        std::size_t count = 0;
+        for (std::size_t i = 0; i < 100; ++i) {
+            bool taken = i % 2 == 0;
+            bool predictedTaken = predictor.nextGuess(10, jne) == 2;
+            if (taken) {
+                predictor.registerBranchTaken(10, jne, 2);
+            } else {
+                predictor.registerBranchNotTaken(10, jne);
+            }
+            if (predictedTaken != taken) {
+                predictor.unrollSpeculation();
+                // Only count after the warm up
+                count += i >= 50;
+            }
+        }
+        return count;
+    };
+
+    EXPECT_EQ(mispredictions(gshare), 0);
+    EXPECT_GE(mispredictions(bimodal), 25);
+}
+
+TEST(BranchPredictorTest, PerBranchStats) {
+    RunWith(forwardExit, "naive");
+    const auto& branches = StatsLogger::instance().branchStats();
+
+    ASSERT_EQ(branches.count(3), 1);
+    EXPECT_EQ(branches.at(3).count, 21);
+    EXPECT_EQ(branches.at(3).mispredictions, 20);
+    EXPECT_GT(branches.at(3).flushTicks, 20);
+    ASSERT_EQ(branches.count(6), 1);
+    EXPECT_EQ(branches.at(6).mispredictions, 0);
+}
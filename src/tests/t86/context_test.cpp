@@ -0,0 +1,111 @@
+#include <gtest/gtest.h>
+
+#include "t86/cpu.h"
+#include "t86/utils/stats_logger.h"
+#include "t86-parser/parser.h"
+
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace tiny::t86;
+
+namespace {
+// Prints the first few Fibonacci numbers
+const char* fibonacci = R"(
+.text
+0 MOV R0, 0
+1 MOV R1, 1
+2 MOV R2, 15
+3 PUTNUM R0
+4 MOV R3, R0
+5 ADD R3, R1
+6 MOV R0, R1
+7 MOV R1, R3
+8 SUB R2, 1
+9 CMP R2, 0
+10 JNE 3
+11 HALT
+)";
+
+struct RunResult {
+    std::string output;
+    std::size_t ticks;
+    std::size_t instructions;
+};
+
+RunResult RunInContext(const std::string& source) {
+    std::istringstream iss{source};
+    Parser parser(iss);
+
+    StatsLogger stats;
+    std::ostringstream output;
+    Cpu::Context context;
+    context.stats = &stats;
+    context.output = &output;
+    Cpu cpu(4, 1, 2, 8, 64, 2, context);
+    cpu.start(parser.Parse());
+    while (!cpu.halted()) {
+        cpu.tick();
+    }
+    return {output.str(), stats.tickCount(), stats.instructionCount()};
+}
+}
+
+TEST(ContextTest, OutputAndStatsGoToTheContext) {
+    StatsLogger::instance().reset();
+    RunResult result = RunInContext(fibonacci);
+
+    EXPECT_EQ(result.output.substr(0, 12), "0\n1\n1\n2\n3\n5\n");
+    EXPECT_GT(result.ticks, 0);
+    EXPECT_GT(result.instructions, 0);
+    // Nothing went to the process-wide logger
+    EXPECT_EQ(StatsLogger::instance().tickCount(), 0);
+}
+
+TEST(ContextTest, ConfigIsPerCpu) {
+    Cpu::Context context;
+    StatsLogger stats;
+    context.stats = &stats;
+    const char* argv[] = {"test", "-registerCnt=6", "-aluCnt=3", "-branchPredictor=gshare"};
+    tiny::Config source;
+    source.parse(4, const_cast<char**>(argv));
+    context.config = Cpu::Config{source};
+
+    Cpu cpu(context);
+    EXPECT_EQ(cpu.registersCount(), 6);
+    EXPECT_EQ(cpu.config().aluCnt(), 3);
+    EXPECT_EQ(cpu.config().branchPredictor(), "gshare");
+    // Options that are not given keep their defaults
+    EXPECT_EQ(cpu.config().ramSize(), Cpu::Config::defaultRamSize);
+}
+
+TEST(ContextTest, NopPastTheTextIsPerCpu) {
+    Cpu first(Cpu::Context{});
+    Cpu second(Cpu::Context{});
+    const auto& nop = first.getDecodedText(100);
+    EXPECT_EQ(nop.type, Instruction::Type::NOP);
+    EXPECT_EQ(nop.latency, first.config().getExecutionLength(nop.instruction));
+    EXPECT_NE(&nop, &second.getDecodedText(100));
+}
+
+TEST(ContextTest, CpusRunOnManyThreads) {
+    RunResult serial = RunInContext(fibonacci);
+
+    std::vector<RunResult> results(8);
+    std::vector<std::thread> threads;
+    for (auto& result : results) {
+        threads.emplace_back([&result]() {
+            result = RunInContext(fibonacci);
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (const auto& result : results) {
+        EXPECT_EQ(result.output, serial.output);
+        EXPECT_EQ(result.ticks, serial.ticks);
+        EXPECT_EQ(result.instructions, serial.instructions);
+    }
+}
@@ -0,0 +1,47 @@
+#include <gtest/gtest.h>
+
+#include "t86/decoded_instruction.h"
+
+using namespace tiny::t86;
+
+TEST(DecodeTest, Arithmetic) {
+    ADD add(Register{0}, Register{1});
+    auto decoded = DecodedInstruction::decode(add);
+    EXPECT_EQ(decoded.instruction, &add);
+    EXPECT_EQ(decoded.type, Instruction::Type::ADD);
+    EXPECT_FALSE(decoded.isJump);
+    EXPECT_TRUE(decoded.needsAlu);
+    EXPECT_EQ(decoded.latency, 3);
+    ASSERT_EQ(decoded.operands.size(), 2);
+    EXPECT_EQ(decoded.operands[1].getRegister(), Register{1});
+    ASSERT_EQ(decoded.products.size(), 2);
+    EXPECT_EQ(decoded.produces, DecodedInstruction::ProducesRegister | DecodedInstruction::ProducesFlags);
+}
+
+TEST(DecodeTest, Jumps) {
+    JMP jmp(uint64_t{5});
+    auto decodedJmp = DecodedInstruction::decode(jmp);
+    EXPECT_TRUE(decodedJmp.isJump);
+    EXPECT_FALSE(decodedJmp.needsAlu);
+    EXPECT_EQ(decodedJmp.produces, DecodedInstruction::ProducesProgramCounter);
+
+    CALL call(uint64_t{3});
+    auto decoded = DecodedInstruction::decode(call);
+    EXPECT_TRUE(decoded.isJump);
+    EXPECT_EQ(decoded.operands.size(), 3);
+    EXPECT_EQ(decoded.signatureOperands.size(), 1);
+    EXPECT_TRUE(decoded.writesMemory());
+    EXPECT_EQ(decoded.produces, DecodedInstruction::ProducesProgramCounter
+                                | DecodedInstruction::ProducesStackPointer
+                                | DecodedInstruction::ProducesMemory);
+}
+
+TEST(DecodeTest, MovLatency) {
+    MOV imm(Register{0}, int64_t{1});
+    EXPECT_EQ(DecodedInstruction::decode(imm).latency, 2);
+    MOV reg(Register{0}, Register{1});
+    EXPECT_EQ(DecodedInstruction::decode(reg).latency, 3);
+    EXPECT_FALSE(DecodedInstruction::decode(reg).writesMemory());
+    MOV mem(Memory::Immediate{4}, Register{1});
+    EXPECT_TRUE(DecodedInstruction::decode(mem).writesMemory());
+}
@@ -0,0 +1,68 @@
+#include <gtest/gtest.h>
+
+#include "t86/utils/event_columns.h"
+
+#include <tuple>
+#include <vector>
+
+using namespace tiny::t86;
+
+namespace {
+using Event = std::tuple<std::size_t, std::size_t, std::size_t>;
+}
+
+TEST(EventColumnsTest, DecodesWhatWasAppended) {
+    EventColumns columns(3);
+    std::vector<Event> expected[3];
+    // Several blocks, ids going both up and down within a tick
+    for (std::size_t tick = 0; tick < 3 * EventColumns::blockSize / 4; ++tick) {
+        for (std::size_t id : {tick + 7, tick + 2, tick + 5}) {
+            std::size_t kind = id % 3;
+            std::size_t arg = kind == 2 ? id * 1000 : 0;
+            columns.append(kind, tick, id, arg);
+            expected[kind].emplace_back(tick, id, arg);
+        }
+    }
+    EXPECT_EQ(columns.size(), 3 * (3 * EventColumns::blockSize / 4));
+
+    for (std::size_t kind = 0; kind < 3; ++kind) {
+        std::vector<Event> decoded;
+        columns.forEach(kind, [&decoded](std::size_t tick, std::size_t id, std::size_t arg) {
+            decoded.emplace_back(tick, id, arg);
+        });
+        EXPECT_EQ(decoded, expected[kind]);
+        EXPECT_GT(columns.blockCount(kind), 0);
+    }
+}
+
+TEST(EventColumnsTest, BlocksDecodeIndependently) {
+    EventColumns columns(1);
+    std::size_t count = 2 * EventColumns::blockSize + 10;
+    for (std::size_t i = 0; i < count; ++i) {
+        columns.append(0, i / 2, i);
+    }
+    ASSERT_EQ(columns.blockCount(0), 3);
+    std::size_t next = EventColumns::blockSize;
+    columns.forEachInBlock(0, 1, [&next](std::size_t tick, std::size_t id, std::size_t arg) {
+        EXPECT_EQ(id, next);
+        EXPECT_EQ(tick, next / 2);
+        EXPECT_EQ(arg, 0);
+        ++next;
+    });
+    EXPECT_EQ(next, 2 * EventColumns::blockSize);
+}
+
+TEST(EventColumnsTest, SmallDeltasTakeFewBytes) {
+    EventColumns columns(1);
+    std::size_t count = 100'000;
+    for (std::size_t i = 0; i < count; ++i) {
+        columns.append(0, 1'000'000 + i, 5'000'000 + i);
+    }
+    // Three bytes per event, even with the spare capacity of the vectors
+    // it is less than one uncompressed number
+    EXPECT_LT(columns.memoryUsage(), sizeof(std::size_t) * count);
+
+    columns.clear();
+    EXPECT_EQ(columns.size(), 0);
+    EXPECT_EQ(columns.blockCount(0), 0);
+}
@@ -0,0 +1,151 @@
+#include <gtest/gtest.h>
+
+#include "t86/cpu.h"
+#include "t86/execution_trace.h"
+#include "t86/os.h"
+#include "utils.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+using namespace tiny::t86;
+
+namespace {
+std::string Record(Cpu::Mode mode, const std::string& path) {
+    Sink sink;
+    OS os(sink.context, 4, 1, 1024);
+    os.SetMode(mode);
+    os.RecordExecution(path);
+    EXPECT_TRUE(os.Run(Parse(loop)));
+    EXPECT_EQ(sink.output.str(), loopOutput);
+    std::ifstream file(path, std::ios::binary);
+    return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+}
+}
+
+TEST(ExecutionTraceTest, SameInBothModes) {
+    std::string path = TempFile("t86_execution_trace_test");
+    std::string cycle = Record(Cpu::Mode::Cycle, path);
+    std::string functional = Record(Cpu::Mode::Functional, path);
+    EXPECT_EQ(cycle, functional);
+    // Most instructions write a register and the flags, or the memory
+    EXPECT_LT(cycle.size(), loopInstructions * 8);
+    std::filesystem::remove(path);
+}
+
+TEST(ExecutionTraceTest, LastWrite) {
+    std::string path = TempFile("t86_execution_trace_test");
+    Record(Cpu::Mode::Functional, path);
+    ExecutionTrace trace(path);
+    EXPECT_EQ(trace.instructions(), loopInstructions);
+    EXPECT_EQ(trace.blocks(), 2);
+
+    // The eighth iteration of the first loop writes 7 to the address 7
+    EXPECT_FALSE(trace.lastWrite(7, 30));
+    auto write = trace.lastWrite(7, 31);
+    ASSERT_TRUE(write);
+    EXPECT_EQ(write->instruction, 30);
+    EXPECT_EQ(write->pc, 2);
+    EXPECT_EQ(write->value, 7);
+    EXPECT_EQ(trace.lastWrite(7, loopInstructions)->instruction, 30);
+
+    // The last PUSH, in the second block
+    write = trace.lastWrite(1023, loopInstructions);
+    ASSERT_TRUE(write);
+    EXPECT_EQ(write->instruction, 2003 + 9 * 499);
+    EXPECT_EQ(write->pc, 7);
+    EXPECT_EQ(write->value, 499);
+    // The return address of the last CALL
+    EXPECT_EQ(trace.lastWrite(1022, loopInstructions)->value, 9);
+    EXPECT_FALSE(trace.lastWrite(600, loopInstructions));
+    std::filesystem::remove(path);
+}
+
+TEST(ExecutionTraceTest, Values) {
+    std::string path = TempFile("t86_execution_trace_test");
+    Record(Cpu::Mode::Cycle, path);
+    ExecutionTrace trace(path);
+
+    auto values = trace.values(trace.slot(Register{3}), 16);
+    ASSERT_EQ(values.size(), 500);
+    for (std::size_t i = 0; i < values.size(); ++i) {
+        EXPECT_EQ(values[i].value, i);
+        EXPECT_EQ(values[i].instruction, 2003 + 9 * i + 3);
+    }
+    values = trace.values(trace.slot(Register{1}), 13);
+    ASSERT_EQ(values.size(), 1);
+    EXPECT_EQ(values[0].value, 124750);
+    values = trace.values(trace.slot(Register::StackPointer()), 9);
+    ASSERT_EQ(values.size(), 500);
+    EXPECT_EQ(values[0].value, 1023);
+    EXPECT_TRUE(trace.values(trace.slot(FloatRegister{0}), 20).empty());
+    EXPECT_THROW(trace.slot(Register{4}), std::invalid_argument);
+    EXPECT_THROW(trace.slot(Register::ProgramCounter()), std::invalid_argument);
+    std::filesystem::remove(path);
+}
+
+TEST(ExecutionTraceTest, Histogram) {
+    std::string path = TempFile("t86_execution_trace_test");
+    Record(Cpu::Mode::Functional, path);
+    ExecutionTrace trace(path);
+    auto histogram = trace.histogram();
+    ASSERT_EQ(histogram.size(), 18);
+    EXPECT_EQ(histogram[0], 1);
+    EXPECT_EQ(histogram[2], 500);
+    EXPECT_EQ(histogram[16], 500);
+    EXPECT_EQ(histogram[14], 1);
+    std::filesystem::remove(path);
+}
+
+TEST(ExecutionTraceTest, Invalid) {
+    std::string path = TempFile("t86_execution_trace_test");
+    EXPECT_THROW(ExecutionTrace("/nonexistent/trace"), std::runtime_error);
+    std::ofstream(path) << "not a trace at all, but long enough to have a header and a trailer";
+    EXPECT_THROW(ExecutionTrace{path}, std::runtime_error);
+
+    // The index is only written once the run ends
+    Sink sink;
+    Cpu cpu(4, 1, 1024, sink.context);
+    cpu.start(Parse(loop));
+    {
+        ExecutionTraceWriter writer(path, cpu);
+        cpu.setExecutionTrace(&writer);
+        for (int i = 0; i < 100; ++i) {
+            cpu.tick();
+        }
+        cpu.setExecutionTrace(nullptr);
+    }
+    EXPECT_THROW(ExecutionTrace{path}, std::runtime_error);
+    std::filesystem::remove(path);
+}
+
+TEST(ExecutionTraceTest, DamagedBlocks) {
+    std::string path = TempFile("t86_execution_trace_test");
+    std::string recorded = Record(Cpu::Mode::Functional, path);
+    auto damage = [&](std::size_t offset, char byte) {
+        std::string damaged = recorded;
+        damaged[offset] = byte;
+        std::ofstream(path, std::ios::binary | std::ios::trunc) << damaged;
+    };
+
+    // The first record of the first block claims seven registers, the records hold at most four
+    damage(sizeof(execution_trace::Header), 0x07);
+    {
+        ExecutionTrace trace(path);
+        EXPECT_THROW(trace.values(trace.slot(Register{1}), 16), std::runtime_error);
+    }
+
+    // The last record of the last block, the HALT, claims a jump whose varint would be in the index
+    execution_trace::Trailer trailer;
+    std::memcpy(&trailer, recorded.data() + recorded.size() - sizeof(trailer), sizeof(trailer));
+    ASSERT_EQ(recorded[trailer.indexOffset - 1], 0);
+    damage(trailer.indexOffset - 1, 0x40);
+    {
+        ExecutionTrace trace(path);
+        EXPECT_THROW(trace.values(trace.slot(Register{1}), 16), std::runtime_error);
+    }
+    std::filesystem::remove(path);
+}
@@ -0,0 +1,107 @@
+#include <gtest/gtest.h>
+
+#include "t86/cpu.h"
+#include "utils.h"
+
+#include <thread>
+#include <vector>
+
+using namespace tiny::t86;
+
+TEST(ForkTest, ChildrenContinueIndependently) {
+    for (auto mode : {Cpu::Mode::Cycle, Cpu::Mode::Functional}) {
+        Sink parentSink;
+        Cpu parent(4, 1, 1024, parentSink.context);
+        parent.setMode(mode);
+        parent.start(Parse(loop));
+        while (parent.retiredInstructions() < 3000) {
+            parent.tick();
+        }
+
+        Sink childSink;
+        auto child = parent.fork(childSink.context);
+        EXPECT_EQ(child->mode(), mode);
+        EXPECT_EQ(child->retiredInstructions(), parent.retiredInstructions());
+        // The sum has not reached the address yet
+        child->setMemory(400, 1400);
+
+        Finish(parent);
+        Finish(*child);
+        EXPECT_EQ(parentSink.output.str(), loopOutput);
+        EXPECT_EQ(childSink.output.str(), "125750\n");
+        EXPECT_EQ(parent.getMemory(400), 400);
+        EXPECT_EQ(child->retiredInstructions(), parent.retiredInstructions());
+    }
+}
+
+TEST(ForkTest, TextIsPatchedSeparately) {
+    Sink parentSink;
+    Cpu parent(4, 1, 1024, parentSink.context);
+    parent.start(Parse(loop));
+    auto patch = Parse(".text\nPUTNUM R0").moveInstructions();
+    parent.setText(13, std::move(patch.at(0)));
+
+    Sink childSink;
+    auto child = parent.fork(childSink.context);
+    auto other = Parse(".text\nPUTNUM R2").moveInstructions();
+    parent.setText(13, std::move(other.at(0)));
+
+    Finish(parent);
+    Finish(*child);
+    EXPECT_EQ(parentSink.output.str(), "499\n");
+    EXPECT_EQ(childSink.output.str(), "500\n");
+}
+
+TEST(ForkTest, PagesAreCopiedOnWrite) {
+    Sink parentSink;
+    Cpu parent(4, 1, 1 << 20, parentSink.context);
+    parent.setMode(Cpu::Mode::Functional);
+    parent.start(Parse(loop));
+    // Nothing was written yet, so there are no pages
+    EXPECT_EQ(parent.ownedRamPages(), 0);
+    parent.setMemory(100000, 1);
+    EXPECT_EQ(parent.ownedRamPages(), 1);
+
+    Sink childSink;
+    auto child = parent.fork(childSink.context);
+    EXPECT_EQ(parent.ownedRamPages(), 0);
+    EXPECT_EQ(child->ownedRamPages(), 0);
+
+    // The loop writes the first 500 words and the stack at the end of the memory
+    Finish(*child);
+    EXPECT_EQ(childSink.output.str(), loopOutput);
+    EXPECT_EQ(child->ownedRamPages(), 2);
+    EXPECT_EQ(parent.ownedRamPages(), 0);
+    EXPECT_EQ(parent.getMemory(42), 0);
+    EXPECT_EQ(child->getMemory(42), 42);
+}
+
+TEST(ForkTest, ChildrenRunOnThreads) {
+    Sink parentSink;
+    Cpu parent(4, 1, 1024, parentSink.context);
+    parent.start(Parse(loop));
+    while (parent.retiredInstructions() < 3000) {
+        parent.tick();
+    }
+
+    const int children = 8;
+    std::vector<Sink> sinks(children);
+    std::vector<std::unique_ptr<Cpu>> forks;
+    for (int i = 0; i < children; ++i) {
+        forks.push_back(parent.fork(sinks[i].context));
+        forks.back()->setMemory(400 + i, 400 + i + 1);
+    }
+    std::vector<std::thread> threads;
+    for (auto& child : forks) {
+        threads.emplace_back([&child]() { Finish(*child); });
+    }
+    Finish(parent);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(parentSink.output.str(), loopOutput);
+    for (int i = 0; i < children; ++i) {
+        EXPECT_EQ(sinks[i].output.str(), "124751\n");
+        EXPECT_EQ(sinks[i].stats.tickCount(), sinks[0].stats.tickCount());
+    }
+}
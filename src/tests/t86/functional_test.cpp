@@ -0,0 +1,202 @@
+#include <gtest/gtest.h>
+#include <vector>
+
+#include "t86/os.h"
+#include "t86-parser/parser.h"
+#include "messenger.h"
+#include "../MockMessenger.h"
+
+#include <string>
+#include <queue>
+#include <sstream>
+
+using namespace tiny::t86;
+
+namespace {
+/// Runs the program without debugger and returns everything
+/// it printed to the standard output.
+std::string RunCaptured(const std::string& source, Cpu::Mode mode) {
+    std::istringstream iss{source};
+    Parser parser(iss);
+    Program p = parser.Parse();
+
+    OS os(4, 2);
+    os.SetMode(mode);
+
+    std::ostringstream captured;
+    auto* old = std::cout.rdbuf(captured.rdbuf());
+    bool ok = os.Run(std::move(p));
+    std::cout.rdbuf(old);
+    EXPECT_TRUE(ok);
+    return captured.str();
+}
+}
+
+TEST(FunctionalTest, SameOutputAsCycleModel) {
+    std::string source = R"(
+.data
+"ABC"
+.text
+0 MOV R0, 0
+# Prints the string from data section
+1 MOV R1, [R0]
+2 CMP R1, 0
+3 JE 7
+4 PUTCHAR R1
+5 INC R0
+6 JMP 1
+# Recursive factorial of 6
+7 PUSH 6
+8 CALL 14
+9 POP R1
+10 PUTNUM R0
+11 MOV F0, 2.5
+12 FMUL F0, F0
+13 JMP 24
+14 MOV R0, [SP + 1]
+15 CMP R0, 1
+16 JG 18
+17 RET
+18 DEC R0
+19 PUSH R0
+20 CALL 14
+21 POP R1
+22 IMUL R0, [SP + 1]
+23 RET
+24 NRW R2, F0
+25 PUTNUM R2
+26 MOV R3, 3
+27 LOOP R3, 27
+28 LEA R2, [R3 + 5 + R0 * 2]
+29 PUTNUM R2
+30 HALT
+)";
+    std::string cycle = RunCaptured(source, Cpu::Mode::Cycle);
+    EXPECT_EQ(cycle, "ABC720\n6\n1445\n");
+    EXPECT_EQ(RunCaptured(source, Cpu::Mode::Functional), cycle);
+}
+
+TEST(FunctionalTest, SingleStepAndBreakpoint) {
+    OS os(3, 0);
+    os.SetMode(Cpu::Mode::Functional);
+    std::queue<std::string> in({
+            "POKETEXT 2 BKPT",
+            "CONTINUE",
+            "REASON",
+            "PEEKREGS",
+            "POKEREGS IP 2",
+            "POKETEXT 2 ADD R0, R1",
+            "SINGLESTEP",
+            "REASON",
+            "PEEKREGS",
+            "CONTINUE",
+            "REASON",
+            "PEEKREGS",
+    });
+
+    std::vector<std::string> out;
+
+    os.SetDebuggerComms(std::make_unique<Comms>(in, out));
+
+    std::istringstream iss{
+R"(
+.text
+
+0 MOV R0, 1
+1 MOV R1, 2
+2 ADD R0, R1
+3 MOV R2, R0
+4 HALT
+)"
+    };
+
+    Parser parser(iss);
+    Program p = parser.Parse();
+
+    ASSERT_TRUE(os.Run(std::move(p)));
+
+    auto it = out.begin();
+    ASSERT_EQ(*it++, "STOPPED");
+    ASSERT_EQ(*it++, "OK");
+    ASSERT_EQ(*it++, "OK");
+    ASSERT_EQ(*it++, "STOPPED");
+    ASSERT_EQ(*it++, "SW_BKPT");
+    ASSERT_EQ(*it++, "IP:3\nBP:1024\nSP:1024\n"
+                     "R0:1\nR1:2\nR2:0\n");
+    ASSERT_EQ(*it++, "OK");
+    ASSERT_EQ(*it++, "OK");
+    ASSERT_EQ(*it++, "OK");
+    ASSERT_EQ(*it++, "STOPPED");
+    ASSERT_EQ(*it++, "SINGLESTEP");
+    ASSERT_EQ(*it++, "IP:3\nBP:1024\nSP:1024\n"
+                     "R0:3\nR1:2\nR2:0\n");
+    ASSERT_EQ(*it++, "OK");
+    ASSERT_EQ(*it++, "STOPPED");
+    ASSERT_EQ(*it++, "HALT");
+    ASSERT_EQ(*it++, "IP:5\nBP:1024\nSP:1024\n"
+                     "R0:3\nR1:2\nR2:3\n");
+}
+
+TEST(FunctionalTest, MemoryBreakpoint) {
+    OS os(1, 0);
+    os.SetMode(Cpu::Mode::Functional);
+    std::queue<std::string> in({
+        "POKEDEBUGREGS D0 5",
+        "POKEDEBUGREGS D4 1",
+        "CONTINUE",
+        "REASON",
+        "PEEKREGS",
+        "PEEKDATA 5 1",
+        "CONTINUE",
+        "REASON",
+    });
+
+    std::vector<std::string> out;
+
+    os.SetDebuggerComms(std::make_unique<Comms>(in, out));
+
+    std::istringstream iss{
+R"(
+.text
+
+0 MOV R0, 5
+1 MOV [4], 2
+2 MOV [R0], 3
+3 HALT
+)"
+    };
+
+    Parser parser(iss);
+    Program p = parser.Parse();
+
+    ASSERT_TRUE(os.Run(std::move(p)));
+
+    auto it = out.begin();
+    ASSERT_EQ(*it++, "STOPPED");
+    ASSERT_EQ(*it++, "OK");
+    ASSERT_EQ(*it++, "OK");
+    ASSERT_EQ(*it++, "OK");
+    ASSERT_EQ(*it++, "STOPPED");
+    ASSERT_EQ(*it++, "HW_BKPT");
+    ASSERT_EQ(*it++, "IP:3\nBP:1024\nSP:1024\n"
+                     "R0:5\n");
+    ASSERT_EQ(*it++, "3\n");
+    ASSERT_EQ(*it++, "OK");
+    ASSERT_EQ(*it++, "STOPPED");
+    ASSERT_EQ(*it++, "HALT");
+}
+
+TEST(FunctionalTest, OutOfRange) {
+    auto run = [](const char* source) {
+        OS os(2, 1, 16);
+        os.SetMode(Cpu::Mode::Functional);
+        std::istringstream iss{source};
+        Parser parser(iss);
+        return os.Run(parser.Parse());
+    };
+    EXPECT_TRUE(run(".text\nMOV R1, 1\nMOV F0, 1.5\nMOV [15], 1\nHALT"));
+    EXPECT_FALSE(run(".text\nMOV R2, 1\nHALT"));
+    EXPECT_FALSE(run(".text\nMOV F1, 1.5\nHALT"));
+    EXPECT_FALSE(run(".text\nMOV [16], 1\nHALT"));
+    EXPECT_FALSE(run(".text\nMOV R0, [16]\nHALT"));
+}
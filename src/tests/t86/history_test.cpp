@@ -0,0 +1,118 @@
+#include <gtest/gtest.h>
+
+#include "t86/cpu.h"
+#include "t86/history.h"
+#include "utils.h"
+
+
+using namespace tiny::t86;
+
+namespace {
+// Echoes eight characters and prints their sum
+const char* echo = R"(
+.text
+0 MOV R2, 0
+1 GETCHAR R0
+2 PUTCHAR R0
+3 ADD R1, R0
+4 INC R2
+5 CMP R2, 8
+6 JL 1
+7 PUTNUM R1
+8 HALT
+)";
+
+void Finish(Cpu& cpu, History& history) {
+    while (!cpu.halted()) {
+        history.tick();
+        cpu.tick();
+    }
+}
+}
+
+TEST(HistoryTest, ReplaysTheInput) {
+    for (auto mode : {Cpu::Mode::Cycle, Cpu::Mode::Functional}) {
+        Sink sink("abcdefgh");
+        Cpu cpu(4, 1, 1024, sink.context);
+        cpu.setMode(mode);
+        cpu.start(Parse(echo));
+        History history(cpu, History::Options{4, 100});
+        Finish(cpu, history);
+        EXPECT_EQ(sink.output.str(), "abcdefgh804\n");
+        EXPECT_EQ(history.position(), 51);
+
+        for (int i = 0; i < 32; ++i) {
+            ASSERT_EQ(history.stepBack(), History::Stop::Step);
+        }
+        EXPECT_EQ(history.position(), 19);
+        EXPECT_FALSE(cpu.halted());
+        // Three characters were read, the fourth one is next
+        EXPECT_EQ(cpu.retiredProgramCounter(), 1);
+        EXPECT_EQ(cpu.getRegister(Register{2}), 3);
+
+        // The source has nothing left, the recorded input is read again
+        // and the output already printed is not printed twice
+        Finish(cpu, history);
+        EXPECT_EQ(sink.output.str(), "abcdefgh804\n");
+        EXPECT_EQ(cpu.getRegister(Register{1}), 804);
+    }
+}
+
+TEST(HistoryTest, GoesBackToTheStart) {
+    Sink sink("abcdefgh");
+    Cpu cpu(4, 1, 1024, sink.context);
+    cpu.start(Parse(echo));
+    History history(cpu, History::Options{4, 100});
+    EXPECT_EQ(history.stepBack(), History::Stop::Start);
+    Finish(cpu, history);
+    EXPECT_EQ(history.continueBack(), History::Stop::Start);
+    EXPECT_EQ(history.position(), 0);
+    EXPECT_EQ(cpu.retiredProgramCounter(), 0);
+    EXPECT_EQ(cpu.getRegister(Register{1}), 0);
+}
+
+TEST(HistoryTest, CheckpointsAreBounded) {
+    Sink sink("abcdefgh");
+    Cpu cpu(4, 1, 1024, sink.context);
+    cpu.start(Parse(echo));
+    History history(cpu, History::Options{1, 4});
+    Finish(cpu, history);
+    // The start and at most four periodic ones
+    EXPECT_LE(history.checkpoints(), 5);
+    EXPECT_GT(history.interval(), 1);
+
+    history.stepBack();
+    EXPECT_EQ(history.position(), 50);
+    EXPECT_EQ(cpu.retiredProgramCounter(), 8);
+}
+
+TEST(HistoryTest, KeepsTheTicksOfTheCycleModel) {
+    auto run = [](bool recorded) {
+        Sink sink;
+        Cpu cpu(4, 1, 1024, sink.context);
+        cpu.start(Parse(loop));
+        History history(cpu, History::Options{100, 100});
+        std::size_t ticks = 0;
+        while (!cpu.halted()) {
+            if (recorded) {
+                history.tick();
+            }
+            cpu.tick();
+            ++ticks;
+        }
+        EXPECT_EQ(sink.output.str(), loopOutput);
+        return std::make_pair(ticks, history.checkpoints());
+    };
+    auto [plain, none] = run(false);
+    auto [recorded, checkpoints] = run(true);
+    EXPECT_EQ(recorded, plain);
+    EXPECT_EQ(none, 0);
+    EXPECT_GT(checkpoints, 10);
+}
+
+TEST(HistoryTest, InvalidOptions) {
+    Sink sink("");
+    Cpu cpu(4, 1, 1024, sink.context);
+    EXPECT_THROW(History(cpu, History::Options{0, 4}), std::invalid_argument);
+    EXPECT_THROW(History(cpu, History::Options{4, 0}), std::invalid_argument);
+}
@@ -0,0 +1,112 @@
+#include <gtest/gtest.h>
+
+#include "t86/cpu.h"
+#include "t86/mapped_file.h"
+#include "t86/os.h"
+#include "utils.h"
+
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <vector>
+
+using namespace tiny::t86;
+
+namespace {
+// Sums the words from 1024 to 2024, overwrites the first of them and prints the data
+const char* sum = R"(
+.text
+0 MOV R0, 1024
+1 MOV R1, 0
+2 ADD R1, [R0]
+3 INC R0
+4 CMP R0, 2024
+5 JL 2
+6 MOV [1024], R1
+7 MOV R2, [1024]
+8 PUTNUM R2
+9 MOV R2, [1]
+10 PUTNUM R2
+11 HALT
+.data
+10
+11
+)";
+
+void WriteWords(const std::string& path, const std::vector<int64_t>& words) {
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(words.data()), words.size() * sizeof(int64_t));
+}
+
+std::vector<int64_t> Iota(std::size_t count) {
+    std::vector<int64_t> words(count);
+    std::iota(words.begin(), words.end(), 0);
+    return words;
+}
+}
+
+TEST(MappedFileTest, ProgramReadsTheFile) {
+    std::string path = TempFile("t86_mapped_file_test");
+    WriteWords(path, Iota(1000));
+    for (auto mode : {Cpu::Mode::Cycle, Cpu::Mode::Functional}) {
+        Sink sink;
+        OS os(sink.context, 4, 1, 4096);
+        os.SetMode(mode);
+        os.MapFile(1024, std::make_shared<MappedFile>(path));
+        EXPECT_TRUE(os.Run(Parse(sum)));
+        EXPECT_EQ(sink.output.str(), "499500\n11\n");
+    }
+    // The writes went into a copy of the page
+    MappedFile file(path);
+    ASSERT_EQ(file.words().size(), 1000);
+    EXPECT_EQ(file.words()[0], 0);
+    std::filesystem::remove(path);
+}
+
+TEST(MappedFileTest, WholePagesAreShared) {
+    std::string path = TempFile("t86_mapped_file_test");
+    WriteWords(path, Iota(2 * RAM::pageSize + 10));
+    auto file = std::make_shared<MappedFile>(path);
+    std::filesystem::remove(path);
+
+    RAM ram(8 * RAM::pageSize, 1);
+    ram.map(RAM::pageSize, file->words(), file);
+    // Only the page with the last ten words is a copy
+    EXPECT_EQ(ram.ownedPages(), 1);
+    EXPECT_EQ(ram.get(RAM::pageSize - 1), 0);
+    EXPECT_EQ(ram.get(RAM::pageSize + 5), 5);
+    EXPECT_EQ(ram.get(3 * RAM::pageSize + 9), 2 * RAM::pageSize + 9);
+    EXPECT_EQ(ram.get(3 * RAM::pageSize + 10), 0);
+
+    ram.set(RAM::pageSize + 5, -1);
+    EXPECT_EQ(ram.ownedPages(), 2);
+    EXPECT_EQ(ram.get(RAM::pageSize + 5), -1);
+    EXPECT_EQ(file->words()[5], 5);
+
+    // Not aligned to a page, the partial pages at both ends are copied
+    RAM other(8 * RAM::pageSize, 1);
+    other.map(7, file->words(), file);
+    EXPECT_EQ(other.ownedPages(), 2);
+    EXPECT_EQ(other.get(7 + RAM::pageSize), RAM::pageSize);
+}
+
+TEST(MappedFileTest, Invalid) {
+    std::string path = TempFile("t86_mapped_file_test");
+    EXPECT_THROW(MappedFile("/nonexistent/file"), std::runtime_error);
+    std::ofstream(path) << "12345";
+    EXPECT_THROW(MappedFile{path}, std::runtime_error);
+
+    WriteWords(path, {});
+    auto empty = std::make_shared<MappedFile>(path);
+    EXPECT_TRUE(empty->words().empty());
+
+    WriteWords(path, Iota(100));
+    auto file = std::make_shared<MappedFile>(path);
+    RAM ram(128, 1);
+    EXPECT_THROW(ram.map(29, file->words(), file), std::out_of_range);
+    ram.map(28, file->words(), file);
+    EXPECT_EQ(ram.get(127), 99);
+    std::filesystem::remove(path);
+}
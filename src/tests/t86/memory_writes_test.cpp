@@ -0,0 +1,68 @@
+#include <gtest/gtest.h>
+
+#include "t86/cpu/memory_writes_manager.h"
+
+using namespace tiny::t86;
+
+TEST(MemoryWritesTest, ForwardsLatestVisibleWrite) {
+    MemoryWritesManager manager;
+    auto first = manager.registerPendingWrite(10);
+    auto second = manager.registerPendingWrite(10);
+    manager.registerPendingWrite(20);
+    manager.specifyValue(first, 1);
+    manager.specifyValue(second, 2);
+
+    EXPECT_FALSE(manager.previousWrite(10, first - 1));
+    EXPECT_EQ(manager.previousWrite(10, first)->value(), 1);
+    EXPECT_EQ(manager.previousWrite(10, manager.currentMaxWriteId())->value(), 2);
+    EXPECT_FALSE(manager.previousWrite(30, manager.currentMaxWriteId()));
+}
+
+TEST(MemoryWritesTest, UnspecifiedAddressBlocksReads) {
+    MemoryWritesManager manager;
+    auto known = manager.registerPendingWrite(10);
+    auto unknown = manager.registerPendingWrite();
+
+    EXPECT_FALSE(manager.hasUnspecifiedWrites(known));
+    EXPECT_TRUE(manager.hasUnspecifiedWrites(unknown));
+    manager.specifyAddress(unknown, 10);
+    manager.specifyValue(unknown, 5);
+    EXPECT_FALSE(manager.hasUnspecifiedWrites(unknown));
+    EXPECT_EQ(manager.previousWrite(10, unknown)->value(), 5);
+}
+
+TEST(MemoryWritesTest, RemovePendingKeepsOutgoing) {
+    RAM ram(64, 1);
+    MemoryWritesManager manager;
+    auto outgoing = manager.registerPendingWrite(10);
+    manager.specifyValue(outgoing, 1);
+    manager.startWriting(outgoing, ram);
+    auto pending = manager.registerPendingWrite(10);
+    manager.registerPendingWrite();
+
+    manager.removePending();
+    EXPECT_FALSE(manager.hasUnspecifiedWrites(manager.currentMaxWriteId()));
+    EXPECT_EQ(manager.previousWrite(10, pending)->id(), outgoing);
+
+    // Ids keep increasing after the thrown away writes
+    auto next = manager.registerPendingWrite(11);
+    EXPECT_GT(next, pending);
+    EXPECT_EQ(manager.getWrite(next).address(), 11);
+}
+
+TEST(MemoryWritesTest, OnlyWritesInFlightAreKept) {
+    RAM ram(4096, 1);
+    MemoryWritesManager manager;
+    // Every write goes to a new address, the queue must not grow with them
+    for (std::size_t address = 0; address < 4096; ++address) {
+        auto id = manager.registerPendingWrite(address);
+        manager.specifyValue(id, address);
+        manager.startWriting(id, ram);
+        while (ram.pending(manager.getWrite(id).writeId())) {
+            ram.tick();
+        }
+        manager.removeFinished(ram);
+        EXPECT_EQ(manager.size(), 0);
+    }
+    EXPECT_EQ(ram.get(4095), 4095);
+}
@@ -0,0 +1,125 @@
+#include <gtest/gtest.h>
+
+#include "t86/cpu.h"
+#include "t86/parallel_simulator.h"
+#include "utils.h"
+
+#include <memory>
+#include <string>
+
+using namespace tiny::t86;
+
+namespace {
+std::shared_ptr<const Program> SharedLoop() {
+    return std::make_shared<const Program>(Parse(loop));
+}
+
+ParallelSimulator::CpuFactory Factory(const std::string& predictor) {
+    return [predictor](const Cpu::Context& context) {
+        auto cpu = std::make_unique<Cpu>(4, 1, 1024, context);
+        cpu->setBranchPredictor(BranchPredictor::create(predictor));
+        return cpu;
+    };
+}
+
+std::size_t ExactTicks(const std::string& predictor, Sink& sink) {
+    auto cpu = Factory(predictor)(sink.context);
+    cpu->start(Parse(loop));
+    while (!cpu->halted()) {
+        cpu->tick();
+    }
+    return sink.stats.tickCount();
+}
+}
+
+TEST(ParallelSimulatorTest, TicksMatchTheWholeRun) {
+    Sink exact(StatsLogger::Level::Counters);
+    std::size_t ticks = ExactTicks("ras", exact);
+
+    Sink parallel(StatsLogger::Level::Counters);
+    ParallelSimulator simulator(Factory("ras"), ParallelSimulator::Options{500, 100, 4});
+    auto result = simulator.run(SharedLoop(), parallel.context);
+
+    EXPECT_EQ(parallel.output.str(), loopOutput);
+    EXPECT_EQ(result.instructions, loopInstructions);
+    EXPECT_EQ(result.intervals, 14);
+    EXPECT_EQ(result.ticks, ticks);
+    EXPECT_GT(result.warmupTicks, 0);
+    EXPECT_EQ(parallel.stats.tickCount(), ticks);
+    EXPECT_EQ(parallel.stats.mispredictionCount(), exact.stats.mispredictionCount());
+    EXPECT_EQ(parallel.stats.retiredTotals().totalTime(), exact.stats.retiredTotals().totalTime());
+    // The instructions in flight at the ends of the intervals are counted twice
+    EXPECT_GE(parallel.stats.instructionCount(), exact.stats.instructionCount());
+    EXPECT_LT(parallel.stats.instructionCount(), exact.stats.instructionCount() + 14 * 16);
+}
+
+TEST(ParallelSimulatorTest, PredictorIsTrainedBeforeTheIntervals) {
+    Sink exact(StatsLogger::Level::Counters);
+    std::size_t ticks = ExactTicks("gshare", exact);
+
+    Sink parallel(StatsLogger::Level::Counters);
+    ParallelSimulator simulator(Factory("gshare"), ParallelSimulator::Options{500, 100, 4});
+    auto result = simulator.run(SharedLoop(), parallel.context);
+    EXPECT_NEAR(static_cast<double>(result.ticks), static_cast<double>(ticks), 0.001 * ticks);
+}
+
+TEST(ParallelSimulatorTest, WithoutWarmupOnlyTheBoundariesDiffer) {
+    Sink exact(StatsLogger::Level::Counters);
+    std::size_t ticks = ExactTicks("naive", exact);
+
+    Sink parallel(StatsLogger::Level::Counters);
+    ParallelSimulator simulator(Factory("naive"), ParallelSimulator::Options{500, 0, 2});
+    auto result = simulator.run(SharedLoop(), parallel.context);
+    EXPECT_GE(result.ticks, ticks);
+    EXPECT_LT(result.ticks, ticks + 20 * result.intervals);
+    EXPECT_EQ(result.warmupTicks, 0);
+}
+
+TEST(ParallelSimulatorTest, ShortProgramIsOneInterval) {
+    Sink exact(StatsLogger::Level::Counters);
+    std::size_t ticks = ExactTicks("naive", exact);
+
+    Sink parallel(StatsLogger::Level::Counters);
+    ParallelSimulator simulator(Factory("naive"), ParallelSimulator::Options{100'000, 1000, 4});
+    auto result = simulator.run(SharedLoop(), parallel.context);
+    EXPECT_EQ(result.intervals, 1);
+    EXPECT_EQ(result.ticks, ticks);
+    EXPECT_EQ(parallel.output.str(), loopOutput);
+}
+
+TEST(ParallelSimulatorTest, CheckpointContinuesTheRun) {
+    Sink first(StatsLogger::Level::Counters);
+    Cpu cpu(4, 1, 1024, first.context);
+    cpu.setMode(Cpu::Mode::Functional);
+    cpu.start(Parse(loop));
+    while (cpu.retiredInstructions() < 3000) {
+        cpu.tick();
+    }
+    Cpu::Checkpoint checkpoint = cpu.checkpoint();
+    EXPECT_EQ(checkpoint.retiredInstructions, 3000);
+    // The checkpoint shares the pages, the run copies the ones it writes
+    cpu.setMemory(42, 0);
+
+    Sink second(StatsLogger::Level::Counters);
+    Cpu restored(4, 1, 1024, second.context);
+    restored.start(Parse(loop));
+    restored.restore(checkpoint);
+    EXPECT_EQ(restored.getMemory(42), 42);
+    EXPECT_EQ(restored.ownedRamPages(), 0);
+    while (!restored.halted()) {
+        restored.tick();
+    }
+    EXPECT_EQ(second.output.str(), loopOutput);
+    EXPECT_EQ(restored.retiredInstructions(), loopInstructions);
+
+    Cpu other(5, 1, 1024, second.context);
+    EXPECT_THROW(other.restore(checkpoint), std::invalid_argument);
+}
+
+TEST(ParallelSimulatorTest, InvalidOptions) {
+    EXPECT_THROW(ParallelSimulator(Factory("naive"), ParallelSimulator::Options{0, 0, 1}), std::invalid_argument);
+
+    Sink full(StatsLogger::Level::Full);
+    ParallelSimulator simulator(Factory("naive"), ParallelSimulator::Options{});
+    EXPECT_THROW(simulator.run(SharedLoop(), full.context), std::invalid_argument);
+}
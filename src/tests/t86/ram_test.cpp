@@ -0,0 +1,134 @@
+#include <gtest/gtest.h>
+
+#include "t86/ram.h"
+
+#include <memory>
+#include <vector>
+
+using namespace tiny::t86;
+
+namespace {
+/// Ticks until the read of the address is ready, starting it first.
+std::size_t TicksToRead(RAM& ram, std::size_t address) {
+    EXPECT_FALSE(ram.read(address));
+    std::size_t ticks = 0;
+    while (!ram.read(address)) {
+        ram.tick();
+        ++ticks;
+    }
+    return ticks;
+}
+
+std::size_t TicksToWrite(RAM& ram, std::size_t address) {
+    RAM::WriteId id = ram.write(address, 1);
+    std::size_t ticks = 0;
+    while (ram.pending(id)) {
+        ram.tick();
+        ++ticks;
+    }
+    return ticks;
+}
+}
+
+TEST(RamTest, DefaultLatency) {
+    RAM ram(64, 2);
+    ram.set(3, 42);
+    EXPECT_EQ(TicksToRead(ram, 3), 5);
+    EXPECT_EQ(*ram.read(3), 42);
+    // The finished write lingers for one more tick
+    EXPECT_EQ(TicksToWrite(ram, 4), 6);
+}
+
+TEST(RamTest, GatesLimitReads) {
+    RAM ram(64, 2);
+    EXPECT_FALSE(ram.read(0));
+    EXPECT_FALSE(ram.read(1));
+    EXPECT_TRUE(ram.isBusy());
+    EXPECT_FALSE(ram.read(2));
+    for (int i = 0; i < 6; ++i) {
+        ram.tick();
+    }
+    // The gates are free again once the reads are gone
+    EXPECT_FALSE(ram.isBusy());
+}
+
+TEST(RamTest, BankedLatency) {
+    RAM ram(64, 4);
+    ram.setLatencyPolicy(std::make_shared<BankedRamLatency>(
+        std::vector<BankedRamLatency::Bank>{{1, 2}, {10, 20}}));
+    EXPECT_EQ(TicksToRead(ram, 4), 1);
+    EXPECT_EQ(TicksToRead(ram, 5), 10);
+    EXPECT_EQ(TicksToWrite(ram, 6), 3);
+    EXPECT_EQ(TicksToWrite(ram, 7), 21);
+}
+
+TEST(RamTest, RegionLatencyLongerThanWheel) {
+    RAM ram(1024, 4);
+    ram.setLatencyPolicy(std::make_shared<RegionRamLatency>(
+        std::vector<RegionRamLatency::Region>{{512, 1024, 200, 300}}, UniformRamLatency{2, 3}));
+    EXPECT_EQ(TicksToRead(ram, 0), 2);
+    EXPECT_EQ(TicksToRead(ram, 600), 200);
+    EXPECT_EQ(TicksToWrite(ram, 1), 4);
+    EXPECT_EQ(TicksToWrite(ram, 700), 301);
+}
+
+TEST(RamTest, SkippedTicksCountDown) {
+    RAM ram(64, 1);
+    EXPECT_FALSE(ram.read(0));
+    std::size_t idle = ram.idleTicks();
+    EXPECT_EQ(idle, 4);
+    ram.skipTicks(idle);
+    EXPECT_FALSE(ram.read(0));
+    ram.tick();
+    EXPECT_TRUE(ram.read(0));
+}
+
+TEST(RamTest, PagesAllocatedOnWrite) {
+    // 8 GiB of words, only the written pages are allocated
+    RAM ram(std::size_t{1} << 30, 1);
+    EXPECT_EQ(ram.ownedPages(), 0);
+    EXPECT_EQ(ram.get(12345678), 0);
+    EXPECT_EQ(TicksToRead(ram, 999999999), 5);
+    EXPECT_EQ(*ram.read(999999999), 0);
+    EXPECT_EQ(ram.ownedPages(), 0);
+
+    ram.set(ram.size() - 1, 7);
+    TicksToWrite(ram, 3 * RAM::pageSize);
+    EXPECT_EQ(ram.ownedPages(), 2);
+    EXPECT_EQ(ram.get(ram.size() - 1), 7);
+    EXPECT_EQ(ram.get(3 * RAM::pageSize), 1);
+    EXPECT_EQ(ram.get(3 * RAM::pageSize + 1), 0);
+    EXPECT_THROW(ram.set(ram.size(), 1), std::out_of_range);
+    EXPECT_THROW(ram.get(ram.size()), std::out_of_range);
+
+    // The zeros of untouched pages are not loaded
+    std::vector<int64_t> values(4 * RAM::pageSize, 0);
+    values[1] = 2;
+    ram.load(values);
+    EXPECT_EQ(ram.ownedPages(), 3);
+    EXPECT_EQ(ram.get(1), 2);
+    EXPECT_EQ(ram.get(3 * RAM::pageSize), 0);
+}
+
+TEST(RamTest, ImageSharesThePages) {
+    RAM ram(std::size_t{1} << 30, 1);
+    ram.set(5, 1);
+    ram.set(ram.size() - 1, 2);
+    RAM::Image image = ram.image();
+    EXPECT_EQ(ram.ownedPages(), 0);
+    EXPECT_EQ(image.pages.front()->at(5), 1);
+
+    // The RAM copies the page, the image keeps the value
+    ram.set(5, 3);
+    EXPECT_EQ(ram.ownedPages(), 1);
+    EXPECT_EQ(image.pages.front()->at(5), 1);
+
+    RAM restored(std::size_t{1} << 30, 1);
+    restored.restore(image);
+    EXPECT_EQ(restored.ownedPages(), 0);
+    EXPECT_EQ(restored.get(5), 1);
+    EXPECT_EQ(restored.get(restored.size() - 1), 2);
+    EXPECT_EQ(restored.get(12345678), 0);
+    restored.set(6, 4);
+    EXPECT_EQ(image.pages.front()->at(6), 0);
+}
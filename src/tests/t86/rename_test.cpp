@@ -0,0 +1,95 @@
+#include <gtest/gtest.h>
+
+#include "t86/cpu.h"
+#include "t86/cpu/register_allocation_table.h"
+#include "t86/execution_error.h"
+#include "t86/utils/stats_logger.h"
+#include "t86-parser/parser.h"
+
+#include <iostream>
+#include <sstream>
+
+using namespace tiny::t86;
+
+TEST(RenameTest, TableStartsWithIdentity) {
+    RegisterAllocationTable rat(3, 2);
+    ASSERT_EQ(rat.size(), 3 + 2 + 4);
+    EXPECT_EQ(rat.translate(Register{2}).index(), 2);
+    EXPECT_EQ(rat.translate(FloatRegister{0}).index(), 3);
+    EXPECT_EQ(rat.translate(Register::ProgramCounter()).index(), 5);
+    EXPECT_EQ(rat.translate(Register::Flags()).index(), 8);
+}
+
+TEST(RenameTest, RenameReturnsPrevious) {
+    RegisterAllocationTable rat(3, 2);
+    auto first = rat.rename(Register{1}, PhysicalRegister{20});
+    EXPECT_EQ(first.previous.index(), 1);
+    auto second = rat.rename(Register{1}, PhysicalRegister{21});
+    EXPECT_EQ(second.previous.index(), 20);
+    EXPECT_EQ(rat.translate(Register{1}).index(), 21);
+
+    RegisterAllocationTable retired(3, 2);
+    retired.apply(first);
+    EXPECT_EQ(retired.translate(Register{1}).index(), 20);
+}
+
+TEST(RenameTest, OutOfRange) {
+    RegisterAllocationTable rat(3, 2);
+    EXPECT_THROW(rat.translate(Register{3}), T86ExecutionError);
+    EXPECT_THROW(rat.rename(FloatRegister{2}, PhysicalRegister{20}), T86ExecutionError);
+}
+
+TEST(RenameTest, AllRegistersFreedAfterRun) {
+    // Misses the prediction on every iteration, so the speculation
+    // is thrown away a lot
+    std::istringstream iss(R"(
+.text
+0 MOV R0, 0
+1 MOV R1, 0
+2 ADD R1, R0
+3 INC R0
+4 CMP R0, 200
+5 JL 2
+6 HALT
+)");
+    Parser parser(iss);
+    Program program = parser.Parse();
+
+    StatsLogger::instance().reset();
+    // Many registers and entries, this used to be quadratic
+    Cpu cpu(256, 64, 4, 256, 1024, 4);
+    cpu.start(std::move(program));
+    std::size_t mapped = 256 + 64 + Cpu::specialRegistersCnt;
+    ASSERT_EQ(cpu.freePhysicalRegistersCount(), cpu.physicalRegistersCount() - mapped);
+    while (!cpu.halted()) {
+        cpu.tick();
+    }
+    EXPECT_EQ(cpu.getRegister(Register{1}), 199 * 200 / 2);
+    EXPECT_EQ(cpu.freePhysicalRegistersCount(), cpu.physicalRegistersCount() - mapped);
+}
+
+TEST(RenameTest, GetcharWritesItsRename) {
+    // GETCHAR writes its register on retirement, after its renames retired
+    std::istringstream iss(R"(
+.text
+0 GETCHAR R0
+1 GETCHAR R1
+2 ADD R0, R1
+3 HALT
+)");
+    Parser parser(iss);
+    Program program = parser.Parse();
+
+    std::istringstream input("ab");
+    auto* old = std::cin.rdbuf(input.rdbuf());
+    StatsLogger::instance().reset();
+    Cpu cpu(4, 1, 1024);
+    cpu.start(std::move(program));
+    std::size_t mapped = 4 + 1 + Cpu::specialRegistersCnt;
+    while (!cpu.halted()) {
+        cpu.tick();
+    }
+    std::cin.rdbuf(old);
+    EXPECT_EQ(cpu.getRegister(Register{0}), 'a' + 'b');
+    EXPECT_EQ(cpu.freePhysicalRegistersCount(), cpu.physicalRegistersCount() - mapped);
+}
@@ -0,0 +1,76 @@
+#include <gtest/gtest.h>
+
+#include "t86/cpu.h"
+#include "t86/sampler.h"
+#include "utils.h"
+
+#include <cmath>
+
+using namespace tiny::t86;
+
+TEST(SamplerTest, EstimatesTheTicks) {
+    Sink exact;
+    Cpu cpu(4, 1, 1024, exact.context);
+    cpu.setBranchPredictor(BranchPredictor::create("ras"));
+    cpu.start(Parse(loop));
+    while (!cpu.halted()) {
+        cpu.tick();
+    }
+
+    Sink sampled;
+    Cpu sampledCpu(4, 1, 1024, sampled.context);
+    sampledCpu.setBranchPredictor(BranchPredictor::create("ras"));
+    Sampler sampler(sampledCpu, Sampler::Options{200, 50, 20});
+    sampledCpu.start(Parse(loop));
+    Sampler::Estimate estimate = sampler.run();
+
+    EXPECT_EQ(sampled.output.str(), exact.output.str());
+    EXPECT_EQ(sampled.output.str(), loopOutput);
+    EXPECT_EQ(estimate.instructions, cpu.retiredInstructions());
+    EXPECT_GT(estimate.samples, 10);
+    EXPECT_LT(estimate.detailedTicks, exact.stats.tickCount() / 2);
+    double error = std::abs(estimate.ticks - static_cast<double>(exact.stats.tickCount()));
+    EXPECT_LT(error, 0.05 * exact.stats.tickCount());
+    EXPECT_GT(estimate.confidence, 0);
+}
+
+TEST(SamplerTest, ExactWithoutFastForward) {
+    Sink exact(StatsLogger::Level::Full);
+    Cpu cpu(4, 1, 1024, exact.context);
+    cpu.start(Parse(loop));
+    while (!cpu.halted()) {
+        cpu.tick();
+    }
+
+    Sink sampled(StatsLogger::Level::Full);
+    Cpu sampledCpu(4, 1, 1024, sampled.context);
+    // The period has no room for the functional engine
+    Sampler::Estimate estimate = [&]() {
+        Sampler sampler(sampledCpu, Sampler::Options{70, 50, 20});
+        sampledCpu.start(Parse(loop));
+        return sampler.run();
+    }();
+    EXPECT_EQ(estimate.ticks, exact.stats.tickCount());
+    EXPECT_EQ(estimate.confidence, 0);
+    EXPECT_EQ(sampled.output.str(), exact.output.str());
+}
+
+TEST(SamplerTest, SwitchingModesKeepsTheProgramCorrect) {
+    Sink run(StatsLogger::Level::Full);
+    Cpu cpu(4, 1, 1024, run.context);
+    cpu.start(Parse(loop));
+    for (std::size_t tick = 0; !cpu.halted(); ++tick) {
+        // Leaves the cycle model with instructions and memory accesses in flight
+        if (tick % 7 == 0) {
+            cpu.setMode(cpu.mode() == Cpu::Mode::Cycle ? Cpu::Mode::Functional : Cpu::Mode::Cycle);
+        }
+        cpu.tick();
+    }
+    EXPECT_EQ(run.output.str(), loopOutput);
+}
+
+TEST(SamplerTest, WindowMustFitIntoThePeriod) {
+    Cpu cpu(4, 1, 1024);
+    EXPECT_THROW(Sampler(cpu, Sampler::Options{100, 90, 20}), std::invalid_argument);
+    EXPECT_THROW(Sampler(cpu, Sampler::Options{100, 0, 20}), std::invalid_argument);
+}
@@ -0,0 +1,73 @@
+#include <gtest/gtest.h>
+
+#include "t86/cpu.h"
+#include "t86/utils/stats_logger.h"
+#include "t86-parser/parser.h"
+
+#include <sstream>
+#include <string>
+
+using namespace tiny::t86;
+
+namespace {
+// Walks a linked list stored in the data section, each load
+// depends on the previous one, so most ticks wait for the RAM
+const char* pointerChase = R"(
+.data
+2 4 6 8 10 12 14 16 18 20 22 24 26 28 30 0
+.text
+0 MOV R1, 0
+1 MOV R2, 0
+2 MOV R0, [R0]
+3 MUL R1, R0
+4 ADD R2, R0
+5 CMP R0, 0
+6 JNE 2
+7 HALT
+)";
+
+struct RunResult {
+    std::size_t calls;
+    std::size_t ticks;
+    int64_t sum;
+    std::string stats;
+};
+
+std::string Stats() {
+    std::ostringstream oss;
+    StatsLogger::instance().processBasicStats(oss);
+    StatsLogger::instance().processDetailedStats(oss);
+    return oss.str();
+}
+
+RunResult RunChase(bool skip) {
+    std::istringstream iss{pointerChase};
+    Parser parser(iss);
+    Program program = parser.Parse();
+
+    StatsLogger::instance().reset();
+    Cpu cpu(4, 1, 2, 4, 64, 1);
+    cpu.setSkipIdleTicks(skip);
+    cpu.start(std::move(program));
+    std::size_t calls = 0;
+    while (!cpu.halted()) {
+        cpu.tick();
+        ++calls;
+    }
+    // The stats point to the instructions of the program, which is owned by the cpu
+    return {calls, StatsLogger::instance().tickCount(), cpu.getRegister(Register{2}), Stats()};
+}
+
+}
+
+TEST(SkipIdleTest, SameTicksAndStats) {
+    RunResult normal = RunChase(false);
+    RunResult skipped = RunChase(true);
+
+    EXPECT_EQ(normal.sum, 2 + 6 + 14 + 30);
+    EXPECT_EQ(skipped.sum, normal.sum);
+    EXPECT_EQ(normal.calls, normal.ticks);
+    EXPECT_EQ(skipped.ticks, normal.ticks);
+    EXPECT_LT(skipped.calls, normal.calls);
+    EXPECT_EQ(skipped.stats, normal.stats);
+}
@@ -0,0 +1,224 @@
+#include <gtest/gtest.h>
+
+#include "t86/cpu.h"
+#include "t86/os.h"
+#include "t86/snapshot.h"
+#include "utils.h"
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+using namespace tiny::t86;
+
+namespace {
+void SaveAndContinue(Cpu::Mode mode) {
+    std::string path = TempFile("t86_snapshot_test");
+    Sink first;
+    Cpu cpu(4, 1, 1024, first.context);
+    cpu.setMode(mode);
+    cpu.start(Parse(loop));
+    cpu.setFloatRegister(FloatRegister{0}, 2.5);
+    cpu.setDebugRegister(0, 7);
+    while (cpu.retiredInstructions() < 3000) {
+        cpu.tick();
+    }
+    cpu.squash();
+    Snapshot::save(cpu, path);
+
+    Snapshot snapshot(path);
+    EXPECT_EQ(snapshot.registersCount(), 4);
+    EXPECT_EQ(snapshot.floatRegistersCount(), 1);
+    EXPECT_EQ(snapshot.ramSize(), 1024);
+    EXPECT_EQ(snapshot.retiredInstructions(), cpu.retiredInstructions());
+
+    Sink second;
+    Cpu restored(4, 1, 1024, second.context);
+    restored.setMode(mode);
+    snapshot.restore(restored);
+    EXPECT_EQ(restored.getFloatRegister(FloatRegister{0}), 2.5);
+    EXPECT_EQ(restored.getDebugRegister(0), 7);
+    EXPECT_EQ(restored.getMemory(42), 42);
+    while (!restored.halted()) {
+        restored.tick();
+    }
+    EXPECT_EQ(second.output.str(), loopOutput);
+    EXPECT_EQ(restored.retiredInstructions(), loopInstructions);
+    std::filesystem::remove(path);
+}
+
+std::string OpenError(const std::string& path) {
+    try {
+        Snapshot snapshot(path);
+    } catch (const std::runtime_error& e) {
+        return e.what();
+    }
+    return "";
+}
+}
+
+TEST(SnapshotTest, FunctionalRunContinues) {
+    SaveAndContinue(Cpu::Mode::Functional);
+}
+
+TEST(SnapshotTest, CycleRunContinues) {
+    SaveAndContinue(Cpu::Mode::Cycle);
+}
+
+TEST(SnapshotTest, SquashKeepsTheProgramCorrect) {
+    Sink run;
+    Cpu cpu(4, 1, 1024, run.context);
+    cpu.start(Parse(loop));
+    for (std::size_t tick = 0; !cpu.halted(); ++tick) {
+        // Longer than an instruction takes to go through the pipeline, so that the run progresses
+        if (tick % 37 == 0) {
+            cpu.squash();
+        }
+        cpu.tick();
+    }
+    EXPECT_EQ(run.output.str(), loopOutput);
+    EXPECT_EQ(cpu.retiredInstructions(), loopInstructions);
+}
+
+TEST(SnapshotTest, PatchedTextIsSaved) {
+    std::string path = TempFile("t86_snapshot_patched_test");
+    Sink first;
+    Cpu cpu(4, 1, 1024, first.context);
+    cpu.start(Parse(loop));
+    auto patch = Parse(".text\nPUTNUM R0").moveInstructions();
+    cpu.setText(13, std::move(patch.at(0)));
+    Snapshot::save(cpu, path);
+
+    Sink second;
+    Cpu restored(4, 1, 1024, second.context);
+    Snapshot(path).restore(restored);
+    EXPECT_EQ(restored.textSize(), 18);
+    EXPECT_EQ(restored.getText(13).toString(), "PUTNUM R0");
+    while (!restored.halted()) {
+        restored.tick();
+    }
+    EXPECT_EQ(second.output.str(), "500\n");
+    std::filesystem::remove(path);
+}
+
+TEST(SnapshotTest, OsSavesAtTheProgramCounter) {
+    std::string path = TempFile("t86_snapshot_os_test");
+    Sink first;
+    OS os(first.context, 4, 1, 1024);
+    os.SetMode(Cpu::Mode::Functional);
+    os.SaveSnapshotAt(Snapshot::Trigger{Snapshot::Trigger::Kind::ProgramCounter, 13}, path);
+    EXPECT_TRUE(os.Run(Parse(loop)));
+    EXPECT_EQ(first.output.str(), loopOutput);
+
+    Snapshot snapshot(path);
+    EXPECT_EQ(snapshot.retiredInstructions(), loopInstructions - 2);
+    Sink second;
+    OS restored(second.context, 4, 1, 1024);
+    EXPECT_TRUE(restored.Run(snapshot));
+    EXPECT_EQ(second.output.str(), loopOutput);
+
+    Cpu other(5, 1, 1024, second.context);
+    EXPECT_THROW(snapshot.restore(other), std::invalid_argument);
+    std::filesystem::remove(path);
+}
+
+TEST(SnapshotTest, RestoredRamSharesTheFile) {
+    std::string path = TempFile("t86_snapshot_pages_test");
+    const std::size_t ramSize = 1 << 16;
+    Sink first;
+    Cpu cpu(4, 1, ramSize, first.context);
+    cpu.setMode(Cpu::Mode::Functional);
+    cpu.start(Parse(loop));
+    while (cpu.retiredInstructions() < 3000) {
+        cpu.tick();
+    }
+    Snapshot::save(cpu, path);
+
+    Sink second;
+    Cpu restored(4, 1, ramSize, second.context);
+    restored.setMode(Cpu::Mode::Functional);
+    // The mapping outlives the snapshot as long as the RAM uses it
+    Snapshot(path).restore(restored);
+    std::filesystem::remove(path);
+    EXPECT_EQ(restored.ownedRamPages(), 0);
+    EXPECT_EQ(restored.getMemory(42), 42);
+    Finish(restored);
+    EXPECT_EQ(second.output.str(), loopOutput);
+    // The rest of the run only writes the stack, only its page was copied
+    EXPECT_EQ(restored.ownedRamPages(), 1);
+}
+
+TEST(SnapshotTest, OnlyWrittenPagesAreStored) {
+    std::string path = TempFile("t86_snapshot_sparse_test");
+    // 8 GiB of words
+    const std::size_t ramSize = std::size_t{1} << 30;
+    Sink first;
+    Cpu cpu(4, 1, ramSize, first.context);
+    cpu.setMode(Cpu::Mode::Functional);
+    cpu.start(Parse(loop));
+    while (cpu.retiredInstructions() < 3000) {
+        cpu.tick();
+    }
+    // Written back to zeros, not stored
+    cpu.setMemory(ramSize / 2, 1);
+    cpu.setMemory(ramSize / 2, 0);
+    Snapshot::save(cpu, path);
+    // The page of the data, the one of the stack and the text
+    EXPECT_LT(std::filesystem::file_size(path), 4 * RAM::pageSize * sizeof(int64_t));
+
+    Snapshot snapshot(path);
+    EXPECT_EQ(snapshot.ramSize(), ramSize);
+    Sink second;
+    Cpu restored(4, 1, ramSize, second.context);
+    restored.setMode(Cpu::Mode::Functional);
+    snapshot.restore(restored);
+    std::filesystem::remove(path);
+    EXPECT_EQ(restored.getMemory(42), 42);
+    EXPECT_EQ(restored.getMemory(ramSize / 2), 0);
+    Finish(restored);
+    EXPECT_EQ(second.output.str(), loopOutput);
+}
+
+TEST(SnapshotTest, ParsesTriggers) {
+    auto tick = Snapshot::Trigger::parse("tick:100");
+    EXPECT_EQ(tick.kind, Snapshot::Trigger::Kind::Tick);
+    EXPECT_EQ(tick.value, 100);
+    EXPECT_EQ(Snapshot::Trigger::parse("42").value, 42);
+    auto pc = Snapshot::Trigger::parse("pc:7");
+    EXPECT_EQ(pc.kind, Snapshot::Trigger::Kind::ProgramCounter);
+    EXPECT_EQ(pc.value, 7);
+    EXPECT_THROW(Snapshot::Trigger::parse("ip:7"), std::invalid_argument);
+    EXPECT_THROW(Snapshot::Trigger::parse("tick:"), std::invalid_argument);
+}
+
+TEST(SnapshotTest, RejectsOtherFiles) {
+    std::string path = TempFile("t86_snapshot_invalid_test");
+    {
+        std::ofstream file(path);
+        file << ".text\nHALT\n";
+    }
+    EXPECT_THROW(Snapshot{path}, std::runtime_error);
+    std::filesystem::remove(path);
+    EXPECT_THROW(Snapshot{path}, std::runtime_error);
+}
+
+TEST(SnapshotTest, ChecksTheVersionBeforeTheLayout) {
+    std::string path = TempFile("t86_snapshot_version_test");
+    const char magic[8] = {'T', '8', '6', 'S', 'N', 'A', 'P', '\0'};
+    {
+        // Only the magic and the version, the header of another version may be shorter
+        std::ofstream file(path, std::ios::binary);
+        uint64_t version = Snapshot::version + 1;
+        file.write(magic, sizeof(magic));
+        file.write(reinterpret_cast<const char*>(&version), sizeof(version));
+    }
+    EXPECT_NE(OpenError(path).find("has version " + std::to_string(Snapshot::version + 1)), std::string::npos);
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        uint64_t version = Snapshot::version;
+        file.write(magic, sizeof(magic));
+        file.write(reinterpret_cast<const char*>(&version), sizeof(version));
+    }
+    EXPECT_NE(OpenError(path).find("is damaged"), std::string::npos);
+    std::filesystem::remove(path);
+}
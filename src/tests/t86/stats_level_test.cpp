@@ -0,0 +1,112 @@
+#include <gtest/gtest.h>
+
+#include "t86/cpu.h"
+#include "t86/utils/stats_logger.h"
+#include "t86-parser/parser.h"
+
+#include <sstream>
+#include <stdexcept>
+
+using namespace tiny::t86;
+
+namespace {
+// Memory reads, a call and a data dependent conditional jump,
+// so that every kind of stall and some mispredictions show up
+const char* loopWithCall = R"(
+.text
+0 MOV R0, 0
+1 MOV R1, 0
+2 MOV [R1], R1
+3 CALL 11
+4 ADD R0, [R1]
+5 ADD R1, 1
+6 MOV R2, R1
+7 AND R2, 3
+8 CMP R1, 30
+9 JL 2
+10 HALT
+11 CMP R2, 0
+12 JE 14
+13 ADD R0, 1
+14 RET
+)";
+
+struct RunResult {
+    std::size_t ticks;
+    std::string stats;
+};
+
+RunResult RunWithLevel(StatsLogger::Level level, bool skipIdleTicks) {
+    std::istringstream iss{loopWithCall};
+    Parser parser(iss);
+    Program program = parser.Parse();
+
+    StatsLogger::instance().setLevel(level);
+    Cpu cpu(4, 1, 2, 8, 64, 2);
+    cpu.setBranchPredictor(BranchPredictor::create("gshare"));
+    cpu.setSkipIdleTicks(skipIdleTicks);
+    cpu.start(std::move(program));
+    while (!cpu.halted()) {
+        cpu.tick();
+    }
+    std::ostringstream stats;
+    StatsLogger::instance().processBasicStats(stats);
+    StatsLogger::instance().processDetailedStats(stats);
+    RunResult result{StatsLogger::instance().tickCount(), stats.str()};
+    StatsLogger::instance().setLevel(StatsLogger::Level::Full);
+    return result;
+}
+}
+
+TEST(StatsLevelTest, CountersPrintTheSameStats) {
+    RunResult full = RunWithLevel(StatsLogger::Level::Full, false);
+    RunResult counters = RunWithLevel(StatsLogger::Level::Counters, false);
+    EXPECT_EQ(counters.ticks, full.ticks);
+    EXPECT_EQ(counters.stats, full.stats);
+    EXPECT_NE(full.stats.find("Average memory read stalls"), std::string::npos);
+    EXPECT_NE(full.stats.find("Jump at 9"), std::string::npos);
+}
+
+TEST(StatsLevelTest, CountersRepeatSkippedTicks) {
+    RunResult full = RunWithLevel(StatsLogger::Level::Full, false);
+    RunResult counters = RunWithLevel(StatsLogger::Level::Counters, true);
+    EXPECT_EQ(counters.ticks, full.ticks);
+    EXPECT_EQ(counters.stats, full.stats);
+}
+
+TEST(StatsLevelTest, ProcessingThreadsDoNotChangeStats) {
+    StatsLogger::instance().setProcessingThreads(1);
+    RunResult single = RunWithLevel(StatsLogger::Level::Full, false);
+    StatsLogger::instance().setProcessingThreads(4);
+    RunResult parallel = RunWithLevel(StatsLogger::Level::Full, false);
+    StatsLogger::instance().setProcessingThreads(0);
+    EXPECT_EQ(parallel.stats, single.stats);
+}
+
+TEST(StatsLevelTest, OffOnlyCountsTicks) {
+    RunResult full = RunWithLevel(StatsLogger::Level::Full, false);
+
+    std::istringstream iss{loopWithCall};
+    Parser parser(iss);
+    StatsLogger::instance().setLevel(StatsLogger::Level::Off);
+    Cpu cpu(4, 1, 2, 8, 64, 2);
+    cpu.setBranchPredictor(BranchPredictor::create("gshare"));
+    cpu.start(parser.Parse());
+    while (!cpu.halted()) {
+        cpu.tick();
+    }
+    auto& logger = StatsLogger::instance();
+    EXPECT_EQ(logger.tickCount(), full.ticks);
+    EXPECT_EQ(logger.instructionCount(), 0);
+    EXPECT_EQ(logger.mispredictionCount(), 0);
+    EXPECT_EQ(logger.flushCount(), 0);
+    EXPECT_TRUE(logger.branchStats().empty());
+    logger.setLevel(StatsLogger::Level::Full);
+}
+
+TEST(StatsLevelTest, ParseLevel) {
+    EXPECT_EQ(StatsLogger::parseLevel("off"), StatsLogger::Level::Off);
+    EXPECT_EQ(StatsLogger::parseLevel("counters"), StatsLogger::Level::Counters);
+    EXPECT_EQ(StatsLogger::parseLevel("full"), StatsLogger::Level::Full);
+    EXPECT_THROW(StatsLogger::parseLevel("verbose"), std::invalid_argument);
+}
@@ -0,0 +1,104 @@
+#include <gtest/gtest.h>
+
+#include "t86/cpu.h"
+#include "t86/utils/stats_logger.h"
+#include "t86/utils/trace_writer.h"
+#include "t86-parser/parser.h"
+
+#include <sstream>
+#include <stdexcept>
+
+using namespace tiny::t86;
+
+namespace {
+// A loop over memory, every jump back is mispredicted by the naive predictor
+const char* loop = R"(
+.text
+0 MOV R0, 0
+1 MOV R1, 0
+2 MOV [R1], R1
+3 ADD R0, [R1]
+4 ADD R1, 1
+5 CMP R1, 10
+6 JL 2
+7 HALT
+)";
+
+struct Trace {
+    std::string text;
+    std::size_t instructions;
+};
+
+Trace RunTraced(const std::string& format, bool skipIdleTicks) {
+    std::istringstream iss{loop};
+    Parser parser(iss);
+
+    // The writer owns the stream, the buffer outlives it
+    std::stringbuf buffer;
+    auto& logger = StatsLogger::instance();
+    logger.setLevel(StatsLogger::Level::Full);
+    logger.setTraceWriter(TraceWriter::create(format, std::make_unique<std::ostream>(&buffer)));
+    Cpu cpu(4, 1, 1, 4, 64, 1);
+    cpu.setSkipIdleTicks(skipIdleTicks);
+    cpu.start(parser.Parse());
+    while (!cpu.halted()) {
+        cpu.tick();
+    }
+    logger.setTraceWriter(nullptr);
+    return {buffer.str(), logger.instructionCount()};
+}
+
+std::size_t CountLines(const std::string& text, const std::string& prefix) {
+    std::istringstream lines{text};
+    std::size_t count = 0;
+    for (std::string line; std::getline(lines, line);) {
+        if (line.rfind(prefix, 0) == 0) {
+            ++count;
+        }
+    }
+    return count;
+}
+}
+
+TEST(TraceWriterTest, KonataRetiresAndSquashes) {
+    Trace trace = RunTraced("konata", false);
+    ASSERT_EQ(trace.text.rfind("Kanata\t0004\n", 0), 0);
+    std::size_t fetched = CountLines(trace.text, "I\t");
+    std::size_t committed = 0;
+    std::size_t flushed = 0;
+    std::istringstream lines{trace.text};
+    for (std::string line; std::getline(lines, line);) {
+        if (line.rfind("R\t", 0) == 0) {
+            // The last field is 1 for the squashed instructions
+            ++(line.back() == '1' ? flushed : committed);
+        }
+    }
+    EXPECT_EQ(committed, trace.instructions);
+    EXPECT_GT(flushed, 0);
+    EXPECT_LE(committed + flushed, fetched);
+    EXPECT_NE(trace.text.find("L\t3\t0\t3: ADD R0, [R1]"), std::string::npos);
+    EXPECT_NE(trace.text.find("\tMem\n"), std::string::npos);
+}
+
+TEST(TraceWriterTest, SkippedTicksGiveTheSameTrace) {
+    EXPECT_EQ(RunTraced("konata", true).text, RunTraced("konata", false).text);
+    EXPECT_EQ(RunTraced("chrome", true).text, RunTraced("chrome", false).text);
+}
+
+TEST(TraceWriterTest, ChromeTraceIsComplete) {
+    Trace trace = RunTraced("chrome", false);
+    ASSERT_EQ(trace.text.rfind("{\"displayTimeUnit\"", 0), 0);
+    EXPECT_EQ(trace.text.substr(trace.text.size() - 3), "]}\n");
+
+    std::size_t retired = 0;
+    for (std::size_t pos = 0; (pos = trace.text.find("\"cat\":\"retired\"", pos)) != std::string::npos; ++pos) {
+        ++retired;
+    }
+    EXPECT_EQ(retired, trace.instructions);
+    EXPECT_NE(trace.text.find("\"name\":\"6: JL 2\""), std::string::npos);
+    EXPECT_NE(trace.text.find("\"name\":\"flush\""), std::string::npos);
+}
+
+TEST(TraceWriterTest, UnknownFormat) {
+    EXPECT_THROW(TraceWriter::create("vcd", std::make_unique<std::ostringstream>()), std::invalid_argument);
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <sstream>
+#include <string>
+
+#include "t86/cpu.h"
+#include "t86/utils/stats_logger.h"
+#include "t86-parser/parser.h"
+
+// Sums the memory in a loop with calls, then prints the sum
+inline const char* loop = R"(
+.text
+0 MOV R0, 0
+1 MOV R1, 0
+2 MOV [R0], R0
+3 INC R0
+4 CMP R0, 500
+5 JL 2
+6 MOV R0, 0
+7 PUSH R0
+8 CALL 15
+9 POP R2
+10 INC R0
+11 CMP R0, 500
+12 JL 7
+13 PUTNUM R1
+14 HALT
+15 MOV R3, [SP + 1]
+16 ADD R1, [R3]
+17 RET
+)";
+
+inline constexpr std::size_t loopInstructions = 2 + 4 * 500 + 1 + 9 * 500 + 2;
+
+inline const char* loopOutput = "124750\n";
+
+inline tiny::t86::Program Parse(const std::string& source) {
+    std::istringstream iss{source};
+    Parser parser(iss);
+    return parser.Parse();
+}
+
+/// Context of a cpu with its own stats, output and input.
+struct Sink {
+    explicit Sink(tiny::t86::StatsLogger::Level level = tiny::t86::StatsLogger::Level::Off, const std::string& in = "")
+            : input(in) {
+        stats.setLevel(level);
+        context.stats = &stats;
+        context.output = &output;
+        context.input = &input;
+    }
+
+    explicit Sink(const std::string& in) : Sink(tiny::t86::StatsLogger::Level::Off, in) {}
+
+    tiny::t86::StatsLogger stats;
+    std::istringstream input;
+    std::ostringstream output;
+    tiny::t86::Cpu::Context context;
+};
+
+inline std::string TempFile(const std::string& name) {
+    return (std::filesystem::temp_directory_path() / name).string();
+}
+
+inline void Finish(tiny::t86::Cpu& cpu) {
+    while (!cpu.halted()) {
+        cpu.tick();
+    }
+}
@@ -0,0 +1,77 @@
+#include <gtest/gtest.h>
+
+#include "t86/cpu.h"
+#include "t86/utils/stats_logger.h"
+#include "t86-parser/parser.h"
+
+#include <sstream>
+#include <stdexcept>
+
+using namespace tiny::t86;
+
+namespace {
+// Three independent chains in every iteration, a wide machine
+// can work on all of them at once
+const char* independentChains = R"(
+.text
+0 MOV R0, 0
+1 MOV R1, 0
+2 MOV R2, 0
+3 MOV R3, 20
+4 ADD R0, 1
+5 ADD R1, 2
+6 ADD R2, 3
+7 SUB R3, 1
+8 CMP R3, 0
+9 JNE 4
+10 ADD R0, R1
+11 ADD R0, R2
+12 HALT
+)";
+
+struct RunResult {
+    std::size_t ticks;
+    int64_t result;
+};
+
+RunResult RunChains(const Cpu::Widths& widths) {
+    std::istringstream iss{independentChains};
+    Parser parser(iss);
+    Program program = parser.Parse();
+
+    StatsLogger::instance().reset();
+    Cpu cpu(4, 1, 4, 16, 64, 1);
+    cpu.setWidths(widths);
+    cpu.start(std::move(program));
+    while (!cpu.halted()) {
+        cpu.tick();
+    }
+    return {StatsLogger::instance().tickCount(), cpu.getRegister(Register{0})};
+}
+
+}
+
+TEST(WidthTest, WiderMachineIsFaster) {
+    RunResult narrow = RunChains(Cpu::Widths{});
+    RunResult wide = RunChains(Cpu::Widths{4, 4, 0, 0});
+
+    EXPECT_EQ(narrow.result, 20 + 40 + 60);
+    EXPECT_EQ(wide.result, narrow.result);
+    EXPECT_LT(wide.ticks, narrow.ticks);
+}
+
+TEST(WidthTest, IssueAndRetireWidthsLimit) {
+    RunResult unlimited = RunChains(Cpu::Widths{4, 4, 0, 0});
+    RunResult singleIssue = RunChains(Cpu::Widths{4, 4, 1, 0});
+    RunResult singleRetire = RunChains(Cpu::Widths{4, 4, 0, 1});
+
+    EXPECT_EQ(singleIssue.result, unlimited.result);
+    EXPECT_EQ(singleRetire.result, unlimited.result);
+    EXPECT_GT(singleIssue.ticks, unlimited.ticks);
+    EXPECT_GT(singleRetire.ticks, unlimited.ticks);
+}
+
+TEST(WidthTest, ZeroFetchWidthIsRejected) {
+    Cpu cpu(4, 1, 4, 16, 64, 1);
+    EXPECT_THROW(cpu.setWidths(Cpu::Widths{0, 1, 0, 0}), std::invalid_argument);
+}